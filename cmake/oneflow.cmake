@@ -107,6 +107,9 @@ foreach(oneflow_single_file ${oneflow_all_src})
        "^${PROJECT_SOURCE_DIR}/oneflow/(core|user|maybe|thread)/.*_test\\.cpp$")
       # test file
       list(APPEND of_all_test_cc ${oneflow_single_file})
+    elseif("${oneflow_single_file}" MATCHES "^${PROJECT_SOURCE_DIR}/oneflow/core/.*_bench\\.cpp$")
+      # benchmark file
+      list(APPEND of_all_bench_cc ${oneflow_single_file})
     elseif(APPLE AND "${oneflow_single_file}" MATCHES
                      "^${PROJECT_SOURCE_DIR}/oneflow/core/comm_network/(epoll|ibverbs)/.*")
       # skip if macOS
@@ -347,6 +350,18 @@ if(BUILD_CUDA)
                               PROPERTIES COMPILE_FLAGS "-DCUDA_REAL_ARCHS=\"${CUDA_REAL_ARCHS}\"")
 endif()
 
+# Each of these is compiled for its own instruction set and only called after a runtime check,
+# see oneflow/core/ep/cpu/simd/simd_kernels.h
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|AMD64|amd64)$" AND NOT MSVC)
+  set(ONEFLOW_SIMD_KERNELS_DIR ${PROJECT_SOURCE_DIR}/oneflow/core/ep/cpu/simd)
+  set_property(SOURCE ${ONEFLOW_SIMD_KERNELS_DIR}/simd_kernels_sse4.cpp APPEND
+               PROPERTY COMPILE_OPTIONS "-msse4.1")
+  set_property(SOURCE ${ONEFLOW_SIMD_KERNELS_DIR}/simd_kernels_avx2.cpp APPEND
+               PROPERTY COMPILE_OPTIONS "-mavx2;-mfma;-mf16c")
+  set_property(SOURCE ${ONEFLOW_SIMD_KERNELS_DIR}/simd_kernels_avx512.cpp APPEND
+               PROPERTY COMPILE_OPTIONS "-mavx512f;-mfma;-mf16c")
+endif()
+
 if(BUILD_CUDA AND WITH_CUTLASS)
   if(CUDA_VERSION VERSION_GREATER_EQUAL "10.1")
     add_definitions(-DCUTLASS_ENABLE_TENSOR_CORE_MMA=1)
@@ -485,6 +500,20 @@ if(BUILD_TESTING)
   endif()
 endif()
 
+# build benchmark
+if(BUILD_BENCHMARK)
+  foreach(bench_cc ${of_all_bench_cc})
+    get_filename_component(bench_name ${bench_cc} NAME_WE)
+    oneflow_add_executable(oneflow_${bench_name} ${bench_cc})
+    target_link_libraries(oneflow_${bench_name} ${of_libs} ${oneflow_third_party_libs} glog::glog)
+    if(BUILD_CUDA)
+      target_link_libraries(oneflow_${bench_name} CUDA::cudart_static)
+    endif()
+    set_target_properties(oneflow_${bench_name} PROPERTIES RUNTIME_OUTPUT_DIRECTORY
+                                                           "${PROJECT_BINARY_DIR}/bin")
+  endforeach()
+endif()
+
 # build include
 add_custom_target(of_include_copy ALL)
 
@@ -181,6 +181,20 @@ if(BUILD_RDMA)
   endif()
 endif()
 
+if(WITH_LIBURING)
+  if(UNIX AND NOT APPLE)
+    include(CheckIncludeFiles)
+    check_include_files(liburing.h HAVE_LIBURING_H)
+    find_library(LIBURING_LIBRARY NAMES uring)
+    if(HAVE_LIBURING_H AND LIBURING_LIBRARY)
+      list(APPEND oneflow_third_party_libs ${LIBURING_LIBRARY})
+      add_definitions(-DWITH_LIBURING)
+    else()
+      message(STATUS "liburing not found, io_uring support is disabled")
+    endif()
+  endif()
+endif()
+
 if(BUILD_HWLOC)
   list(APPEND oneflow_third_party_dependencies hwloc)
   list(APPEND oneflow_third_party_libs ${ONEFLOW_HWLOC_STATIC_LIBRARIES})
@@ -16,6 +16,7 @@ limitations under the License.
 #include <pybind11/pybind11.h>
 #include "oneflow/api/python/of_api_registry.h"
 #include "oneflow/core/profiler/profiler.h"
+#include "oneflow/core/profiler/counter.h"
 
 namespace py = pybind11;
 
@@ -37,6 +38,8 @@ ONEFLOW_API_PYBIND11_MODULE("profiler", m) {
   m.def("StartRecord", &profiler::StartRecord);
 
   m.def("EndRecord", &profiler::EndRecord);
+
+  m.def("DumpCounters", &profiler::DumpCountersJson);
 }
 
 }  // namespace oneflow
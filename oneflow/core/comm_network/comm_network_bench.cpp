@@ -0,0 +1,458 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+// Microbenchmark of the host communication stack: one-sided reads of the epoll CommNet,
+// Transport::Send/Receive and the CPU collectives of ccl, run by several processes on localhost.
+//
+//   oneflow_comm_network_bench --ranks=4 --min_bytes=8 --max_bytes=67108864 --iters=100 \
+//       --transport=net --ops=comm_net,transport,all_reduce
+//
+// Without RANK in the environment the program forks --ranks processes itself, otherwise it runs
+// as the given rank and expects MASTER_ADDR, MASTER_PORT and WORLD_SIZE like the C++ API does.
+// Rank 0 (rank 1 for comm_net) prints bandwidth, p50/p99 latency and the CPU time the whole
+// process spent per byte, followed by the runtime counters.
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/common/singleton.h"
+#include "oneflow/core/common/symbol.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/framework/transport_token.h"
+#include "oneflow/core/job/env.pb.h"
+#include "oneflow/core/job/env_global_objects_scope.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/profiler/counter.h"
+#include "oneflow/core/thread/thread_global_id.h"
+#include "oneflow/user/kernels/collective_communication/include/all_gather.h"
+#include "oneflow/user/kernels/collective_communication/include/all_reduce.h"
+#include "oneflow/user/kernels/collective_communication/include/broadcast.h"
+#include "oneflow/user/kernels/collective_communication/include/communication_context.h"
+#include "oneflow/user/kernels/collective_communication/include/reduce.h"
+#include "oneflow/user/kernels/collective_communication/include/reduce_scatter.h"
+#ifdef __linux__
+#include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/transport/transport.h"
+#endif  // __linux__
+
+namespace oneflow {
+
+namespace {
+
+struct BenchOptions {
+  int64_t ranks = 2;
+  int64_t min_bytes = 8;
+  int64_t max_bytes = 64 << 20;
+  int64_t iters = 100;
+  int64_t warmup = 10;
+  // "shm" keeps the default routing, "net" sends everything through the epoll CommNet.
+  std::string transport = "shm";
+  std::set<std::string> ops{"comm_net",   "transport", "all_reduce", "reduce_scatter",
+                            "all_gather", "broadcast", "reduce"};
+};
+
+bool ParseOptions(int argc, char** argv, BenchOptions* opts) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t pos = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || pos == std::string::npos) { return false; }
+    const std::string key = arg.substr(2, pos - 2);
+    const std::string value = arg.substr(pos + 1);
+    if (key == "ranks") {
+      opts->ranks = std::stoll(value);
+    } else if (key == "min_bytes") {
+      opts->min_bytes = std::stoll(value);
+    } else if (key == "max_bytes") {
+      opts->max_bytes = std::stoll(value);
+    } else if (key == "iters") {
+      opts->iters = std::stoll(value);
+    } else if (key == "warmup") {
+      opts->warmup = std::stoll(value);
+    } else if (key == "transport") {
+      opts->transport = value;
+    } else if (key == "ops") {
+      opts->ops.clear();
+      size_t begin = 0;
+      while (begin <= value.size()) {
+        const size_t end = std::min(value.find(',', begin), value.size());
+        if (end > begin) { opts->ops.insert(value.substr(begin, end - begin)); }
+        begin = end + 1;
+      }
+    } else {
+      return false;
+    }
+  }
+  return opts->ranks >= 2 && opts->min_bytes > 0 && opts->max_bytes >= opts->min_bytes
+         && opts->iters > 0 && opts->warmup >= 0
+         && (opts->transport == "shm" || opts->transport == "net");
+}
+
+int64_t NowNs() {
+  struct timespec t {};
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+// CPU time of every thread of this process, including the poller threads doing the actual I/O.
+int64_t ProcessCpuNs() {
+  struct timespec t {};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+std::vector<int64_t> MessageSizes(const BenchOptions& opts) {
+  std::vector<int64_t> sizes;
+  for (int64_t size = opts.min_bytes; size <= opts.max_bytes; size *= 2) { sizes.push_back(size); }
+  return sizes;
+}
+
+void PrintHeader(const std::string& title) {
+  std::printf("\n# %s\n", title.c_str());
+  std::printf("%14s %8s %12s %12s %12s %12s %12s\n", "bytes", "iters", "p50(us)", "p99(us)",
+              "algbw(GB/s)", "busbw(GB/s)", "cpu(ns/B)");
+}
+
+// `bus_factor` converts the algorithm bandwidth into the bandwidth each link has to sustain, as
+// nccl-tests does, so that results of different collectives and rank counts are comparable.
+void PrintResult(int64_t bytes, std::vector<int64_t> ns, int64_t cpu_ns, double bus_factor) {
+  std::sort(ns.begin(), ns.end());
+  const size_t n = ns.size();
+  const int64_t p50 = ns[n / 2];
+  const int64_t p99 = ns[std::min(n - 1, n * 99 / 100)];
+  int64_t total = 0;
+  for (int64_t t : ns) { total += t; }
+  const double algbw = static_cast<double>(bytes) * n / total;
+  std::printf("%14ld %8zu %12.2f %12.2f %12.3f %12.3f %12.3f\n", bytes, n, p50 / 1e3, p99 / 1e3,
+              algbw, algbw * bus_factor, static_cast<double>(cpu_ns) / (bytes * n));
+  std::fflush(stdout);
+}
+
+class BenchTokenSeq final {
+ public:
+  // Tokens of the meta type aren't used by anything else in this program, so the sequence can't
+  // collide with the data tokens of the collectives.
+  BenchTokenSeq(int64_t src_rank, int64_t dst_rank)
+      : token_(CHECK_JUST(TransportToken::NewTransportToken(kTransportTokenTypeMeta))) {
+    CHECK_JUST(token_.set_src_rank(src_rank));
+    CHECK_JUST(token_.set_dst_rank(dst_rank));
+  }
+
+  uint64_t Next() { return static_cast<uint64_t>(++token_); }
+
+ private:
+  TransportToken token_;
+};
+
+class Collectives final {
+ public:
+  explicit Collectives(int64_t world_size) {
+    ParallelConf parallel_conf;
+    parallel_conf.set_device_tag("cpu");
+    parallel_conf.add_device_name("0-" + std::to_string(world_size - 1) + ":0");
+    communication_ctx_ =
+        ccl::NewCommunicationContext(DeviceType::kCPU, SymbolOf(ParallelDesc(parallel_conf)));
+    all_reduce_ = ccl::NewCollectiveCommunication<ccl::AllReduce>(DeviceType::kCPU,
+                                                                  DataType::kFloat, ccl::kSum);
+    reduce_scatter_ = ccl::NewCollectiveCommunication<ccl::ReduceScatter>(
+        DeviceType::kCPU, DataType::kFloat, ccl::kSum);
+    all_gather_ =
+        ccl::NewCollectiveCommunication<ccl::AllGather>(DeviceType::kCPU, DataType::kFloat);
+    broadcast_ =
+        ccl::NewCollectiveCommunication<ccl::Broadcast>(DeviceType::kCPU, DataType::kFloat);
+    reduce_ = ccl::NewCollectiveCommunication<ccl::Reduce>(DeviceType::kCPU, DataType::kFloat,
+                                                           ccl::kSum);
+  }
+
+  void Barrier() const {
+    float value = 0;
+    all_reduce_->Launch(nullptr, &value, &value, 1, communication_ctx_);
+  }
+
+  // Runs the collective `op` over a tensor of `bytes` bytes in total.
+  void Run(const std::string& op, int64_t bytes, float* in, float* out) const {
+    const int64_t world_size = GlobalProcessCtx::WorldSize();
+    const size_t elem_cnt = bytes / sizeof(float);
+    if (op == "all_reduce") {
+      all_reduce_->Launch(nullptr, in, out, elem_cnt, communication_ctx_);
+    } else if (op == "reduce_scatter") {
+      reduce_scatter_->Launch(nullptr, in, out, elem_cnt / world_size, communication_ctx_);
+    } else if (op == "all_gather") {
+      all_gather_->Launch(nullptr, in, out, elem_cnt / world_size, communication_ctx_);
+    } else if (op == "broadcast") {
+      broadcast_->Launch(nullptr, in, out, elem_cnt, 0, communication_ctx_);
+    } else if (op == "reduce") {
+      reduce_->Launch(nullptr, in, out, elem_cnt, 0, communication_ctx_);
+    } else {
+      UNIMPLEMENTED() << op;
+    }
+  }
+
+  static double BusFactor(const std::string& op, int64_t world_size) {
+    if (op == "all_reduce") { return 2.0 * (world_size - 1) / world_size; }
+    if (op == "reduce_scatter" || op == "all_gather") {
+      return static_cast<double>(world_size - 1) / world_size;
+    }
+    return 1.0;
+  }
+
+ private:
+  std::shared_ptr<ccl::CommunicationContext> communication_ctx_;
+  std::unique_ptr<ccl::AllReduce> all_reduce_;
+  std::unique_ptr<ccl::ReduceScatter> reduce_scatter_;
+  std::unique_ptr<ccl::AllGather> all_gather_;
+  std::unique_ptr<ccl::Broadcast> broadcast_;
+  std::unique_ptr<ccl::Reduce> reduce_;
+};
+
+#ifdef __linux__
+
+void TransportSend(BenchTokenSeq* seq, int64_t dst, const void* ptr, size_t size,
+                   BlockingCounter* counter) {
+  Singleton<Transport>::Get()->Send(seq->Next(), dst, ptr, size, [counter]() {
+    counter->Decrease();
+  });
+}
+
+void TransportReceive(BenchTokenSeq* seq, int64_t src, void* ptr, size_t size,
+                      BlockingCounter* counter) {
+  Singleton<Transport>::Get()->Receive(seq->Next(), src, ptr, size, [counter]() {
+    counter->Decrease();
+  });
+}
+
+// Ping-pong between rank 0 and rank 1, half of the round trip is reported by rank 0.
+void BenchTransport(const BenchOptions& opts, const Collectives& collectives) {
+  const int64_t rank = GlobalProcessCtx::Rank();
+  const int64_t peer = 1 - rank;
+  if (rank == 0) { PrintHeader("Transport::Send/Receive ping-pong, rank 0 <-> rank 1"); }
+  std::vector<char> send_buffer(opts.max_bytes, 1);
+  std::vector<char> recv_buffer(opts.max_bytes);
+  for (int64_t bytes : MessageSizes(opts)) {
+    collectives.Barrier();
+    if (rank > 1) { continue; }
+    BenchTokenSeq send_seq(rank, peer);
+    BenchTokenSeq recv_seq(peer, rank);
+    std::vector<int64_t> ns;
+    int64_t cpu_ns = 0;
+    for (int64_t i = 0; i < opts.warmup + opts.iters; ++i) {
+      const int64_t start = NowNs();
+      const int64_t cpu_start = ProcessCpuNs();
+      if (rank == 0) {
+        BlockingCounter send_counter(1);
+        TransportSend(&send_seq, peer, send_buffer.data(), bytes, &send_counter);
+        BlockingCounter recv_counter(1);
+        TransportReceive(&recv_seq, peer, recv_buffer.data(), bytes, &recv_counter);
+        send_counter.WaitForeverUntilCntEqualZero();
+        recv_counter.WaitForeverUntilCntEqualZero();
+      } else {
+        BlockingCounter recv_counter(1);
+        TransportReceive(&recv_seq, peer, recv_buffer.data(), bytes, &recv_counter);
+        recv_counter.WaitForeverUntilCntEqualZero();
+        BlockingCounter send_counter(1);
+        TransportSend(&send_seq, peer, send_buffer.data(), bytes, &send_counter);
+        send_counter.WaitForeverUntilCntEqualZero();
+      }
+      if (i >= opts.warmup) {
+        ns.push_back((NowNs() - start) / 2);
+        cpu_ns += (ProcessCpuNs() - cpu_start) / 2;
+      }
+    }
+    if (rank == 0) { PrintResult(bytes, ns, cpu_ns, 1.0); }
+  }
+}
+
+// One-sided reads of the epoll CommNet: rank 1 reads a buffer registered by rank 0. The memory
+// tokens are exchanged over the transport, which is left out of the measurement.
+void BenchCommNet(const BenchOptions& opts, const Collectives& collectives) {
+  const int64_t rank = GlobalProcessCtx::Rank();
+  EpollCommNet* comm_net = Singleton<EpollCommNet>::Get();
+  if (rank == 1) { PrintHeader("EpollCommNet one-sided read, rank 1 reads from rank 0"); }
+  std::vector<char> buffer(opts.max_bytes, 1);
+  for (int64_t bytes : MessageSizes(opts)) {
+    collectives.Barrier();
+    if (rank > 1) { continue; }
+    void* mem_token = comm_net->RegisterMemory(buffer.data(), bytes);
+    BenchTokenSeq seq(0, 1);
+    uint64_t src_mem_token = reinterpret_cast<uint64_t>(mem_token);
+    BlockingCounter token_counter(1);
+    if (rank == 0) {
+      TransportSend(&seq, 1, &src_mem_token, sizeof(src_mem_token), &token_counter);
+    } else {
+      TransportReceive(&seq, 0, &src_mem_token, sizeof(src_mem_token), &token_counter);
+    }
+    token_counter.WaitForeverUntilCntEqualZero();
+    if (rank == 1) {
+      void* read_id = comm_net->NewActorReadId();
+      std::vector<int64_t> ns;
+      int64_t cpu_ns = 0;
+      for (int64_t i = 0; i < opts.warmup + opts.iters; ++i) {
+        const int64_t start = NowNs();
+        const int64_t cpu_start = ProcessCpuNs();
+        BlockingCounter read_counter(1);
+        comm_net->Read(read_id, 0, reinterpret_cast<void*>(src_mem_token), mem_token);
+        comm_net->AddReadCallBack(read_id, [&read_counter]() { read_counter.Decrease(); });
+        read_counter.WaitForeverUntilCntEqualZero();
+        if (i >= opts.warmup) {
+          ns.push_back(NowNs() - start);
+          cpu_ns += ProcessCpuNs() - cpu_start;
+        }
+      }
+      comm_net->DeleteActorReadId(read_id);
+      PrintResult(bytes, ns, cpu_ns, 1.0);
+    }
+    // Rank 0 may unregister its buffer only after the reads of rank 1 are done.
+    uint64_t done = 0;
+    BlockingCounter done_counter(1);
+    if (rank == 1) {
+      TransportSend(&seq, 0, &done, sizeof(done), &done_counter);
+    } else {
+      TransportReceive(&seq, 1, &done, sizeof(done), &done_counter);
+    }
+    done_counter.WaitForeverUntilCntEqualZero();
+    comm_net->UnRegisterMemory(mem_token);
+  }
+}
+
+#endif  // __linux__
+
+void BenchCollective(const BenchOptions& opts, const Collectives& collectives,
+                     const std::string& op) {
+  const int64_t rank = GlobalProcessCtx::Rank();
+  const int64_t world_size = GlobalProcessCtx::WorldSize();
+  if (rank == 0) { PrintHeader("ccl cpu " + op + ", " + std::to_string(world_size) + " ranks"); }
+  std::vector<float> in(opts.max_bytes / sizeof(float), 1.0f);
+  std::vector<float> out(opts.max_bytes / sizeof(float));
+  for (int64_t bytes : MessageSizes(opts)) {
+    // reduce_scatter and all_gather need at least one element on every rank.
+    if (bytes < world_size * static_cast<int64_t>(sizeof(float))) { continue; }
+    const int64_t rounded_bytes = bytes / (world_size * sizeof(float)) * world_size * sizeof(float);
+    collectives.Barrier();
+    std::vector<int64_t> ns;
+    int64_t cpu_ns = 0;
+    for (int64_t i = 0; i < opts.warmup + opts.iters; ++i) {
+      const int64_t start = NowNs();
+      const int64_t cpu_start = ProcessCpuNs();
+      collectives.Run(op, rounded_bytes, in.data(), out.data());
+      if (i >= opts.warmup) {
+        ns.push_back(NowNs() - start);
+        cpu_ns += ProcessCpuNs() - cpu_start;
+      }
+    }
+    if (rank == 0) {
+      PrintResult(rounded_bytes, ns, cpu_ns, Collectives::BusFactor(op, world_size));
+    }
+  }
+}
+
+int RunRank(const BenchOptions& opts) {
+  EnvProto env_proto;
+  auto* bootstrap_conf = env_proto.mutable_ctrl_bootstrap_conf();
+  const char* master_addr = std::getenv("MASTER_ADDR");
+  bootstrap_conf->mutable_master_addr()->set_host(master_addr ? master_addr : "127.0.0.1");
+  bootstrap_conf->mutable_master_addr()->set_port(std::atoi(std::getenv("MASTER_PORT")));
+  bootstrap_conf->set_world_size(std::atoll(std::getenv("WORLD_SIZE")));
+  bootstrap_conf->set_rank(std::atoll(std::getenv("RANK")));
+  {
+    EnvGlobalObjectsScope env_scope(env_proto);
+    ThreadGlobalIdGuard thread_global_id_guard(kThreadGlobalIdMain);
+    Collectives collectives(GlobalProcessCtx::WorldSize());
+#ifdef __linux__
+    if (opts.ops.count("comm_net") > 0) { BenchCommNet(opts, collectives); }
+    if (opts.ops.count("transport") > 0) { BenchTransport(opts, collectives); }
+#endif  // __linux__
+    for (const std::string op : {"all_reduce", "reduce_scatter", "all_gather", "broadcast",
+                                 "reduce"}) {
+      if (opts.ops.count(op) > 0) { BenchCollective(opts, collectives, op); }
+    }
+    collectives.Barrier();
+    if (GlobalProcessCtx::Rank() == 0) {
+      std::printf("\n# counters of rank 0\n%s\n", profiler::DumpCountersJson().c_str());
+      std::fflush(stdout);
+    }
+    collectives.Barrier();
+  }
+  return 0;
+}
+
+int32_t FindFreePort() {
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  PCHECK(sock >= 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  PCHECK(bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+  socklen_t len = sizeof(addr);
+  PCHECK(getsockname(sock, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0);
+  close(sock);
+  return ntohs(addr.sin_port);
+}
+
+// Forks one process per rank, all of them on this host.
+int LaunchRanks(const BenchOptions& opts) {
+  const std::string port = std::to_string(FindFreePort());
+  std::vector<pid_t> pids;
+  for (int64_t rank = 0; rank < opts.ranks; ++rank) {
+    const pid_t pid = fork();
+    PCHECK(pid >= 0);
+    if (pid == 0) {
+      setenv("MASTER_ADDR", "127.0.0.1", 1);
+      setenv("MASTER_PORT", port.c_str(), 1);
+      setenv("WORLD_SIZE", std::to_string(opts.ranks).c_str(), 1);
+      setenv("RANK", std::to_string(rank).c_str(), 1);
+      _exit(RunRank(opts));
+    }
+    pids.push_back(pid);
+  }
+  int ret = 0;
+  for (pid_t pid : pids) {
+    int status = 0;
+    PCHECK(waitpid(pid, &status, 0) == pid);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) { ret = 1; }
+  }
+  return ret;
+}
+
+}  // namespace
+
+}  // namespace oneflow
+
+int main(int argc, char** argv) {
+  oneflow::BenchOptions opts;
+  if (!oneflow::ParseOptions(argc, argv, &opts)) {
+    std::fprintf(stderr,
+                 "usage: %s [--ranks=N] [--min_bytes=B] [--max_bytes=B] [--iters=N] "
+                 "[--warmup=N] [--transport=shm|net] [--ops=comm_net,transport,all_reduce,"
+                 "reduce_scatter,all_gather,broadcast,reduce]\n",
+                 argv[0]);
+    return 1;
+  }
+  // Read when the Transport is created, so it has to be set before any rank starts.
+  if (opts.transport == "net") { setenv("ONEFLOW_TRANSPORT_USE_SHM", "0", 1); }
+  if (std::getenv("RANK") != nullptr) {
+    opts.ranks = std::atoll(std::getenv("WORLD_SIZE"));
+    return oneflow::RunRank(opts);
+  }
+  return oneflow::LaunchRanks(opts);
+}
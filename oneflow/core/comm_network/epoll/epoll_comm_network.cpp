@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
 #include "glog/logging.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/env_var/env_var.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/resource_desc.h"
@@ -68,6 +70,42 @@ int SockListen(int listen_sockfd, int32_t* listen_port, int32_t total_machine_nu
   return bind_result;
 }
 
+void SetSockOpts(int sockfd) {
+  const int val = 1;
+  PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+#ifdef SO_BUSY_POLL
+  const int busy_poll_usecs = EnvInteger<ONEFLOW_COMM_NET_BUSY_POLL_USECS>();
+  if (busy_poll_usecs > 0
+      && setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_usecs, sizeof(int)) != 0) {
+    PLOG(WARNING) << "CommNet:Epoll can't busy poll sockfd " << sockfd;
+  }
+#endif
+}
+
+// The handshake goes over blocking sockets, which may transfer it in several parts.
+void WriteFully(int sockfd, const void* buf, size_t size) {
+  const char* ptr = static_cast<const char*>(buf);
+  while (size > 0) {
+    const ssize_t n = write(sockfd, ptr, size);
+    if (n == -1 && errno == EINTR) { continue; }
+    PCHECK(n > 0) << "sockfd " << sockfd;
+    ptr += n;
+    size -= n;
+  }
+}
+
+void ReadFully(int sockfd, void* buf, size_t size) {
+  char* ptr = static_cast<char*>(buf);
+  while (size > 0) {
+    const ssize_t n = read(sockfd, ptr, size);
+    if (n == -1 && errno == EINTR) { continue; }
+    PCHECK(n != -1) << "sockfd " << sockfd;
+    CHECK_GT(n, 0) << "sockfd " << sockfd << " closed by peer during the handshake";
+    ptr += n;
+    size -= n;
+  }
+}
+
 std::string GenPortKey(int64_t machine_id) { return "EpollPort/" + std::to_string(machine_id); }
 void PushPort(int64_t machine_id, uint16_t port) {
   Singleton<CtrlClient>::Get()->PushKV(GenPortKey(machine_id), std::to_string(port));
@@ -101,7 +139,7 @@ void EpollCommNet::SendActorMsg(int64_t dst_machine_id, const ActorMsg& actor_ms
   if (actor_msg.IsDataRegstMsgToConsumer()) {
     msg.actor_msg.set_comm_net_token(actor_msg.regst()->comm_net_token());
   }
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  GetSocketHelper(dst_machine_id, 0)->AsyncWrite(msg);
 }
 
 void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg& transport_msg) {
@@ -112,7 +150,28 @@ void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg&
 }
 
 void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  if (msg.msg_type != SocketMsgType::kRequestRead) {
+    GetSocketHelper(dst_machine_id, 0)->AsyncWrite(msg);
+    return;
+  }
+  // Large data is split over the sockets to the peer, smaller reads take turns on them.
+  const int64_t socket_num = machine_id2sockfds_.at(dst_machine_id).size();
+  const int64_t byte_size =
+      static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token)->byte_size;
+  const int64_t piece_num = GetStripePieceNum(byte_size, socket_num, stripe_min_bytes_);
+  const int64_t first_socket_idx = next_socket_idx_.fetch_add(piece_num) % socket_num;
+  BalancedSplitter bs(byte_size, piece_num);
+  FOR_RANGE(int64_t, i, 0, piece_num) {
+    SocketMsg piece = msg;
+    piece.request_read_msg.offset = bs.At(i).begin();
+    piece.request_read_msg.size = bs.At(i).size();
+    piece.request_read_msg.piece_num = piece_num;
+    GetSocketHelper(dst_machine_id, (first_socket_idx + i) % socket_num)->AsyncWrite(piece);
+  }
+}
+
+void EpollCommNet::ReadPieceDone(void* read_id, int64_t piece_num) {
+  if (read_piece_counter_.PieceArrived(read_id, piece_num)) { ReadDone(read_id); }
 }
 
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
@@ -122,7 +181,8 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
   return mem_desc;
 }
 
-EpollCommNet::EpollCommNet() : CommNetIf() {
+EpollCommNet::EpollCommNet() : CommNetIf(), next_socket_idx_(0) {
+  stripe_min_bytes_ = std::max<int64_t>(EnvInteger<ONEFLOW_COMM_NET_STRIPE_MIN_BYTES>(), 1);
   pollers_.resize(Singleton<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
@@ -133,7 +193,8 @@ void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Singleton<ResourceDesc, ForSession>::Get()->process_ranks().size();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  const int64_t socket_num = std::max<int64_t>(EnvInteger<ONEFLOW_COMM_NET_SOCKETS_PER_PEER>(), 1);
+  machine_id2sockfds_.assign(total_machine_num, std::vector<int>(socket_num, -1));
   sockfd2helper_.clear();
   size_t poller_idx = 0;
   auto NewSocketHelper = [&](int sockfd) {
@@ -152,7 +213,7 @@ void EpollCommNet::InitSockets() {
       this_listen_port = Singleton<EnvDesc>::Get()->data_port();
     }
   }
-  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num), 0);
+  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num * socket_num), 0);
   CHECK_NE(this_listen_port, 0);
   PushPort(this_machine_id, this_listen_port);
   int32_t src_machine_count = 0;
@@ -166,42 +227,50 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    ssize_t n = write(sockfd, &this_machine_id, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int64_t, socket_idx, 0, socket_num) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      SetSockOpts(sockfd);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      const int64_t hello[3] = {this_machine_id, socket_idx, socket_num};
+      WriteFully(sockfd, hello, sizeof(hello));
+      CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
+      machine_id2sockfds_[peer_id][socket_idx] = sockfd;
+    }
   }
 
   // accept
-  HashSet<int64_t> processed_ranks;
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int32_t, idx, 0, src_machine_count * socket_num) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
-    int64_t peer_rank;
-    ssize_t n = read(sockfd, &peer_rank, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
+    SetSockOpts(sockfd);
+    int64_t hello[3];
+    ReadFully(sockfd, hello, sizeof(hello));
+    const int64_t peer_rank = hello[0];
+    const int64_t socket_idx = hello[1];
+    CHECK_EQ(hello[2], socket_num)
+        << "ONEFLOW_COMM_NET_SOCKETS_PER_PEER differs between machine " << this_machine_id
+        << " and machine " << peer_rank;
+    CHECK_EQ(machine_id2sockfds_.at(peer_rank).at(socket_idx), -1);
     CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    CHECK(processed_ranks.emplace(peer_rank).second);
-    machine_id2sockfd_[peer_rank] = sockfd;
+    machine_id2sockfds_[peer_rank][socket_idx] = sockfd;
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    VLOG(2) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    FOR_RANGE(int64_t, socket_idx, 0, socket_num) {
+      VLOG(2) << "machine " << machine_id << " socket " << socket_idx << " sockfd "
+              << machine_id2sockfds_[machine_id][socket_idx];
+    }
   }
 }
 
-SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id, int64_t socket_idx) {
+  int sockfd = machine_id2sockfds_.at(machine_id).at(socket_idx);
   return sockfd2helper_.at(sockfd);
 }
 
@@ -212,7 +281,7 @@ void EpollCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token
   msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
   msg.request_write_msg.dst_token = dst_token;
   msg.request_write_msg.read_id = read_id;
-  GetSocketHelper(src_machine_id)->AsyncWrite(msg);
+  GetSocketHelper(src_machine_id, 0)->AsyncWrite(msg);
 }
 
 }  // namespace oneflow
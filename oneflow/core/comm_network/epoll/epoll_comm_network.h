@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/comm_network/comm_network.h"
 #include "oneflow/core/comm_network/epoll/socket_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/comm_network/epoll/socket_stripe.h"
 
 namespace oneflow {
 
@@ -32,6 +33,8 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
   void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  // One of the piece_num parts of the data of read_id has arrived.
+  void ReadPieceDone(void* read_id, int64_t piece_num);
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -39,12 +42,18 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   friend class Singleton<EpollCommNet>;
   EpollCommNet();
   void InitSockets();
-  SocketHelper* GetSocketHelper(int64_t machine_id);
+  SocketHelper* GetSocketHelper(int64_t machine_id, int64_t socket_idx);
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  // There are ONEFLOW_COMM_NET_SOCKETS_PER_PEER sockets to every peer. The data of the reads is
+  // spread over all of them, the other messages keep their order on the first one.
+  std::vector<std::vector<int>> machine_id2sockfds_;
   HashMap<int, SocketHelper*> sockfd2helper_;
+  int64_t stripe_min_bytes_;
+  std::atomic<int64_t> next_socket_idx_;
+
+  ReadPieceCounter read_piece_counter_;
 };
 
 }  // namespace oneflow
@@ -16,7 +16,9 @@ limitations under the License.
 #ifdef __linux__
 
 #include "oneflow/core/comm_network/epoll/io_event_poller.h"
+#include "oneflow/core/common/env_var/env_var.h"
 #include <sys/eventfd.h>
+#include <sys/ioctl.h>
 
 namespace oneflow {
 
@@ -29,6 +31,17 @@ IOEventPoller::IOEventPoller() {
   break_epoll_loop_fd_ = eventfd(0, 0);
   PCHECK(break_epoll_loop_fd_ != -1);
   AddFdWithOnlyReadHandler(break_epoll_loop_fd_, []() { VLOG(1) << "Break Epoll Loop"; });
+#ifdef EPIOCSPARAMS
+  // Let epoll_wait busy poll the device queues before it sleeps, if the kernel supports it.
+  const int64_t busy_poll_usecs = EnvInteger<ONEFLOW_COMM_NET_BUSY_POLL_USECS>();
+  if (busy_poll_usecs > 0) {
+    epoll_params params{};
+    params.busy_poll_usecs = busy_poll_usecs;
+    if (ioctl(epfd_, EPIOCSPARAMS, &params) != 0) {
+      PLOG(WARNING) << "IOEventPoller can't busy poll for " << busy_poll_usecs << "us";
+    }
+  }
+#endif
 }
 
 IOEventPoller::~IOEventPoller() {
@@ -42,11 +55,17 @@ IOEventPoller::~IOEventPoller() {
 
 void IOEventPoller::AddFd(int fd, std::function<void()> read_handler,
                           std::function<void()> write_handler) {
-  AddFd(fd, &read_handler, &write_handler);
+  AddFd(fd, &read_handler, &write_handler, nullptr);
+}
+
+void IOEventPoller::AddFd(int fd, std::function<void()> read_handler,
+                          std::function<void()> write_handler,
+                          std::function<void()> error_handler) {
+  AddFd(fd, &read_handler, &write_handler, &error_handler);
 }
 
 void IOEventPoller::AddFdWithOnlyReadHandler(int fd, std::function<void()> read_handler) {
-  AddFd(fd, &read_handler, nullptr);
+  AddFd(fd, &read_handler, nullptr, nullptr);
 }
 
 void IOEventPoller::Start() { thread_ = std::thread(&IOEventPoller::EpollLoop, this); }
@@ -58,7 +77,8 @@ void IOEventPoller::Stop() {
 }
 
 void IOEventPoller::AddFd(int fd, std::function<void()>* read_handler,
-                          std::function<void()>* write_handler) {
+                          std::function<void()>* write_handler,
+                          std::function<void()>* error_handler) {
   // Set Fd NONBLOCK
   int opt = fcntl(fd, F_GETFL);
   PCHECK(opt != -1);
@@ -71,6 +91,7 @@ void IOEventPoller::AddFd(int fd, std::function<void()>* read_handler,
   IOHandler* io_handler = new IOHandler;
   if (read_handler) { io_handler->read_handler = *read_handler; }
   if (write_handler) { io_handler->write_handler = *write_handler; }
+  if (error_handler) { io_handler->error_handler = *error_handler; }
   io_handler->fd = fd;
   io_handlers_.push_front(io_handler);
   // Add Fd to Epoll
@@ -92,8 +113,10 @@ void IOEventPoller::EpollLoop() {
     const epoll_event* cur_event = ep_events_;
     for (int event_idx = 0; event_idx < event_num; ++event_idx, ++cur_event) {
       auto io_handler = static_cast<IOHandler*>(cur_event->data.ptr);
-      PCHECK(!(cur_event->events & EPOLLERR)) << "fd: " << io_handler->fd;
+      PCHECK(!(cur_event->events & EPOLLERR) || io_handler->error_handler)
+          << "fd: " << io_handler->fd;
       if (io_handler->fd == break_epoll_loop_fd_) { return; }
+      if (cur_event->events & EPOLLERR) { io_handler->error_handler(); }
       if (cur_event->events & EPOLLIN) {
         if (cur_event->events & EPOLLRDHUP) {
           LOG(FATAL) << "fd " << io_handler->fd << " closed by peer";
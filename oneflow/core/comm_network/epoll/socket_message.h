@@ -54,10 +54,15 @@ struct RequestWriteMsg {
   void* read_id;
 };
 
+// The data of a read may be split over the sockets to the peer, each RequestReadMsg carries the
+// part [offset, offset + size) of it, and piece_num is the number of parts.
 struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  int64_t offset;
+  int64_t size;
+  int64_t piece_num;
 };
 
 struct SocketMsg {
@@ -19,17 +19,27 @@ limitations under the License.
 #include "oneflow/core/lazy/actor/actor_message_bus.h"
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
 #include "oneflow/core/transport/transport.h"
+#include "oneflow/core/profiler/counter.h"
 
 #include <netinet/tcp.h>
 
 namespace oneflow {
 
+namespace {
+
+constexpr size_t kReadBufferMsgNum = 64;
+
+}  // namespace
+
 SocketReadHelper::~SocketReadHelper() {
   // do nothing
 }
 
 SocketReadHelper::SocketReadHelper(int sockfd) {
   sockfd_ = sockfd;
+  read_buffer_.resize(kReadBufferMsgNum * sizeof(SocketMsg));
+  read_buffer_begin_ = 0;
+  read_buffer_end_ = 0;
   SwitchToMsgHeadReadHandle();
 }
 
@@ -37,8 +47,8 @@ void SocketReadHelper::NotifyMeSocketReadable() { ReadUntilSocketNotReadable();
 
 void SocketReadHelper::SwitchToMsgHeadReadHandle() {
   cur_read_handle_ = &SocketReadHelper::MsgHeadReadHandle;
-  read_ptr_ = reinterpret_cast<char*>(&cur_msg_);
-  read_size_ = sizeof(cur_msg_);
+  read_ptr_ = nullptr;
+  read_size_ = 0;
 }
 
 void SocketReadHelper::ReadUntilSocketNotReadable() {
@@ -46,17 +56,50 @@ void SocketReadHelper::ReadUntilSocketNotReadable() {
 }
 
 bool SocketReadHelper::MsgHeadReadHandle() {
-  return DoCurRead(&SocketReadHelper::SetStatusWhenMsgHeadDone);
+  if (read_buffer_end_ - read_buffer_begin_ < sizeof(cur_msg_)) { return ReadIntoBuffer(); }
+  std::memcpy(&cur_msg_, read_buffer_.data() + read_buffer_begin_, sizeof(cur_msg_));
+  read_buffer_begin_ += sizeof(cur_msg_);
+  SetStatusWhenMsgHeadDone();
+  return true;
 }
 
 bool SocketReadHelper::MsgBodyReadHandle() {
+  const size_t buffered_size = std::min(read_size_, read_buffer_end_ - read_buffer_begin_);
+  if (buffered_size > 0) {
+    std::memcpy(read_ptr_, read_buffer_.data() + read_buffer_begin_, buffered_size);
+    read_buffer_begin_ += buffered_size;
+    read_ptr_ += buffered_size;
+    read_size_ -= buffered_size;
+  }
+  if (read_size_ == 0) {
+    SetStatusWhenMsgBodyDone();
+    return true;
+  }
   return DoCurRead(&SocketReadHelper::SetStatusWhenMsgBodyDone);
 }
 
+bool SocketReadHelper::ReadIntoBuffer() {
+  if (read_buffer_begin_ > 0) {
+    // Move the part of the next header to the front.
+    std::memmove(read_buffer_.data(), read_buffer_.data() + read_buffer_begin_,
+                 read_buffer_end_ - read_buffer_begin_);
+    read_buffer_end_ -= read_buffer_begin_;
+    read_buffer_begin_ = 0;
+  }
+  ssize_t n = ReadAndQuickAck(read_buffer_.data() + read_buffer_end_,
+                              read_buffer_.size() - read_buffer_end_);
+  if (n >= 0) {
+    read_buffer_end_ += n;
+    return true;
+  } else {
+    CHECK_EQ(n, -1);
+    PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+    return false;
+  }
+}
+
 bool SocketReadHelper::DoCurRead(void (SocketReadHelper::*set_cur_read_done)()) {
-  ssize_t n = read(sockfd_, read_ptr_, read_size_);
-  const int val = 1;
-  PCHECK(setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, (char*)&val, sizeof(int)) == 0);
+  ssize_t n = ReadAndQuickAck(read_ptr_, read_size_);
   if (n == read_size_) {
     (this->*set_cur_read_done)();
     return true;
@@ -71,7 +114,19 @@ bool SocketReadHelper::DoCurRead(void (SocketReadHelper::*set_cur_read_done)())
   }
 }
 
+ssize_t SocketReadHelper::ReadAndQuickAck(char* ptr, size_t size) {
+  ssize_t n = read(sockfd_, ptr, size);
+  if (n > 0) {
+    OF_COUNTER_ADD("comm_net.read_calls", 1);
+    OF_COUNTER_ADD("comm_net.received_bytes", n);
+  }
+  const int val = 1;
+  PCHECK(setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, (char*)&val, sizeof(int)) == 0);
+  return n;
+}
+
 void SocketReadHelper::SetStatusWhenMsgHeadDone() {
+  OF_COUNTER_ADD("comm_net.received_msgs", 1);
   switch (cur_msg_.msg_type) {
 #define MAKE_ENTRY(x, y) \
   case SocketMsgType::k##x: SetStatusWhen##x##MsgHeadDone(); break;
@@ -83,7 +138,8 @@ void SocketReadHelper::SetStatusWhenMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenMsgBodyDone() {
   if (cur_msg_.msg_type == SocketMsgType::kRequestRead) {
-    Singleton<EpollCommNet>::Get()->ReadDone(cur_msg_.request_read_msg.read_id);
+    Singleton<EpollCommNet>::Get()->ReadPieceDone(cur_msg_.request_read_msg.read_id,
+                                                  cur_msg_.request_read_msg.piece_num);
   }
   SwitchToMsgHeadReadHandle();
 }
@@ -101,8 +157,10 @@ void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenRequestReadMsgHeadDone() {
   auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
-  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr);
-  read_size_ = mem_desc->byte_size;
+  CHECK_LE(cur_msg_.request_read_msg.offset + cur_msg_.request_read_msg.size,
+           static_cast<int64_t>(mem_desc->byte_size));
+  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + cur_msg_.request_read_msg.offset;
+  read_size_ = cur_msg_.request_read_msg.size;
   cur_read_handle_ = &SocketReadHelper::MsgBodyReadHandle;
 }
 
@@ -22,6 +22,9 @@ limitations under the License.
 
 namespace oneflow {
 
+// SocketReadHelper reads the socket into a buffer and takes as many headers out of it as arrived
+// with one read. Bodies are read into their destination directly, after what is left of them in
+// the buffer.
 class SocketReadHelper final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SocketReadHelper);
@@ -39,7 +42,10 @@ class SocketReadHelper final {
   bool MsgHeadReadHandle();
   bool MsgBodyReadHandle();
 
+  // Returns false if the socket is not readable.
+  bool ReadIntoBuffer();
   bool DoCurRead(void (SocketReadHelper::*set_cur_read_done)());
+  ssize_t ReadAndQuickAck(char* ptr, size_t size);
   void SetStatusWhenMsgHeadDone();
   void SetStatusWhenMsgBodyDone();
 
@@ -53,6 +59,10 @@ class SocketReadHelper final {
   bool (SocketReadHelper::*cur_read_handle_)();
   char* read_ptr_;
   size_t read_size_;
+
+  std::vector<char> read_buffer_;
+  size_t read_buffer_begin_;
+  size_t read_buffer_end_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,60 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_STRIPE_H_
+#define ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_STRIPE_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// The number of pieces the data of a read is split into over socket_num sockets, at most one per
+// socket and none smaller than stripe_min_bytes, except a single one.
+inline int64_t GetStripePieceNum(int64_t byte_size, int64_t socket_num, int64_t stripe_min_bytes) {
+  return std::max<int64_t>(std::min<int64_t>(socket_num, byte_size / stripe_min_bytes), 1);
+}
+
+// ReadPieceCounter counts the pieces of the reads arriving on the sockets, which may be served by
+// different pollers.
+class ReadPieceCounter final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ReadPieceCounter);
+  ReadPieceCounter() = default;
+  ~ReadPieceCounter() = default;
+
+  // One of the piece_num pieces of read_id has arrived, returns whether it was the last one.
+  bool PieceArrived(void* read_id, int64_t piece_num) {
+    if (piece_num == 1) { return true; }
+    std::unique_lock<std::mutex> lck(mutex_);
+    int64_t* arrived_piece_num = &read_id2arrived_piece_num_[read_id];
+    *arrived_piece_num += 1;
+    if (*arrived_piece_num < piece_num) { return false; }
+    read_id2arrived_piece_num_.erase(read_id);
+    return true;
+  }
+
+  size_t pending_read_num() const {
+    std::unique_lock<std::mutex> lck(mutex_);
+    return read_id2arrived_piece_num_.size();
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  HashMap<void*, int64_t> read_id2arrived_piece_num_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_STRIPE_H_
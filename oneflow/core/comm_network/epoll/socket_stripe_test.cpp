@@ -0,0 +1,97 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/comm_network/epoll/socket_stripe.h"
+#include "oneflow/core/common/balanced_splitter.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(SocketStripe, piece_num) {
+  // Below stripe_min_bytes a read takes a single socket.
+  ASSERT_EQ(GetStripePieceNum(0, 4, 1024), 1);
+  ASSERT_EQ(GetStripePieceNum(1023, 4, 1024), 1);
+  ASSERT_EQ(GetStripePieceNum(2047, 4, 1024), 1);
+  ASSERT_EQ(GetStripePieceNum(2048, 4, 1024), 2);
+  ASSERT_EQ(GetStripePieceNum(4096, 4, 1024), 4);
+  ASSERT_EQ(GetStripePieceNum(1 << 30, 4, 1024), 4);
+  ASSERT_EQ(GetStripePieceNum(1 << 30, 1, 1024), 1);
+}
+
+TEST(SocketStripe, pieces_cover_the_read) {
+  for (int64_t socket_num : {1, 2, 3, 8}) {
+    for (int64_t byte_size : {0, 1, 999, 1000, 2999, 3001, 7777, 1 << 20}) {
+      const int64_t piece_num = GetStripePieceNum(byte_size, socket_num, 1000);
+      ASSERT_LE(piece_num, socket_num);
+      BalancedSplitter bs(byte_size, piece_num);
+      int64_t offset = 0;
+      for (int64_t i = 0; i < piece_num; ++i) {
+        ASSERT_EQ(bs.At(i).begin(), offset);
+        if (piece_num > 1) { ASSERT_GE(bs.At(i).size(), 1000); }
+        offset = bs.At(i).end();
+      }
+      ASSERT_EQ(offset, byte_size);
+    }
+  }
+}
+
+TEST(ReadPieceCounter, single_piece) {
+  ReadPieceCounter counter;
+  int read_id = 0;
+  ASSERT_TRUE(counter.PieceArrived(&read_id, 1));
+  ASSERT_TRUE(counter.PieceArrived(&read_id, 1));
+  ASSERT_EQ(counter.pending_read_num(), 0);
+}
+
+TEST(ReadPieceCounter, interleaved_reads) {
+  ReadPieceCounter counter;
+  int read_ids[2];
+  ASSERT_FALSE(counter.PieceArrived(&read_ids[0], 3));
+  ASSERT_FALSE(counter.PieceArrived(&read_ids[1], 2));
+  ASSERT_FALSE(counter.PieceArrived(&read_ids[0], 3));
+  ASSERT_EQ(counter.pending_read_num(), 2);
+  ASSERT_TRUE(counter.PieceArrived(&read_ids[1], 2));
+  ASSERT_TRUE(counter.PieceArrived(&read_ids[0], 3));
+  ASSERT_EQ(counter.pending_read_num(), 0);
+  // A read id is reused by the next read once it is done.
+  ASSERT_FALSE(counter.PieceArrived(&read_ids[0], 2));
+  ASSERT_TRUE(counter.PieceArrived(&read_ids[0], 2));
+}
+
+TEST(ReadPieceCounter, pieces_from_several_pollers) {
+  constexpr int kReadNum = 1000;
+  constexpr int kPollerNum = 4;
+  ReadPieceCounter counter;
+  std::vector<int> read_ids(kReadNum);
+  std::vector<std::atomic<int>> done_num(kReadNum);
+  std::vector<std::thread> pollers;
+  for (int i = 0; i < kPollerNum; ++i) {
+    pollers.emplace_back([&]() {
+      for (int j = 0; j < kReadNum; ++j) {
+        if (counter.PieceArrived(&read_ids.at(j), kPollerNum)) { done_num.at(j) += 1; }
+      }
+    });
+  }
+  for (auto& poller : pollers) { poller.join(); }
+  for (int j = 0; j < kReadNum; ++j) { ASSERT_EQ(done_num.at(j), 1); }
+  ASSERT_EQ(counter.pending_read_num(), 0);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
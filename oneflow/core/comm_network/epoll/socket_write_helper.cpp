@@ -17,11 +17,31 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/socket_write_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/common/env_var/env_var.h"
+#include "oneflow/core/profiler/counter.h"
 
 #include <sys/eventfd.h>
 
 namespace oneflow {
 
+namespace {
+
+constexpr int kMaxIovNum = 64;
+
+// Only RequestRead messages are followed by a body, which is a part of the registered memory.
+void GetMsgBody(const SocketMsg& msg, const char** body, size_t* body_size) {
+  if (msg.msg_type == SocketMsgType::kRequestRead) {
+    auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+    *body = reinterpret_cast<const char*>(src_mem_desc->mem_ptr) + msg.request_read_msg.offset;
+    *body_size = msg.request_read_msg.size;
+  } else {
+    *body = nullptr;
+    *body_size = 0;
+  }
+}
+
+}  // namespace
+
 SocketWriteHelper::~SocketWriteHelper() {
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
@@ -38,23 +58,43 @@ SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
   PCHECK(queue_not_empty_fd_ != -1);
   poller->AddFdWithOnlyReadHandler(queue_not_empty_fd_,
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
-  cur_msg_queue_ = new std::queue<SocketMsg>;
-  pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  zero_copy_ = false;
+  zero_copy_min_bytes_ = std::max<int64_t>(EnvInteger<ONEFLOW_COMM_NET_ZERO_COPY_MIN_BYTES>(), 1);
+  if (EnvBool<ONEFLOW_COMM_NET_USE_ZERO_COPY>()) {
+    const int val = 1;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(int)) == 0) {
+      zero_copy_ = true;
+    } else {
+      PLOG(WARNING) << "CommNet:Epoll sends without MSG_ZEROCOPY on sockfd " << sockfd_;
+    }
+  }
+  cur_msg_queue_ = new std::deque<SocketMsg>;
+  pending_msg_queue_ = new std::deque<SocketMsg>;
+  cur_msg_written_size_ = 0;
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
   pending_msg_queue_mtx_.lock();
   bool need_send_event = pending_msg_queue_->empty();
-  pending_msg_queue_->push(msg);
+  pending_msg_queue_->push_back(msg);
   pending_msg_queue_mtx_.unlock();
+  OF_COUNTER_UPDATE("comm_net.send_queue_depth", 1);
   if (need_send_event) { SendQueueNotEmptyEvent(); }
 }
 
 void SocketWriteHelper::NotifyMeSocketWriteable() { WriteUntilMsgQueueEmptyOrSocketNotWriteable(); }
 
+void SocketWriteHelper::NotifyMeSocketError() {
+  // The kernel reports finished zero-copy sends on the error queue. A body is registered memory
+  // that isn't written again before the peer has read all of it, and bytes the peer already has
+  // are dropped if they are retransmitted, so the notifications are only drained.
+  if (zero_copy_) { DrainErrorQueue(); }
+  int error = 0;
+  socklen_t len = sizeof(error);
+  PCHECK(getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &error, &len) == 0);
+  CHECK_EQ(error, 0) << "sockfd " << sockfd_ << ": " << strerror(error);
+}
+
 void SocketWriteHelper::SendQueueNotEmptyEvent() {
   uint64_t event_num = 1;
   PCHECK(write(queue_not_empty_fd_, &event_num, 8) == 8);
@@ -67,10 +107,10 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
+  while (WriteOnce()) {}
 }
 
-bool SocketWriteHelper::InitMsgWriteHandle() {
+bool SocketWriteHelper::WriteOnce() {
   if (cur_msg_queue_->empty()) {
     {
       std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
@@ -78,70 +118,90 @@ bool SocketWriteHelper::InitMsgWriteHandle() {
     }
     if (cur_msg_queue_->empty()) { return false; }
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
-  return true;
-}
-
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
-}
-
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
-}
-
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
-    return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
-    return true;
-  } else {
-    CHECK_EQ(n, -1);
+  iovec iovs[kMaxIovNum];
+  int iov_num = 0;
+  int flags = MSG_NOSIGNAL;
+  size_t skip_size = cur_msg_written_size_;
+  for (const SocketMsg& msg : *cur_msg_queue_) {
+    if (iov_num + 2 > kMaxIovNum) { break; }
+    if (skip_size < sizeof(SocketMsg)) {
+      iovs[iov_num].iov_base = const_cast<char*>(reinterpret_cast<const char*>(&msg)) + skip_size;
+      iovs[iov_num].iov_len = sizeof(SocketMsg) - skip_size;
+      ++iov_num;
+      skip_size = 0;
+    } else {
+      skip_size -= sizeof(SocketMsg);
+    }
+    const char* body = nullptr;
+    size_t body_size = 0;
+    GetMsgBody(msg, &body, &body_size);
+    if (UseZeroCopy(body_size)) {
+      // The headers are reused as soon as they are written, so they can't go with MSG_ZEROCOPY.
+      if (iov_num == 0) {
+        iovs[iov_num].iov_base = const_cast<char*>(body) + skip_size;
+        iovs[iov_num].iov_len = body_size - skip_size;
+        ++iov_num;
+        flags |= MSG_ZEROCOPY;
+      }
+      break;
+    }
+    if (body_size > skip_size) {
+      iovs[iov_num].iov_base = const_cast<char*>(body) + skip_size;
+      iovs[iov_num].iov_len = body_size - skip_size;
+      ++iov_num;
+    }
+    skip_size = 0;
+  }
+  msghdr msg_hdr{};
+  msg_hdr.msg_iov = iovs;
+  msg_hdr.msg_iovlen = iov_num;
+  ssize_t n = sendmsg(sockfd_, &msg_hdr, flags);
+  if (n == -1 && errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+    // Undrained notifications use up the option memory of the socket, copy this time.
+    DrainErrorQueue();
+    n = sendmsg(sockfd_, &msg_hdr, flags & ~MSG_ZEROCOPY);
+  }
+  if (n == -1) {
     PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+    OF_COUNTER_ADD("comm_net.send_would_block", 1);
     return false;
   }
-}
-
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
-#define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
+  OF_COUNTER_ADD("comm_net.sendmsg_calls", 1);
+  OF_COUNTER_ADD("comm_net.sent_bytes", n);
+  size_t written_size = n;
+  while (written_size > 0) {
+    const char* body = nullptr;
+    size_t body_size = 0;
+    GetMsgBody(cur_msg_queue_->front(), &body, &body_size);
+    const size_t left_size = sizeof(SocketMsg) + body_size - cur_msg_written_size_;
+    if (written_size < left_size) {
+      cur_msg_written_size_ += written_size;
+      break;
+    }
+    written_size -= left_size;
+    cur_msg_written_size_ = 0;
+    cur_msg_queue_->pop_front();
+    OF_COUNTER_ADD("comm_net.sent_msgs", 1);
+    OF_COUNTER_UPDATE("comm_net.send_queue_depth", -1);
   }
+  return true;
 }
 
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+bool SocketWriteHelper::UseZeroCopy(size_t body_size) const {
+  return zero_copy_ && body_size >= zero_copy_min_bytes_;
 }
 
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+void SocketWriteHelper::DrainErrorQueue() {
+  char control[128];
+  while (true) {
+    msghdr msg_hdr{};
+    msg_hdr.msg_control = control;
+    msg_hdr.msg_controllen = sizeof(control);
+    if (recvmsg(sockfd_, &msg_hdr, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+      return;
+    }
+  }
 }
 
 }  // namespace oneflow
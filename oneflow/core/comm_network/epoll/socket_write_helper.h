@@ -23,6 +23,9 @@ limitations under the License.
 
 namespace oneflow {
 
+// SocketWriteHelper gathers the queued messages into one sendmsg, the header of each message
+// followed by its body if it has one. Bodies of at least ONEFLOW_COMM_NET_ZERO_COPY_MIN_BYTES are
+// sent on their own with MSG_ZEROCOPY if ONEFLOW_COMM_NET_USE_ZERO_COPY is on.
 class SocketWriteHelper final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SocketWriteHelper);
@@ -34,36 +37,30 @@ class SocketWriteHelper final {
   void AsyncWrite(const SocketMsg& msg);
 
   void NotifyMeSocketWriteable();
+  void NotifyMeSocketError();
 
  private:
   void SendQueueNotEmptyEvent();
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
-
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
-  OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
+  // Returns false if there is nothing to write or the socket is not writeable.
+  bool WriteOnce();
+  bool UseZeroCopy(size_t body_size) const;
+  void DrainErrorQueue();
 
   int sockfd_;
   int queue_not_empty_fd_;
+  bool zero_copy_;
+  size_t zero_copy_min_bytes_;
 
-  std::queue<SocketMsg>* cur_msg_queue_;
+  std::deque<SocketMsg>* cur_msg_queue_;
 
   std::mutex pending_msg_queue_mtx_;
-  std::queue<SocketMsg>* pending_msg_queue_;
+  std::deque<SocketMsg>* pending_msg_queue_;
 
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  // The bytes of the front of cur_msg_queue_ which have been written.
+  size_t cur_msg_written_size_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,167 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include <poll.h>
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/comm_network/epoll/socket_write_helper.h"
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class ZeroCopyEnvGuard final {
+ public:
+  explicit ZeroCopyEnvGuard(bool zero_copy) {
+    setenv("ONEFLOW_COMM_NET_USE_ZERO_COPY", zero_copy ? "true" : "false", 1);
+    setenv("ONEFLOW_COMM_NET_ZERO_COPY_MIN_BYTES", "4096", 1);
+  }
+  ~ZeroCopyEnvGuard() {
+    unsetenv("ONEFLOW_COMM_NET_USE_ZERO_COPY");
+    unsetenv("ONEFLOW_COMM_NET_ZERO_COPY_MIN_BYTES");
+  }
+};
+
+// A connected pair of TCP sockets on the loopback, MSG_ZEROCOPY needs TCP.
+void NewLoopbackSockets(int* send_fd, int* recv_fd) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(listen_fd != -1);
+  sockaddr_in sa{};
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  PCHECK(bind(listen_fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+  PCHECK(listen(listen_fd, 1) == 0);
+  socklen_t len = sizeof(sa);
+  PCHECK(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&sa), &len) == 0);
+  *send_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(connect(*send_fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+  *recv_fd = accept(listen_fd, nullptr, nullptr);
+  PCHECK(*recv_fd != -1);
+  PCHECK(close(listen_fd) == 0);
+}
+
+void ReadFully(int sockfd, void* buf, size_t size) {
+  char* ptr = static_cast<char*>(buf);
+  while (size > 0) {
+    const ssize_t n = read(sockfd, ptr, size);
+    PCHECK(n > 0);
+    ptr += n;
+    size -= n;
+  }
+}
+
+// The kernel keeps reporting EPOLLERR while zero-copy completions are queued.
+bool HasErrorQueued(int sockfd) {
+  pollfd pfd{};
+  pfd.fd = sockfd;
+  CHECK_GE(poll(&pfd, 1, 0), 0);
+  return pfd.revents & POLLERR;
+}
+
+bool SupportsZeroCopy() {
+  const int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(sockfd != -1);
+  const int val = 1;
+  const bool supported = setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(int)) == 0;
+  PCHECK(close(sockfd) == 0);
+  return supported;
+}
+
+std::vector<SocketMsg> GenMsgs(SocketMemDesc* mem_desc) {
+  const std::vector<int64_t> body_sizes = {0, 100, 4095, 4096, 70000, 1 << 20};
+  std::vector<SocketMsg> msgs;
+  for (int i = 0; i < 600; ++i) {
+    SocketMsg msg{};
+    if (i % 7 == 3) {
+      msg.msg_type = SocketMsgType::kRequestWrite;
+      msg.request_write_msg.dst_machine_id = i;
+    } else {
+      msg.msg_type = SocketMsgType::kRequestRead;
+      msg.request_read_msg.src_token = mem_desc;
+      msg.request_read_msg.size = body_sizes.at(i % body_sizes.size());
+      msg.request_read_msg.offset = (i * 4099) % (mem_desc->byte_size - msg.request_read_msg.size);
+      msg.request_read_msg.piece_num = 1;
+    }
+    msgs.emplace_back(msg);
+  }
+  return msgs;
+}
+
+void CheckReceived(int recv_fd, const std::vector<SocketMsg>& msgs, const std::vector<char>& data) {
+  std::vector<char> body;
+  for (const SocketMsg& expected : msgs) {
+    SocketMsg msg{};
+    ReadFully(recv_fd, &msg, sizeof(msg));
+    ASSERT_EQ(msg.msg_type, expected.msg_type);
+    if (msg.msg_type == SocketMsgType::kRequestWrite) {
+      ASSERT_EQ(msg.request_write_msg.dst_machine_id, expected.request_write_msg.dst_machine_id);
+      continue;
+    }
+    ASSERT_EQ(msg.request_read_msg.offset, expected.request_read_msg.offset);
+    ASSERT_EQ(msg.request_read_msg.size, expected.request_read_msg.size);
+    body.resize(msg.request_read_msg.size);
+    ReadFully(recv_fd, body.data(), body.size());
+    ASSERT_TRUE(std::equal(body.begin(), body.end(), data.begin() + msg.request_read_msg.offset));
+  }
+}
+
+// Writes a mix of headers and bodies of every size through a SocketWriteHelper and checks that
+// the peer receives them in order.
+void TestWriteHelper(bool zero_copy) {
+  if (zero_copy && !SupportsZeroCopy()) { GTEST_SKIP() << "SO_ZEROCOPY isn't supported"; }
+  ZeroCopyEnvGuard guard(zero_copy);
+  int send_fd = -1;
+  int recv_fd = -1;
+  NewLoopbackSockets(&send_fd, &recv_fd);
+  std::vector<char> data(4 << 20);
+  for (size_t i = 0; i < data.size(); ++i) { data[i] = static_cast<char>(i * 7 + i / 4096); }
+  SocketMemDesc mem_desc{data.data(), data.size()};
+  const std::vector<SocketMsg> msgs = GenMsgs(&mem_desc);
+  IOEventPoller poller;
+  SocketWriteHelper write_helper(send_fd, &poller);
+  poller.AddFd(
+      send_fd, []() {}, [&]() { write_helper.NotifyMeSocketWriteable(); },
+      [&]() { write_helper.NotifyMeSocketError(); });
+  poller.Start();
+  for (const SocketMsg& msg : msgs) { write_helper.AsyncWrite(msg); }
+  CheckReceived(recv_fd, msgs, data);
+  bool error_queued = false;
+  if (zero_copy) {
+    // The completions of the zero-copy sends are drained by the poller as they arrive.
+    for (int i = 0; i < 1000 && (error_queued = HasErrorQueued(send_fd)); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  poller.Stop();
+  PCHECK(close(recv_fd) == 0);
+  ASSERT_FALSE(error_queued);
+}
+
+}  // namespace
+
+TEST(SocketWriteHelper, copy) { TestWriteHelper(false); }
+
+TEST(SocketWriteHelper, zero_copy) { TestWriteHelper(true); }
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // __linux__
@@ -0,0 +1,301 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
+#define ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/cpu_relax.h"
+#include "oneflow/core/common/env_var/env_var.h"
+
+namespace oneflow {
+
+// A lock-free ring buffer with the same Send/Receive/Close semantics as Channel. Items are
+// handed over through per-slot sequence numbers, see
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue. A thread
+// that finds the buffer empty (Receive) or full (Send) spins for a while and then parks on a
+// condition variable, so the mutex is only touched when some thread is blocked.
+//
+// single_producer/single_consumer may be set when only one thread ever sends/receives, which
+// replaces the CAS on the corresponding position by a plain store.
+//
+// Receive returns kChannelStatusErrorClosed once the channel is closed and drained. Send
+// returns kChannelStatusErrorClosed after Close, items that raced with Close may stay in the
+// buffer and are destroyed with the channel.
+template<typename T, bool single_producer = false, bool single_consumer = false>
+class BoundedChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(BoundedChannel);
+  explicit BoundedChannel(size_t capacity)
+      : BoundedChannel(capacity, EnvInteger<ONEFLOW_CHANNEL_SPIN_COUNT>()) {}
+  BoundedChannel(size_t capacity, int64_t spin_count);
+  ~BoundedChannel();
+
+  template<typename U>
+  ChannelStatus Send(U&& item);
+  // Sends all items, blocks whenever the buffer is full.
+  ChannelStatus SendMany(std::queue<T>* items);
+  ChannelStatus Receive(T* item);
+  // Receives all items in the buffer, blocks only if the buffer is empty.
+  ChannelStatus ReceiveMany(std::queue<T>* items);
+  // Receives an item if there is one, never blocks.
+  bool TryReceive(T* item);
+  void Close();
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    alignas(T) unsigned char storage[sizeof(T)];
+    T* item() { return reinterpret_cast<T*>(storage); }
+  };
+
+  template<typename U>
+  bool TryPush(U&& item);
+  bool TryPop(T* item);
+  // Spins and then parks until try_func returns true or the channel is closed. Returns false
+  // only if the channel is closed.
+  template<typename F>
+  bool WaitUntil(const F& try_func, std::condition_variable* cond,
+                 std::atomic<int64_t>* num_waiters);
+  void Notify(std::condition_variable* cond, std::atomic<int64_t>* num_waiters, bool all);
+
+  static constexpr size_t kCacheLineSize = 64;
+
+  size_t mask_;
+  int64_t spin_count_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<size_t> enqueue_pos_;
+  alignas(kCacheLineSize) std::atomic<size_t> dequeue_pos_;
+  alignas(kCacheLineSize) std::atomic<bool> is_closed_;
+  std::atomic<int64_t> num_waiting_senders_;
+  std::atomic<int64_t> num_waiting_receivers_;
+  std::mutex mutex_;
+  std::condition_variable not_full_cond_;
+  std::condition_variable not_empty_cond_;
+};
+
+template<typename T>
+using SpscBoundedChannel = BoundedChannel<T, true, true>;
+
+template<typename T, bool single_producer, bool single_consumer>
+BoundedChannel<T, single_producer, single_consumer>::BoundedChannel(size_t capacity,
+                                                                    int64_t spin_count)
+    : spin_count_(spin_count),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      is_closed_(false),
+      num_waiting_senders_(0),
+      num_waiting_receivers_(0) {
+  CHECK_GT(capacity, 0);
+  size_t rounded_capacity = 1;
+  while (rounded_capacity < capacity) { rounded_capacity <<= 1; }
+  mask_ = rounded_capacity - 1;
+  cells_.reset(new Cell[rounded_capacity]);
+  for (size_t i = 0; i < rounded_capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+BoundedChannel<T, single_producer, single_consumer>::~BoundedChannel() {
+  const size_t end = enqueue_pos_.load(std::memory_order_acquire);
+  for (size_t pos = dequeue_pos_.load(std::memory_order_acquire); pos != end; ++pos) {
+    Cell* cell = &cells_[pos & mask_];
+    if (cell->sequence.load(std::memory_order_acquire) == pos + 1) { cell->item()->~T(); }
+  }
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+template<typename U>
+bool BoundedChannel<T, single_producer, single_consumer>::TryPush(U&& item) {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (single_producer) {
+        enqueue_pos_.store(pos + 1, std::memory_order_relaxed);
+        break;
+      }
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  new (cell->item()) T(std::forward<U>(item));
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+bool BoundedChannel<T, single_producer, single_consumer>::TryPop(T* item) {
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (single_consumer) {
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        break;
+      }
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  *item = std::move(*cell->item());
+  cell->item()->~T();
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+template<typename F>
+bool BoundedChannel<T, single_producer, single_consumer>::WaitUntil(
+    const F& try_func, std::condition_variable* cond, std::atomic<int64_t>* num_waiters) {
+  for (int64_t i = 0; i < spin_count_; ++i) {
+    if (try_func()) { return true; }
+    if (is_closed_.load(std::memory_order_acquire)) { return try_func(); }
+    CpuRelax();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_waiters->fetch_add(1, std::memory_order_relaxed);
+  // Pairs with the fence in Notify, either the waker sees num_waiters or try_func sees the
+  // state published before the fence.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool succeeded = false;
+  while (true) {
+    if (try_func()) {
+      succeeded = true;
+      break;
+    }
+    if (is_closed_.load(std::memory_order_acquire)) {
+      succeeded = try_func();
+      break;
+    }
+    cond->wait(lock);
+  }
+  num_waiters->fetch_sub(1, std::memory_order_relaxed);
+  return succeeded;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+void BoundedChannel<T, single_producer, single_consumer>::Notify(
+    std::condition_variable* cond, std::atomic<int64_t>* num_waiters, bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_waiters->load(std::memory_order_relaxed) == 0) { return; }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (all) {
+    cond->notify_all();
+  } else {
+    cond->notify_one();
+  }
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+template<typename U>
+ChannelStatus BoundedChannel<T, single_producer, single_consumer>::Send(U&& item) {
+  if (is_closed_.load(std::memory_order_acquire)) { return kChannelStatusErrorClosed; }
+  // TryPush constructs the item only when it succeeds, so forwarding it more than once is fine.
+  auto TrySend = [&]() {
+    return !is_closed_.load(std::memory_order_relaxed) && TryPush(std::forward<U>(item));
+  };
+  if (!TrySend() && !WaitUntil(TrySend, &not_full_cond_, &num_waiting_senders_)) {
+    return kChannelStatusErrorClosed;
+  }
+  Notify(&not_empty_cond_, &num_waiting_receivers_, false);
+  return kChannelStatusSuccess;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+ChannelStatus BoundedChannel<T, single_producer, single_consumer>::SendMany(
+    std::queue<T>* items) {
+  if (is_closed_.load(std::memory_order_acquire)) { return kChannelStatusErrorClosed; }
+  auto TrySend = [&]() {
+    if (is_closed_.load(std::memory_order_relaxed)) { return false; }
+    bool pushed = false;
+    while (!items->empty() && TryPush(std::move(items->front()))) {
+      items->pop();
+      pushed = true;
+    }
+    return pushed;
+  };
+  while (!items->empty()) {
+    if (!TrySend() && !WaitUntil(TrySend, &not_full_cond_, &num_waiting_senders_)) {
+      return kChannelStatusErrorClosed;
+    }
+    Notify(&not_empty_cond_, &num_waiting_receivers_, true);
+  }
+  return kChannelStatusSuccess;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+ChannelStatus BoundedChannel<T, single_producer, single_consumer>::Receive(T* item) {
+  auto TryReceive = [&]() { return TryPop(item); };
+  if (!TryReceive() && !WaitUntil(TryReceive, &not_empty_cond_, &num_waiting_receivers_)) {
+    return kChannelStatusErrorClosed;
+  }
+  Notify(&not_full_cond_, &num_waiting_senders_, false);
+  return kChannelStatusSuccess;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+bool BoundedChannel<T, single_producer, single_consumer>::TryReceive(T* item) {
+  if (!TryPop(item)) { return false; }
+  Notify(&not_full_cond_, &num_waiting_senders_, false);
+  return true;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+ChannelStatus BoundedChannel<T, single_producer, single_consumer>::ReceiveMany(
+    std::queue<T>* items) {
+  auto TryReceive = [&]() {
+    bool popped = false;
+    T item;
+    while (TryPop(&item)) {
+      items->push(std::move(item));
+      popped = true;
+    }
+    return popped;
+  };
+  if (!TryReceive() && !WaitUntil(TryReceive, &not_empty_cond_, &num_waiting_receivers_)) {
+    return kChannelStatusErrorClosed;
+  }
+  Notify(&not_full_cond_, &num_waiting_senders_, true);
+  return kChannelStatusSuccess;
+}
+
+template<typename T, bool single_producer, bool single_consumer>
+void BoundedChannel<T, single_producer, single_consumer>::Close() {
+  is_closed_.store(true, std::memory_order_release);
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_full_cond_.notify_all();
+  not_empty_cond_.notify_all();
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
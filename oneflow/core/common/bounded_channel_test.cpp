@@ -0,0 +1,121 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/common/bounded_channel.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(BoundedChannel, 30sender40receiver) {
+  // a small capacity makes senders block on a full buffer
+  BoundedChannel<int> channel(16);
+  const int sender_num = 30;
+  const int receiver_num = 40;
+  const int range_num = 200;
+  std::vector<std::vector<int>> visits(receiver_num, std::vector<int>(range_num, 0));
+  std::vector<std::thread> senders;
+  std::vector<std::thread> receivers;
+  for (int i = 0; i < sender_num; ++i) {
+    senders.emplace_back([&]() {
+      for (int j = 0; j < range_num; ++j) { ASSERT_EQ(channel.Send(j), kChannelStatusSuccess); }
+    });
+  }
+  for (int i = 0; i < receiver_num; ++i) {
+    receivers.emplace_back([&, i]() {
+      int num = -1;
+      while (channel.Receive(&num) == kChannelStatusSuccess) { ++visits[i][num]; }
+    });
+  }
+  for (std::thread& this_thread : senders) { this_thread.join(); }
+  channel.Close();
+  for (std::thread& this_thread : receivers) { this_thread.join(); }
+  for (int j = 0; j < range_num; ++j) {
+    int visit_count = 0;
+    for (int i = 0; i < receiver_num; ++i) { visit_count += visits[i][j]; }
+    ASSERT_EQ(visit_count, sender_num);
+  }
+}
+
+TEST(BoundedChannel, SpscKeepsOrder) {
+  SpscBoundedChannel<std::unique_ptr<int>> channel(8);
+  const int num = 100000;
+  std::thread sender([&]() {
+    std::queue<std::unique_ptr<int>> items;
+    for (int i = 0; i < num; ++i) {
+      items.push(std::make_unique<int>(i));
+      if (items.size() == 5) { ASSERT_EQ(channel.SendMany(&items), kChannelStatusSuccess); }
+    }
+    ASSERT_EQ(channel.SendMany(&items), kChannelStatusSuccess);
+    channel.Close();
+  });
+  int expected = 0;
+  std::queue<std::unique_ptr<int>> items;
+  while (channel.ReceiveMany(&items) == kChannelStatusSuccess) {
+    while (!items.empty()) {
+      ASSERT_EQ(*items.front(), expected);
+      items.pop();
+      ++expected;
+    }
+  }
+  sender.join();
+  ASSERT_EQ(expected, num);
+}
+
+TEST(BoundedChannel, Close) {
+  BoundedChannel<int> channel(2, 0);
+  ASSERT_EQ(channel.capacity(), 2);
+  ASSERT_EQ(channel.Send(1), kChannelStatusSuccess);
+  ASSERT_EQ(channel.Send(2), kChannelStatusSuccess);
+  // the buffer is full, Close must wake the blocked sender up
+  std::thread sender([&]() { ASSERT_EQ(channel.Send(3), kChannelStatusErrorClosed); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  channel.Close();
+  sender.join();
+  ASSERT_EQ(channel.Send(4), kChannelStatusErrorClosed);
+  int item = 0;
+  ASSERT_EQ(channel.Receive(&item), kChannelStatusSuccess);
+  ASSERT_EQ(item, 1);
+  ASSERT_EQ(channel.Receive(&item), kChannelStatusSuccess);
+  ASSERT_EQ(item, 2);
+  ASSERT_EQ(channel.Receive(&item), kChannelStatusErrorClosed);
+}
+
+TEST(BoundedChannel, TryReceive) {
+  BoundedChannel<int> channel(2, 0);
+  int item = 0;
+  ASSERT_FALSE(channel.TryReceive(&item));
+  ASSERT_EQ(channel.Send(1), kChannelStatusSuccess);
+  ASSERT_EQ(channel.Send(2), kChannelStatusSuccess);
+  // the buffer is full, TryReceive must wake the blocked sender up
+  std::thread sender([&]() { ASSERT_EQ(channel.Send(3), kChannelStatusSuccess); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_TRUE(channel.TryReceive(&item));
+  ASSERT_EQ(item, 1);
+  sender.join();
+  channel.Close();
+  // the items sent before Close are still handed out
+  ASSERT_TRUE(channel.TryReceive(&item));
+  ASSERT_EQ(item, 2);
+  ASSERT_TRUE(channel.TryReceive(&item));
+  ASSERT_EQ(item, 3);
+  ASSERT_FALSE(channel.TryReceive(&item));
+  ASSERT_EQ(channel.Receive(&item), kChannelStatusErrorClosed);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -31,6 +31,7 @@ class Channel final {
 
   template<typename U>
   ChannelStatus Send(U&& item);
+  ChannelStatus SendMany(std::queue<T>* items);
   ChannelStatus Receive(T* item);
   ChannelStatus ReceiveMany(std::queue<T>* items);
   void Close();
@@ -56,6 +57,22 @@ ChannelStatus Channel<T>::Send(U&& item) {
   return kChannelStatusSuccess;
 }
 
+template<typename T>
+ChannelStatus Channel<T>::SendMany(std::queue<T>* items) {
+  bool notify;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_closed_) { return kChannelStatusErrorClosed; }
+    notify = queue_.empty();
+    while (!items->empty()) {
+      queue_.push(std::move(items->front()));
+      items->pop();
+    }
+  }
+  if (notify) { cond_.notify_all(); }
+  return kChannelStatusSuccess;
+}
+
 template<typename T>
 ChannelStatus Channel<T>::Receive(T* item) {
   std::unique_lock<std::mutex> lock(mutex_);
@@ -0,0 +1,52 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_ENV_VAR_DATA_H_
+#define ONEFLOW_CORE_COMMON_ENV_VAR_DATA_H_
+
+#include "oneflow/core/common/env_var/env_var.h"
+
+namespace oneflow {
+
+// map local files read by PersistentInStream into memory instead of copying them into a buffer,
+// only for files which are not truncated while being read, which would raise SIGBUS
+DEFINE_ENV_BOOL(ONEFLOW_PERSISTENT_IN_STREAM_USE_MMAP, false);
+DEFINE_ENV_INTEGER(ONEFLOW_PERSISTENT_IN_STREAM_MMAP_READAHEAD_BYTES, 8 * 1024 * 1024);
+
+// read OFRecord part files through their offset index instead of one sequential stream
+DEFINE_ENV_BOOL(ONEFLOW_DATA_OFRECORD_USE_INDEX, false);
+// write the index built for a part file without a valid one next to it
+DEFINE_ENV_BOOL(ONEFLOW_DATA_OFRECORD_SAVE_INDEX, false);
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_OFRECORD_NUM_IO_THREADS, 4);
+// number of records read by one window, and number of windows in flight
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_OFRECORD_READ_WINDOW_SIZE, 256);
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_OFRECORD_NUM_PREFETCH_WINDOWS, 4);
+// upper bound of one coalesced read
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_OFRECORD_MAX_READ_BYTES, 4 * 1024 * 1024);
+
+// hand the serialized records to the OFRecord decoders, which then only look into the features
+// they decode, instead of parsing the whole records in the reader
+DEFINE_ENV_BOOL(ONEFLOW_DATA_OFRECORD_LAZY_PARSE, false);
+
+// number of workers running Parser::Prepare in DataReader, and whether their batches are
+// handed out in load order
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_READER_NUM_WORKERS, 4);
+DEFINE_ENV_BOOL(ONEFLOW_DATA_READER_ORDERED, true);
+// bounds of the number of batches DataReader loads ahead of Read
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_READER_MIN_PREFETCH_DEPTH, 4);
+DEFINE_ENV_INTEGER(ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH, 16);
+
+}  // namespace oneflow
+#endif  // ONEFLOW_CORE_COMMON_ENV_VAR_DATA_H_
@@ -45,6 +45,26 @@ DEFINE_ENV_INTEGER(ONEFLOW_CHECK_TIMEOUT_SLEEP_SECONDS, EnvInteger<ONEFLOW_TIMEO
 
 DEFINE_ENV_INTEGER(ONEFLOW_VM_BLOCKING_DEBUG_INSTRUCTIONS_DISPLAY_LIMIT, 100);
 DEFINE_ENV_INTEGER(ONEFLOW_DELETE_OUTDATED_SHM_NAMES_INTERVAL, 1000);
+DEFINE_ENV_INTEGER(ONEFLOW_THREAD_POOL_SPIN_COUNT, 4096);
+DEFINE_ENV_INTEGER(ONEFLOW_CHANNEL_SPIN_COUNT, 1024);
+DEFINE_ENV_INTEGER(ONEFLOW_CPU_CONV_MAX_NUM_COL_BUFS, 16);
+DEFINE_ENV_INTEGER(ONEFLOW_CPU_CONV_COL_BUF_MAX_BYTES, 256 * 1024 * 1024);
+DEFINE_ENV_INTEGER(ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES, 1024 * 1024);
+DEFINE_ENV_INTEGER(ONEFLOW_CCL_CPU_ALL_REDUCE_MAX_CHUNKS_IN_FLIGHT, 4);
+DEFINE_ENV_INTEGER(ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK, 4 * 1024);
+DEFINE_ENV_INTEGER(ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES, 4 * 1024 * 1024);
+DEFINE_ENV_BOOL(ONEFLOW_CCL_CPU_HIERARCHICAL_ALL_REDUCE, false);
+DEFINE_ENV_BOOL(ONEFLOW_TRANSPORT_USE_SHM, true);
+DEFINE_ENV_INTEGER(ONEFLOW_TRANSPORT_SHM_SLOT_NUM, 8);
+DEFINE_ENV_INTEGER(ONEFLOW_TRANSPORT_SHM_SLOT_BYTES, 128 * 1024);
+// Every process has to use the same ONEFLOW_COMM_NET_SOCKETS_PER_PEER.
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_SOCKETS_PER_PEER, 1);
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_STRIPE_MIN_BYTES, 1024 * 1024);
+DEFINE_ENV_BOOL(ONEFLOW_COMM_NET_USE_ZERO_COPY, false);
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_ZERO_COPY_MIN_BYTES, 64 * 1024);
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_BUSY_POLL_USECS, 0);
+// Threads used by graph compile, 0 means the number of cpus and 1 means single-threaded.
+DEFINE_ENV_INTEGER(ONEFLOW_GRAPH_COMPILE_THREAD_NUM, 0);
 
 template<typename env_var>
 bool ThreadLocalEnvBool();
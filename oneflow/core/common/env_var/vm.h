@@ -26,6 +26,7 @@ DEFINE_THREAD_LOCAL_ENV_INTEGER(ONEFLOW_VM_PENDING_HANDLE_WINDOW_SIZE, 10)
 DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_VM_ENABLE_SCHEDULE_YIELD, true)
 DEFINE_THREAD_LOCAL_ENV_INTEGER(ONEFLOW_VM_WORKER_THREAD_LIMIT, 16);
 DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_VM_MULTI_THREAD, true);
+DEFINE_ENV_BOOL(ONEFLOW_VM_ENABLE_THREAD_CACHING_HOST_ALLOCATOR, true);
 
 }  // namespace oneflow
 #endif  // ONEFLOW_CORE_COMMON_ENV_VAR_VM_H_
@@ -0,0 +1,257 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/async_read_engine.h"
+
+#ifdef __linux__
+
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+#include <unistd.h>
+
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#endif  // WITH_LIBURING
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+class AioReadEngine final : public AsyncReadEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AioReadEngine);
+  explicit AioReadEngine(size_t queue_depth)
+      : ctx_{}, queue_depth_(queue_depth), num_reads_in_flight_(0) {
+    PCHECK(syscall(__NR_io_setup, queue_depth_, &ctx_) >= 0);
+    events_.resize(queue_depth_);
+  }
+  ~AioReadEngine() override { PCHECK(syscall(__NR_io_destroy, ctx_) >= 0); }
+
+  void PrepRead(int fd, void* buf, size_t count, size_t offset, uint64_t tag) override {
+    struct iocb cb {};
+    cb.aio_data = tag;
+    cb.aio_fildes = fd;
+    cb.aio_lio_opcode = IOCB_CMD_PREAD;
+    cb.aio_buf = reinterpret_cast<uintptr_t>(buf);
+    cb.aio_nbytes = count;
+    cb.aio_offset = offset;
+    cbs_.push_back(cb);
+  }
+
+  void Submit() override {
+    cbs_ptr_.resize(cbs_.size());
+    for (size_t i = 0; i < cbs_.size(); ++i) { cbs_ptr_[i] = &cbs_[i]; }
+    size_t num_submitted = 0;
+    while (num_submitted < cbs_.size()) {
+      const long ret = syscall(__NR_io_submit, ctx_, cbs_.size() - num_submitted,
+                               cbs_ptr_.data() + num_submitted);
+      if (ret > 0) {
+        num_submitted += ret;
+        num_reads_in_flight_ += ret;
+        continue;
+      }
+      PCHECK(ret < 0 && (errno == EAGAIN || errno == EINTR)) << "io_submit failed";
+      if (errno == EINTR) { continue; }
+      // The kernel is out of request slots. Wait for reads in flight to complete instead of
+      // spinning, the next Reap hands their completions out.
+      PCHECK(num_reads_in_flight_ > 0) << "io_submit failed";
+      GetEvents(&reaped_);
+    }
+    cbs_.clear();
+  }
+
+  void Reap(std::vector<std::pair<uint64_t, int64_t>>* completions) override {
+    if (!reaped_.empty()) {
+      completions->insert(completions->end(), reaped_.begin(), reaped_.end());
+      reaped_.clear();
+      return;
+    }
+    GetEvents(completions);
+  }
+
+  size_t queue_depth() const override { return queue_depth_; }
+
+ private:
+  void GetEvents(std::vector<std::pair<uint64_t, int64_t>>* completions) {
+    long ret = 0;
+    do {
+      ret = syscall(__NR_io_getevents, ctx_, 1, queue_depth_, events_.data(), nullptr);
+    } while (ret < 0 && errno == EINTR);
+    PCHECK(ret > 0) << "io_getevents failed";
+    for (long i = 0; i < ret; ++i) { completions->emplace_back(events_[i].data, events_[i].res); }
+    num_reads_in_flight_ -= ret;
+  }
+
+  aio_context_t ctx_;
+  size_t queue_depth_;
+  size_t num_reads_in_flight_;
+  std::vector<struct iocb> cbs_;
+  std::vector<struct iocb*> cbs_ptr_;
+  std::vector<struct io_event> events_;
+  // completions reaped by Submit while waiting for free request slots
+  std::vector<std::pair<uint64_t, int64_t>> reaped_;
+};
+
+#ifdef WITH_LIBURING
+
+class RingReadEngine final : public AsyncReadEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RingReadEngine);
+  RingReadEngine(size_t queue_depth, uint32_t max_registered_files, uint32_t poll_spin_count)
+      : ring_{},
+        queue_depth_(queue_depth),
+        max_registered_files_(max_registered_files),
+        poll_spin_count_(poll_spin_count),
+        num_prepared_(0),
+        files_registered_(false),
+        num_registered_files_(0) {
+    init_ret_ = io_uring_queue_init(queue_depth_, &ring_, 0);
+    if (init_ret_ == 0 && max_registered_files_ > 0) {
+      std::vector<int> sparse_files(max_registered_files_, -1);
+      files_registered_ =
+          io_uring_register_files(&ring_, sparse_files.data(), sparse_files.size()) == 0;
+    }
+  }
+  ~RingReadEngine() override {
+    if (init_ret_ == 0) { io_uring_queue_exit(&ring_); }
+  }
+
+  int init_ret() const { return init_ret_; }
+
+  void PrepRead(int fd, void* buf, size_t count, size_t offset, uint64_t tag) override {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    CHECK_NOTNULL(sqe);
+    const int file_index = GetRegisteredFileIndex(fd);
+    if (file_index >= 0) {
+      io_uring_prep_read(sqe, file_index, buf, count, offset);
+      sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+      io_uring_prep_read(sqe, fd, buf, count, offset);
+    }
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(tag));
+    num_prepared_ += 1;
+  }
+
+  void Submit() override {
+    if (num_prepared_ == 0) { return; }
+    const int ret = io_uring_submit(&ring_);
+    CHECK_EQ(ret, static_cast<int>(num_prepared_)) << "io_uring_submit failed: " << strerror(-ret);
+    num_prepared_ = 0;
+  }
+
+  void Reap(std::vector<std::pair<uint64_t, int64_t>>* completions) override {
+    cqes_.resize(queue_depth_);
+    uint32_t num_spins = 0;
+    while (true) {
+      const uint32_t num_completed = io_uring_peek_batch_cqe(&ring_, cqes_.data(), cqes_.size());
+      if (num_completed > 0) {
+        for (uint32_t i = 0; i < num_completed; ++i) {
+          completions->emplace_back(reinterpret_cast<uint64_t>(io_uring_cqe_get_data(cqes_[i])),
+                                    cqes_[i]->res);
+        }
+        io_uring_cq_advance(&ring_, num_completed);
+        return;
+      }
+      if (num_spins < poll_spin_count_) {
+        num_spins += 1;
+        continue;
+      }
+      struct io_uring_cqe* cqe = nullptr;
+      int ret = 0;
+      do { ret = io_uring_wait_cqe(&ring_, &cqe); } while (ret == -EINTR);
+      CHECK_EQ(ret, 0) << "io_uring_wait_cqe failed: " << strerror(-ret);
+    }
+  }
+
+  void UnregisterFile(int fd) override {
+    if (fd >= static_cast<int>(fd2file_index_.size()) || fd2file_index_.at(fd) < 0) { return; }
+    const int file_index = fd2file_index_.at(fd);
+    int invalid_fd = -1;
+    CHECK_EQ(io_uring_register_files_update(&ring_, file_index, &invalid_fd, 1), 1);
+    fd2file_index_.at(fd) = -1;
+    free_file_indices_.push_back(file_index);
+  }
+
+  size_t queue_depth() const override { return queue_depth_; }
+
+ private:
+  int GetRegisteredFileIndex(int fd) {
+    if (!files_registered_) { return -1; }
+    if (fd < static_cast<int>(fd2file_index_.size()) && fd2file_index_.at(fd) >= 0) {
+      return fd2file_index_.at(fd);
+    }
+    int file_index = -1;
+    if (!free_file_indices_.empty()) {
+      file_index = free_file_indices_.back();
+    } else if (num_registered_files_ < max_registered_files_) {
+      file_index = num_registered_files_;
+    } else {
+      return -1;
+    }
+    if (io_uring_register_files_update(&ring_, file_index, &fd, 1) != 1) { return -1; }
+    if (!free_file_indices_.empty()) {
+      free_file_indices_.pop_back();
+    } else {
+      num_registered_files_ += 1;
+    }
+    if (fd >= static_cast<int>(fd2file_index_.size())) { fd2file_index_.resize(fd + 1, -1); }
+    fd2file_index_.at(fd) = file_index;
+    return file_index;
+  }
+
+  struct io_uring ring_;
+  int init_ret_;
+  size_t queue_depth_;
+  uint32_t max_registered_files_;
+  uint32_t poll_spin_count_;
+  uint32_t num_prepared_;
+  bool files_registered_;
+  uint32_t num_registered_files_;
+  std::vector<int> fd2file_index_;
+  std::vector<int> free_file_indices_;
+  std::vector<struct io_uring_cqe*> cqes_;
+};
+
+#endif  // WITH_LIBURING
+
+}  // namespace
+
+std::unique_ptr<AsyncReadEngine> NewAioReadEngine(size_t queue_depth) {
+  return std::make_unique<AioReadEngine>(queue_depth);
+}
+
+std::unique_ptr<AsyncReadEngine> NewRingReadEngine(size_t queue_depth,
+                                                   uint32_t max_registered_files,
+                                                   uint32_t poll_spin_count) {
+#ifdef WITH_LIBURING
+  std::unique_ptr<RingReadEngine> engine(
+      new RingReadEngine(queue_depth, max_registered_files, poll_spin_count));
+  if (engine->init_ret() != 0) {
+    LOG(WARNING) << "io_uring_queue_init failed: " << strerror(-engine->init_ret());
+    return nullptr;
+  }
+  return engine;
+#else
+  return nullptr;
+#endif  // WITH_LIBURING
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // __linux__
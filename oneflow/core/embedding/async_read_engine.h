@@ -0,0 +1,65 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_ASYNC_READ_ENGINE_H_
+#define ONEFLOW_CORE_EMBEDDING_ASYNC_READ_ENGINE_H_
+
+#include "oneflow/core/common/util.h"
+
+#ifdef __linux__
+
+namespace oneflow {
+
+namespace embedding {
+
+// Reads which are submitted together and complete in any order. An engine is used by one thread
+// at a time.
+class AsyncReadEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AsyncReadEngine);
+  AsyncReadEngine() = default;
+  virtual ~AsyncReadEngine() = default;
+
+  // Queues a read which starts with the next Submit. At most queue_depth() reads should be
+  // queued or in flight at the same time.
+  virtual void PrepRead(int fd, void* buf, size_t count, size_t offset, uint64_t tag) = 0;
+  // Starts the queued reads. If the kernel runs out of request slots, Submit waits for reads in
+  // flight to complete and Reap hands their completions out later.
+  virtual void Submit() = 0;
+  // Waits until at least one read completes, a completion is the tag of a read and the number of
+  // bytes read or a negative errno. A read may complete short, the caller resubmits the rest.
+  virtual void Reap(std::vector<std::pair<uint64_t, int64_t>>* completions) = 0;
+  // Must be called before fd is closed, with no read of fd in flight.
+  virtual void UnregisterFile(int fd) {}
+  virtual size_t queue_depth() const = 0;
+};
+
+// Linux native AIO, reads are only asynchronous with O_DIRECT.
+std::unique_ptr<AsyncReadEngine> NewAioReadEngine(size_t queue_depth);
+
+// io_uring. With max_registered_files > 0 the files read are registered with the ring, Reap peeks
+// for completions poll_spin_count times before it sleeps. Returns nullptr if OneFlow was built
+// without liburing or io_uring isn't available, e.g. disabled by a seccomp profile.
+std::unique_ptr<AsyncReadEngine> NewRingReadEngine(size_t queue_depth,
+                                                   uint32_t max_registered_files = 0,
+                                                   uint32_t poll_spin_count = 0);
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // __linux__
+
+#endif  // ONEFLOW_CORE_EMBEDDING_ASYNC_READ_ENGINE_H_
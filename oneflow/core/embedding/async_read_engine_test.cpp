@@ -0,0 +1,141 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/async_read_engine.h"
+#include "oneflow/core/embedding/posix_file.h"
+#include <gtest/gtest.h>
+#include <set>
+
+namespace oneflow {
+
+namespace embedding {
+
+#ifdef __linux__
+
+namespace {
+
+constexpr size_t kFileSize = 1024 * 1024;
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_are_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+unsigned char ByteAt(size_t offset) { return static_cast<unsigned char>(offset * 7 + offset / 251); }
+
+std::string CreateTestFile(const std::string& dir) {
+  const std::string path = PosixFile::JoinPath(dir, "data");
+  PosixFile file(path, O_RDWR | O_CREAT, 0644);
+  std::vector<unsigned char> data(kFileSize);
+  for (size_t i = 0; i < kFileSize; ++i) { data[i] = ByteAt(i); }
+  PCHECK(write(file.fd(), data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+  return path;
+}
+
+// Reads num_reads spans of read_size bytes, submitting submit_batch reads at a time, and checks
+// every byte. Short reads are resubmitted.
+void TestReads(AsyncReadEngine* engine, int fd, size_t num_reads, size_t read_size,
+               size_t submit_batch) {
+  std::vector<std::vector<unsigned char>> bufs(num_reads, std::vector<unsigned char>(read_size));
+  std::vector<size_t> offsets(num_reads);
+  std::vector<size_t> num_read(num_reads, 0);
+  std::vector<size_t> to_submit;
+  for (size_t i = 0; i < num_reads; ++i) {
+    offsets[i] = (i * 4096 * 3 + i) % (kFileSize - read_size);
+    to_submit.push_back(i);
+  }
+  size_t num_done = 0;
+  size_t num_in_flight = 0;
+  std::vector<std::pair<uint64_t, int64_t>> completions;
+  while (num_done < num_reads) {
+    size_t num_prepared = 0;
+    while (!to_submit.empty() && num_prepared < submit_batch) {
+      const size_t i = to_submit.back();
+      to_submit.pop_back();
+      engine->PrepRead(fd, bufs[i].data() + num_read[i], read_size - num_read[i],
+                       offsets[i] + num_read[i], i);
+      num_prepared += 1;
+    }
+    engine->Submit();
+    num_in_flight += num_prepared;
+    ASSERT_GT(num_in_flight, 0);
+    completions.clear();
+    engine->Reap(&completions);
+    ASSERT_FALSE(completions.empty());
+    std::set<uint64_t> tags;
+    for (const auto& completion : completions) {
+      ASSERT_TRUE(tags.insert(completion.first).second);
+      ASSERT_GT(completion.second, 0);
+      const size_t i = completion.first;
+      num_read[i] += completion.second;
+      ASSERT_LE(num_read[i], read_size);
+      num_in_flight -= 1;
+      if (num_read[i] < read_size) {
+        to_submit.push_back(i);
+      } else {
+        num_done += 1;
+      }
+    }
+  }
+  ASSERT_EQ(num_in_flight, 0);
+  for (size_t i = 0; i < num_reads; ++i) {
+    for (size_t j = 0; j < read_size; ++j) { ASSERT_EQ(bufs[i][j], ByteAt(offsets[i] + j)); }
+  }
+}
+
+}  // namespace
+
+TEST(AsyncReadEngine, Aio) {
+  const std::string dir = CreateTempDirectory();
+  PosixFile file(CreateTestFile(dir), O_RDONLY, 0644);
+  auto engine = NewAioReadEngine(8);
+  ASSERT_EQ(engine->queue_depth(), 8);
+  TestReads(engine.get(), file.fd(), 256, 4096, 8);
+  TestReads(engine.get(), file.fd(), 100, 1000, 3);
+  // Far more reads than the context has request slots, Submit has to wait for completions and
+  // Reap hands them out afterwards.
+  TestReads(engine.get(), file.fd(), 8192, 16, 8192);
+  file.Close();
+  PosixFile::RecursiveDelete(dir);
+}
+
+TEST(AsyncReadEngine, Ring) {
+  for (uint32_t max_registered_files : {0, 4}) {
+    auto engine = NewRingReadEngine(16, max_registered_files, /*poll_spin_count=*/64);
+    if (!engine) { GTEST_SKIP() << "io_uring is unavailable"; }
+    const std::string dir = CreateTempDirectory();
+    PosixFile file(CreateTestFile(dir), O_RDONLY, 0644);
+    TestReads(engine.get(), file.fd(), 256, 4096, 16);
+    TestReads(engine.get(), file.fd(), 100, 1000, 5);
+    engine->UnregisterFile(file.fd());
+    file.Close();
+    // the file index freed above is reused
+    PosixFile other(CreateTestFile(dir), O_RDONLY, 0644);
+    TestReads(engine.get(), other.fd(), 64, 512, 16);
+    engine->UnregisterFile(other.fd());
+    other.Close();
+    PosixFile::RecursiveDelete(dir);
+  }
+}
+
+#endif  // __linux__
+
+}  // namespace embedding
+
+}  // namespace oneflow
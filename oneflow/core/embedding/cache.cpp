@@ -16,12 +16,27 @@ limitations under the License.
 #include "oneflow/core/embedding/cache.h"
 #include "oneflow/core/embedding/full_cache.h"
 #include "oneflow/core/embedding/lru_cache.h"
+#include "oneflow/core/embedding/cpu_full_cache.h"
+#include "oneflow/core/embedding/cpu_lru_cache.h"
 
 namespace oneflow {
 
 namespace embedding {
 
 std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
+  if (options.device_type == DeviceType::kCPU) {
+    CHECK_GT(options.key_size, 0);
+    CHECK_GT(options.value_size, 0);
+    CHECK_GT(options.capacity, 0);
+    if (options.policy == CacheOptions::Policy::kLRU) {
+      return NewCpuLruCache(options);
+    } else if (options.policy == CacheOptions::Policy::kFull) {
+      return NewCpuFullCache(options);
+    } else {
+      UNIMPLEMENTED();
+      return nullptr;
+    }
+  }
 #ifdef WITH_CUDA
   CHECK_GT(options.key_size, 0);
   CHECK_GT(options.value_size, 0);
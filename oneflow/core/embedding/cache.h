@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/ep/include/stream.h"
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/device_type.h"
 
 namespace oneflow {
 
@@ -35,6 +36,9 @@ struct CacheOptions {
     kHost,
   };
   Policy policy = Policy::kLRU;
+  // kCPU selects the host-memory implementations, whose keys, values and outputs all live in host
+  // memory and whose methods run synchronously on an ep::CpuStream.
+  DeviceType device_type = DeviceType::kCUDA;
   MemoryKind value_memory_kind = MemoryKind::kDevice;
   uint64_t capacity{};
   uint32_t key_size{};
@@ -57,6 +61,7 @@ class Cache {
   virtual uint64_t Capacity() const = 0;
   virtual uint64_t DumpCapacity() const { return Capacity(); }
   virtual CacheOptions::Policy Policy() const = 0;
+  virtual DeviceType device_type() const = 0;
   virtual void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
                     void* missing_keys, uint32_t* missing_indices) = 0;
   virtual void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values,
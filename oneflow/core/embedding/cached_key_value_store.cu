@@ -318,8 +318,8 @@ std::unique_ptr<KeyValueStore> DispatchKeyType(std::unique_ptr<KeyValueStore>&&
 
 }  // namespace
 
-std::unique_ptr<KeyValueStore> NewCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store,
-                                                      std::unique_ptr<Cache>&& cache) {
+std::unique_ptr<KeyValueStore> NewCudaCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store,
+                                                          std::unique_ptr<Cache>&& cache) {
   return DispatchKeyType(std::move(store), std::move(cache));
 }
 
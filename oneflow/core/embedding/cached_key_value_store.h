@@ -23,9 +23,18 @@ namespace oneflow {
 
 namespace embedding {
 
+// The store and the cache must live on the same kind of device: a cache created with
+// CacheOptions::device_type == kCPU needs a store whose Get/Put take host pointers.
 std::unique_ptr<KeyValueStore> NewCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store,
                                                       std::unique_ptr<Cache>&& cache);
 
+#ifdef WITH_CUDA
+
+std::unique_ptr<KeyValueStore> NewCudaCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store,
+                                                          std::unique_ptr<Cache>&& cache);
+
+#endif  // WITH_CUDA
+
 }  // namespace embedding
 
 }  // namespace oneflow
@@ -0,0 +1,130 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_CPU_CACHE_SET_H_
+#define ONEFLOW_CORE_EMBEDDING_CPU_CACHE_SET_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "oneflow/core/common/cpu_relax.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif  // __SSE2__
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace cpu_cache {
+
+constexpr size_t kCacheLineSize = 64;
+constexpr uint32_t kNumWays = 16;
+constexpr size_t kParallelForGrain = 256;
+
+// A one-byte test-and-test-and-set lock. A set spans more than one cache line, so the lock is kept
+// after the keys, on the same line as n_valid and the other per-set bookkeeping that every
+// critical section reads or updates. Critical sections are a handful of compares and one value
+// copy.
+class SetMutex {
+ public:
+  void lock() {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      while (locked_.load(std::memory_order_relaxed)) { CpuRelax(); }
+    }
+  }
+  void unlock() { locked_.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> locked_{false};
+};
+
+// Returns a bitmask with bit i set iff keys[i] == key, for the kNumWays keys of one set. keys must
+// be aligned to kCacheLineSize.
+template<typename Key>
+inline uint32_t MatchKeys(const Key* keys, Key key) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kNumWays; ++i) { mask |= static_cast<uint32_t>(keys[i] == key) << i; }
+  return mask;
+}
+
+#if defined(__AVX2__)
+
+template<>
+inline uint32_t MatchKeys<uint64_t>(const uint64_t* keys, uint64_t key) {
+  const __m256i k = _mm256_set1_epi64x(static_cast<int64_t>(key));
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kNumWays / 4; ++i) {
+    const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i * 4));
+    const __m256d eq = _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, k));
+    mask |= static_cast<uint32_t>(_mm256_movemask_pd(eq)) << (i * 4);
+  }
+  return mask;
+}
+
+template<>
+inline uint32_t MatchKeys<uint32_t>(const uint32_t* keys, uint32_t key) {
+  const __m256i k = _mm256_set1_epi32(static_cast<int32_t>(key));
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kNumWays / 8; ++i) {
+    const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i * 8));
+    const __m256 eq = _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, k));
+    mask |= static_cast<uint32_t>(_mm256_movemask_ps(eq)) << (i * 8);
+  }
+  return mask;
+}
+
+#elif defined(__SSE2__)
+
+template<>
+inline uint32_t MatchKeys<uint32_t>(const uint32_t* keys, uint32_t key) {
+  const __m128i k = _mm_set1_epi32(static_cast<int32_t>(key));
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kNumWays / 4; ++i) {
+    const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + i * 4));
+    const __m128 eq = _mm_castsi128_ps(_mm_cmpeq_epi32(v, k));
+    mask |= static_cast<uint32_t>(_mm_movemask_ps(eq)) << (i * 4);
+  }
+  return mask;
+}
+
+#endif  // __AVX2__
+
+// Mask with the lowest n bits set, n <= kNumWays.
+inline uint32_t LowBits(uint32_t n) { return (1U << n) - 1U; }
+
+// Appends the missing keys found by one ParallelFor range to the shared outputs, reserving the
+// output slots with a single atomic add per range.
+template<typename Key>
+void AppendMissing(const std::vector<uint32_t>& local_missing_indices, const Key* keys,
+                   std::atomic<uint32_t>* n_missing, Key* missing_keys,
+                   uint32_t* missing_indices) {
+  if (local_missing_indices.empty()) { return; }
+  const uint32_t offset =
+      n_missing->fetch_add(local_missing_indices.size(), std::memory_order_relaxed);
+  for (size_t i = 0; i < local_missing_indices.size(); ++i) {
+    const uint32_t index = local_missing_indices[i];
+    missing_keys[offset + i] = keys[index];
+    missing_indices[offset + i] = index;
+  }
+}
+
+}  // namespace cpu_cache
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EMBEDDING_CPU_CACHE_SET_H_
@@ -0,0 +1,280 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/cpu_full_cache.h"
+#include "oneflow/core/embedding/cpu_cache_set.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include <cstring>
+#include <mutex>
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+using cpu_cache::kCacheLineSize;
+using cpu_cache::kNumWays;
+using cpu_cache::kParallelForGrain;
+
+// One bucket of the open-addressing key table. A key lives in the first set of its probe sequence
+// that had a free way when it was inserted; entries are never removed except by Clear, so a set
+// that is not full terminates every probe sequence passing through it.
+template<typename Key, typename Index>
+struct alignas(kCacheLineSize) FullCacheSet {
+  Key keys[kNumWays];
+  Index indices[kNumWays];
+  uint32_t dirty_mask;
+  uint8_t n_valid;
+  cpu_cache::SetMutex mutex;
+};
+
+template<typename Key, typename Index>
+class CpuFullCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuFullCache);
+  explicit CpuFullCache(const CacheOptions& options)
+      : if_dump_dirty_(ParseBooleanFromEnv("ONEFLOW_ONE_EMBEDDING_DUMP_DIRTY_ONLY", false)),
+        capacity_(options.capacity),
+        n_set_((static_cast<uint64_t>(options.capacity / options.load_factor) + kNumWays - 1)
+               / kNumWays),
+        value_size_(options.value_size),
+        value_type_(options.value_type),
+        max_query_length_(0),
+        size_(0),
+        sets_(n_set_),
+        values_(capacity_ * value_size_) {
+    CHECK_GE(n_set_ * kNumWays, capacity_);
+    Clear();
+  }
+  ~CpuFullCache() override = default;
+
+  uint64_t Capacity() const override { return capacity_; }
+  uint64_t DumpCapacity() const override { return n_set_ * kNumWays; }
+  uint32_t KeySize() const override { return sizeof(Key); }
+  uint32_t ValueSize() const override { return value_size_; }
+  DataType ValueType() const override { return value_type_; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    max_query_length_ = std::max(max_query_length_, query_length);
+  }
+
+  CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kFull; }
+
+  DeviceType device_type() const override { return DeviceType::kCPU; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<true>(stream, n_keys, static_cast<const Key*>(keys), nullptr, n_missing,
+                 static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<false>(stream, n_keys, static_cast<const Key*>(keys), static_cast<char*>(values),
+                  n_missing, static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values,
+           uint8_t* mask) override {
+    CHECK_LE(n_keys, max_query_length_);
+    const Key* keys_ptr = static_cast<const Key*>(keys);
+    char* values_ptr = static_cast<char*>(values);
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            Index index = 0;
+            mask[i] = Find<false>(keys_ptr[i], &index);
+            if (mask[i]) { std::memcpy(values_ptr + i * value_size_, Value(index), value_size_); }
+          }
+        },
+        kParallelForGrain);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override {
+    const char* values_ptr = static_cast<const char*>(values);
+    PutImpl(stream, n_keys, static_cast<const Key*>(keys), n_evicted, [&](uint32_t i, char* dst) {
+      std::memcpy(dst, values_ptr + i * value_size_, value_size_);
+    });
+  }
+
+  void FusedHalfUpdatePut(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                          const void* update, const float* lr, float scale, uint32_t* n_evicted,
+                          void* evicted_keys, void* evicted_values) override {
+    CHECK_EQ(value_type_, DataType::kFloat);
+    const uint32_t line_size = value_size_ / sizeof(float);
+    const float* values_ptr = static_cast<const float*>(values);
+    const float16* update_ptr = static_cast<const float16*>(update);
+    const float alpha = -*lr * scale;
+    PutImpl(stream, n_keys, static_cast<const Key*>(keys), n_evicted, [&](uint32_t i, char* dst) {
+      float* out = reinterpret_cast<float*>(dst);
+      const float* in = values_ptr + i * line_size;
+      const float16* diff = update_ptr + i * line_size;
+      for (uint32_t j = 0; j < line_size; ++j) {
+        out[j] = in[j] + static_cast<float>(diff[j]) * alpha;
+      }
+    });
+  }
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override {
+    Key* keys_ptr = static_cast<Key*>(keys);
+    char* values_ptr = static_cast<char*>(values);
+    uint32_t count = 0;
+    for (uint64_t slot = start_key_index; slot < end_key_index; ++slot) {
+      const FullCacheSet<Key, Index>& set = sets_[slot / kNumWays];
+      const uint32_t way = slot % kNumWays;
+      if (way >= set.n_valid) { continue; }
+      if (if_dump_dirty_ && (set.dirty_mask & (1U << way)) == 0) { continue; }
+      keys_ptr[count] = set.keys[way];
+      std::memcpy(values_ptr + count * value_size_, Value(set.indices[way]), value_size_);
+      count += 1;
+    }
+    *n_dumped = count;
+  }
+
+  void ClearDirtyFlags() override {
+    if (!if_dump_dirty_) { return; }
+    for (auto& set : sets_) { set.dirty_mask = 0; }
+  }
+
+  void Clear() override {
+    for (auto& set : sets_) {
+      set.dirty_mask = 0;
+      set.n_valid = 0;
+    }
+    size_ = 0;
+  }
+
+ private:
+  char* Value(Index index) { return values_.data() + index * value_size_; }
+
+  // Looks key up along its probe sequence, inserting it into the first set with a free way when
+  // insert is true. Returns false iff the key is absent and was not inserted.
+  template<bool insert>
+  bool Find(Key key, Index* index) {
+    uint64_t set_id = FullCacheHash()(key) % n_set_;
+    for (uint64_t count = 0; count < n_set_; ++count) {
+      FullCacheSet<Key, Index>* set = &sets_[set_id];
+      std::lock_guard<cpu_cache::SetMutex> lock(set->mutex);
+      const uint32_t n_valid = set->n_valid;
+      const uint32_t hit =
+          cpu_cache::MatchKeys<Key>(set->keys, key) & cpu_cache::LowBits(n_valid);
+      if (hit != 0) {
+        const uint32_t way = __builtin_ctz(hit);
+        if (insert && if_dump_dirty_) { set->dirty_mask |= 1U << way; }
+        *index = set->indices[way];
+        return true;
+      }
+      if (n_valid < kNumWays) {
+        if (!insert) { return false; }
+        const uint64_t new_index = size_.fetch_add(1, std::memory_order_relaxed);
+        CHECK_LT(new_index, capacity_) << "The full cache is out of capacity";
+        set->keys[n_valid] = key;
+        set->indices[n_valid] = static_cast<Index>(new_index);
+        if (if_dump_dirty_) { set->dirty_mask |= 1U << n_valid; }
+        set->n_valid = n_valid + 1;
+        *index = static_cast<Index>(new_index);
+        return true;
+      }
+      set_id = set_id + 1 == n_set_ ? 0 : set_id + 1;
+    }
+    CHECK(!insert) << "The full cache is out of capacity";
+    return false;
+  }
+
+  template<bool test_only>
+  void Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+              uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices) {
+    CHECK_LE(n_keys, max_query_length_);
+    std::atomic<uint32_t> missing_count(0);
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          std::vector<uint32_t> local_missing;
+          for (int64_t i = begin; i < end; ++i) {
+            Index index = 0;
+            if (!Find<false>(keys[i], &index)) {
+              local_missing.push_back(i);
+            } else if (!test_only) {
+              std::memcpy(values + i * value_size_, Value(index), value_size_);
+            }
+          }
+          cpu_cache::AppendMissing<Key>(local_missing, keys, &missing_count, missing_keys,
+                                        missing_indices);
+        },
+        kParallelForGrain);
+    *n_missing = missing_count.load();
+  }
+
+  // Value rows are never moved once assigned, so they are written outside the set lock; duplicate
+  // keys within one batch race exactly as they do in the device implementation.
+  template<typename WriteValue>
+  void PutImpl(ep::Stream* stream, uint32_t n_keys, const Key* keys, uint32_t* n_evicted,
+               const WriteValue& write_value) {
+    CHECK_LE(n_keys, max_query_length_);
+    *n_evicted = 0;
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            Index index = 0;
+            Find<true>(keys[i], &index);
+            write_value(i, Value(index));
+          }
+        },
+        kParallelForGrain);
+  }
+
+  const bool if_dump_dirty_;
+  const uint64_t capacity_;
+  const uint64_t n_set_;
+  const uint32_t value_size_;
+  const DataType value_type_;
+  uint32_t max_query_length_;
+  std::atomic<uint64_t> size_;
+  std::vector<FullCacheSet<Key, Index>> sets_;
+  std::vector<char> values_;
+};
+
+template<typename Key>
+std::unique_ptr<Cache> DispatchIndexType(const CacheOptions& options) {
+  if (options.capacity <= UINT32_MAX) {
+    return std::unique_ptr<Cache>(new CpuFullCache<Key, uint32_t>(options));
+  } else {
+    return std::unique_ptr<Cache>(new CpuFullCache<Key, uint64_t>(options));
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewCpuFullCache(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return DispatchIndexType<uint32_t>(options);
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return DispatchIndexType<uint64_t>(options);
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
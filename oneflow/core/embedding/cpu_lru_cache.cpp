@@ -0,0 +1,297 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/cpu_lru_cache.h"
+#include "oneflow/core/embedding/cpu_cache_set.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include <cstring>
+#include <mutex>
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+using cpu_cache::kCacheLineSize;
+using cpu_cache::kNumWays;
+using cpu_cache::kParallelForGrain;
+
+// One set of the cache. Ways are filled in order and never freed individually, so the valid ways
+// are always [0, n_valid). Ages follow the device implementation: 0 marks an empty way, the most
+// recently inserted or updated way has age kNumWays and the way with age 1 is evicted next.
+template<typename Key>
+struct alignas(kCacheLineSize) LruCacheSet {
+  Key keys[kNumWays];
+  uint8_t ages[kNumWays];
+  uint8_t n_valid;
+  cpu_cache::SetMutex mutex;
+};
+
+template<typename Key>
+class CpuLruCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuLruCache);
+  explicit CpuLruCache(const CacheOptions& options)
+      : n_set_((options.capacity + kNumWays - 1) / kNumWays),
+        value_size_(options.value_size),
+        value_type_(options.value_type),
+        max_query_length_(0),
+        sets_(n_set_),
+        values_(n_set_ * kNumWays * value_size_) {
+    Clear();
+  }
+  ~CpuLruCache() override = default;
+
+  uint32_t KeySize() const override { return sizeof(Key); }
+  uint32_t ValueSize() const override { return value_size_; }
+  DataType ValueType() const override { return value_type_; }
+  uint64_t Capacity() const override { return n_set_ * kNumWays; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    if (query_length <= max_query_length_) { return; }
+    pending_keys_.resize(query_length);
+    pending_indices_.resize(query_length);
+    max_query_length_ = query_length;
+  }
+
+  CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kLRU; }
+
+  DeviceType device_type() const override { return DeviceType::kCPU; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<true>(stream, n_keys, static_cast<const Key*>(keys), nullptr, n_missing,
+                 static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  using Cache::Get;
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<false>(stream, n_keys, static_cast<const Key*>(keys), static_cast<char*>(values),
+                  n_missing, static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values,
+           uint8_t* mask) override {
+    CHECK_LE(n_keys, max_query_length_);
+    const Key* keys_ptr = static_cast<const Key*>(keys);
+    char* values_ptr = static_cast<char*>(values);
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            LruCacheSet<Key>* set = SetOf(keys_ptr[i]);
+            std::lock_guard<cpu_cache::SetMutex> lock(set->mutex);
+            const uint32_t hit = cpu_cache::MatchKeys<Key>(set->keys, keys_ptr[i])
+                                 & cpu_cache::LowBits(set->n_valid);
+            mask[i] = hit != 0;
+            if (hit == 0) { continue; }
+            std::memcpy(values_ptr + i * value_size_, Value(set, __builtin_ctz(hit)), value_size_);
+          }
+        },
+        kParallelForGrain);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override {
+    const char* values_ptr = static_cast<const char*>(values);
+    PutImpl(stream, n_keys, static_cast<const Key*>(keys), n_evicted,
+            static_cast<Key*>(evicted_keys), static_cast<char*>(evicted_values),
+            [&](uint32_t i, char* dst) {
+              std::memcpy(dst, values_ptr + i * value_size_, value_size_);
+            });
+  }
+
+  void FusedHalfUpdatePut(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                          const void* update, const float* lr, float scale, uint32_t* n_evicted,
+                          void* evicted_keys, void* evicted_values) override {
+    CHECK_EQ(value_type_, DataType::kFloat);
+    const uint32_t line_size = value_size_ / sizeof(float);
+    const float* values_ptr = static_cast<const float*>(values);
+    const float16* update_ptr = static_cast<const float16*>(update);
+    const float alpha = -*lr * scale;
+    PutImpl(stream, n_keys, static_cast<const Key*>(keys), n_evicted,
+            static_cast<Key*>(evicted_keys), static_cast<char*>(evicted_values),
+            [&](uint32_t i, char* dst) {
+              float* out = reinterpret_cast<float*>(dst);
+              const float* in = values_ptr + i * line_size;
+              const float16* diff = update_ptr + i * line_size;
+              for (uint32_t j = 0; j < line_size; ++j) {
+                out[j] = in[j] + static_cast<float>(diff[j]) * alpha;
+              }
+            });
+  }
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override {
+    Key* keys_ptr = static_cast<Key*>(keys);
+    char* values_ptr = static_cast<char*>(values);
+    uint32_t count = 0;
+    for (uint64_t index = start_key_index; index < end_key_index; ++index) {
+      LruCacheSet<Key>* set = &sets_[index / kNumWays];
+      const uint32_t way = index % kNumWays;
+      if (way >= set->n_valid) { continue; }
+      keys_ptr[count] = set->keys[way];
+      std::memcpy(values_ptr + count * value_size_, Value(set, way), value_size_);
+      count += 1;
+    }
+    *n_dumped = count;
+  }
+
+  void ClearDirtyFlags() override {
+    // do nothing.
+    return;
+  }
+
+  void Clear() override {
+    for (auto& set : sets_) {
+      std::fill(std::begin(set.keys), std::end(set.keys), Key{});
+      std::fill(std::begin(set.ages), std::end(set.ages), 0);
+      set.n_valid = 0;
+    }
+  }
+
+ private:
+  LruCacheSet<Key>* SetOf(Key key) { return &sets_[LruCacheHash()(key) % n_set_]; }
+
+  char* Value(const LruCacheSet<Key>* set, uint32_t way) {
+    return values_.data() + ((set - sets_.data()) * kNumWays + way) * value_size_;
+  }
+
+  template<bool test_only>
+  void Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+              uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices) {
+    CHECK_LE(n_keys, max_query_length_);
+    std::atomic<uint32_t> missing_count(0);
+    stream->As<ep::CpuStream>()->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          std::vector<uint32_t> local_missing;
+          for (int64_t i = begin; i < end; ++i) {
+            const Key key = keys[i];
+            LruCacheSet<Key>* set = SetOf(key);
+            std::lock_guard<cpu_cache::SetMutex> lock(set->mutex);
+            const uint32_t hit =
+                cpu_cache::MatchKeys<Key>(set->keys, key) & cpu_cache::LowBits(set->n_valid);
+            if (hit == 0) {
+              local_missing.push_back(i);
+            } else if (!test_only) {
+              std::memcpy(values + i * value_size_, Value(set, __builtin_ctz(hit)), value_size_);
+            }
+          }
+          cpu_cache::AppendMissing<Key>(local_missing, keys, &missing_count, missing_keys,
+                                        missing_indices);
+        },
+        kParallelForGrain);
+    *n_missing = missing_count.load();
+  }
+
+  // Same two phases as the device implementation: the first pass updates hits and fills free ways,
+  // the second evicts for the remaining keys. Keys of the batch are thus refreshed before any
+  // eviction happens, and an evicted key is never left in the cache by the same Put.
+  template<typename WriteValue>
+  void PutImpl(ep::Stream* stream, uint32_t n_keys, const Key* keys, uint32_t* n_evicted,
+               Key* evicted_keys, char* evicted_values, const WriteValue& write_value) {
+    CHECK_LE(n_keys, max_query_length_);
+    auto* cpu_stream = stream->As<ep::CpuStream>();
+    std::atomic<uint32_t> pending_count(0);
+    cpu_stream->ParallelFor(
+        0, n_keys,
+        [&](int64_t begin, int64_t end) {
+          std::vector<uint32_t> local_pending;
+          for (int64_t i = begin; i < end; ++i) {
+            const Key key = keys[i];
+            LruCacheSet<Key>* set = SetOf(key);
+            std::lock_guard<cpu_cache::SetMutex> lock(set->mutex);
+            const uint32_t n_valid = set->n_valid;
+            const uint32_t hit =
+                cpu_cache::MatchKeys<Key>(set->keys, key) & cpu_cache::LowBits(n_valid);
+            uint32_t way = 0;
+            if (hit != 0) {
+              way = __builtin_ctz(hit);
+              const uint8_t age = set->ages[way];
+              for (uint32_t w = 0; w < n_valid; ++w) {
+                if (set->ages[w] > age) { set->ages[w] -= 1; }
+              }
+            } else if (n_valid < kNumWays) {
+              way = n_valid;
+              for (uint32_t w = 0; w < n_valid; ++w) { set->ages[w] -= 1; }
+              set->keys[way] = key;
+              set->n_valid = n_valid + 1;
+            } else {
+              local_pending.push_back(i);
+              continue;
+            }
+            set->ages[way] = kNumWays;
+            write_value(i, Value(set, way));
+          }
+          cpu_cache::AppendMissing<Key>(local_pending, keys, &pending_count,
+                                        pending_keys_.data(), pending_indices_.data());
+        },
+        kParallelForGrain);
+    std::atomic<uint32_t> evicted_count(0);
+    cpu_stream->ParallelFor(
+        0, pending_count.load(),
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            const Key key = pending_keys_[i];
+            LruCacheSet<Key>* set = SetOf(key);
+            std::lock_guard<cpu_cache::SetMutex> lock(set->mutex);
+            uint32_t way = 0;
+            for (uint32_t w = 0; w < kNumWays; ++w) {
+              if (set->ages[w] == 1) { way = w; }
+              set->ages[w] -= 1;
+            }
+            const uint32_t offset = evicted_count.fetch_add(1, std::memory_order_relaxed);
+            evicted_keys[offset] = set->keys[way];
+            std::memcpy(evicted_values + offset * value_size_, Value(set, way), value_size_);
+            set->keys[way] = key;
+            set->ages[way] = kNumWays;
+            write_value(pending_indices_[i], Value(set, way));
+          }
+        },
+        kParallelForGrain);
+    *n_evicted = evicted_count.load();
+  }
+
+  const uint64_t n_set_;
+  const uint32_t value_size_;
+  const DataType value_type_;
+  uint32_t max_query_length_;
+  std::vector<LruCacheSet<Key>> sets_;
+  std::vector<char> values_;
+  std::vector<Key> pending_keys_;
+  std::vector<uint32_t> pending_indices_;
+};
+
+}  // namespace
+
+std::unique_ptr<Cache> NewCpuLruCache(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return std::unique_ptr<Cache>(new CpuLruCache<uint32_t>(options));
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return std::unique_ptr<Cache>(new CpuLruCache<uint64_t>(options));
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -496,6 +496,8 @@ class CacheImpl : public Cache {
 
   CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kFull; }
 
+  DeviceType device_type() const override { return DeviceType::kCUDA; }
+
   void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
             void* missing_keys, uint32_t* missing_indices) override;
 
@@ -18,6 +18,7 @@ limitations under the License.
 #include "nlohmann/json.hpp"
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/embedding/cache.h"
+#include "oneflow/core/embedding/persistent_table.h"
 
 namespace oneflow {
 namespace embedding {
@@ -147,6 +148,18 @@ class KeyValueStoreOptions final {
     } else {
       persistent_table_capacity_hint_ = 0;
     }
+    persistent_table_io_engine_ = PersistentTableOptions::IoEngine::kAio;
+    if (persistent_table.contains("io_engine")) {
+      CHECK(persistent_table["io_engine"].is_string());
+      const std::string io_engine = persistent_table["io_engine"].get<std::string>();
+      if (io_engine == "aio") {
+        persistent_table_io_engine_ = PersistentTableOptions::IoEngine::kAio;
+      } else if (io_engine == "uring") {
+        persistent_table_io_engine_ = PersistentTableOptions::IoEngine::kUring;
+      } else {
+        UNIMPLEMENTED() << "Unsupported persistent table io_engine";
+      }
+    }
   }
   ~KeyValueStoreOptions() = default;
   int64_t KeyTypeSize() const { return key_type_size_; }
@@ -158,6 +171,9 @@ class KeyValueStoreOptions final {
   const std::vector<std::string>& PersistentTablePaths() const { return persistent_table_paths_; }
   int64_t PersistentTablePhysicalBlockSize() const { return persistent_table_physical_block_size_; }
   int64_t PersistentTableCapacityHint() const { return persistent_table_capacity_hint_; }
+  PersistentTableOptions::IoEngine PersistentTableIoEngine() const {
+    return persistent_table_io_engine_;
+  }
   bool IsFullCache() const {
     if (cache_options_.size() > 0 && cache_options_.at(0).policy == CacheOptions::Policy::kFull) {
       return true;
@@ -174,6 +190,7 @@ class KeyValueStoreOptions final {
   std::vector<std::string> persistent_table_paths_;
   int64_t persistent_table_physical_block_size_;
   int64_t persistent_table_capacity_hint_;
+  PersistentTableOptions::IoEngine persistent_table_io_engine_;
   std::vector<CacheOptions> cache_options_;
 };
 
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/embedding/persistent_table_key_value_store.h"
+#include "oneflow/core/embedding/persistent_table.h"
 #include "oneflow/core/embedding/cached_key_value_store.h"
 #include "oneflow/core/embedding/mock_key_value_store.h"
 #include "oneflow/core/embedding/cache.h"
@@ -21,6 +22,9 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "oneflow/core/ep/include/device_manager_registry.h"
 #include "oneflow/core/embedding/posix_file.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace oneflow {
 
@@ -28,8 +32,6 @@ namespace embedding {
 
 namespace {
 
-#ifdef WITH_CUDA
-
 std::string CreateTempDirectory() {
   const char* tmp_env = getenv("TMPDIR");
   const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
@@ -39,6 +41,371 @@ std::string CreateTempDirectory() {
   return std::string(path);
 }
 
+#ifdef __linux__
+
+constexpr uint32_t kHostValueLength = 32;
+
+PersistentTableOptions HostTableOptions(const std::string& path) {
+  PersistentTableOptions options{};
+  options.path = path;
+  options.key_size = sizeof(uint64_t);
+  options.value_size = kHostValueLength * sizeof(float);
+  options.physical_block_size = 512;
+  return options;
+}
+
+void PutHostValues(PersistentTable* table, const std::vector<uint64_t>& keys, float version) {
+  std::vector<float> values(keys.size() * kHostValueLength);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (size_t j = 0; j < kHostValueLength; ++j) {
+      values[i * kHostValueLength + j] = keys[i] + version;
+    }
+  }
+  table->Put(keys.size(), keys.data(), values.data());
+}
+
+void CheckHostValues(PersistentTable* table, const std::vector<uint64_t>& keys,
+                     const std::function<float(uint64_t)>& ExpectedVersion) {
+  std::vector<float> values(keys.size() * kHostValueLength);
+  std::vector<uint32_t> missing_indices(keys.size());
+  uint32_t n_missing = 0;
+  table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (size_t j = 0; j < kHostValueLength; ++j) {
+      ASSERT_EQ(values[i * kHostValueLength + j], keys[i] + ExpectedVersion(keys[i]));
+    }
+  }
+}
+
+void TestHostPersistentTable(const PersistentTableOptions& options) {
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  std::vector<uint64_t> keys(4096);
+  for (size_t i = 0; i < keys.size(); ++i) { keys[i] = i * 3 + 1; }
+  PutHostValues(table.get(), keys, 0);
+  CheckHostValues(table.get(), keys, [](uint64_t) { return 0.f; });
+  std::vector<uint64_t> missing_keys = {0, 2, keys.back() + 3};
+  std::vector<float> values(missing_keys.size() * kHostValueLength);
+  std::vector<uint32_t> missing_indices(missing_keys.size());
+  uint32_t n_missing = 0;
+  table->Get(missing_keys.size(), missing_keys.data(), values.data(), &n_missing,
+             missing_indices.data());
+  ASSERT_EQ(n_missing, missing_keys.size());
+  table->SaveSnapshot("host");
+  table.reset();
+  table = NewPersistentTable(options);
+  table->LoadSnapshot("host");
+  CheckHostValues(table.get(), keys, [](uint64_t) { return 0.f; });
+}
+
+TEST(PersistentTable, UringEngine) {
+  if (!IsUringEngineSupported()) {
+    GTEST_SKIP() << "io_uring is unavailable: built without liburing or unsupported by kernel";
+  }
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.io_engine = PersistentTableOptions::IoEngine::kUring;
+  TestHostPersistentTable(options);
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, AioEngine) {
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.io_engine = PersistentTableOptions::IoEngine::kAio;
+  TestHostPersistentTable(options);
+  PosixFile::RecursiveDelete(path);
+}
+
+// Checks that every key is found and that each row holds a single version written by a Put.
+void CheckHostValuesConsistent(PersistentTable* table, const std::vector<uint64_t>& keys,
+                               float max_version) {
+  std::vector<float> values(keys.size() * kHostValueLength);
+  std::vector<uint32_t> missing_indices(keys.size());
+  uint32_t n_missing = 0;
+  table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const float version = values[i * kHostValueLength] - keys[i];
+    ASSERT_GE(version, 0);
+    ASSERT_LE(version, max_version);
+    for (size_t j = 1; j < kHostValueLength; ++j) {
+      ASSERT_EQ(values[i * kHostValueLength + j], values[i * kHostValueLength]);
+    }
+  }
+}
+
+TEST(PersistentTable, ConcurrentGetPutSnapshot) {
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.target_chunk_size_mb = 1;
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  constexpr size_t kNumKeys = 2048;
+  constexpr int kNumWriters = 2;
+  constexpr int kNumReaders = 4;
+  constexpr int kNumIters = 20;
+  constexpr int kNumSnapshots = 8;
+  std::vector<uint64_t> all_keys(kNumKeys);
+  for (size_t i = 0; i < kNumKeys; ++i) { all_keys[i] = i; }
+  PutHostValues(table.get(), all_keys, 0);
+
+  std::atomic<bool> writers_done(false);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < kNumWriters; ++w) {
+    threads.emplace_back([&, w]() {
+      // Writers update overlapping halves of the key space.
+      std::vector<uint64_t> keys(all_keys.begin() + w * kNumKeys / 4,
+                                 all_keys.begin() + w * kNumKeys / 4 + kNumKeys / 2);
+      for (int iter = 1; iter <= kNumIters; ++iter) { PutHostValues(table.get(), keys, iter); }
+    });
+  }
+  for (int r = 0; r < kNumReaders; ++r) {
+    threads.emplace_back([&, r]() {
+      std::vector<uint64_t> keys;
+      for (size_t i = r; i < kNumKeys; i += 3) { keys.emplace_back(i); }
+      while (!writers_done) { CheckHostValuesConsistent(table.get(), keys, kNumIters); }
+    });
+  }
+  std::thread snapshot_thread([&]() {
+    for (int i = 0; i < kNumSnapshots; ++i) { table->SaveSnapshot("s" + std::to_string(i)); }
+  });
+  for (int w = 0; w < kNumWriters; ++w) { threads.at(w).join(); }
+  snapshot_thread.join();
+  writers_done = true;
+  for (size_t i = kNumWriters; i < threads.size(); ++i) { threads.at(i).join(); }
+
+  CheckHostValuesConsistent(table.get(), all_keys, kNumIters);
+  for (int i = 0; i < kNumSnapshots; ++i) {
+    table->LoadSnapshot("s" + std::to_string(i));
+    CheckHostValuesConsistent(table.get(), all_keys, kNumIters);
+  }
+  PutHostValues(table.get(), all_keys, kNumIters + 1);
+  CheckHostValues(table.get(), all_keys, [](uint64_t) { return kNumIters + 1.f; });
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+std::vector<uint64_t> KeyRange(uint64_t begin, uint64_t end) {
+  std::vector<uint64_t> keys(end - begin);
+  for (uint64_t i = begin; i < end; ++i) { keys[i - begin] = i; }
+  return keys;
+}
+
+bool ValueChunkExists(const std::string& path, uint64_t chunk_id) {
+  std::string name = std::to_string(chunk_id);
+  name = "value-" + std::string(12 - name.size(), '0') + name;
+  return PosixFile::FileExists(PosixFile::JoinPath(PosixFile::JoinPath(path, "values"), name));
+}
+
+// With 1MB chunks, 512B blocks and 128B values, a chunk holds 8192 values.
+constexpr uint64_t kHostValuesPerChunk = 8192;
+
+// Fills chunk 0, then overwrites three quarters of it so its liveness drops to 0.25.
+void FillAndOverwriteFirstChunk(PersistentTable* table) {
+  PutHostValues(table, KeyRange(0, kHostValuesPerChunk), 0);
+  PutHostValues(table, KeyRange(0, kHostValuesPerChunk * 3 / 4), 1);
+}
+
+float LatestVersionAfterOverwrite(uint64_t key) { return key < kHostValuesPerChunk * 3 / 4; }
+
+TEST(PersistentTable, Compaction) {
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.target_chunk_size_mb = 1;
+  options.compaction_liveness_threshold = 0.5;
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  const std::vector<uint64_t> keys = KeyRange(0, kHostValuesPerChunk);
+  FillAndOverwriteFirstChunk(table.get());
+  ASSERT_TRUE(ValueChunkExists(path, 0));
+  table->Compact();
+  ASSERT_FALSE(ValueChunkExists(path, 0));
+  CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+  // Compacting again finds nothing to do and keeps the data intact.
+  table->Compact();
+  CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+  table->SaveSnapshot("compacted");
+  table.reset();
+
+  table = NewPersistentTable(options);
+  table->LoadSnapshot("compacted");
+  CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+  PutHostValues(table.get(), keys, 2);
+  CheckHostValues(table.get(), keys, [](uint64_t) { return 2.f; });
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, CompactionKeepsSnapshotChunks) {
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.target_chunk_size_mb = 1;
+  options.compaction_liveness_threshold = 0.5;
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  const std::vector<uint64_t> keys = KeyRange(0, kHostValuesPerChunk);
+  PutHostValues(table.get(), keys, 0);
+  table->SaveSnapshot("before");
+  PutHostValues(table.get(), KeyRange(0, kHostValuesPerChunk * 3 / 4), 1);
+  table->Compact();
+  ASSERT_TRUE(ValueChunkExists(path, 0));
+  CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+  table->LoadSnapshot("before");
+  CheckHostValues(table.get(), keys, [](uint64_t) { return 0.f; });
+  table.reset();
+
+  table = NewPersistentTable(options);
+  table->LoadSnapshot("before");
+  CheckHostValues(table.get(), keys, [](uint64_t) { return 0.f; });
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, BackgroundCompaction) {
+  std::string path = CreateTempDirectory();
+  PersistentTableOptions options = HostTableOptions(path);
+  options.target_chunk_size_mb = 1;
+  options.enable_compaction = true;
+  options.compaction_liveness_threshold = 0.5;
+  options.compaction_interval_ms = 1;
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  const std::vector<uint64_t> keys = KeyRange(0, kHostValuesPerChunk);
+  FillAndOverwriteFirstChunk(table.get());
+  // Readers keep running while the background thread rewrites live rows and removes the chunk.
+  for (int i = 0; i < 10000 && ValueChunkExists(path, 0); ++i) {
+    CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_FALSE(ValueChunkExists(path, 0));
+  CheckHostValues(table.get(), keys, LatestVersionAfterOverwrite);
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+// Host counterpart of TestKeyValueStore for stores built on host caches and tables. The second
+// round of Puts makes the LRU cache evict into the store and the full cache sync on SaveSnapshot.
+void TestCpuKeyValueStore(KeyValueStore* store, size_t num_embeddings, size_t embedding_vec_size) {
+  auto device = Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const size_t batch_size = 128;
+  std::vector<uint64_t> keys(num_embeddings);
+  std::vector<float> values(num_embeddings * embedding_vec_size);
+  std::vector<float> values1(num_embeddings * embedding_vec_size);
+  std::vector<uint32_t> missing_indices(batch_size);
+  uint32_t n_missing = 0;
+  for (size_t i = 0; i < num_embeddings; ++i) { keys[i] = i + 1; }
+  const auto FillValues = [&](float version) {
+    for (size_t i = 0; i < num_embeddings; ++i) {
+      for (size_t j = 0; j < embedding_vec_size; ++j) {
+        values[i * embedding_vec_size + j] = keys[i] + version;
+      }
+    }
+  };
+  const auto PutAll = [&]() {
+    for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+      const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+      store->Put(stream, num_keys, keys.data() + offset,
+                 values.data() + offset * embedding_vec_size);
+    }
+  };
+  const auto CheckAll = [&](float version) {
+    std::fill(values1.begin(), values1.end(), 0.f);
+    for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+      const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+      store->Get(stream, num_keys, keys.data() + offset,
+                 values1.data() + offset * embedding_vec_size, &n_missing, missing_indices.data());
+      ASSERT_EQ(n_missing, 0);
+    }
+    for (size_t i = 0; i < num_embeddings * embedding_vec_size; ++i) {
+      ASSERT_EQ(values1[i], keys[i / embedding_vec_size] + version);
+    }
+  };
+  const auto CheckAllMissing = [&]() {
+    for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+      const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+      store->Get(stream, num_keys, keys.data() + offset,
+                 values1.data() + offset * embedding_vec_size, &n_missing, missing_indices.data());
+      ASSERT_EQ(n_missing, num_keys);
+      std::sort(missing_indices.begin(), missing_indices.begin() + n_missing);
+      for (uint32_t i = 0; i < n_missing; ++i) { ASSERT_EQ(missing_indices[i], i); }
+    }
+  };
+
+  store->SaveSnapshot("init");
+  store->Put(stream, 0, keys.data(), values.data());
+  CheckAllMissing();
+  FillValues(0);
+  PutAll();
+  CheckAll(0);
+  store->SaveSnapshot("final");
+  FillValues(1);
+  PutAll();
+  CheckAll(1);
+  store->SaveSnapshot("updated");
+
+  store->LoadSnapshot("init");
+  CheckAllMissing();
+  store->LoadSnapshot("final");
+  CheckAll(0);
+  store->LoadSnapshot("updated");
+  CheckAll(1);
+  device->DestroyStream(stream);
+}
+
+PersistentTableKeyValueStoreOptions CpuStoreOptions(const std::string& path,
+                                                    uint32_t value_length) {
+  PersistentTableKeyValueStoreOptions options{};
+  options.device_type = DeviceType::kCPU;
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  return options;
+}
+
+void TestCpuCachedKeyValueStore(CacheOptions::Policy policy, uint64_t capacity) {
+  Singleton<ep::DeviceManagerRegistry>::New();
+  std::string path = CreateTempDirectory();
+  const uint32_t value_length = 128;
+  std::unique_ptr<KeyValueStore> store =
+      NewPersistentTableKeyValueStore(CpuStoreOptions(path, value_length));
+  CacheOptions cache_options{};
+  cache_options.policy = policy;
+  cache_options.device_type = DeviceType::kCPU;
+  cache_options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  cache_options.value_size = value_length * sizeof(float);
+  cache_options.value_type = DataType::kFloat;
+  cache_options.capacity = capacity;
+  cache_options.key_size = 8;
+  std::unique_ptr<KeyValueStore> cached_store =
+      NewCachedKeyValueStore(std::move(store), NewCache(cache_options));
+  cached_store->ReserveQueryLength(128);
+  TestCpuKeyValueStore(cached_store.get(), 1024, value_length);
+  cached_store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(PersistentTableKeyValueStore, Cpu) {
+  Singleton<ep::DeviceManagerRegistry>::New();
+  std::string path = CreateTempDirectory();
+  std::unique_ptr<KeyValueStore> store =
+      NewPersistentTableKeyValueStore(CpuStoreOptions(path, 128));
+  store->ReserveQueryLength(128);
+  TestCpuKeyValueStore(store.get(), 1024, 128);
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(CachedKeyValueStore, CpuLRU) { TestCpuCachedKeyValueStore(CacheOptions::Policy::kLRU, 512); }
+
+TEST(CachedKeyValueStore, CpuFull) {
+  TestCpuCachedKeyValueStore(CacheOptions::Policy::kFull, 1024 * 2);
+}
+
+#endif  // __linux__
+
+#ifdef WITH_CUDA
+
 bool HasCudaDevice() {
   int device_count = 0;
   if (cudaGetDeviceCount(&device_count) != cudaSuccess) { return false; }
@@ -191,6 +558,30 @@ TEST(PersistentTableKeyValueStore, PersistentTableKeyValueStore) {
   Singleton<ep::DeviceManagerRegistry>::Delete();
 }
 
+TEST(PersistentTableKeyValueStore, UringEngine) {
+  if (!HasCudaDevice()) { return; }
+  if (!IsUringEngineSupported()) {
+    GTEST_SKIP() << "io_uring is unavailable: built without liburing or unsupported by kernel";
+  }
+  Singleton<ep::DeviceManagerRegistry>::New();
+  PersistentTableKeyValueStoreOptions options{};
+  uint32_t value_length = 128;
+
+  std::string path = CreateTempDirectory();
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  options.table_options.io_engine = PersistentTableOptions::IoEngine::kUring;
+
+  std::unique_ptr<KeyValueStore> store = NewPersistentTableKeyValueStore(options);
+  store->ReserveQueryLength(128);
+  TestKeyValueStore(store.get(), 1024, 1024, value_length);
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Singleton<ep::DeviceManagerRegistry>::Delete();
+}
+
 TEST(CachedKeyValueStore, LRU) {
   if (!HasCudaDevice()) { return; }
   Singleton<ep::DeviceManagerRegistry>::New();
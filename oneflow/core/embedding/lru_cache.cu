@@ -535,6 +535,8 @@ class LruCache : public Cache {
 
   CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kLRU; }
 
+  DeviceType device_type() const override { return DeviceType::kCUDA; }
+
   void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
             void* missing_keys, uint32_t* missing_indices) override {
     CHECK_LE(n_keys, max_query_length_);
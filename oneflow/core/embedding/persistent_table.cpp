@@ -21,15 +21,22 @@ limitations under the License.
 
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/embedding/posix_file.h"
+#include "oneflow/core/embedding/async_read_engine.h"
 #include "oneflow/core/common/blocking_counter.h"
 #include <robin_hood.h>
+#include <cstring>
+#include <shared_mutex>
+#include <pthread.h>
+#include <unordered_set>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <dirent.h>
-#include <sys/syscall.h>
-#include <linux/aio_abi.h>
 #include <unistd.h>
 
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#endif  // WITH_LIBURING
+
 #endif  // __linux__
 
 namespace oneflow {
@@ -41,8 +48,9 @@ namespace embedding {
 namespace {
 
 constexpr uint32_t kDefaultNumWorkerThreads = 4;
-constexpr uint32_t kRingQueueDepth = 128;
-constexpr uint32_t kRingSubmitBatch = 32;
+constexpr uint32_t kRingQueueDepth = 512;
+constexpr uint32_t kRingMaxRegisteredFiles = 1024;
+constexpr uint32_t kRingPollSpinCount = 1024;
 constexpr uint32_t kAioQueueDepth = 128;
 constexpr uint32_t kChunkNameSuffixLength = 12;
 constexpr char const* kKeyFileNamePrefix = "key-";
@@ -58,6 +66,8 @@ constexpr char const* kValuesDirName = "values";
 constexpr char const* kSnapshotsDirName = "snapshots";
 constexpr char const* kSnapshotListFileName = "LIST";
 constexpr size_t kParallelForStride = 256;
+constexpr uint32_t kNumIndexShards = 64;
+constexpr uint64_t kCompactionBatchBlocks = 1024;
 
 template<typename T>
 T* BytesOffset(T* ptr, size_t bytes) {
@@ -194,54 +204,122 @@ class ChunkIteratorImpl : public PersistentTable::Iterator {
   uint64_t chunk_index_offset_;
 };
 
-class AioEngine final {
+// Reads blocks through an AsyncReadEngine, at most its queue depth of them at a time.
+// WaitUntilDone submits the queued reads and waits for all of them, resubmitting the rest of the
+// reads which complete short.
+class ReadEngine {
  public:
-  OF_DISALLOW_COPY_AND_MOVE(AioEngine);
-  AioEngine() : ctx_{}, num_readings_(0) {
-    PCHECK(syscall(__NR_io_setup, kAioQueueDepth, &ctx_) >= 0);
-    cbs_.resize(kAioQueueDepth);
-    cbs_ptr_.resize(kAioQueueDepth);
-    for (uint32_t i = 0; i < kAioQueueDepth; ++i) { cbs_ptr_[i] = &cbs_[i]; }
-    events_.resize(kAioQueueDepth);
-  }
-  ~AioEngine() {
-    WaitUntilDone();
-    PCHECK(syscall(__NR_io_destroy, ctx_) >= 0);
+  OF_DISALLOW_COPY_AND_MOVE(ReadEngine);
+  explicit ReadEngine(std::unique_ptr<AsyncReadEngine>&& engine) : engine_(std::move(engine)) {
+    CHECK(engine_);
+    reads_.reserve(engine_->queue_depth());
   }
+  ~ReadEngine() { WaitUntilDone(); }
 
   void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
-    if (num_readings_ == kAioQueueDepth) { WaitUntilDone(); }
-    struct iocb* cb = &cbs_.at(num_readings_);
-    cb->aio_fildes = fd;
-    cb->aio_lio_opcode = IOCB_CMD_PREAD;
-    cb->aio_reqprio = 0;
-    cb->aio_buf = reinterpret_cast<uintptr_t>(buf);
-    cb->aio_nbytes = count;
-    cb->aio_offset = offset;
-    const long nr = 1;
-    PCHECK(syscall(__NR_io_submit, ctx_, nr, &cbs_ptr_.at(num_readings_)) >= 0);
-    num_readings_ += 1;
+    if (reads_.size() == engine_->queue_depth()) { WaitUntilDone(); }
+    reads_.push_back(Read{fd, static_cast<char*>(buf), count, static_cast<size_t>(offset), 0});
+    engine_->PrepRead(fd, buf, count, offset, reads_.size() - 1);
   }
 
   void WaitUntilDone() {
-    if (num_readings_ != 0) {
-      PCHECK(syscall(__NR_io_getevents, ctx_, num_readings_, num_readings_, events_.data(), nullptr)
-             >= 0);
-      for (long i = 0; i < num_readings_; ++i) { CHECK_GT(events_.at(i).res, 0); }
-      num_readings_ = 0;
+    engine_->Submit();
+    size_t num_pending_reads = reads_.size();
+    while (num_pending_reads != 0) {
+      completions_.clear();
+      engine_->Reap(&completions_);
+      bool resubmit = false;
+      for (const auto& completion : completions_) {
+        Read& read = reads_.at(completion.first);
+        CHECK_GE(completion.second, 0)
+            << "failed to read " << read.count << " bytes at offset " << read.offset << " of fd "
+            << read.fd << ": " << strerror(-completion.second);
+        CHECK_GT(completion.second, 0) << "unexpected end of file at offset "
+                                       << read.offset + read.num_read << " of fd " << read.fd;
+        read.num_read += completion.second;
+        if (read.num_read < read.count) {
+          engine_->PrepRead(read.fd, read.buf + read.num_read, read.count - read.num_read,
+                            read.offset + read.num_read, completion.first);
+          resubmit = true;
+        } else {
+          num_pending_reads -= 1;
+        }
+      }
+      if (resubmit) { engine_->Submit(); }
     }
+    reads_.clear();
+  }
+
+  void UnregisterFile(int fd) {
+    WaitUntilDone();
+    engine_->UnregisterFile(fd);
   }
 
  private:
-  aio_context_t ctx_;
-  long num_readings_;
-  std::vector<struct iocb> cbs_;
-  std::vector<struct iocb*> cbs_ptr_;
-  std::vector<struct io_event> events_;
+  struct Read {
+    int fd;
+    char* buf;
+    size_t count;
+    size_t offset;
+    size_t num_read;
+  };
+
+  std::unique_ptr<AsyncReadEngine> engine_;
+  // Reads since the last WaitUntilDone, tagged with their index.
+  std::vector<Read> reads_;
+  std::vector<std::pair<uint64_t, int64_t>> completions_;
+};
+
+class AioEngine final : public ReadEngine {
+ public:
+  AioEngine() : ReadEngine(NewAioReadEngine(kAioQueueDepth)) {}
+};
+
+#ifdef WITH_LIBURING
+
+// Every worker sets up its own ring, which may still fail after IsUringEngineSupported, e.g. once
+// the rings exceed RLIMIT_MEMLOCK. Such a worker reads with aio instead.
+std::unique_ptr<AsyncReadEngine> NewRingOrAioReadEngine() {
+  std::unique_ptr<AsyncReadEngine> engine =
+      NewRingReadEngine(kRingQueueDepth, kRingMaxRegisteredFiles, kRingPollSpinCount);
+  if (engine) { return engine; }
+  LOG(WARNING) << "failed to set up an io_uring of depth " << kRingQueueDepth
+               << ", fall back to the aio engine";
+  return NewAioReadEngine(kAioQueueDepth);
+}
+
+class RingEngine final : public ReadEngine {
+ public:
+  RingEngine() : ReadEngine(NewRingOrAioReadEngine()) {}
 };
 
+#endif  // WITH_LIBURING
+
 constexpr size_t kCacheLineSize = 64;
 
+// std::shared_mutex is reader-preferring on glibc, so back-to-back Get calls from several threads
+// could keep a Put or a compaction waiting forever. New readers queue behind a waiting writer here.
+class SharedMutex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SharedMutex);
+  SharedMutex() {
+    pthread_rwlockattr_t attr;
+    CHECK_EQ(pthread_rwlockattr_init(&attr), 0);
+    CHECK_EQ(pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP), 0);
+    CHECK_EQ(pthread_rwlock_init(&rwlock_, &attr), 0);
+    CHECK_EQ(pthread_rwlockattr_destroy(&attr), 0);
+  }
+  ~SharedMutex() { CHECK_EQ(pthread_rwlock_destroy(&rwlock_), 0); }
+
+  void lock() { CHECK_EQ(pthread_rwlock_wrlock(&rwlock_), 0); }
+  void unlock() { CHECK_EQ(pthread_rwlock_unlock(&rwlock_), 0); }
+  void lock_shared() { CHECK_EQ(pthread_rwlock_rdlock(&rwlock_), 0); }
+  void unlock_shared() { CHECK_EQ(pthread_rwlock_unlock(&rwlock_), 0); }
+
+ private:
+  pthread_rwlock_t rwlock_;
+};
+
 template<typename Engine>
 using IoTask = std::function<void(Engine* engine)>;
 
@@ -303,6 +381,7 @@ class PersistentTableImpl : public PersistentTable {
                     const std::function<void(Iterator* iter)>& Hook) override;
   void SaveSnapshot(const std::string& name) override;
   Iterator* ReadSnapshot(const std::string& name) override;
+  void Compact() override;
 
  private:
   friend class SnapshotIteratorImpl<Key, Engine>;
@@ -314,6 +393,34 @@ class PersistentTableImpl : public PersistentTable {
   void LoadSnapshotImpl(const std::string& name);
   void SaveSnapshotImpl(const std::string& name);
   void ParallelFor(size_t total, const ForRange<Engine>& for_range);
+  void PutImpl(uint32_t num_keys, const void* keys, const void* values,
+               const uint64_t* expected_row_ids);
+  void PutBlocksImpl(uint32_t num_keys, const void* keys, const void* blocks,
+                     const uint64_t* expected_row_ids);
+  void CompactionLoop();
+  void CompactOnce();
+  void CompactChunk(uint64_t chunk_id);
+  void RemoveChunkIfUnused(uint64_t chunk_id);
+  std::unordered_set<uint64_t> ListSnapshotReferencedChunks();
+
+  struct alignas(kCacheLineSize) IndexShard {
+    SharedMutex mutex;
+    robin_hood::unordered_flat_map<Key, uint64_t> row_id_mapping;
+  };
+
+  struct CallBuffers {
+    explicit CallBuffers(size_t alignment) : blocks(alignment) {}
+    std::vector<uint32_t> offsets;
+    AlignedBuffer blocks;
+  };
+
+  uint32_t ShardIndex(Key key) const {
+    return PersistentTableIndexHash()(static_cast<uint64_t>(key)) % kNumIndexShards;
+  }
+  bool FindRowId(Key key, uint64_t* row_id);
+  std::vector<std::unique_lock<SharedMutex>> LockAllShards();
+  std::unique_ptr<CallBuffers> AcquireCallBuffers();
+  void ReleaseCallBuffers(std::unique_ptr<CallBuffers>&& buffers);
 
   std::string root_dir_;
   std::string keys_dir_;
@@ -329,17 +436,30 @@ class PersistentTableImpl : public PersistentTable {
 
   std::vector<std::unique_ptr<Worker<Engine>>> workers_;
 
-  std::vector<uint32_t> offsets_buffer_;
-  AlignedBuffer blocks_buffer_;
+  std::mutex call_buffers_mutex_;
+  std::vector<std::unique_ptr<CallBuffers>> call_buffers_pool_;
 
   std::recursive_mutex mutex_;
   uint64_t physical_table_size_;
-  robin_hood::unordered_flat_map<Key, uint64_t> row_id_mapping_;
+  std::unique_ptr<IndexShard[]> shards_;
+  std::vector<uint32_t> put_shard_offsets_;
+  std::vector<uint32_t> put_key_indices_;
+  SharedMutex value_files_mutex_;
   std::vector<PosixFile> value_files_;
+  std::vector<uint64_t> chunk_live_counts_;
   PosixFile writable_key_file_;
   uint64_t writable_key_file_chunk_id_;
   PosixFileLockGuard lock_;
   bool read_only_;
+
+  double compaction_liveness_threshold_;
+  uint64_t compaction_interval_ms_;
+  std::mutex compaction_mutex_;
+  std::condition_variable compaction_cond_;
+  // Serializes passes of the background loop and Compact().
+  std::mutex compaction_pass_mutex_;
+  bool compaction_shutdown_;
+  std::thread compaction_thread_;
 };
 
 template<typename Key, typename Engine>
@@ -349,12 +469,21 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
       value_size_(options.value_size),
       physical_block_size_(options.physical_block_size),
       logical_block_size_(GetLogicalBlockSize(options.physical_block_size, value_size_)),
-      blocks_buffer_(options.physical_block_size),
+      shards_(new IndexShard[kNumIndexShards]),
       writable_key_file_chunk_id_(-1),
-      read_only_(options.read_only) {
+      read_only_(options.read_only),
+      compaction_liveness_threshold_(options.compaction_liveness_threshold),
+      compaction_interval_ms_(ParseIntegerFromEnv(
+          "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_INTERVAL_MS",
+          options.compaction_interval_ms)),
+      compaction_shutdown_(false) {
   const uint64_t capacity_hint = ParseIntegerFromEnv(
       "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_CAPACITY_HINT", options.capacity_hint);
-  if (capacity_hint > 0) { row_id_mapping_.reserve(capacity_hint); }
+  if (capacity_hint > 0) {
+    for (uint32_t i = 0; i < kNumIndexShards; ++i) {
+      shards_[i].row_id_mapping.reserve(capacity_hint / kNumIndexShards + 1);
+    }
+  }
   PosixFile::RecursiveCreateDirectory(options.path, 0755);
   const std::string lock_filename = PosixFile::JoinPath(options.path, kLockFileName);
   const bool init = !PosixFile::FileExists(lock_filename);
@@ -403,10 +532,24 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
   } else {
     physical_table_size_ = 0;
   }
+  chunk_live_counts_.resize(value_files_.size());
+  const bool enable_compaction = ParseBooleanFromEnv(
+      "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_ENABLE_COMPACTION", options.enable_compaction);
+  if (enable_compaction && !read_only_) {
+    compaction_thread_ = std::thread(&PersistentTableImpl<Key, Engine>::CompactionLoop, this);
+  }
 }
 
 template<typename Key, typename Engine>
 PersistentTableImpl<Key, Engine>::~PersistentTableImpl() {
+  if (compaction_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(compaction_mutex_);
+      compaction_shutdown_ = true;
+    }
+    compaction_cond_.notify_all();
+    compaction_thread_.join();
+  }
   for (uint32_t tid = 0; tid < workers_.size(); ++tid) { workers_.at(tid)->Shutdown(); }
 }
 
@@ -415,18 +558,56 @@ uint32_t PersistentTableImpl<Key, Engine>::LogicalBlockSize() const {
   return logical_block_size_;
 }
 
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::FindRowId(Key key, uint64_t* row_id) {
+  IndexShard& shard = shards_[ShardIndex(key)];
+  std::shared_lock<SharedMutex> lock(shard.mutex);
+  auto it = shard.row_id_mapping.find(key);
+  if (it == shard.row_id_mapping.end()) { return false; }
+  *row_id = it->second;
+  return true;
+}
+
+template<typename Key, typename Engine>
+std::vector<std::unique_lock<SharedMutex>>
+PersistentTableImpl<Key, Engine>::LockAllShards() {
+  std::vector<std::unique_lock<SharedMutex>> locks;
+  locks.reserve(kNumIndexShards);
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) { locks.emplace_back(shards_[i].mutex); }
+  return locks;
+}
+
+template<typename Key, typename Engine>
+std::unique_ptr<typename PersistentTableImpl<Key, Engine>::CallBuffers>
+PersistentTableImpl<Key, Engine>::AcquireCallBuffers() {
+  {
+    std::lock_guard<std::mutex> lock(call_buffers_mutex_);
+    if (!call_buffers_pool_.empty()) {
+      std::unique_ptr<CallBuffers> buffers = std::move(call_buffers_pool_.back());
+      call_buffers_pool_.pop_back();
+      return buffers;
+    }
+  }
+  return std::make_unique<CallBuffers>(physical_block_size_);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReleaseCallBuffers(std::unique_ptr<CallBuffers>&& buffers) {
+  std::lock_guard<std::mutex> lock(call_buffers_mutex_);
+  call_buffers_pool_.push_back(std::move(buffers));
+}
+
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void* keys, void* blocks,
                                                  uint32_t* offsets) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  std::shared_lock<SharedMutex> files_lock(value_files_mutex_);
   ParallelFor(num_keys, [&](Engine* engine, size_t start, size_t end) {
     for (uint64_t i = start; i < end; ++i) {
       const Key key = static_cast<const Key*>(keys)[i];
-      auto it = row_id_mapping_.find(key);
-      if (it == row_id_mapping_.end()) {
+      uint64_t id = 0;
+      if (!FindRowId(key, &id)) {
         offsets[i] = logical_block_size_;
       } else {
-        const uint64_t id = it->second;
         const uint64_t block_id = id / num_values_per_block_;
         const uint32_t id_in_block = id - block_id * num_values_per_block_;
         const uint32_t offset_in_block = id_in_block * value_size_;
@@ -445,35 +626,44 @@ void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void*
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys, void* values,
                                            uint32_t* n_missing, uint32_t* missing_indices) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  offsets_buffer_.resize(num_keys);
+  std::unique_ptr<CallBuffers> buffers = AcquireCallBuffers();
+  std::vector<uint32_t>& offsets = buffers->offsets;
+  offsets.resize(num_keys);
   void* blocks_ptr = nullptr;
   if (value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
-    blocks_buffer_.Resize(num_keys * logical_block_size_);
-    blocks_ptr = blocks_buffer_.ptr();
+    buffers->blocks.Resize(num_keys * logical_block_size_);
+    blocks_ptr = buffers->blocks.ptr();
   }
-  GetBlocks(num_keys, keys, blocks_ptr, offsets_buffer_.data());
+  GetBlocks(num_keys, keys, blocks_ptr, offsets.data());
   uint32_t missing_count = 0;
   for (uint32_t i = 0; i < num_keys; ++i) {
-    if (offsets_buffer_.at(i) == logical_block_size_) {
+    if (offsets.at(i) == logical_block_size_) {
       missing_indices[missing_count] = i;
       missing_count += 1;
     } else {
-      if (value_size_ != logical_block_size_) {
-        MemcpyOffset(values, i * value_size_, blocks_ptr,
-                     (i * logical_block_size_) + offsets_buffer_[i], value_size_);
+      if (blocks_ptr != values) {
+        MemcpyOffset(values, i * value_size_, blocks_ptr, (i * logical_block_size_) + offsets[i],
+                     value_size_);
       }
     }
   }
   *n_missing = missing_count;
+  ReleaseCallBuffers(std::move(buffers));
 }
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void* keys,
                                                  const void* blocks) {
+  PutBlocksImpl(num_keys, keys, blocks, nullptr);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::PutBlocksImpl(uint32_t num_keys, const void* keys,
+                                                     const void* blocks,
+                                                     const uint64_t* expected_row_ids) {
   CHECK(!read_only_);
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   const uint32_t num_blocks = RoundUp(num_keys, num_values_per_block_) / num_values_per_block_;
@@ -482,6 +672,15 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
   physical_table_size_ += num_padded_keys;
   CHECK_EQ(start_index % num_values_per_block_, 0);
   const uint64_t start_block_id = start_index / num_values_per_block_;
+  if (num_blocks > 0) {
+    const uint64_t end_chunk_id = (start_block_id + num_blocks - 1) / num_logical_blocks_per_chunk_;
+    std::unique_lock<SharedMutex> files_lock(value_files_mutex_);
+    while (value_files_.size() <= end_chunk_id) {
+      value_files_.emplace_back(ValueFilePath(value_files_.size()), O_CREAT | O_RDWR | O_DIRECT,
+                                0644);
+    }
+    chunk_live_counts_.resize(value_files_.size());
+  }
   uint64_t written_blocks = 0;
   const uint64_t block_keys_size = num_values_per_block_ * sizeof(Key);
   BlockingCounter bc(1);
@@ -489,11 +688,7 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
     while (written_blocks < num_blocks) {
       const uint64_t batch_start_block_id = start_block_id + written_blocks;
       const uint64_t batch_chunk_id = batch_start_block_id / num_logical_blocks_per_chunk_;
-      if (batch_chunk_id == value_files_.size()) {
-        value_files_.emplace_back(ValueFilePath(batch_chunk_id), O_CREAT | O_RDWR | O_DIRECT, 0644);
-      } else {
-        CHECK_LE(batch_chunk_id, value_files_.size());
-      }
+      CHECK_LT(batch_chunk_id, value_files_.size());
       if ((!writable_key_file_.IsOpen()) || writable_key_file_chunk_id_ != batch_chunk_id) {
         writable_key_file_ = PosixFile(KeyFilePath(batch_chunk_id), O_CREAT | O_RDWR, 0644);
       }
@@ -522,35 +717,75 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
     }
     bc.Decrease();
   });
-  for (uint64_t i = 0; i < num_keys; ++i) {
-    row_id_mapping_[static_cast<const Key*>(keys)[i]] = start_index + i;
+  put_shard_offsets_.assign(kNumIndexShards + 1, 0);
+  put_key_indices_.resize(num_keys);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    put_shard_offsets_[ShardIndex(static_cast<const Key*>(keys)[i]) + 1] += 1;
+  }
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) {
+    put_shard_offsets_[i + 1] += put_shard_offsets_[i];
+  }
+  std::vector<uint32_t> shard_cursors(put_shard_offsets_.begin(), put_shard_offsets_.end() - 1);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    put_key_indices_[shard_cursors[ShardIndex(static_cast<const Key*>(keys)[i])]++] = i;
   }
+  // Keys must not become visible to readers before their values are on disk.
   bc.WaitForeverUntilCntEqualZero();
+  for (uint32_t shard_id = 0; shard_id < kNumIndexShards; ++shard_id) {
+    const uint32_t begin = put_shard_offsets_[shard_id];
+    const uint32_t end = put_shard_offsets_[shard_id + 1];
+    if (begin == end) { continue; }
+    IndexShard& shard = shards_[shard_id];
+    std::unique_lock<SharedMutex> shard_lock(shard.mutex);
+    for (uint32_t j = begin; j < end; ++j) {
+      const uint32_t i = put_key_indices_[j];
+      const uint64_t row_id = start_index + i;
+      auto it = shard.row_id_mapping.find(static_cast<const Key*>(keys)[i]);
+      if (it != shard.row_id_mapping.end()) {
+        // Rows relocated by the compactor must not override a newer value of the same key.
+        if (expected_row_ids != nullptr && it->second != expected_row_ids[i]) { continue; }
+        chunk_live_counts_.at(it->second / num_values_per_chunk_) -= 1;
+        it->second = row_id;
+      } else {
+        if (expected_row_ids != nullptr) { continue; }
+        shard.row_id_mapping.emplace(static_cast<const Key*>(keys)[i], row_id);
+      }
+      chunk_live_counts_.at(row_id / num_values_per_chunk_) += 1;
+    }
+  }
 }
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::Put(uint32_t num_keys, const void* keys,
                                            const void* values) {
+  PutImpl(num_keys, keys, values, nullptr);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::PutImpl(uint32_t num_keys, const void* keys,
+                                               const void* values,
+                                               const uint64_t* expected_row_ids) {
   CHECK(!read_only_);
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  std::unique_ptr<CallBuffers> buffers = AcquireCallBuffers();
   const void* blocks_ptr = nullptr;
   if (value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
     const uint32_t num_blocks = RoundUp(num_keys, num_values_per_block_);
-    blocks_buffer_.Resize(num_blocks * logical_block_size_);
+    buffers->blocks.Resize(num_blocks * logical_block_size_);
     for (uint32_t i = 0; i < num_keys; i += num_values_per_block_) {
       const uint32_t block_id = i / num_values_per_block_;
       const uint32_t copy_size = (num_keys - i) < num_values_per_block_
                                      ? (num_keys - i) * value_size_
                                      : logical_block_size_;
-      MemcpyOffset(blocks_buffer_.ptr(), block_id * logical_block_size_, values, i * value_size_,
+      MemcpyOffset(buffers->blocks.ptr(), block_id * logical_block_size_, values, i * value_size_,
                    copy_size);
     }
-    blocks_ptr = blocks_buffer_.ptr();
+    blocks_ptr = buffers->blocks.ptr();
   }
-  PutBlocks(num_keys, keys, blocks_ptr);
+  PutBlocksImpl(num_keys, keys, blocks_ptr, expected_row_ids);
+  ReleaseCallBuffers(std::move(buffers));
 }
 
 template<typename Key, typename Engine>
@@ -582,9 +817,11 @@ std::string PersistentTableImpl<Key, Engine>::SnapshotListFilePath(const std::st
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
+  auto shard_locks = LockAllShards();
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) { shards_[i].row_id_mapping.clear(); }
+  std::fill(chunk_live_counts_.begin(), chunk_live_counts_.end(), 0);
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -600,9 +837,10 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name)
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
+    chunk_live_counts_.at(chunk_id) = n_entries;
     for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+      const Key key = keys[indices[i] - chunk_start_index];
+      CHECK(shards_[ShardIndex(key)].row_id_mapping.emplace(key, indices[i]).second);
     }
   }
 }
@@ -611,26 +849,28 @@ template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name) {
   CHECK(!read_only_);
   std::lock_guard<std::recursive_mutex> lock(mutex_);
+  auto shard_locks = LockAllShards();
   PosixFile::RecursiveCreateDirectory(SnapshotDirPath(name), 0755);
   std::ofstream list_ofs(SnapshotListFilePath(name));
-  if (row_id_mapping_.empty()) { return; }
   std::vector<PosixMappedFile> index_files(value_files_.size());
   std::vector<uint64_t> counters(value_files_.size());
   const uint64_t max_index_file_size = num_values_per_chunk_ * sizeof(uint64_t);
-  for (const auto& pair : row_id_mapping_) {
-    const uint64_t chunk_id = pair.second / num_values_per_chunk_;
-    CHECK(chunk_id < value_files_.size());
-    if (index_files[chunk_id].ptr() == nullptr) {
-      PosixFile snapshot_file(IndexFilePath(name, chunk_id), O_CREAT | O_RDWR, 0644);
-      snapshot_file.Truncate(max_index_file_size);
-      index_files[chunk_id] =
-          PosixMappedFile(std::move(snapshot_file), max_index_file_size, PROT_READ | PROT_WRITE);
+  for (uint32_t shard_id = 0; shard_id < kNumIndexShards; ++shard_id) {
+    for (const auto& pair : shards_[shard_id].row_id_mapping) {
+      const uint64_t chunk_id = pair.second / num_values_per_chunk_;
+      CHECK(chunk_id < value_files_.size());
+      if (index_files[chunk_id].ptr() == nullptr) {
+        PosixFile snapshot_file(IndexFilePath(name, chunk_id), O_CREAT | O_RDWR, 0644);
+        snapshot_file.Truncate(max_index_file_size);
+        index_files[chunk_id] =
+            PosixMappedFile(std::move(snapshot_file), max_index_file_size, PROT_READ | PROT_WRITE);
+      }
+      uint64_t* indices = static_cast<uint64_t*>(index_files[chunk_id].ptr());
+      uint64_t& count = counters[chunk_id];
+      CHECK_LT(count, num_values_per_chunk_);
+      indices[count] = pair.second;
+      count += 1;
     }
-    uint64_t* indices = static_cast<uint64_t*>(index_files[chunk_id].ptr());
-    uint64_t& count = counters[chunk_id];
-    CHECK_LT(count, num_values_per_chunk_);
-    indices[count] = pair.second;
-    count += 1;
   }
   for (size_t i = 0; i < value_files_.size(); ++i) {
     const uint64_t count = counters[i];
@@ -665,7 +905,11 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
   }
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
+  {
+    auto shard_locks = LockAllShards();
+    for (uint32_t i = 0; i < kNumIndexShards; ++i) { shards_[i].row_id_mapping.clear(); }
+    std::fill(chunk_live_counts_.begin(), chunk_live_counts_.end(), 0);
+  }
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -681,9 +925,14 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
-    for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+    chunk_live_counts_.at(chunk_id) = n_entries;
+    {
+      // The hook may call back into the table, so shard locks are released before running it.
+      auto shard_locks = LockAllShards();
+      for (size_t i = 0; i < n_entries; ++i) {
+        const Key key = keys[indices[i] - chunk_start_index];
+        CHECK(shards_[ShardIndex(key)].row_id_mapping.emplace(key, indices[i]).second);
+      }
     }
     if (Hook) {
       PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
@@ -728,6 +977,147 @@ void PersistentTableImpl<Key, Engine>::ParallelFor(size_t total,
   bc.WaitForeverUntilCntEqualZero();
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactionLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(compaction_mutex_);
+      compaction_cond_.wait_for(lock, std::chrono::milliseconds(compaction_interval_ms_),
+                                [&]() { return compaction_shutdown_; });
+      if (compaction_shutdown_) { break; }
+    }
+    CompactOnce();
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Compact() {
+  CHECK(!read_only_);
+  CompactOnce();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactOnce() {
+  std::lock_guard<std::mutex> pass_lock(compaction_pass_mutex_);
+  std::vector<uint64_t> candidates;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    const std::unordered_set<uint64_t> referenced = ListSnapshotReferencedChunks();
+    // The last chunk is still being appended to and is never compacted.
+    const uint64_t num_sealed_chunks = physical_table_size_ / num_values_per_chunk_;
+    for (uint64_t chunk_id = 0; chunk_id < num_sealed_chunks && chunk_id < value_files_.size();
+         ++chunk_id) {
+      if (!value_files_.at(chunk_id).IsOpen()) { continue; }
+      if (referenced.count(chunk_id) != 0) { continue; }
+      const double liveness =
+          static_cast<double>(chunk_live_counts_.at(chunk_id)) / num_values_per_chunk_;
+      if (liveness < compaction_liveness_threshold_) { candidates.push_back(chunk_id); }
+    }
+  }
+  for (const uint64_t chunk_id : candidates) {
+    CompactChunk(chunk_id);
+    RemoveChunkIfUnused(chunk_id);
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactChunk(uint64_t chunk_id) {
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (chunk_live_counts_.at(chunk_id) == 0) { return; }
+  }
+  PosixFile key_file(KeyFilePath(chunk_id), O_RDONLY, 0644);
+  if (key_file.Size() == 0) { return; }
+  const size_t key_file_size = key_file.Size();
+  PosixMappedFile mapped_key(std::move(key_file), key_file_size, PROT_READ);
+  const Key* chunk_keys = static_cast<const Key*>(mapped_key.ptr());
+  const uint64_t num_blocks =
+      std::min<uint64_t>(key_file_size / (num_values_per_block_ * sizeof(Key)),
+                         num_logical_blocks_per_chunk_);
+  const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
+  AlignedBuffer blocks_buffer(physical_block_size_);
+  blocks_buffer.Resize(kCompactionBatchBlocks * logical_block_size_);
+  std::vector<Key> live_keys;
+  std::vector<uint64_t> live_row_ids;
+  std::vector<char> live_values;
+  for (uint64_t batch_start = 0; batch_start < num_blocks; batch_start += kCompactionBatchBlocks) {
+    const uint64_t batch_blocks = std::min(kCompactionBatchBlocks, num_blocks - batch_start);
+    live_keys.clear();
+    live_row_ids.clear();
+    live_values.clear();
+    {
+      std::shared_lock<SharedMutex> files_lock(value_files_mutex_);
+      PosixFile& value_file = value_files_.at(chunk_id);
+      const size_t bytes = batch_blocks * logical_block_size_;
+      PCHECK(pread(value_file.fd(), blocks_buffer.ptr(), bytes, batch_start * logical_block_size_)
+             == bytes);
+    }
+    for (uint64_t index_in_batch = 0; index_in_batch < batch_blocks * num_values_per_block_;
+         ++index_in_batch) {
+      const uint64_t index_in_chunk = batch_start * num_values_per_block_ + index_in_batch;
+      const uint64_t row_id = chunk_start_index + index_in_chunk;
+      const Key key = chunk_keys[index_in_chunk];
+      uint64_t current_row_id = 0;
+      if (!FindRowId(key, &current_row_id) || current_row_id != row_id) { continue; }
+      const uint64_t block_in_batch = index_in_batch / num_values_per_block_;
+      const uint64_t index_in_block = index_in_batch - block_in_batch * num_values_per_block_;
+      const char* value = static_cast<const char*>(blocks_buffer.ptr())
+                          + block_in_batch * logical_block_size_ + index_in_block * value_size_;
+      live_keys.push_back(key);
+      live_row_ids.push_back(row_id);
+      live_values.insert(live_values.end(), value, value + value_size_);
+    }
+    if (!live_keys.empty()) {
+      PutImpl(live_keys.size(), live_keys.data(), live_values.data(), live_row_ids.data());
+    }
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::RemoveChunkIfUnused(uint64_t chunk_id) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!value_files_.at(chunk_id).IsOpen()) { return; }
+  if (chunk_live_counts_.at(chunk_id) != 0) { return; }
+  if (ListSnapshotReferencedChunks().count(chunk_id) != 0) { return; }
+  {
+    std::unique_lock<SharedMutex> files_lock(value_files_mutex_);
+    PosixFile& value_file = value_files_.at(chunk_id);
+    const int fd = value_file.fd();
+    BlockingCounter bc(workers_.size());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_.at(i)->Schedule([&](Engine* engine) {
+        engine->UnregisterFile(fd);
+        bc.Decrease();
+      });
+    }
+    bc.WaitForeverUntilCntEqualZero();
+    value_file.Close();
+  }
+  PCHECK(unlink(ValueFilePath(chunk_id).c_str()) == 0);
+  PCHECK(unlink(KeyFilePath(chunk_id).c_str()) == 0);
+}
+
+template<typename Key, typename Engine>
+std::unordered_set<uint64_t> PersistentTableImpl<Key, Engine>::ListSnapshotReferencedChunks() {
+  std::unordered_set<uint64_t> referenced;
+  DIR* dir = opendir(snapshots_dir_.c_str());
+  if (dir == nullptr) {
+    PCHECK(errno == ENOENT);
+    return referenced;
+  }
+  struct dirent* ent = nullptr;
+  while ((ent = readdir(dir)) != nullptr) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) { continue; }
+    std::ifstream list_if(SnapshotListFilePath(ent->d_name));
+    std::string index_filename;
+    while (std::getline(list_if, index_filename)) {
+      referenced.insert(GetChunkId(index_filename, kIndexFileNamePrefix));
+    }
+  }
+  PCHECK(closedir(dir) == 0);
+  return referenced;
+}
+
 template<typename Key, typename Engine>
 class SnapshotIteratorImpl : public PersistentTable::Iterator {
  public:
@@ -819,6 +1209,14 @@ std::unique_ptr<PersistentTable> DispatchKeyType(const PersistentTableOptions& o
 }
 
 std::unique_ptr<PersistentTable> DispatchEngine(const PersistentTableOptions& options) {
+  if (options.io_engine == PersistentTableOptions::IoEngine::kUring) {
+#ifdef WITH_LIBURING
+    if (IsUringEngineSupported()) { return DispatchKeyType<RingEngine>(options); }
+    LOG(WARNING) << "io_uring is not supported by the kernel, fall back to the aio engine";
+#else
+    LOG(WARNING) << "OneFlow was built without liburing, fall back to the aio engine";
+#endif  // WITH_LIBURING
+  }
   return DispatchKeyType<AioEngine>(options);
 }
 
@@ -826,6 +1224,21 @@ std::unique_ptr<PersistentTable> DispatchEngine(const PersistentTableOptions& op
 
 #endif  // __linux__
 
+bool IsUringEngineSupported() {
+#if defined(__linux__) && defined(WITH_LIBURING)
+  static const bool supported = []() {
+    // the depth the engine asks for, a deeper ring locks more memory
+    struct io_uring ring {};
+    if (io_uring_queue_init(kRingQueueDepth, &ring, 0) != 0) { return false; }
+    io_uring_queue_exit(&ring);
+    return true;
+  }();
+  return supported;
+#else
+  return false;
+#endif  // defined(__linux__) && defined(WITH_LIBURING)
+}
+
 std::unique_ptr<PersistentTable> NewPersistentTable(const PersistentTableOptions& options) {
 #ifdef __linux__
   CHECK(!options.path.empty());
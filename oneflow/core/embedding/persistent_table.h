@@ -23,6 +23,10 @@ namespace oneflow {
 namespace embedding {
 
 struct PersistentTableOptions {
+  enum class IoEngine {
+    kAio,
+    kUring,
+  };
   std::string path;
   uint32_t key_size = 0;
   uint32_t value_size = 0;
@@ -30,6 +34,12 @@ struct PersistentTableOptions {
   uint16_t physical_block_size = 4096;
   uint64_t capacity_hint = 0;
   bool read_only = false;
+  IoEngine io_engine = IoEngine::kAio;
+  // Rewrites value chunks whose fraction of live rows drops below compaction_liveness_threshold
+  // and removes chunks that are neither live nor referenced by any snapshot.
+  bool enable_compaction = false;
+  double compaction_liveness_threshold = 0.5;
+  uint64_t compaction_interval_ms = 60 * 1000;
 };
 
 class PersistentTable {
@@ -62,10 +72,16 @@ class PersistentTable {
                             const std::function<void(Iterator* iter)>& Hook) = 0;
   virtual void SaveSnapshot(const std::string& name) = 0;
   virtual Iterator* ReadSnapshot(const std::string& name) = 0;
+  // Runs one compaction pass on the calling thread, whether or not enable_compaction is set.
+  virtual void Compact() = 0;
 };
 
 std::unique_ptr<PersistentTable> NewPersistentTable(const PersistentTableOptions& options);
 
+// Whether IoEngine::kUring is usable, i.e. OneFlow is built with liburing and the running kernel
+// supports io_uring. Tables asking for kUring fall back to kAio otherwise.
+bool IsUringEngineSupported();
+
 }  // namespace embedding
 
 }  // namespace oneflow
@@ -227,7 +227,7 @@ void KeyValueStoreImpl<Key>::SaveSnapshot(const std::string& name) {
 
 }  // namespace
 
-std::unique_ptr<KeyValueStore> NewPersistentTableKeyValueStore(
+std::unique_ptr<KeyValueStore> NewCudaPersistentTableKeyValueStore(
     const PersistentTableKeyValueStoreOptions& options) {
   if (options.table_options.key_size == sizeof(uint64_t)) {
     return std::unique_ptr<KeyValueStore>(new KeyValueStoreImpl<uint64_t>(options));
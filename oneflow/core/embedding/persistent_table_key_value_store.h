@@ -18,20 +18,26 @@ limitations under the License.
 
 #include "oneflow/core/embedding/key_value_store.h"
 #include "oneflow/core/embedding/persistent_table.h"
+#include "oneflow/core/common/device_type.h"
 
 namespace oneflow {
 
 namespace embedding {
 
-#ifdef WITH_CUDA
-
 struct PersistentTableKeyValueStoreOptions {
   PersistentTableOptions table_options{};
+  // kCPU selects the host implementation, whose keys, values and outputs all live in host memory.
+  DeviceType device_type = DeviceType::kCUDA;
 };
 
 std::unique_ptr<KeyValueStore> NewPersistentTableKeyValueStore(
     const PersistentTableKeyValueStoreOptions& options);
 
+#ifdef WITH_CUDA
+
+std::unique_ptr<KeyValueStore> NewCudaPersistentTableKeyValueStore(
+    const PersistentTableKeyValueStoreOptions& options);
+
 #endif  // WITH_CUDA
 
 }  // namespace embedding
@@ -17,6 +17,8 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/broadcast_matmul.h"
 #include "oneflow/core/ep/common/primitive/broadcast_matmul.h"
 #include "oneflow/core/common/blas.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/primitive/packed_gemm.h"
 
 namespace oneflow {
 
@@ -30,6 +32,11 @@ namespace internal {
 namespace {
 
 constexpr size_t kMaxNumDims = 8;
+// GEMMs of at most this many multiply-adds don't keep several cores busy on their own, batches of
+// them are always run in parallel.
+constexpr int64_t kSmallMatmulMaxMacs = 128 * 128 * 128;
+// Parallel chunks get at least this many multiply-adds.
+constexpr int64_t kMatmulChunkMinMacs = 64 * 64 * 64;
 
 CBLAS_TRANSPOSE GetCblasTranspose(BlasTransposeType transpose_type) {
   if (transpose_type == BlasTransposeType::N) {
@@ -62,11 +69,68 @@ void CblasMatmul(CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int m, int n,
     UNIMPLEMENTED();
   }
   const int ldc = n;
-  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+  // BLAS rejects leading dimensions below 1, which an empty m, n or k would give.
+  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, m, n, k, alpha, a, std::max(lda, 1), b,
+                std::max(ldb, 1), beta, c, std::max(ldc, 1));
+}
+
+// Like ForEachMatmul, but runs the batches in parallel on the threads of the stream if every batch
+// writes its own C. Batches reducing into a shared C keep the serial order of ForEachMatmul.
+// Larger GEMMs are only spread over batches if `func` parallelizes on the stream too, so that
+// nested loops run inline; BLAS has thread pools of its own and would be oversubscribed.
+template<typename Func>
+void ParallelForEachMatmul(CpuStream* stream, bool func_uses_stream_threads, DataType data_type,
+                           int64_t m, int64_t n, int64_t k, Scalar beta, int64_t num_batch_dims,
+                           const int64_t* broadcast_batch_dims, const int64_t* a_batch_dims,
+                           const int64_t* b_batch_dims, const int64_t* c_batch_dims, const void* a,
+                           const void* b, void* c, const Func& func) {
+  int64_t batch_count = 1;
+  bool reduce_c = false;
+  for (int64_t i = 0; i < num_batch_dims; ++i) {
+    batch_count *= broadcast_batch_dims[i];
+    if (c_batch_dims[i] != broadcast_batch_dims[i]) { reduce_c = true; }
+  }
+  const int64_t macs = m * n * k;
+  const bool parallel_batches =
+      macs <= kSmallMatmulMaxMacs
+      || (func_uses_stream_threads && batch_count >= stream->device()->GetNumThreads());
+  if (reduce_c || batch_count <= 1 || !parallel_batches) {
+    ForEachMatmul<kMaxNumDims>(data_type, m, n, k, beta, num_batch_dims, broadcast_batch_dims,
+                               a_batch_dims, b_batch_dims, c_batch_dims, a, b, c, func);
+    return;
+  }
+  const size_t size_of_data_type = GetSizeOfDataType(data_type);
+  const size_t stride_a = m * k * size_of_data_type;
+  const size_t stride_b = k * n * size_of_data_type;
+  const size_t stride_c = m * n * size_of_data_type;
+  NdIndexOffsetHelper<int64_t, kMaxNumDims> broadcast_index_helper(broadcast_batch_dims,
+                                                                   num_batch_dims);
+  NdIndexOffsetHelper<int64_t, kMaxNumDims> a_index_helper(a_batch_dims, num_batch_dims);
+  NdIndexOffsetHelper<int64_t, kMaxNumDims> b_index_helper(b_batch_dims, num_batch_dims);
+  stream->ParallelFor(
+      0, batch_count,
+      [&](int64_t begin, int64_t end) {
+        int64_t batch_index[kMaxNumDims]{};
+        int64_t a_batch_index[kMaxNumDims]{};
+        int64_t b_batch_index[kMaxNumDims]{};
+        for (int64_t batch_id = begin; batch_id < end; ++batch_id) {
+          broadcast_index_helper.OffsetToNdIndex(batch_id, batch_index);
+          for (int64_t i = 0; i < num_batch_dims; ++i) {
+            a_batch_index[i] = a_batch_dims[i] == 1 ? 0 : batch_index[i];
+            b_batch_index[i] = b_batch_dims[i] == 1 ? 0 : batch_index[i];
+          }
+          const int64_t a_batch_id = a_index_helper.NdIndexToOffset(a_batch_index);
+          const int64_t b_batch_id = b_index_helper.NdIndexToOffset(b_batch_index);
+          func(static_cast<const unsigned char*>(a) + a_batch_id * stride_a,
+               static_cast<const unsigned char*>(b) + b_batch_id * stride_b,
+               static_cast<unsigned char*>(c) + batch_id * stride_c, beta);
+        }
+      },
+      std::max<int64_t>(kMatmulChunkMinMacs / std::max<int64_t>(macs, 1), 1));
 }
 
 template<typename T>
-void LaunchCblasBroadcastMatmul(Stream* /*stream*/, DataType data_type,
+void LaunchCblasBroadcastMatmul(Stream* stream, DataType data_type,
                                 BlasTransposeType transpose_a, BlasTransposeType transpose_b,
                                 int64_t num_batch_dims, const int64_t* broadcast_batch_dims,
                                 const int64_t* a_batch_dims, const int64_t* b_batch_dims,
@@ -81,8 +145,30 @@ void LaunchCblasBroadcastMatmul(Stream* /*stream*/, DataType data_type,
                    static_cast<const T*>(batch_a), static_cast<const T*>(batch_b), beta_value,
                    static_cast<T*>(batch_c));
   };
-  ForEachMatmul<kMaxNumDims>(data_type, m, n, k, beta, num_batch_dims, broadcast_batch_dims,
-                             a_batch_dims, b_batch_dims, c_batch_dims, a, b, c, func);
+  ParallelForEachMatmul(stream->As<CpuStream>(), /*func_uses_stream_threads=*/false, data_type, m,
+                        n, k, beta, num_batch_dims, broadcast_batch_dims, a_batch_dims,
+                        b_batch_dims, c_batch_dims, a, b, c, func);
+}
+
+template<typename T>
+void LaunchPackedBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType transpose_a,
+                                 BlasTransposeType transpose_b, int64_t num_batch_dims,
+                                 const int64_t* broadcast_batch_dims, const int64_t* a_batch_dims,
+                                 const int64_t* b_batch_dims, const int64_t* c_batch_dims,
+                                 int64_t m, int64_t n, int64_t k, Scalar alpha, const void* a,
+                                 const void* b, Scalar beta, void* c) {
+  CpuStream* cpu_stream = stream->As<CpuStream>();
+  const bool trans_a = GetCblasTranspose(transpose_a) == CblasTrans;
+  const bool trans_b = GetCblasTranspose(transpose_b) == CblasTrans;
+  const float alpha_value = alpha.Value<float>();
+  auto func = [&](const void* batch_a, const void* batch_b, void* batch_c, Scalar batch_beta) {
+    packed_gemm::Gemm<T>(cpu_stream, trans_a, trans_b, m, n, k, alpha_value,
+                         static_cast<const T*>(batch_a), static_cast<const T*>(batch_b),
+                         batch_beta.Value<float>(), static_cast<T*>(batch_c));
+  };
+  ParallelForEachMatmul(cpu_stream, /*func_uses_stream_threads=*/true, data_type, m, n, k, beta,
+                        num_batch_dims, broadcast_batch_dims, a_batch_dims, b_batch_dims,
+                        c_batch_dims, a, b, c, func);
 }
 
 void LaunchBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType transpose_a,
@@ -99,6 +185,15 @@ void LaunchBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType
     LaunchCblasBroadcastMatmul<double>(stream, data_type, transpose_a, transpose_b, num_batch_dims,
                                        broadcast_batch_dims, a_batch_dims, b_batch_dims,
                                        c_batch_dims, m, n, k, alpha, a, b, beta, c);
+  } else if (data_type == DataType::kFloat16) {
+    LaunchPackedBroadcastMatmul<float16>(stream, data_type, transpose_a, transpose_b,
+                                         num_batch_dims, broadcast_batch_dims, a_batch_dims,
+                                         b_batch_dims, c_batch_dims, m, n, k, alpha, a, b, beta, c);
+  } else if (data_type == DataType::kBFloat16) {
+    LaunchPackedBroadcastMatmul<bfloat16>(stream, data_type, transpose_a, transpose_b,
+                                          num_batch_dims, broadcast_batch_dims, a_batch_dims,
+                                          b_batch_dims, c_batch_dims, m, n, k, alpha, a, b, beta,
+                                          c);
   } else {
     UNIMPLEMENTED();
   }
@@ -114,7 +209,8 @@ class BroadcastMatmulFactoryImpl : public BroadcastMatmulFactory {
                                        BlasTransposeType transpose_b,
                                        size_t max_num_dims) override {
     if (max_num_dims > kMaxNumDims) { return nullptr; }
-    if (data_type == DataType::kFloat || data_type == DataType::kDouble) {
+    if (data_type == DataType::kFloat || data_type == DataType::kDouble
+        || data_type == DataType::kFloat16 || data_type == DataType::kBFloat16) {
       return std::make_unique<BroadcastMatmulImpl<kMaxNumDims>>(data_type, transpose_a,
                                                                 transpose_b);
     } else {
@@ -15,6 +15,8 @@ limitations under the License.
 */
 #include "oneflow/core/ep/include/primitive/cast.h"
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
 
 namespace oneflow {
 
@@ -46,17 +48,46 @@ struct CpuCastFunctor<From, bfloat16,
   }
 };
 
+// Vectorized kernel of the float <-> float16/bfloat16 casts for simd::GetIsa(), or nullptr.
+template<typename From, typename To>
+simd::CastKernel GetSimdCastKernel() {
+  if (std::is_same<From, float>::value && std::is_same<To, float16>::value) {
+    return simd::GetFloatToFloat16Kernel();
+  } else if (std::is_same<From, float16>::value && std::is_same<To, float>::value) {
+    return simd::GetFloat16ToFloatKernel();
+  } else if (std::is_same<From, float>::value && std::is_same<To, bfloat16>::value) {
+    return simd::GetFloatToBfloat16Kernel();
+  } else if (std::is_same<From, bfloat16>::value && std::is_same<To, float>::value) {
+    return simd::GetBfloat16ToFloatKernel();
+  } else {
+    return nullptr;
+  }
+}
+
 template<typename From, typename To>
 class CastImpl : public Cast {
  public:
   OF_DISALLOW_COPY_AND_MOVE(CastImpl);
-  CastImpl() = default;
+  CastImpl() : simd_kernel_(GetSimdCastKernel<From, To>()) {}
   ~CastImpl() override = default;
 
   void Launch(Stream* stream, const void* from, void* to, size_t count) override {
+    if (simd_kernel_ != nullptr) {
+      const From* src = reinterpret_cast<const From*>(from);
+      To* dst = reinterpret_cast<To*>(to);
+      const simd::CastKernel kernel = simd_kernel_;
+      CpuStream* cpu_stream = stream->As<CpuStream>();
+      cpu_stream->ParallelFor(0, count, [kernel, src, dst](int64_t begin, int64_t end) {
+        kernel(src + begin, dst + begin, end - begin);
+      });
+      return;
+    }
     CpuCastFunctor<From, To>::Call(reinterpret_cast<const From*>(from), reinterpret_cast<To*>(to),
                                    count);
   }
+
+ private:
+  simd::CastKernel simd_kernel_;
 };
 
 template<typename From, typename To>
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/ep/cpu/primitive/unary_functor.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
 
 namespace oneflow {
 
@@ -30,12 +31,27 @@ template<UnaryOp unary_op, typename Src, typename Dst>
 class ElementwiseUnaryImpl : public ElementwiseUnary {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ElementwiseUnaryImpl);
-  ElementwiseUnaryImpl(Scalar attr0, Scalar attr1) : attr0(attr0), attr1(attr1) {}
+  ElementwiseUnaryImpl(Scalar attr0, Scalar attr1)
+      : attr0(attr0), attr1(attr1), simd_kernel(nullptr) {
+    if (std::is_same<Src, float>::value && std::is_same<Dst, float>::value) {
+      simd_kernel = simd::GetFloatUnaryKernel(unary_op);
+    }
+  }
   ~ElementwiseUnaryImpl() override = default;
 
   void Launch(Stream* stream, const void* src_ptr, void* dst_ptr, size_t count) override {
     CpuStream* cpu_stream = stream->As<CpuStream>();
 
+    if (simd_kernel != nullptr) {
+      const float* src = reinterpret_cast<const float*>(src_ptr);
+      float* dst = reinterpret_cast<float*>(dst_ptr);
+      const simd::FloatUnaryKernel kernel = simd_kernel;
+      cpu_stream->ParallelFor(0, count, [kernel, src, dst](int64_t begin, int64_t end) {
+        kernel(src + begin, dst + begin, end - begin);
+      });
+      return;
+    }
+
     Dst* dst = reinterpret_cast<Dst*>(dst_ptr);
     const Src* src = reinterpret_cast<const Src*>(src_ptr);
     auto functor = UnaryFunctor<DeviceType::kCPU, unary_op, Dst, Src>(attr0, attr1);
@@ -46,6 +62,8 @@ class ElementwiseUnaryImpl : public ElementwiseUnary {
 
  protected:
   Scalar attr0, attr1;
+  // Vectorized kernel for simd::GetIsa(), set for the float ops simd::GetFloatUnaryKernel covers.
+  simd::FloatUnaryKernel simd_kernel;
 };
 
 template<UnaryOp unary_op, typename Src, typename Dst>
@@ -0,0 +1,175 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_PRIMITIVE_PACKED_GEMM_H_
+#define ONEFLOW_CORE_EP_CPU_PRIMITIVE_PACKED_GEMM_H_
+
+#include <algorithm>
+#include <vector>
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+namespace packed_gemm {
+
+// Row-major GEMM for element types without a BLAS routine (float16, bfloat16). Panels of op(A)
+// and op(B) are converted to float while they are packed, products are accumulated in float and
+// C is rounded to T once at the end, so the precision doesn't depend on k.
+//
+// C is split into kMc x kNc blocks computed in parallel. Every block walks k in steps of kKc,
+// packing an A panel into kMr-row slivers and a B panel into kNr-column slivers, so that the
+// micro kernel reads both contiguously while it keeps a kMr x kNr tile of C in registers.
+constexpr int64_t kMr = 4;
+constexpr int64_t kNr = 16;
+constexpr int64_t kMc = 64;
+constexpr int64_t kKc = 256;
+constexpr int64_t kNc = 256;
+static_assert(kMc % kMr == 0 && kNc % kNr == 0, "");
+
+template<typename T>
+void PackA(const T* a, int64_t lda, bool trans_a, int64_t i0, int64_t mc, int64_t p0, int64_t kc,
+           float* packed) {
+  for (int64_t ir = 0; ir < mc; ir += kMr) {
+    const int64_t mr = std::min(kMr, mc - ir);
+    for (int64_t p = 0; p < kc; ++p) {
+      for (int64_t r = 0; r < kMr; ++r) {
+        float value = 0;
+        if (r < mr) {
+          const int64_t i = i0 + ir + r;
+          value = static_cast<float>(trans_a ? a[(p0 + p) * lda + i] : a[i * lda + p0 + p]);
+        }
+        *packed++ = value;
+      }
+    }
+  }
+}
+
+template<typename T>
+void PackB(const T* b, int64_t ldb, bool trans_b, int64_t p0, int64_t kc, int64_t j0, int64_t nc,
+           float* packed) {
+  for (int64_t jr = 0; jr < nc; jr += kNr) {
+    const int64_t nr = std::min(kNr, nc - jr);
+    for (int64_t p = 0; p < kc; ++p) {
+      for (int64_t c = 0; c < kNr; ++c) {
+        float value = 0;
+        if (c < nr) {
+          const int64_t j = j0 + jr + c;
+          value = static_cast<float>(trans_b ? b[j * ldb + p0 + p] : b[(p0 + p) * ldb + j]);
+        }
+        *packed++ = value;
+      }
+    }
+  }
+}
+
+// acc[0:kMr, 0:kNr] (leading dimension ldacc) += a_sliver * b_sliver
+//
+// One array per row keeps the tile in vector registers: with a two-dimensional tile GCC at -O3
+// tries to vectorize over p instead and falls back to scalar code.
+inline void MicroKernel(int64_t kc, const float* a, const float* b, float* acc, int64_t ldacc) {
+  static_assert(kMr == 4, "");
+  float c0[kNr];
+  float c1[kNr];
+  float c2[kNr];
+  float c3[kNr];
+  for (int64_t c = 0; c < kNr; ++c) {
+    c0[c] = acc[c];
+    c1[c] = acc[ldacc + c];
+    c2[c] = acc[2 * ldacc + c];
+    c3[c] = acc[3 * ldacc + c];
+  }
+  for (int64_t p = 0; p < kc; ++p) {
+    const float* a_col = a + p * kMr;
+    const float* b_row = b + p * kNr;
+    for (int64_t c = 0; c < kNr; ++c) {
+      c0[c] += a_col[0] * b_row[c];
+      c1[c] += a_col[1] * b_row[c];
+      c2[c] += a_col[2] * b_row[c];
+      c3[c] += a_col[3] * b_row[c];
+    }
+  }
+  for (int64_t c = 0; c < kNr; ++c) {
+    acc[c] = c0[c];
+    acc[ldacc + c] = c1[c];
+    acc[2 * ldacc + c] = c2[c];
+    acc[3 * ldacc + c] = c3[c];
+  }
+}
+
+template<typename T>
+void GemmBlock(bool trans_a, bool trans_b, int64_t k, float alpha, const T* a, int64_t lda,
+               const T* b, int64_t ldb, float beta, T* c, int64_t ldc, int64_t i0, int64_t mc,
+               int64_t j0, int64_t nc) {
+  thread_local std::vector<float> packed_a(kMc * kKc);
+  thread_local std::vector<float> packed_b(kKc * kNc);
+  thread_local std::vector<float> acc(kMc * kNc);
+  std::fill(acc.begin(), acc.end(), 0.0f);
+  for (int64_t p0 = 0; p0 < k; p0 += kKc) {
+    const int64_t kc = std::min(kKc, k - p0);
+    PackA(a, lda, trans_a, i0, mc, p0, kc, packed_a.data());
+    PackB(b, ldb, trans_b, p0, kc, j0, nc, packed_b.data());
+    for (int64_t jr = 0; jr < nc; jr += kNr) {
+      for (int64_t ir = 0; ir < mc; ir += kMr) {
+        MicroKernel(kc, packed_a.data() + ir * kc, packed_b.data() + jr * kc,
+                    acc.data() + ir * kNc + jr, kNc);
+      }
+    }
+  }
+  for (int64_t i = 0; i < mc; ++i) {
+    T* c_row = c + (i0 + i) * ldc + j0;
+    const float* acc_row = acc.data() + i * kNc;
+    if (beta == 0) {
+      // C may be uninitialized, it must not be read.
+      for (int64_t j = 0; j < nc; ++j) { c_row[j] = static_cast<T>(alpha * acc_row[j]); }
+    } else {
+      for (int64_t j = 0; j < nc; ++j) {
+        c_row[j] = static_cast<T>(alpha * acc_row[j] + beta * static_cast<float>(c_row[j]));
+      }
+    }
+  }
+}
+
+// C(m x n) = alpha * op(A) * op(B) + beta * C, all matrices row-major and densely packed.
+template<typename T>
+void Gemm(CpuStream* stream, bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+          float alpha, const T* a, const T* b, float beta, T* c) {
+  const int64_t lda = trans_a ? m : k;
+  const int64_t ldb = trans_b ? k : n;
+  const int64_t num_m_blocks = (m + kMc - 1) / kMc;
+  const int64_t num_n_blocks = (n + kNc - 1) / kNc;
+  stream->ParallelFor(
+      0, num_m_blocks * num_n_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t block = begin; block < end; ++block) {
+          const int64_t i0 = (block / num_n_blocks) * kMc;
+          const int64_t j0 = (block % num_n_blocks) * kNc;
+          GemmBlock<T>(trans_a, trans_b, k, alpha, a, lda, b, ldb, beta, c, n, i0,
+                       std::min(kMc, m - i0), j0, std::min(kNc, n - j0));
+        }
+      },
+      1);
+}
+
+}  // namespace packed_gemm
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_PRIMITIVE_PACKED_GEMM_H_
@@ -0,0 +1,383 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ep/include/primitive/quantized_matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define OF_CPU_QUANTIZED_MATMUL_WITH_VNNI
+#endif
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+namespace {
+
+// A is packed as unsigned bytes a + 128, so that the micro kernel can be built on u8 x s8 dot
+// products (vpdpbusd), and the offset is removed again with the column sums of op(B):
+// sum_p (a + 128) * b = sum_p a * b + 128 * sum_p b.
+//
+// The blocking follows packed_gemm.h, but k is consumed in quads: for every quad, a packed A
+// sliver holds the 4 bytes of each of its kMr rows next to each other and a packed B sliver
+// holds the 4 bytes of each of its kNr columns next to each other. A quad of one row of A is a
+// 32-bit broadcast and a quad of the B sliver is a kNr x 4 byte vector.
+constexpr int64_t kMr = 4;
+constexpr int64_t kNr = 32;
+constexpr int64_t kMc = 128;
+constexpr int64_t kKc = 512;
+constexpr int64_t kNc = 256;
+constexpr int64_t kQuad = 4;
+constexpr int32_t kAOffset = 128;
+static_assert(kMc % kMr == 0 && kNc % kNr == 0 && kKc % kQuad == 0, "");
+
+int64_t NumQuads(int64_t kc) { return (kc + kQuad - 1) / kQuad; }
+
+void PackA(const int8_t* a, int64_t lda, bool trans_a, int64_t i0, int64_t mc, int64_t p0,
+           int64_t kc, uint8_t* packed) {
+  const int64_t num_quads = NumQuads(kc);
+  for (int64_t ir = 0; ir < mc; ir += kMr) {
+    const int64_t mr = std::min(kMr, mc - ir);
+    for (int64_t q = 0; q < num_quads; ++q) {
+      const int64_t p = p0 + q * kQuad;
+      const int64_t num_p = std::min(kQuad, kc - q * kQuad);
+      for (int64_t r = 0; r < kMr; ++r) {
+        const int64_t i = i0 + ir + r;
+        for (int64_t e = 0; e < kQuad; ++e) {
+          int32_t value = 0;
+          if (r < mr && e < num_p) { value = trans_a ? a[(p + e) * lda + i] : a[i * lda + p + e]; }
+          packed[e] = static_cast<uint8_t>(value + kAOffset);
+        }
+        packed += kQuad;
+      }
+    }
+  }
+}
+
+void PackB(const int8_t* b, int64_t ldb, bool trans_b, int64_t p0, int64_t kc, int64_t j0,
+           int64_t nc, int8_t* packed) {
+  const int64_t num_quads = NumQuads(kc);
+  for (int64_t jr = 0; jr < nc; jr += kNr) {
+    const int64_t nr = std::min(kNr, nc - jr);
+    for (int64_t q = 0; q < num_quads; ++q) {
+      const int64_t p = p0 + q * kQuad;
+      const int64_t num_p = std::min(kQuad, kc - q * kQuad);
+      for (int64_t col = 0; col < kNr; ++col) {
+        const int64_t j = j0 + jr + col;
+        if (col < nr && num_p == kQuad) {
+          if (trans_b) {
+            std::memcpy(packed, b + j * ldb + p, kQuad);
+          } else {
+            for (int64_t e = 0; e < kQuad; ++e) { packed[e] = b[(p + e) * ldb + j]; }
+          }
+        } else {
+          for (int64_t e = 0; e < kQuad; ++e) {
+            packed[e] = (col < nr && e < num_p) ? b[trans_b ? j * ldb + p + e : (p + e) * ldb + j]
+                                                : 0;
+          }
+        }
+        packed += kQuad;
+      }
+    }
+  }
+}
+
+// col_sum[j] = sum_p op(B)[p][j] for j in [j_begin, j_end)
+void ColumnSum(const int8_t* b, int64_t ldb, bool trans_b, int64_t k, int64_t j_begin,
+               int64_t j_end, int32_t* col_sum) {
+  if (trans_b) {
+    for (int64_t j = j_begin; j < j_end; ++j) {
+      int32_t sum = 0;
+      for (int64_t p = 0; p < k; ++p) { sum += b[j * ldb + p]; }
+      col_sum[j] = sum;
+    }
+  } else {
+    std::fill(col_sum + j_begin, col_sum + j_end, 0);
+    for (int64_t p = 0; p < k; ++p) {
+      for (int64_t j = j_begin; j < j_end; ++j) { col_sum[j] += b[p * ldb + j]; }
+    }
+  }
+}
+
+// acc[0:kMr, 0:kNr] (leading dimension ldacc) += a_sliver * b_sliver
+using MicroKernelFunc = void (*)(int64_t num_quads, const uint8_t* a, const int8_t* b,
+                                 int32_t* acc, int64_t ldacc);
+
+void MicroKernel(int64_t num_quads, const uint8_t* a, const int8_t* b, int32_t* acc,
+                 int64_t ldacc) {
+  static_assert(kMr == 4, "");
+  int32_t c0[kNr];
+  int32_t c1[kNr];
+  int32_t c2[kNr];
+  int32_t c3[kNr];
+  for (int64_t col = 0; col < kNr; ++col) {
+    c0[col] = acc[col];
+    c1[col] = acc[ldacc + col];
+    c2[col] = acc[2 * ldacc + col];
+    c3[col] = acc[3 * ldacc + col];
+  }
+  for (int64_t q = 0; q < num_quads; ++q) {
+    const uint8_t* a_quad = a + q * kMr * kQuad;
+    const int8_t* b_quad = b + q * kNr * kQuad;
+    for (int64_t col = 0; col < kNr; ++col) {
+      const int32_t b0 = b_quad[col * kQuad];
+      const int32_t b1 = b_quad[col * kQuad + 1];
+      const int32_t b2 = b_quad[col * kQuad + 2];
+      const int32_t b3 = b_quad[col * kQuad + 3];
+      c0[col] += a_quad[0] * b0 + a_quad[1] * b1 + a_quad[2] * b2 + a_quad[3] * b3;
+      c1[col] += a_quad[4] * b0 + a_quad[5] * b1 + a_quad[6] * b2 + a_quad[7] * b3;
+      c2[col] += a_quad[8] * b0 + a_quad[9] * b1 + a_quad[10] * b2 + a_quad[11] * b3;
+      c3[col] += a_quad[12] * b0 + a_quad[13] * b1 + a_quad[14] * b2 + a_quad[15] * b3;
+    }
+  }
+  for (int64_t col = 0; col < kNr; ++col) {
+    acc[col] = c0[col];
+    acc[ldacc + col] = c1[col];
+    acc[2 * ldacc + col] = c2[col];
+    acc[3 * ldacc + col] = c3[col];
+  }
+}
+
+#ifdef OF_CPU_QUANTIZED_MATMUL_WITH_VNNI
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) void MicroKernelVnni(
+    int64_t num_quads, const uint8_t* a, const int8_t* b, int32_t* acc, int64_t ldacc) {
+  static_assert(kMr == 4 && kNr == 32, "");
+  __m512i c00 = _mm512_loadu_si512(acc);
+  __m512i c01 = _mm512_loadu_si512(acc + 16);
+  __m512i c10 = _mm512_loadu_si512(acc + ldacc);
+  __m512i c11 = _mm512_loadu_si512(acc + ldacc + 16);
+  __m512i c20 = _mm512_loadu_si512(acc + 2 * ldacc);
+  __m512i c21 = _mm512_loadu_si512(acc + 2 * ldacc + 16);
+  __m512i c30 = _mm512_loadu_si512(acc + 3 * ldacc);
+  __m512i c31 = _mm512_loadu_si512(acc + 3 * ldacc + 16);
+  for (int64_t q = 0; q < num_quads; ++q) {
+    const uint8_t* a_quad = a + q * kMr * kQuad;
+    const int8_t* b_quad = b + q * kNr * kQuad;
+    const __m512i b0 = _mm512_loadu_si512(b_quad);
+    const __m512i b1 = _mm512_loadu_si512(b_quad + 16 * kQuad);
+    int32_t a_rows[kMr];
+    std::memcpy(a_rows, a_quad, sizeof(a_rows));
+    const __m512i a0 = _mm512_set1_epi32(a_rows[0]);
+    c00 = _mm512_dpbusd_epi32(c00, a0, b0);
+    c01 = _mm512_dpbusd_epi32(c01, a0, b1);
+    const __m512i a1 = _mm512_set1_epi32(a_rows[1]);
+    c10 = _mm512_dpbusd_epi32(c10, a1, b0);
+    c11 = _mm512_dpbusd_epi32(c11, a1, b1);
+    const __m512i a2 = _mm512_set1_epi32(a_rows[2]);
+    c20 = _mm512_dpbusd_epi32(c20, a2, b0);
+    c21 = _mm512_dpbusd_epi32(c21, a2, b1);
+    const __m512i a3 = _mm512_set1_epi32(a_rows[3]);
+    c30 = _mm512_dpbusd_epi32(c30, a3, b0);
+    c31 = _mm512_dpbusd_epi32(c31, a3, b1);
+  }
+  _mm512_storeu_si512(acc, c00);
+  _mm512_storeu_si512(acc + 16, c01);
+  _mm512_storeu_si512(acc + ldacc, c10);
+  _mm512_storeu_si512(acc + ldacc + 16, c11);
+  _mm512_storeu_si512(acc + 2 * ldacc, c20);
+  _mm512_storeu_si512(acc + 2 * ldacc + 16, c21);
+  _mm512_storeu_si512(acc + 3 * ldacc, c30);
+  _mm512_storeu_si512(acc + 3 * ldacc + 16, c31);
+}
+
+#endif  // OF_CPU_QUANTIZED_MATMUL_WITH_VNNI
+
+MicroKernelFunc GetMicroKernel() {
+#ifdef OF_CPU_QUANTIZED_MATMUL_WITH_VNNI
+  static const bool has_vnni =
+      __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+  if (has_vnni) { return MicroKernelVnni; }
+#endif  // OF_CPU_QUANTIZED_MATMUL_WITH_VNNI
+  return MicroKernel;
+}
+
+template<typename T>
+struct Epilogue;
+
+template<>
+struct Epilogue<int32_t> {
+  static int32_t Apply(int32_t acc, float scale, float bias) { return acc; }
+};
+
+template<>
+struct Epilogue<float> {
+  static float Apply(int32_t acc, float scale, float bias) {
+    return static_cast<float>(acc) * scale + bias;
+  }
+};
+
+template<>
+struct Epilogue<int8_t> {
+  static int8_t Apply(int32_t acc, float scale, float bias) {
+    const float value = std::nearbyint(static_cast<float>(acc) * scale + bias);
+    return static_cast<int8_t>(std::min(std::max(value, -128.0f), 127.0f));
+  }
+};
+
+struct GemmArgs {
+  bool trans_a;
+  bool trans_b;
+  bool channel_on_m;
+  int64_t k;
+  const int8_t* a;
+  int64_t lda;
+  const int8_t* b;
+  int64_t ldb;
+  const float* scale;
+  const float* bias;
+  const int32_t* col_sum;
+  int64_t ldc;
+};
+
+template<typename T>
+void GemmBlock(MicroKernelFunc micro_kernel, const GemmArgs& args, T* c, int64_t i0, int64_t mc,
+               int64_t j0, int64_t nc) {
+  thread_local std::vector<uint8_t> packed_a(kMc * kKc);
+  thread_local std::vector<int8_t> packed_b(kKc * kNc);
+  thread_local std::vector<int32_t> acc(kMc * kNc);
+  std::fill(acc.begin(), acc.end(), 0);
+  for (int64_t p0 = 0; p0 < args.k; p0 += kKc) {
+    const int64_t kc = std::min(kKc, args.k - p0);
+    const int64_t num_quads = NumQuads(kc);
+    PackA(args.a, args.lda, args.trans_a, i0, mc, p0, kc, packed_a.data());
+    PackB(args.b, args.ldb, args.trans_b, p0, kc, j0, nc, packed_b.data());
+    for (int64_t jr = 0; jr < nc; jr += kNr) {
+      for (int64_t ir = 0; ir < mc; ir += kMr) {
+        micro_kernel(num_quads, packed_a.data() + ir * num_quads * kQuad,
+                     packed_b.data() + jr * num_quads * kQuad, acc.data() + ir * kNc + jr, kNc);
+      }
+    }
+  }
+  const int32_t* col_sum = args.col_sum + j0;
+  for (int64_t i = 0; i < mc; ++i) {
+    T* c_row = c + (i0 + i) * args.ldc + j0;
+    const int32_t* acc_row = acc.data() + i * kNc;
+    if (args.channel_on_m) {
+      const float scale = args.scale != nullptr ? args.scale[i0 + i] : 1.0f;
+      const float bias = args.bias != nullptr ? args.bias[i0 + i] : 0.0f;
+      for (int64_t j = 0; j < nc; ++j) {
+        c_row[j] = Epilogue<T>::Apply(acc_row[j] - kAOffset * col_sum[j], scale, bias);
+      }
+    } else {
+      for (int64_t j = 0; j < nc; ++j) {
+        const float scale = args.scale != nullptr ? args.scale[j0 + j] : 1.0f;
+        const float bias = args.bias != nullptr ? args.bias[j0 + j] : 0.0f;
+        c_row[j] = Epilogue<T>::Apply(acc_row[j] - kAOffset * col_sum[j], scale, bias);
+      }
+    }
+  }
+}
+
+template<typename T>
+class QuantizedMatmulImpl : public QuantizedMatmul {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(QuantizedMatmulImpl);
+  QuantizedMatmulImpl(BlasTransposeType transpose_a, BlasTransposeType transpose_b,
+                      QuantizedMatmulChannelAxis channel_axis)
+      : transpose_a_(transpose_a),
+        transpose_b_(transpose_b),
+        channel_axis_(channel_axis),
+        micro_kernel_(GetMicroKernel()) {}
+  ~QuantizedMatmulImpl() override = default;
+
+  void Launch(Stream* stream, size_t m, size_t n, size_t k, const void* a, const void* b,
+              const float* scale, const float* bias, void* c) override {
+    if (std::is_same<T, int32_t>::value) {
+      CHECK(scale == nullptr && bias == nullptr) << "int32 output takes neither scale nor bias";
+    }
+    GemmArgs args{};
+    args.trans_a = transpose_a_ == BlasTransposeType::T;
+    args.trans_b = transpose_b_ == BlasTransposeType::T;
+    args.channel_on_m = channel_axis_ == QuantizedMatmulChannelAxis::kM;
+    args.k = k;
+    args.a = static_cast<const int8_t*>(a);
+    args.lda = args.trans_a ? m : k;
+    args.b = static_cast<const int8_t*>(b);
+    args.ldb = args.trans_b ? k : n;
+    args.scale = scale;
+    args.bias = bias;
+    args.ldc = n;
+    T* c_ptr = static_cast<T*>(c);
+    auto* cpu_stream = stream->As<CpuStream>();
+    // Thread-local names resolve to the instance of the executing thread, so the workers get
+    // the buffer by pointer.
+    thread_local std::vector<int32_t> col_sum_buffer;
+    col_sum_buffer.resize(n);
+    int32_t* col_sum = col_sum_buffer.data();
+    cpu_stream->ParallelFor(
+        0, n,
+        [&](int64_t begin, int64_t end) {
+          ColumnSum(args.b, args.ldb, args.trans_b, k, begin, end, col_sum);
+        },
+        kNc);
+    args.col_sum = col_sum;
+    const int64_t num_m_blocks = (static_cast<int64_t>(m) + kMc - 1) / kMc;
+    const int64_t num_n_blocks = (static_cast<int64_t>(n) + kNc - 1) / kNc;
+    cpu_stream->ParallelFor(
+        0, num_m_blocks * num_n_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t block = begin; block < end; ++block) {
+            const int64_t i0 = (block / num_n_blocks) * kMc;
+            const int64_t j0 = (block % num_n_blocks) * kNc;
+            GemmBlock<T>(micro_kernel_, args, c_ptr, i0, std::min<int64_t>(kMc, m - i0), j0,
+                         std::min<int64_t>(kNc, n - j0));
+          }
+        },
+        1);
+  }
+
+ private:
+  BlasTransposeType transpose_a_;
+  BlasTransposeType transpose_b_;
+  QuantizedMatmulChannelAxis channel_axis_;
+  MicroKernelFunc micro_kernel_;
+};
+
+class QuantizedMatmulFactoryImpl : public QuantizedMatmulFactory {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(QuantizedMatmulFactoryImpl);
+  QuantizedMatmulFactoryImpl() = default;
+  ~QuantizedMatmulFactoryImpl() override = default;
+
+  std::unique_ptr<QuantizedMatmul> New(DataType c_type, BlasTransposeType transpose_a,
+                                       BlasTransposeType transpose_b,
+                                       QuantizedMatmulChannelAxis channel_axis) override {
+    if (c_type == DataType::kInt32) {
+      return std::make_unique<QuantizedMatmulImpl<int32_t>>(transpose_a, transpose_b,
+                                                            channel_axis);
+    } else if (c_type == DataType::kFloat) {
+      return std::make_unique<QuantizedMatmulImpl<float>>(transpose_a, transpose_b, channel_axis);
+    } else if (c_type == DataType::kInt8) {
+      return std::make_unique<QuantizedMatmulImpl<int8_t>>(transpose_a, transpose_b,
+                                                           channel_axis);
+    } else {
+      return nullptr;
+    }
+  }
+};
+
+REGISTER_PRIMITIVE_FACTORY(DeviceType::kCPU, QuantizedMatmulFactory, QuantizedMatmulFactoryImpl);
+
+}  // namespace
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
@@ -0,0 +1,128 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
+#include "oneflow/core/common/util.h"
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#endif
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+namespace {
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+bool HasF16c() {
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) { return false; }
+  return (ecx & bit_F16C) != 0;
+}
+
+#endif
+
+const Kernels* KernelsOf(Isa isa) {
+  switch (isa) {
+    case Isa::kSse4: return sse4::GetKernels();
+    case Isa::kAvx2: return avx2::GetKernels();
+    case Isa::kAvx512: return avx512::GetKernels();
+    case Isa::kNeon: return neon::GetKernels();
+    default: return nullptr;
+  }
+}
+
+Isa DetectIsa() {
+  const std::string max_isa = GetStringFromEnv("ONEFLOW_EP_CPU_SIMD_ISA", "auto");
+  // From the widest to the narrowest.
+  const std::vector<std::pair<std::string, Isa>> candidates{
+      {"avx512", Isa::kAvx512}, {"avx2", Isa::kAvx2}, {"sse4", Isa::kSse4}, {"neon", Isa::kNeon}};
+  bool allowed = max_isa == "auto";
+  for (const auto& pair : candidates) {
+    allowed = allowed || pair.first == max_isa;
+    if (allowed && HostSupports(pair.second) && KernelsOf(pair.second) != nullptr) {
+      return pair.second;
+    }
+  }
+  if (!allowed && max_isa != "scalar") {
+    LOG(WARNING) << "Unknown ONEFLOW_EP_CPU_SIMD_ISA " << max_isa << ", using scalar kernels";
+  }
+  return Isa::kScalar;
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = []() {
+    const Kernels* isa_kernels = KernelsOf(GetIsa());
+    return isa_kernels == nullptr ? Kernels{} : *isa_kernels;
+  }();
+  return kernels;
+}
+
+}  // namespace
+
+bool HostSupports(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar: return true;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    case Isa::kSse4: return __builtin_cpu_supports("sse4.1");
+    case Isa::kAvx2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && HasF16c();
+    case Isa::kAvx512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma") && HasF16c();
+#endif
+#if defined(__aarch64__)
+    case Isa::kNeon: return true;
+#endif
+    default: return false;
+  }
+}
+
+Isa GetIsa() {
+  static const Isa isa = DetectIsa();
+  return isa;
+}
+
+FloatUnaryKernel GetFloatUnaryKernel(primitive::UnaryOp unary_op) {
+  const Kernels& kernels = GetKernels();
+  switch (unary_op) {
+    case primitive::UnaryOp::kExp: return kernels.exp;
+    case primitive::UnaryOp::kLog: return kernels.log;
+    case primitive::UnaryOp::kTanh: return kernels.tanh;
+    case primitive::UnaryOp::kSigmoid: return kernels.sigmoid;
+    case primitive::UnaryOp::kGelu: return kernels.gelu;
+    case primitive::UnaryOp::kFastGelu: return kernels.fast_gelu;
+    default: return nullptr;
+  }
+}
+
+CastKernel GetFloatToFloat16Kernel() { return GetKernels().float_to_float16; }
+
+CastKernel GetFloat16ToFloatKernel() { return GetKernels().float16_to_float; }
+
+CastKernel GetFloatToBfloat16Kernel() { return GetKernels().float_to_bfloat16; }
+
+CastKernel GetBfloat16ToFloatKernel() { return GetKernels().bfloat16_to_float; }
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_SIMD_SIMD_KERNELS_H_
+#define ONEFLOW_CORE_EP_CPU_SIMD_SIMD_KERNELS_H_
+
+#include <cstddef>
+#include "oneflow/core/ep/include/primitive/unary_op.h"
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+enum class Isa {
+  kScalar = 0,
+  kSse4,
+  kAvx2,
+  kAvx512,
+  kNeon,
+};
+
+using FloatUnaryKernel = void (*)(const float* src, float* dst, size_t count);
+// float16 and bfloat16 are passed as their 16-bit patterns.
+using CastKernel = void (*)(const void* src, void* dst, size_t count);
+
+struct Kernels {
+  FloatUnaryKernel exp;
+  FloatUnaryKernel log;
+  FloatUnaryKernel tanh;
+  FloatUnaryKernel sigmoid;
+  FloatUnaryKernel gelu;
+  FloatUnaryKernel fast_gelu;
+  CastKernel float_to_float16;
+  CastKernel float16_to_float;
+  CastKernel float_to_bfloat16;
+  CastKernel bfloat16_to_float;
+};
+
+// The widest instruction set that both this build and the host support, detected once. It can be
+// capped with ONEFLOW_EP_CPU_SIMD_ISA=scalar|sse4|avx2|avx512|neon, e.g. to get the same results
+// on different machines.
+Isa GetIsa();
+
+// Whether the host can run the instructions of isa.
+bool HostSupports(Isa isa);
+
+// Vectorized float kernel of unary_op for GetIsa(), or nullptr if there is none.
+FloatUnaryKernel GetFloatUnaryKernel(primitive::UnaryOp unary_op);
+
+// Vectorized kernels of the float <-> float16/bfloat16 casts for GetIsa(), or nullptr.
+CastKernel GetFloatToFloat16Kernel();
+CastKernel GetFloat16ToFloatKernel();
+CastKernel GetFloatToBfloat16Kernel();
+CastKernel GetBfloat16ToFloatKernel();
+
+// Each of these translation units is compiled for its own instruction set and returns nullptr when
+// the build does not target it. They must only be called after checking the host supports it.
+namespace sse4 {
+const Kernels* GetKernels();
+}  // namespace sse4
+
+namespace avx2 {
+const Kernels* GetKernels();
+}  // namespace avx2
+
+namespace avx512 {
+const Kernels* GetKernels();
+}  // namespace avx512
+
+namespace neon {
+const Kernels* GetKernels();
+}  // namespace neon
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_SIMD_SIMD_KERNELS_H_
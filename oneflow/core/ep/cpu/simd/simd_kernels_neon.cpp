@@ -0,0 +1,107 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
+
+// NEON and its float16 conversions are part of the aarch64 baseline, no extra flags are needed.
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#include "oneflow/core/ep/cpu/simd/simd_math.h"
+#define OF_SIMD_WITH_NEON
+#endif  // defined(__aarch64__) && defined(__ARM_NEON)
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+namespace neon {
+
+#ifdef OF_SIMD_WITH_NEON
+
+namespace {
+
+struct Vec {
+  using Reg = float32x4_t;
+  using Mask = uint32x4_t;
+  static constexpr size_t kWidth = 4;
+  static constexpr bool kHasFloat16 = true;
+
+  static Reg Load(const float* p) { return vld1q_f32(p); }
+  static void Store(float* p, Reg a) { vst1q_f32(p, a); }
+  static Reg Set1(float a) { return vdupq_n_f32(a); }
+  static Reg Add(Reg a, Reg b) { return vaddq_f32(a, b); }
+  static Reg Sub(Reg a, Reg b) { return vsubq_f32(a, b); }
+  static Reg Mul(Reg a, Reg b) { return vmulq_f32(a, b); }
+  static Reg Div(Reg a, Reg b) { return vdivq_f32(a, b); }
+  static Reg MulAdd(Reg a, Reg b, Reg c) { return vfmaq_f32(c, a, b); }
+  static Reg Abs(Reg a) { return vabsq_f32(a); }
+  // vmaxq_f32 and vminq_f32 return NaN when either operand is NaN.
+  static Reg Max(Reg a, Reg b) { return vmaxq_f32(a, b); }
+  static Reg Min(Reg a, Reg b) { return vminq_f32(a, b); }
+  static Mask Lt(Reg a, Reg b) { return vcltq_f32(a, b); }
+  static Mask Eq(Reg a, Reg b) { return vceqq_f32(a, b); }
+  static Mask IsNan(Reg a) { return vmvnq_u32(vceqq_f32(a, a)); }
+  static Reg Select(Mask m, Reg a, Reg b) { return vbslq_f32(m, a, b); }
+  static Reg Round(Reg a) { return vrndnq_f32(a); }
+  static Reg Pow2(Reg n) {
+    return vreinterpretq_f32_s32(
+        vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23));
+  }
+  static Reg Exponent(Reg a) {
+    const int32x4_t biased = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_f32(a), 23));
+    return vcvtq_f32_s32(vsubq_s32(biased, vdupq_n_s32(126)));
+  }
+  static Reg Mantissa(Reg a) {
+    const uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(a), vdupq_n_u32(0x807FFFFF));
+    return vreinterpretq_f32_u32(vorrq_u32(bits, vdupq_n_u32(0x3F000000)));
+  }
+  static void StoreFloat16(uint16_t* p, Reg a) {
+    vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(a)));
+  }
+  static Reg LoadFloat16(const uint16_t* p) {
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)));
+  }
+  // Round to nearest even as the bfloat16 constructor, NaN maps to 0x7FC0.
+  static void StoreBfloat16(uint16_t* p, Reg a) {
+    const uint32x4_t bits = vreinterpretq_u32_f32(a);
+    const uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), vdupq_n_u32(1));
+    uint32x4_t rounded = vaddq_u32(vaddq_u32(bits, lsb), vdupq_n_u32(0x7FFF));
+    rounded = vbslq_u32(IsNan(a), vdupq_n_u32(0x7FC00000), rounded);
+    vst1_u16(p, vshrn_n_u32(rounded, 16));
+  }
+  static Reg LoadBfloat16(const uint16_t* p) {
+    return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p), 16));
+  }
+};
+
+}  // namespace
+
+const Kernels* GetKernels() { return MakeKernels<Vec>(); }
+
+#else
+
+const Kernels* GetKernels() { return nullptr; }
+
+#endif  // OF_SIMD_WITH_NEON
+
+}  // namespace neon
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
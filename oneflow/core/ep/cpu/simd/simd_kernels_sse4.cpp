@@ -0,0 +1,102 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
+
+// Compiled with -msse4.1, see cmake/oneflow.cmake.
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#include "oneflow/core/ep/cpu/simd/simd_math.h"
+#define OF_SIMD_WITH_SSE4
+#endif  // defined(__SSE4_1__)
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+namespace sse4 {
+
+#ifdef OF_SIMD_WITH_SSE4
+
+namespace {
+
+struct Vec {
+  using Reg = __m128;
+  using Mask = __m128;
+  static constexpr size_t kWidth = 4;
+  static constexpr bool kHasFloat16 = false;
+
+  static Reg Load(const float* p) { return _mm_loadu_ps(p); }
+  static void Store(float* p, Reg a) { _mm_storeu_ps(p, a); }
+  static Reg Set1(float a) { return _mm_set1_ps(a); }
+  static Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+  static Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+  static Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+  static Reg Div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+  static Reg MulAdd(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static Reg Abs(Reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+  static Reg Max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+  static Reg Min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+  static Mask Lt(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+  static Mask Eq(Reg a, Reg b) { return _mm_cmpeq_ps(a, b); }
+  static Mask IsNan(Reg a) { return _mm_cmpunord_ps(a, a); }
+  static Reg Select(Mask m, Reg a, Reg b) { return _mm_blendv_ps(b, a, m); }
+  static Reg Round(Reg a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static Reg Pow2(Reg n) {
+    return _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+  }
+  static Reg Exponent(Reg a) {
+    return _mm_cvtepi32_ps(
+        _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a), 23), _mm_set1_epi32(126)));
+  }
+  static Reg Mantissa(Reg a) {
+    const __m128i bits = _mm_and_si128(_mm_castps_si128(a), _mm_set1_epi32(0x807FFFFF));
+    return _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3F000000)));
+  }
+  // Round to nearest even as the bfloat16 constructor, NaN maps to 0x7FC0.
+  static void StoreBfloat16(uint16_t* p, Reg a) {
+    const __m128i bits = _mm_castps_si128(a);
+    const __m128i lsb = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1));
+    __m128i rounded =
+        _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, lsb), _mm_set1_epi32(0x7FFF)), 16);
+    rounded = _mm_blendv_epi8(rounded, _mm_set1_epi32(0x7FC0), _mm_castps_si128(IsNan(a)));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi32(rounded, rounded));
+  }
+  static Reg LoadBfloat16(const uint16_t* p) {
+    const __m128i bits = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    return _mm_castsi128_ps(_mm_slli_epi32(bits, 16));
+  }
+};
+
+}  // namespace
+
+const Kernels* GetKernels() { return MakeKernels<Vec>(); }
+
+#else
+
+const Kernels* GetKernels() { return nullptr; }
+
+#endif  // OF_SIMD_WITH_SSE4
+
+}  // namespace sse4
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
@@ -0,0 +1,157 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "oneflow/core/common/bfloat16.h"
+#include "oneflow/core/common/data_type.h"
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+namespace test {
+
+namespace {
+
+// Odd sizes so that every kernel also runs its tail.
+constexpr size_t kNumInputs = 10007;
+
+std::vector<float> RandomInputs(float low, float high) {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(low, high);
+  std::vector<float> inputs(kNumInputs);
+  for (auto& x : inputs) { x = dist(rng); }
+  return inputs;
+}
+
+// Every instruction set this build has kernels for and the host can run.
+std::vector<std::pair<std::string, const Kernels*>> GetSupportedKernels() {
+  const std::vector<std::tuple<std::string, Isa, const Kernels*>> candidates{
+      {"sse4", Isa::kSse4, sse4::GetKernels()},
+      {"avx2", Isa::kAvx2, avx2::GetKernels()},
+      {"avx512", Isa::kAvx512, avx512::GetKernels()},
+      {"neon", Isa::kNeon, neon::GetKernels()}};
+  std::vector<std::pair<std::string, const Kernels*>> kernels;
+  for (const auto& candidate : candidates) {
+    if (std::get<2>(candidate) != nullptr && HostSupports(std::get<1>(candidate))) {
+      kernels.emplace_back(std::get<0>(candidate), std::get<2>(candidate));
+    }
+  }
+  return kernels;
+}
+
+void TestUnary(FloatUnaryKernel kernel, const std::vector<float>& inputs,
+               double (*reference)(double), double rtol, double atol) {
+  std::vector<float> outputs(inputs.size());
+  kernel(inputs.data(), outputs.data(), inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    // Rounded to float, so that results beyond the float range are expected as inf.
+    const double expected = static_cast<float>(reference(inputs[i]));
+    if (std::isnan(expected)) {
+      ASSERT_TRUE(std::isnan(outputs[i])) << inputs[i];
+    } else if (std::isinf(expected)) {
+      ASSERT_EQ(outputs[i], expected) << inputs[i];
+    } else {
+      ASSERT_LE(std::abs(outputs[i] - expected), atol + rtol * std::abs(expected)) << inputs[i];
+    }
+  }
+}
+
+double Sigmoid(double x) { return 1 / (1 + std::exp(-x)); }
+
+double Gelu(double x) { return 0.5 * x * std::erfc(-x / std::sqrt(2.0)); }
+
+double FastGelu(double x) {
+  return 0.5 * x * (1 + std::tanh(0.7978845608028654 * (x + 0.044715 * x * x * x)));
+}
+
+}  // namespace
+
+TEST(SimdKernels, Unary) {
+  std::vector<float> inputs = RandomInputs(-20, 20);
+  for (float x : {0.0f, -0.0f, 1e-30f, -1e-30f, 1e-40f, 88.0f, 88.5f, 88.7f, 88.8f, -87.0f,
+                  -88.0f, -100.0f, -103.0f, -104.5f, -200.0f, INFINITY, -INFINITY, NAN}) {
+    inputs.push_back(x);
+  }
+  std::vector<float> log_inputs = RandomInputs(0, 1000);
+  for (float x : {0.0f, 1e-40f, 1e-30f, 1.0f, -1.0f, INFINITY, NAN}) { log_inputs.push_back(x); }
+  const double denorm_min = std::numeric_limits<float>::denorm_min();
+  for (const auto& pair : GetSupportedKernels()) {
+    SCOPED_TRACE(pair.first);
+    const Kernels* kernels = pair.second;
+    // Exp rounds into the denormal range like expf, sigmoid of x below -88 may be flushed to zero.
+    TestUnary(kernels->exp, inputs, std::exp, 1e-6, denorm_min);
+    TestUnary(kernels->tanh, inputs, std::tanh, 1e-6, 0);
+    TestUnary(kernels->sigmoid, inputs, Sigmoid, 1e-6, 1e-38);
+    TestUnary(kernels->gelu, inputs, Gelu, 1e-6, 1e-6);
+    TestUnary(kernels->fast_gelu, inputs, FastGelu, 1e-6, 1e-6);
+    TestUnary(kernels->log, log_inputs, std::log, 1e-6, 0);
+  }
+}
+
+TEST(SimdKernels, Cast) {
+  std::vector<float> inputs = RandomInputs(-70000, 70000);
+  for (float x : {0.0f, -0.0f, 1e-8f, 65520.0f, INFINITY, -INFINITY, NAN}) { inputs.push_back(x); }
+  std::vector<uint16_t> bits(inputs.size());
+  std::vector<float> outputs(inputs.size());
+  for (const auto& pair : GetSupportedKernels()) {
+    SCOPED_TRACE(pair.first);
+    const Kernels* kernels = pair.second;
+    if (kernels->float_to_bfloat16 != nullptr) {
+      kernels->float_to_bfloat16(inputs.data(), bits.data(), inputs.size());
+      kernels->bfloat16_to_float(bits.data(), outputs.data(), inputs.size());
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        const bfloat16 expected(inputs[i]);
+        ASSERT_EQ(bits[i], expected.x) << inputs[i];
+        const float expected_float = expected;
+        ASSERT_EQ(std::memcmp(&outputs[i], &expected_float, sizeof(float)), 0) << inputs[i];
+      }
+    }
+    if (kernels->float_to_float16 != nullptr) {
+      kernels->float_to_float16(inputs.data(), bits.data(), inputs.size());
+      kernels->float16_to_float(bits.data(), outputs.data(), inputs.size());
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        const float16 expected = static_cast<float16>(inputs[i]);
+        uint16_t expected_bits = 0;
+        std::memcpy(&expected_bits, &expected, sizeof(expected_bits));
+        if (std::isnan(inputs[i])) {
+          ASSERT_TRUE(std::isnan(outputs[i]));
+          continue;
+        }
+        ASSERT_EQ(bits[i], expected_bits) << inputs[i];
+        ASSERT_EQ(outputs[i], static_cast<float>(expected)) << inputs[i];
+      }
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
@@ -0,0 +1,269 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_SIMD_SIMD_MATH_H_
+#define ONEFLOW_CORE_EP_CPU_SIMD_SIMD_MATH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "oneflow/core/ep/cpu/simd/simd_kernels.h"
+
+// Vectorized float math shared by the per instruction set translation units, written against a
+// vector type V which provides
+//
+//   Reg, Mask, kWidth, kHasFloat16
+//   Load, Store, Set1, Add, Sub, Mul, Div, MulAdd (a * b + c), Abs, Max, Min, Lt, Eq, IsNan,
+//   Select (mask ? a : b), Round (to nearest even), Pow2 (2^n of an integral n), Mantissa
+//   (in [0.5, 1)), Exponent (so that x = Mantissa(x) * 2^Exponent(x) for normal x),
+//   LoadFloat16, StoreFloat16, LoadBfloat16, StoreBfloat16
+//
+// Max(a, b) and Min(a, b) return b when either operand is NaN, so clamping as Min(hi, Max(lo, x))
+// keeps NaN inputs.
+//
+// Only instantiate these with a V declared in an anonymous namespace. The instantiations then have
+// internal linkage, so the linker never picks code compiled for one instruction set to serve
+// another translation unit. For the same reason, do not call into the standard library here.
+
+namespace oneflow {
+
+namespace ep {
+
+namespace simd {
+
+// Cephes expf: exp(x) = 2^n * exp(r) with r = x - n * ln2 in [-ln2 / 2, ln2 / 2].
+//
+// n runs from -150 to 128 over the clamped range, past what a single Pow2 can represent, so 2^n is
+// applied as two halves that are always normal floats. The last multiply then overflows to inf
+// above ln(FLT_MAX) and rounds to denormals and zero below ln(FLT_MIN), as expf does.
+template<typename V>
+typename V::Reg Exp(typename V::Reg x) {
+  x = V::Min(V::Set1(89.0f), V::Max(V::Set1(-104.0f), x));
+  const typename V::Reg n = V::Round(V::Mul(x, V::Set1(1.44269504088896341f)));
+  const typename V::Reg n_half = V::Round(V::Mul(n, V::Set1(0.5f)));
+  // ln2 split in two so that r is exact.
+  x = V::Sub(x, V::Mul(n, V::Set1(0.693359375f)));
+  x = V::Sub(x, V::Mul(n, V::Set1(-2.12194440e-4f)));
+  typename V::Reg y = V::Set1(1.9875691500e-4f);
+  y = V::MulAdd(y, x, V::Set1(1.3981999507e-3f));
+  y = V::MulAdd(y, x, V::Set1(8.3334519073e-3f));
+  y = V::MulAdd(y, x, V::Set1(4.1665795894e-2f));
+  y = V::MulAdd(y, x, V::Set1(1.6666665459e-1f));
+  y = V::MulAdd(y, x, V::Set1(5.0000001201e-1f));
+  y = V::MulAdd(y, V::Mul(x, x), V::Add(x, V::Set1(1.0f)));
+  return V::Mul(V::Mul(y, V::Pow2(n_half)), V::Pow2(V::Sub(n, n_half)));
+}
+
+// Cephes logf: log(x) = e * ln2 + log(m) with m in [sqrt(0.5), sqrt(2)).
+template<typename V>
+typename V::Reg Log(typename V::Reg x) {
+  using Reg = typename V::Reg;
+  const Reg zero = V::Set1(0.0f);
+  // Scale denormals up so that Mantissa and Exponent see a normal number.
+  const typename V::Mask denormal = V::Lt(x, V::Set1(1.17549435e-38f));
+  const Reg scaled = V::Select(denormal, V::Mul(x, V::Set1(8388608.0f)), x);
+  Reg e = V::Sub(V::Exponent(scaled), V::Select(denormal, V::Set1(23.0f), zero));
+  Reg m = V::Mantissa(scaled);
+  const typename V::Mask small = V::Lt(m, V::Set1(0.707106781186547524f));
+  e = V::Sub(e, V::Select(small, V::Set1(1.0f), zero));
+  m = V::Sub(V::Add(m, V::Select(small, m, zero)), V::Set1(1.0f));
+  const Reg z = V::Mul(m, m);
+  Reg y = V::Set1(7.0376836292e-2f);
+  y = V::MulAdd(y, m, V::Set1(-1.1514610310e-1f));
+  y = V::MulAdd(y, m, V::Set1(1.1676998740e-1f));
+  y = V::MulAdd(y, m, V::Set1(-1.2420140846e-1f));
+  y = V::MulAdd(y, m, V::Set1(1.4249322787e-1f));
+  y = V::MulAdd(y, m, V::Set1(-1.6668057665e-1f));
+  y = V::MulAdd(y, m, V::Set1(2.0000714765e-1f));
+  y = V::MulAdd(y, m, V::Set1(-2.4999993993e-1f));
+  y = V::MulAdd(y, m, V::Set1(3.3333331174e-1f));
+  y = V::Mul(V::Mul(y, m), z);
+  y = V::MulAdd(e, V::Set1(-2.12194440e-4f), y);
+  y = V::MulAdd(z, V::Set1(-0.5f), y);
+  Reg result = V::Add(m, y);
+  result = V::MulAdd(e, V::Set1(0.693359375f), result);
+  const Reg inf = V::Set1(__builtin_inff());
+  result = V::Select(V::Eq(x, inf), inf, result);
+  result = V::Select(V::Eq(x, zero), V::Set1(-__builtin_inff()), result);
+  return V::Select(V::Lt(x, zero), V::Set1(__builtin_nanf("")), V::Select(V::IsNan(x), x, result));
+}
+
+// tanh(x) = x * P(x^2) / Q(x^2), the rational approximation used by Eigen, on |x| <= 9 where it
+// rounds to +-1 in float.
+template<typename V>
+typename V::Reg Tanh(typename V::Reg x) {
+  using Reg = typename V::Reg;
+  const typename V::Mask tiny = V::Lt(V::Abs(x), V::Set1(0.0004f));
+  const Reg clamped = V::Min(V::Set1(9.0f), V::Max(V::Set1(-9.0f), x));
+  const Reg x2 = V::Mul(clamped, clamped);
+  Reg p = V::Set1(-2.76076847742355e-16f);
+  p = V::MulAdd(p, x2, V::Set1(2.00018790482477e-13f));
+  p = V::MulAdd(p, x2, V::Set1(-8.60467152213735e-11f));
+  p = V::MulAdd(p, x2, V::Set1(5.12229709037114e-08f));
+  p = V::MulAdd(p, x2, V::Set1(1.48572235717979e-05f));
+  p = V::MulAdd(p, x2, V::Set1(6.37261928875436e-04f));
+  p = V::MulAdd(p, x2, V::Set1(4.89352455891786e-03f));
+  p = V::Mul(p, clamped);
+  Reg q = V::Set1(1.19825839466702e-06f);
+  q = V::MulAdd(q, x2, V::Set1(1.18534705686654e-04f));
+  q = V::MulAdd(q, x2, V::Set1(2.26843463243900e-03f));
+  q = V::MulAdd(q, x2, V::Set1(4.89352518554385e-03f));
+  return V::Select(tiny, x, V::Div(p, q));
+}
+
+template<typename V>
+typename V::Reg Sigmoid(typename V::Reg x) {
+  const typename V::Reg one = V::Set1(1.0f);
+  return V::Div(one, V::Add(one, Exp<V>(V::Sub(V::Set1(0.0f), x))));
+}
+
+// 0.5 * x * (1 + erf(x / sqrt(2))), with erfc(|z|) = t * P(t) * exp(-z^2), t = 1 / (1 + p|z|)
+// from Abramowitz and Stegun 7.1.26. Negative x use erfc directly to avoid cancellation.
+template<typename V>
+typename V::Reg Gelu(typename V::Reg x) {
+  using Reg = typename V::Reg;
+  const Reg one = V::Set1(1.0f);
+  const Reg z = V::Mul(V::Abs(x), V::Set1(0.707106781186547524f));
+  const Reg t = V::Div(one, V::MulAdd(z, V::Set1(0.3275911f), one));
+  Reg p = V::Set1(1.061405429f);
+  p = V::MulAdd(p, t, V::Set1(-1.453152027f));
+  p = V::MulAdd(p, t, V::Set1(1.421413741f));
+  p = V::MulAdd(p, t, V::Set1(-0.284496736f));
+  p = V::MulAdd(p, t, V::Set1(0.254829592f));
+  const Reg erfc = V::Mul(V::Mul(p, t), Exp<V>(V::Sub(V::Set1(0.0f), V::Mul(z, z))));
+  const Reg one_plus_erf =
+      V::Select(V::Lt(x, V::Set1(0.0f)), erfc, V::Sub(V::Set1(2.0f), erfc));
+  return V::Mul(V::Mul(V::Set1(0.5f), x), one_plus_erf);
+}
+
+// 0.5 * x * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3))), as the scalar kFastGelu functor.
+template<typename V>
+typename V::Reg FastGelu(typename V::Reg x) {
+  using Reg = typename V::Reg;
+  const Reg inner = V::Mul(V::Set1(0.7978845608028654f),
+                           V::MulAdd(V::Mul(V::Set1(0.044715f), V::Mul(x, x)), x, x));
+  return V::Mul(V::Mul(V::Set1(0.5f), x), V::Add(V::Set1(1.0f), Tanh<V>(inner)));
+}
+
+// Applies f to whole vectors, and to the tail through a zero padded vector so that every element
+// gets the same result.
+template<typename V, typename F>
+void ApplyUnary(const float* src, float* dst, size_t count, F f) {
+  size_t i = 0;
+  for (; i + V::kWidth <= count; i += V::kWidth) { V::Store(dst + i, f(V::Load(src + i))); }
+  if (i < count) {
+    float buf[V::kWidth] = {0};
+    for (size_t j = 0; i + j < count; ++j) { buf[j] = src[i + j]; }
+    V::Store(buf, f(V::Load(buf)));
+    for (size_t j = 0; i + j < count; ++j) { dst[i + j] = buf[j]; }
+  }
+}
+
+template<typename V>
+void ExpKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return Exp<V>(x); });
+}
+
+template<typename V>
+void LogKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return Log<V>(x); });
+}
+
+template<typename V>
+void TanhKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return Tanh<V>(x); });
+}
+
+template<typename V>
+void SigmoidKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return Sigmoid<V>(x); });
+}
+
+template<typename V>
+void GeluKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return Gelu<V>(x); });
+}
+
+template<typename V>
+void FastGeluKernel(const float* src, float* dst, size_t count) {
+  ApplyUnary<V>(src, dst, count, [](typename V::Reg x) { return FastGelu<V>(x); });
+}
+
+// float -> 16-bit conversions, with the tail going through padded buffers like ApplyUnary.
+template<typename V, void (*store)(uint16_t*, typename V::Reg)>
+void FloatTo16BitKernel(const void* src, void* dst, size_t count) {
+  const float* from = static_cast<const float*>(src);
+  uint16_t* to = static_cast<uint16_t*>(dst);
+  size_t i = 0;
+  for (; i + V::kWidth <= count; i += V::kWidth) { store(to + i, V::Load(from + i)); }
+  if (i < count) {
+    float in[V::kWidth] = {0};
+    uint16_t out[V::kWidth];
+    for (size_t j = 0; i + j < count; ++j) { in[j] = from[i + j]; }
+    store(out, V::Load(in));
+    for (size_t j = 0; i + j < count; ++j) { to[i + j] = out[j]; }
+  }
+}
+
+template<typename V, typename V::Reg (*load)(const uint16_t*)>
+void From16BitToFloatKernel(const void* src, void* dst, size_t count) {
+  const uint16_t* from = static_cast<const uint16_t*>(src);
+  float* to = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + V::kWidth <= count; i += V::kWidth) { V::Store(to + i, load(from + i)); }
+  if (i < count) {
+    uint16_t in[V::kWidth] = {0};
+    float out[V::kWidth];
+    for (size_t j = 0; i + j < count; ++j) { in[j] = from[i + j]; }
+    V::Store(out, load(in));
+    for (size_t j = 0; i + j < count; ++j) { to[i + j] = out[j]; }
+  }
+}
+
+template<typename V, bool has_float16 = V::kHasFloat16>
+struct Float16Kernels {
+  static CastKernel FromFloat() { return FloatTo16BitKernel<V, V::StoreFloat16>; }
+  static CastKernel ToFloat() { return From16BitToFloatKernel<V, V::LoadFloat16>; }
+};
+
+template<typename V>
+struct Float16Kernels<V, false> {
+  static CastKernel FromFloat() { return nullptr; }
+  static CastKernel ToFloat() { return nullptr; }
+};
+
+template<typename V>
+const Kernels* MakeKernels() {
+  static const Kernels kernels{
+      ExpKernel<V>,
+      LogKernel<V>,
+      TanhKernel<V>,
+      SigmoidKernel<V>,
+      GeluKernel<V>,
+      FastGeluKernel<V>,
+      Float16Kernels<V>::FromFloat(),
+      Float16Kernels<V>::ToFloat(),
+      FloatTo16BitKernel<V, V::StoreBfloat16>,
+      From16BitToFloatKernel<V, V::LoadBfloat16>,
+  };
+  return &kernels;
+}
+
+}  // namespace simd
+
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_SIMD_SIMD_MATH_H_
@@ -0,0 +1,68 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_PRIMITIVE_QUANTIZED_MATMUL_H_
+#define ONEFLOW_CORE_EP_PRIMITIVE_QUANTIZED_MATMUL_H_
+
+#include "oneflow/core/ep/include/primitive/primitive.h"
+#include "oneflow/core/ep/include/primitive/blas.h"
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+// The dimension of C whose indices select the per-channel scale and bias.
+enum class QuantizedMatmulChannelAxis {
+  kM = 0,
+  kN,
+};
+
+// C(m x n) = epilogue(op(A) * op(B)), A and B are int8 and the products are accumulated in
+// int32. The epilogue is selected by the data type of C:
+//
+//   kInt32: C = acc
+//   kFloat: C = acc * scale + bias                   (dequantize)
+//   kInt8:  C = saturate(round(acc * scale + bias))  (requantize)
+//
+// scale and bias are float arrays with one value per channel and may be null, meaning 1 and 0.
+// For requantization scale is a_scale * b_scale / c_scale and bias is in units of C.
+class QuantizedMatmul : public Primitive {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(QuantizedMatmul);
+  QuantizedMatmul() = default;
+  ~QuantizedMatmul() override = default;
+
+  virtual void Launch(Stream* stream, size_t m, size_t n, size_t k, const void* a, const void* b,
+                      const float* scale, const float* bias, void* c) = 0;
+};
+
+class QuantizedMatmulFactory : public Factory<QuantizedMatmul> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(QuantizedMatmulFactory);
+  QuantizedMatmulFactory() = default;
+  ~QuantizedMatmulFactory() override = default;
+
+  virtual std::unique_ptr<QuantizedMatmul> New(DataType c_type, BlasTransposeType transpose_a,
+                                               BlasTransposeType transpose_b,
+                                               QuantizedMatmulChannelAxis channel_axis) = 0;
+};
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_PRIMITIVE_QUANTIZED_MATMUL_H_
@@ -54,10 +54,6 @@ void TestBatchMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>
   Eigen::Tensor<T, 3, Eigen::RowMajor> in_b_transposed = in_b_buffer.shuffle(shuffling);
 
   for (const auto& device_type : device_types) {
-    if (device_type == DeviceType::kCPU && data_type == DataType::kFloat16) {
-      // CPU matmul not support float16
-      continue;
-    }
     auto device = registry->GetDevice(device_type, 0);
     ep::test::PinnedMemoryGuard input_a(device.get(), a_size);
     ep::test::PinnedMemoryGuard input_b(device.get(), b_size);
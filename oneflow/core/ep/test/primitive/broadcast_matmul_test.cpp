@@ -30,21 +30,43 @@ namespace test {
 
 namespace {
 
-template<DataType data_type, typename T>
+// Eigen has no bfloat16, so its reference is computed in float from inputs rounded to bfloat16.
+template<typename T, typename ComputeT>
+void RoundTo(ComputeT* data, int64_t size) {
+  for (int64_t i = 0; i < size; ++i) { data[i] = static_cast<ComputeT>(static_cast<T>(data[i])); }
+}
+
+template<typename T, typename ComputeT>
+void CopyAs(void* dst, const ComputeT* src, int64_t size) {
+  for (int64_t i = 0; i < size; ++i) { static_cast<T*>(dst)[i] = static_cast<T>(src[i]); }
+}
+
+template<typename T, typename ComputeT>
+std::vector<ComputeT> CopyFrom(const void* src, int64_t size) {
+  std::vector<ComputeT> dst(size);
+  for (int64_t i = 0; i < size; ++i) {
+    dst[i] = static_cast<ComputeT>(static_cast<const T*>(src)[i]);
+  }
+  return dst;
+}
+
+template<DataType data_type, typename T, typename ComputeT = T>
 void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
                          int batch_size, int m, int k, int n, bool transpose_a, bool transpose_b,
                          bool broadcast_a, bool broadcast_b, bool reduce_c) {
-  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using Matrix = Eigen::Matrix<ComputeT, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
   CHECK((!broadcast_a) || (!broadcast_b));
   int a_batch_dims = broadcast_a ? 1 : batch_size;
   int b_batch_dims = broadcast_b ? 1 : batch_size;
   int c_batch_dims = reduce_c ? 1 : batch_size;
-  Eigen::Tensor<T, 3, Eigen::RowMajor> in_a_buffer(a_batch_dims, m, k);
-  Eigen::Tensor<T, 3, Eigen::RowMajor> in_b_buffer(b_batch_dims, k, n);
-  Eigen::Tensor<T, 3, Eigen::RowMajor> out_c_buffer(c_batch_dims, m, n);
-  Eigen::Tensor<T, 3, Eigen::RowMajor> broadcast_c_buffer(batch_size, m, n);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> in_a_buffer(a_batch_dims, m, k);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> in_b_buffer(b_batch_dims, k, n);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> out_c_buffer(c_batch_dims, m, n);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> broadcast_c_buffer(batch_size, m, n);
   in_a_buffer.setRandom();
   in_b_buffer.setRandom();
+  RoundTo<T>(in_a_buffer.data(), in_a_buffer.size());
+  RoundTo<T>(in_b_buffer.data(), in_b_buffer.size());
   for (int i = 0; i < batch_size; ++i) {
     int64_t a_offset = broadcast_a ? 0 : i * m * k;
     int64_t b_offset = broadcast_b ? 0 : i * k * n;
@@ -63,8 +85,8 @@ void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceT
   int64_t b_size = b_batch_dims * k * n * sizeof(T);
   int64_t c_size = c_batch_dims * m * n * sizeof(T);
   Eigen::array<int, 3> shuffling({0, 2, 1});
-  Eigen::Tensor<T, 3, Eigen::RowMajor> in_a_transposed = in_a_buffer.shuffle(shuffling);
-  Eigen::Tensor<T, 3, Eigen::RowMajor> in_b_transposed = in_b_buffer.shuffle(shuffling);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> in_a_transposed = in_a_buffer.shuffle(shuffling);
+  Eigen::Tensor<ComputeT, 3, Eigen::RowMajor> in_b_transposed = in_b_buffer.shuffle(shuffling);
 
   size_t num_a_dims = broadcast_a ? 2 : 3;
   std::vector<int64_t> a_dims;
@@ -93,22 +115,18 @@ void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceT
   c_dims.push_back(n);
 
   for (const auto& device_type : device_types) {
-    if (device_type == DeviceType::kCPU && data_type == DataType::kFloat16) {
-      // CPU matmul not support float16
-      continue;
-    }
     auto device = registry->GetDevice(device_type, 0);
     ep::test::PinnedMemoryGuard input_a(device.get(), a_size);
     ep::test::PinnedMemoryGuard input_b(device.get(), b_size);
     if (transpose_a) {
-      std::memcpy(input_a.ptr(), in_a_transposed.data(), a_size);
+      CopyAs<T>(input_a.ptr(), in_a_transposed.data(), in_a_transposed.size());
     } else {
-      std::memcpy(input_a.ptr(), in_a_buffer.data(), a_size);
+      CopyAs<T>(input_a.ptr(), in_a_buffer.data(), in_a_buffer.size());
     }
     if (transpose_b) {
-      std::memcpy(input_b.ptr(), in_b_transposed.data(), b_size);
+      CopyAs<T>(input_b.ptr(), in_b_transposed.data(), in_b_transposed.size());
     } else {
-      std::memcpy(input_b.ptr(), in_b_buffer.data(), b_size);
+      CopyAs<T>(input_b.ptr(), in_b_buffer.data(), in_b_buffer.size());
     }
     ep::test::PinnedMemoryGuard output(device.get(), c_size);
     ep::test::DeviceMemoryGuard device_a(device.get(), a_size);
@@ -131,45 +149,52 @@ void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceT
                              c_dims.data(), device_c.ptr());
     d2h->Launch(stream.stream(), output.ptr(), device_c.ptr(), c_size);
     CHECK_JUST(stream.stream()->Sync());
-    Eigen::Map<Eigen::Matrix<T, 1, Eigen::Dynamic>, Eigen::Unaligned> eigen_out(
+    std::vector<ComputeT> of_out_buffer = CopyFrom<T, ComputeT>(output.ptr(), out_c_buffer.size());
+    Eigen::Map<Eigen::Matrix<ComputeT, 1, Eigen::Dynamic>, Eigen::Unaligned> eigen_out(
         out_c_buffer.data(), out_c_buffer.size());
-    Eigen::Map<Eigen::Matrix<T, 1, Eigen::Dynamic>, Eigen::Unaligned> of_out(
-        reinterpret_cast<T*>(output.ptr()), out_c_buffer.size());
-    ASSERT_TRUE(eigen_out.template isApprox(of_out, static_cast<T>(0.001)));
+    Eigen::Map<Eigen::Matrix<ComputeT, 1, Eigen::Dynamic>, Eigen::Unaligned> of_out(
+        of_out_buffer.data(), of_out_buffer.size());
+    // bfloat16 keeps 8 bits of mantissa.
+    const double precision = data_type == DataType::kBFloat16 ? 0.01 : 0.001;
+    ASSERT_TRUE(eigen_out.template isApprox(of_out, static_cast<ComputeT>(precision)));
   }
 }
 
-template<DataType data_type, typename T>
+template<DataType data_type, typename T, typename ComputeT = T>
 void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
                          int m, int k, int n, bool transpose_a, bool transpose_b) {
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 10, m, k, n, transpose_a, transpose_b,
-                                    false, false, true);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 10, m, k, n, transpose_a, transpose_b,
-                                    false, false, false);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 10, m, k, n, transpose_a, transpose_b,
-                                    false, true, true);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 10, m, k, n, transpose_a, transpose_b,
-                                    false, true, false);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 12, m, k, n, transpose_a, transpose_b,
-                                    true, false, true);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 12, m, k, n, transpose_a, transpose_b,
-                                    true, false, false);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 10, m, k, n, transpose_a,
+                                              transpose_b, false, false, true);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 10, m, k, n, transpose_a,
+                                              transpose_b, false, false, false);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 10, m, k, n, transpose_a,
+                                              transpose_b, false, true, true);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 10, m, k, n, transpose_a,
+                                              transpose_b, false, true, false);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 12, m, k, n, transpose_a,
+                                              transpose_b, true, false, true);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 12, m, k, n, transpose_a,
+                                              transpose_b, true, false, false);
 }
 
-template<DataType data_type, typename T>
+template<DataType data_type, typename T, typename ComputeT = T>
 void TestBroadcastMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
                          int m, int k, int n) {
-  TestBroadcastMatmul<data_type, T>(registry, device_types, m, k, n, false, false);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, m, k, n, true, false);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, m, k, n, false, true);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, m, k, n, true, true);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, m, k, n, false, false);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, m, k, n, true, false);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, m, k, n, false, true);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, m, k, n, true, true);
 }
 
-template<DataType data_type, typename T>
+template<DataType data_type, typename T, typename ComputeT = T>
 void TestBroadcastMatmul(DeviceManagerRegistry* registry,
                          const std::set<DeviceType>& device_types) {
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 64, 16, 8);
-  TestBroadcastMatmul<data_type, T>(registry, device_types, 16, 7, 12);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 64, 16, 8);
+  TestBroadcastMatmul<data_type, T, ComputeT>(registry, device_types, 16, 7, 12);
+  // An empty k only applies beta.
+  if (device_types.count(DeviceType::kCPU) > 0) {
+    TestBroadcastMatmul<data_type, T, ComputeT>(registry, {DeviceType::kCPU}, 16, 0, 12);
+  }
 }
 
 }  // namespace
@@ -180,6 +205,8 @@ TEST_F(PrimitiveTest, TestBroadcastMatmul) {
   TestBroadcastMatmul<DataType::kFloat, float>(&device_manager_registry_, available_device_types_);
   TestBroadcastMatmul<DataType::kFloat16, Eigen::half>(&device_manager_registry_,
                                                        available_device_types_);
+  TestBroadcastMatmul<DataType::kBFloat16, bfloat16, float>(&device_manager_registry_,
+                                                            available_device_types_);
 }
 
 }  // namespace test
@@ -0,0 +1,160 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/ep/test/primitive/primitive_test.h"
+#include "oneflow/core/ep/include/primitive/memcpy.h"
+#include "oneflow/core/ep/include/primitive/quantized_matmul.h"
+#include <Eigen/Core>
+
+namespace oneflow {
+
+namespace ep {
+
+namespace primitive {
+
+namespace test {
+
+namespace {
+
+using Int32Matrix = Eigen::Matrix<int32_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using Int8Matrix = Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using FloatMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+Int8Matrix RandomInt8Matrix(int rows, int cols) {
+  Int8Matrix matrix(rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) { matrix(i, j) = static_cast<int8_t>(std::rand() % 256 - 128); }
+  }
+  return matrix;
+}
+
+template<DataType data_type, typename T>
+void TestQuantizedMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
+                         int m, int k, int n, bool transpose_a, bool transpose_b,
+                         QuantizedMatmulChannelAxis channel_axis) {
+  const Int8Matrix a = RandomInt8Matrix(m, k);
+  const Int8Matrix b = RandomInt8Matrix(k, n);
+  const Int32Matrix acc = a.cast<int32_t>() * b.cast<int32_t>();
+  const int num_channels = channel_axis == QuantizedMatmulChannelAxis::kM ? m : n;
+  std::vector<float> scale(num_channels);
+  std::vector<float> bias(num_channels);
+  for (int i = 0; i < num_channels; ++i) {
+    scale[i] = static_cast<float>(std::rand() % 100 + 1) / 10000;
+    bias[i] = static_cast<float>(std::rand() % 100) / 10;
+  }
+  FloatMatrix c(m, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      const int channel = channel_axis == QuantizedMatmulChannelAxis::kM ? i : j;
+      c(i, j) = data_type == DataType::kInt32
+                    ? static_cast<float>(acc(i, j))
+                    : static_cast<float>(acc(i, j)) * scale[channel] + bias[channel];
+    }
+  }
+  const Int8Matrix a_transpose = a.transpose();
+  const Int8Matrix b_transpose = b.transpose();
+
+  const int64_t a_size = m * k;
+  const int64_t b_size = k * n;
+  const int64_t c_size = m * n * sizeof(T);
+  const int64_t channel_size = num_channels * sizeof(float);
+
+  for (const auto& device_type : device_types) {
+    const auto trans_a = transpose_a ? BlasTransposeType::T : BlasTransposeType::N;
+    const auto trans_b = transpose_b ? BlasTransposeType::T : BlasTransposeType::N;
+    std::unique_ptr<QuantizedMatmul> matmul = NewPrimitive<QuantizedMatmulFactory>(
+        device_type, data_type, trans_a, trans_b, channel_axis);
+    if (!matmul) { continue; }
+    auto device = registry->GetDevice(device_type, 0);
+    ep::test::PinnedMemoryGuard input_a(device.get(), a_size);
+    ep::test::PinnedMemoryGuard input_b(device.get(), b_size);
+    ep::test::PinnedMemoryGuard input_scale(device.get(), channel_size);
+    ep::test::PinnedMemoryGuard input_bias(device.get(), channel_size);
+    std::memcpy(input_a.ptr(), transpose_a ? a_transpose.data() : a.data(), a_size);
+    std::memcpy(input_b.ptr(), transpose_b ? b_transpose.data() : b.data(), b_size);
+    std::memcpy(input_scale.ptr(), scale.data(), channel_size);
+    std::memcpy(input_bias.ptr(), bias.data(), channel_size);
+    ep::test::PinnedMemoryGuard output(device.get(), c_size);
+    ep::test::DeviceMemoryGuard device_a(device.get(), a_size);
+    ep::test::DeviceMemoryGuard device_b(device.get(), b_size);
+    ep::test::DeviceMemoryGuard device_scale(device.get(), channel_size);
+    ep::test::DeviceMemoryGuard device_bias(device.get(), channel_size);
+    ep::test::DeviceMemoryGuard device_c(device.get(), c_size);
+    ep::test::StreamGuard stream(device.get());
+    std::unique_ptr<Memcpy> h2d = NewPrimitive<MemcpyFactory>(device_type, MemcpyKind::kHtoD);
+    std::unique_ptr<Memcpy> d2h = NewPrimitive<MemcpyFactory>(device_type, MemcpyKind::kDtoH);
+    ASSERT_TRUE(d2h.operator bool());
+    ASSERT_TRUE(h2d.operator bool());
+    h2d->Launch(stream.stream(), device_a.ptr(), input_a.ptr(), a_size);
+    h2d->Launch(stream.stream(), device_b.ptr(), input_b.ptr(), b_size);
+    h2d->Launch(stream.stream(), device_scale.ptr(), input_scale.ptr(), channel_size);
+    h2d->Launch(stream.stream(), device_bias.ptr(), input_bias.ptr(), channel_size);
+    if (data_type == DataType::kInt32) {
+      matmul->Launch(stream.stream(), m, n, k, device_a.ptr(), device_b.ptr(), nullptr, nullptr,
+                     device_c.ptr());
+    } else {
+      matmul->Launch(stream.stream(), m, n, k, device_a.ptr(), device_b.ptr(),
+                     reinterpret_cast<const float*>(device_scale.ptr()),
+                     reinterpret_cast<const float*>(device_bias.ptr()), device_c.ptr());
+    }
+    d2h->Launch(stream.stream(), output.ptr(), device_c.ptr(), c_size);
+    CHECK_JUST(stream.stream()->Sync());
+    auto res = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>,
+                          Eigen::Unaligned>(reinterpret_cast<T*>(output.ptr()), m, n);
+    if (data_type == DataType::kInt8) {
+      const FloatMatrix expected = c.array().round().max(-128.f).min(127.f).matrix();
+      ASSERT_TRUE((expected - res.template cast<float>()).cwiseAbs().maxCoeff() <= 1.f);
+    } else {
+      ASSERT_TRUE(c.isApprox(res.template cast<float>(), 0.0001f));
+    }
+  }
+}
+
+template<DataType data_type, typename T>
+void TestQuantizedMatmul(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
+                         int m, int k, int n) {
+  for (const auto channel_axis : {QuantizedMatmulChannelAxis::kM, QuantizedMatmulChannelAxis::kN}) {
+    TestQuantizedMatmul<data_type, T>(registry, device_types, m, k, n, false, false, channel_axis);
+    TestQuantizedMatmul<data_type, T>(registry, device_types, m, k, n, true, false, channel_axis);
+    TestQuantizedMatmul<data_type, T>(registry, device_types, m, k, n, false, true, channel_axis);
+    TestQuantizedMatmul<data_type, T>(registry, device_types, m, k, n, true, true, channel_axis);
+  }
+}
+
+template<DataType data_type, typename T>
+void TestQuantizedMatmul(DeviceManagerRegistry* registry,
+                         const std::set<DeviceType>& device_types) {
+  TestQuantizedMatmul<data_type, T>(registry, device_types, 64, 16, 8);
+  TestQuantizedMatmul<data_type, T>(registry, device_types, 16, 7, 12);
+  TestQuantizedMatmul<data_type, T>(registry, device_types, 130, 600, 70);
+}
+
+}  // namespace
+
+TEST_F(PrimitiveTest, TestQuantizedMatmul) {
+  TestQuantizedMatmul<DataType::kInt32, int32_t>(&device_manager_registry_,
+                                                 available_device_types_);
+  TestQuantizedMatmul<DataType::kFloat, float>(&device_manager_registry_, available_device_types_);
+  TestQuantizedMatmul<DataType::kInt8, int8_t>(&device_manager_registry_, available_device_types_);
+}
+
+}  // namespace test
+
+}  // namespace primitive
+
+}  // namespace ep
+
+}  // namespace oneflow
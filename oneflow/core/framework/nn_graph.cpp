@@ -37,6 +37,7 @@ limitations under the License.
 #include "oneflow/core/job/job_instance.h"
 #include "oneflow/core/job/critical_section_instance.h"
 #include "oneflow/core/job/lazy_mode.h"
+#include "oneflow/core/job/plan_cache.h"
 #include "oneflow/core/job/plan_util.h"
 #include "oneflow/core/job/utils/progress_bar.h"
 #include "oneflow/core/job_rewriter/job_completer.h"
@@ -409,28 +410,37 @@ Maybe<void> NNGraph::CompilePlanForRuntime() {
   // A global variable to get graph configurations.
   auto current_graph_config = std::make_unique<GlobalJobDescScope>(job_.job_conf(), job_id());
   if (GlobalProcessCtx::IsThisProcessMaster()) {
-    // TODO(chengcheng): new memory reused by chunk
-    Compiler().Compile(&job_, &plan_);
-    auto sub_compile_tc = std::make_unique<CostCounter<std::chrono::seconds>>(true, true);
-    PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(&plan_, variable_op_names_);
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " GenMemBlockAndChunk", 1, true);
-    if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
-      TeePersistentLogStream::Create("job_" + name_ + "_plan")->Write(plan_);
-      PlanUtil::ToDotFile(plan_, "job_" + name_ + "_plan.dot");
-    }
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " LogPlan", 1, true);
-    PlanUtil::GenRegisterHint(&plan_);
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " GenRegisterHint", 1, true);
-    // TODO(chengcheng): test collective boxing for multi-job.
-    PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " GenCollectiveBoxingPlan", 1, true);
-    PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " DumpCtrlRegstInfoToPlan", 1, true);
-    PlanUtil::PlanMemoryLog(&plan_, name_);
-    if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
-      PlanUtil::GenLightPlan(&plan_, name_);
+    const std::unique_ptr<PlanCache> plan_cache = PlanCache::New(job_, job_id());
+    if (plan_cache && plan_cache->TryLoad(&plan_)) {
+      LOG(INFO) << "[GraphCompile]" << name_ << " load plan from " << plan_cache->file_path();
+    } else {
+      // TODO(chengcheng): new memory reused by chunk
+      Compiler().Compile(&job_, &plan_);
+      auto sub_compile_tc = std::make_unique<CostCounter<std::chrono::seconds>>(true, true);
+      PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(&plan_, variable_op_names_);
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " GenMemBlockAndChunk", 1, true);
+      if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
+        TeePersistentLogStream::Create("job_" + name_ + "_plan")->Write(plan_);
+        PlanUtil::ToDotFile(plan_, "job_" + name_ + "_plan.dot");
+      }
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " LogPlan", 1, true);
+      PlanUtil::GenRegisterHint(&plan_);
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " GenRegisterHint", 1, true);
+      // TODO(chengcheng): test collective boxing for multi-job.
+      PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " GenCollectiveBoxingPlan", 1, true);
+      PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " DumpCtrlRegstInfoToPlan", 1, true);
+      PlanUtil::PlanMemoryLog(&plan_, name_);
+      if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
+        PlanUtil::GenLightPlan(&plan_, name_);
+      }
+      sub_compile_tc->Count("[GraphCompile]" + name_ + " GenMemAndLightPlanLog", 1, true);
+      if (plan_cache) {
+        plan_cache->Save(plan_);
+        sub_compile_tc->Count("[GraphCompile]" + name_ + " SavePlanCache", 1, true);
+      }
     }
-    sub_compile_tc->Count("[GraphCompile]" + name_ + " GenMemAndLightPlanLog", 1, true);
   }
   compile_tc->Count("[GraphCompile]" + name_ + " CompilePlan", 0);
   if (GlobalProcessCtx::WorldSize() > 1) {
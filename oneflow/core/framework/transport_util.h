@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/common/symbol.h"
 #include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/framework/transport_token.h"
+#include "oneflow/core/profiler/counter.h"
 
 namespace oneflow {
 
@@ -34,6 +35,7 @@ class AsyncTransportCtx {
   BlockingCounter* mut_blocking_counter() { return &blocking_counter_; }
 
   Maybe<void> WaitDone() {
+    OF_COUNTER_TIME_GUARD("transport.wait_done_ns");
     mut_blocking_counter()->Decrease();
     return mut_blocking_counter()->WaitUntilCntEqualZero([]() -> Maybe<bool> { return true; });
   }
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/functional/impl/binary_functor.h"
 
 #include "oneflow/core/framework/attr_map.h"
+#include "oneflow/core/framework/dtype.h"
 #include "oneflow/core/framework/mutable_attr_map.h"
 #include "oneflow/core/framework/op_builder.h"
 #include "oneflow/core/framework/op_expr.h"
@@ -378,6 +379,116 @@ class FusedLinearWithGroupwiseQuantizedWeightFunctor {
   std::shared_ptr<OpExpr> asymmetric_without_bias_op_;
 };
 
+namespace {
+
+// Ops with the given inputs followed by every combination of the optional scale and bias inputs,
+// indexed by has_scale * 2 + has_bias.
+std::array<std::shared_ptr<OpExpr>, 4> BuildQuantizedOps(const std::string& op_type_name,
+                                                         const std::vector<std::string>& inputs) {
+  std::array<std::shared_ptr<OpExpr>, 4> ops;
+  for (int i = 0; i < 4; ++i) {
+    one::OpBuilder builder(op_type_name);
+    for (const auto& input : inputs) { builder.Input(input); }
+    if (i & 2) { builder.Input("scale"); }
+    if (i & 1) { builder.Input("bias"); }
+    ops[i] = CHECK_JUST(builder.Output("out").Build());
+  }
+  return ops;
+}
+
+Maybe<DataType> GetQuantizedOutDataType(const Optional<one::Tensor>& scale,
+                                        const Optional<one::Tensor>& bias,
+                                        const Optional<Symbol<DType>>& out_dtype) {
+  DataType data_type = DataType::kInt32;
+  if (out_dtype) {
+    data_type = JUST(out_dtype)->data_type();
+  } else if (scale || bias) {
+    data_type = DataType::kFloat;
+  }
+  CHECK_OR_RETURN(data_type == DataType::kInt32 || data_type == DataType::kFloat
+                  || data_type == DataType::kInt8)
+      << "out_dtype should be int32, float or int8.";
+  if (data_type == DataType::kInt32) {
+    CHECK_OR_RETURN(!scale && !bias) << "int32 output takes neither scale nor bias.";
+  }
+  return data_type;
+}
+
+Maybe<TensorTuple> QuantizedOpInputs(const std::shared_ptr<one::Tensor>& x,
+                                     const std::shared_ptr<one::Tensor>& w,
+                                     const Optional<one::Tensor>& scale,
+                                     const Optional<one::Tensor>& bias) {
+  TensorTuple inputs{x, w};
+  for (const auto* optional_input : {&scale, &bias}) {
+    if (*optional_input) {
+      const auto& input = JUST(*optional_input);
+      CHECK_OR_RETURN(input->dtype()->data_type() == DataType::kFloat)
+          << "The dtype of scale and bias should be float.";
+      inputs.emplace_back(input);
+    }
+  }
+  return inputs;
+}
+
+}  // namespace
+
+class QuantizedMatmulFunctor {
+ public:
+  QuantizedMatmulFunctor() { ops_ = BuildQuantizedOps("quantized_matmul", {"a", "b"}); }
+  Maybe<Tensor> operator()(const std::shared_ptr<one::Tensor>& a,
+                           const std::shared_ptr<one::Tensor>& b,
+                           const Optional<one::Tensor>& scale, const Optional<one::Tensor>& bias,
+                           const bool& transpose_a, const bool& transpose_b,
+                           const Optional<Symbol<DType>>& out_dtype) const {
+    CHECK_OR_RETURN(a->dtype()->data_type() == DataType::kInt8
+                    && b->dtype()->data_type() == DataType::kInt8)
+        << "The dtype of tensor a and b should be int8.";
+    const DataType data_type = JUST(GetQuantizedOutDataType(scale, bias, out_dtype));
+    auto& attrs = THREAD_CACHED_MUTABLE_ATTR_MAP("transpose_a", "transpose_b", "out_dtype");
+    attrs.SetAllAttrs(transpose_a, transpose_b, data_type);
+    const auto& op = ops_[static_cast<bool>(scale) * 2 + static_cast<bool>(bias)];
+    return OpInterpUtil::Dispatch<Tensor>(*op, *JUST(QuantizedOpInputs(a, b, scale, bias)), attrs);
+  }
+
+ private:
+  std::array<std::shared_ptr<OpExpr>, 4> ops_;
+};
+
+class QuantizedConv2dFunctor {
+ public:
+  QuantizedConv2dFunctor() { ops_ = BuildQuantizedOps("quantized_conv2d", {"in", "weight"}); }
+  Maybe<Tensor> operator()(const std::shared_ptr<one::Tensor>& input,
+                           const std::shared_ptr<one::Tensor>& weight,
+                           const Optional<one::Tensor>& scale, const Optional<one::Tensor>& bias,
+                           const std::vector<int32_t>& stride, const std::vector<int32_t>& padding,
+                           const std::vector<int32_t>& dilation, const int32_t& groups,
+                           const std::string& channel_pos,
+                           const Optional<Symbol<DType>>& out_dtype) const {
+    CHECK_OR_RETURN(input->dtype()->data_type() == DataType::kInt8
+                    && weight->dtype()->data_type() == DataType::kInt8)
+        << "The dtype of tensor input and weight should be int8.";
+    CHECK_EQ_OR_RETURN(input->shape()->NumAxes(), 4)
+        << "The number of dimensions for tensor input should be equal to 4.";
+    CHECK_EQ_OR_RETURN(weight->shape()->NumAxes(), 4)
+        << "The number of dimensions for tensor weight should be equal to 4.";
+    const DataType data_type = JUST(GetQuantizedOutDataType(scale, bias, out_dtype));
+    const int32_t kernel_idx_offset = channel_pos == "channels_last" ? 1 : 2;
+    std::vector<int32_t> kernel_size(2);
+    for (int i = 0; i < 2; ++i) { kernel_size[i] = weight->shape()->At(i + kernel_idx_offset); }
+    auto& attrs =
+        THREAD_CACHED_MUTABLE_ATTR_MAP("filters", "kernel_size", "padding_before", "strides",
+                                       "dilation_rate", "groups", "data_format", "out_dtype");
+    attrs.SetAllAttrs(static_cast<int32_t>(weight->shape()->At(0)), kernel_size, padding, stride,
+                      dilation, groups, channel_pos, data_type);
+    const auto& op = ops_[static_cast<bool>(scale) * 2 + static_cast<bool>(bias)];
+    return OpInterpUtil::Dispatch<Tensor>(*op, *JUST(QuantizedOpInputs(input, weight, scale, bias)),
+                                          attrs);
+  }
+
+ private:
+  std::array<std::shared_ptr<OpExpr>, 4> ops_;
+};
+
 }  // namespace impl
 
 ONEFLOW_FUNCTION_LIBRARY(m) { m.add_functor<impl::FakeQuantizationFunctor>("FakeQuantization"); };
@@ -391,6 +502,10 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
   m.add_functor<impl::FusedLinearWithGroupwiseQuantizedWeightFunctor>(
       "FusedLinearWithGroupwiseQuantizedWeight");
 };
+ONEFLOW_FUNCTION_LIBRARY(m) {
+  m.add_functor<impl::QuantizedMatmulFunctor>("QuantizedMatmul");
+  m.add_functor<impl::QuantizedConv2dFunctor>("QuantizedConv2d");
+};
 
 }  // namespace functional
 }  // namespace one
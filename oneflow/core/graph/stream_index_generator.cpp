@@ -49,4 +49,36 @@ StreamIndexGenerator::stream_index_t StreamIndexGenerator::GenerateNamedRoundRob
   return cur_stream_index;
 }
 
+void StreamIndexGenerator::ToProto(StreamIndexGeneratorProto* proto) const {
+  std::unique_lock<std::mutex> lck(mtx_);
+  proto->set_next_stream_index(next_stream_index_);
+  auto* name2rr_range = proto->mutable_name2rr_range();
+  name2rr_range->clear();
+  for (const auto& pair : name2rr_range_) {
+    StreamIndexRangeProto* range = &(*name2rr_range)[pair.first];
+    range->set_begin(pair.second.begin);
+    range->set_size(pair.second.size);
+    range->set_offset(pair.second.offset);
+  }
+}
+
+void StreamIndexGenerator::InitFromProto(const StreamIndexGeneratorProto& proto) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  CHECK_GE(proto.next_stream_index(), 0);
+  CHECK_LE(proto.next_stream_index(), static_cast<int64_t>(StreamId::kMaxStreamIndex) + 1);
+  next_stream_index_ = proto.next_stream_index();
+  name2rr_range_.clear();
+  for (const auto& pair : proto.name2rr_range()) {
+    const StreamIndexRangeProto& range = pair.second;
+    CHECK_GE(range.begin(), 0);
+    CHECK_GT(range.size(), 0);
+    CHECK_LE(range.begin() + range.size(), proto.next_stream_index());
+    CHECK_GE(range.offset(), 0);
+    CHECK_LT(range.offset(), range.size());
+    RoundRobinRange rr_range(range.begin(), range.size());
+    rr_range.offset = range.offset();
+    name2rr_range_.emplace(pair.first, rr_range);
+  }
+}
+
 }  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_GRAPH_STREAM_INDEX_GENERATOR_H_
 
 #include "oneflow/core/graph/stream_id.h"
+#include "oneflow/core/job/id_state.pb.h"
 
 namespace oneflow {
 
@@ -32,6 +33,9 @@ class StreamIndexGenerator final {
   stream_index_t GenerateNamed(const std::string& name);
   stream_index_t GenerateNamedRoundRobin(const std::string& name, size_t size);
 
+  void ToProto(StreamIndexGeneratorProto* proto) const;
+  void InitFromProto(const StreamIndexGeneratorProto& proto);
+
  private:
   struct RoundRobinRange {
     RoundRobinRange(stream_index_t begin, size_t size) : begin(begin), size(size), offset(0) {}
@@ -42,7 +46,7 @@ class StreamIndexGenerator final {
 
   stream_index_t next_stream_index_;
   HashMap<std::string, RoundRobinRange> name2rr_range_;
-  std::mutex mtx_;
+  mutable std::mutex mtx_;
 };
 
 }  // namespace oneflow
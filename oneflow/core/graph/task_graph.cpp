@@ -37,6 +37,8 @@ limitations under the License.
 #include "oneflow/core/register/runtime_register_desc.h"
 #include "oneflow/core/common/env_var/env_var.h"
 #include "oneflow/core/framework/user_op_registry_manager.h"
+#include "oneflow/core/job/lazy_mode.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -597,6 +599,93 @@ void TaskGraph::ConnectCtrlEdges(const std::vector<CompTaskNode*>& src_task_node
   }
 }
 
+void TaskGraph::ParallelTopoForEachNode(int64_t thread_num,
+                                        const std::function<void(TaskNode*)>& Handler) const {
+  std::vector<TaskNode*> topo_nodes;
+  topo_nodes.reserve(node_num());
+  TopoForEachNode([&](TaskNode* node) { topo_nodes.emplace_back(node); });
+  if (thread_num <= 1 || topo_nodes.size() <= 1) {
+    for (TaskNode* node : topo_nodes) { Handler(node); }
+    return;
+  }
+  const int64_t node_cnt = topo_nodes.size();
+  HashMap<const TaskNode*, int64_t> node2index;
+  node2index.reserve(node_cnt);
+  FOR_RANGE(int64_t, i, 0, node_cnt) { CHECK(node2index.emplace(topo_nodes.at(i), i).second); }
+  // NOTE: only compute task nodes are handled by the pool. Transport task nodes may construct ops
+  // and allocate global ids while being built, so they run on the calling thread in exactly the
+  // order of TopoForEachNode to keep the result independent of thread scheduling.
+  std::vector<bool> is_pooled(node_cnt);
+  std::vector<std::vector<int64_t>> out_indices(node_cnt);
+  std::unique_ptr<std::atomic<int64_t>[]> in_cnts(new std::atomic<int64_t>[node_cnt]);
+  FOR_RANGE(int64_t, i, 0, node_cnt) { in_cnts[i] = 0; }
+  FOR_RANGE(int64_t, i, 0, node_cnt) {
+    is_pooled[i] = dynamic_cast<CompTaskNode*>(topo_nodes.at(i)) != nullptr;
+    topo_nodes.at(i)->ForEachNodeOnOutEdge([&](TaskNode* out_node) {
+      const int64_t out_index = node2index.at(out_node);
+      out_indices[i].emplace_back(out_index);
+      in_cnts[out_index] += 1;
+    });
+  }
+
+  const bool lazy_mode_enabled = LazyMode::is_enabled();
+  std::mutex mtx;
+  std::condition_variable cond;
+  int64_t remain_cnt = node_cnt;
+  std::exception_ptr error;
+  std::atomic<bool> failed(false);
+  std::function<void(int64_t)> Run;
+  std::function<void(int64_t)> AddWork;
+  // NOTE: the pool is declared after everything its works refer to, so that its destructor joins
+  // the workers before any of those objects is destroyed.
+  ThreadPool thread_pool(std::min(thread_num, node_cnt));
+  AddWork = [&](int64_t index) {
+    thread_pool.AddWork([&, index]() {
+      LazyMode::Guard lazy_mode_guard(lazy_mode_enabled);
+      Run(index);
+    });
+  };
+  Run = [&](int64_t index) {
+    // Once a handler failed the remaining ones are skipped, but successors are still released so
+    // that every node is accounted for before the error is rethrown.
+    if (!failed) {
+      try {
+        Handler(topo_nodes.at(index));
+      } catch (...) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!error) { error = std::current_exception(); }
+        failed = true;
+      }
+    }
+    for (int64_t out_index : out_indices.at(index)) {
+      if (--in_cnts[out_index] == 0 && is_pooled[out_index]) { AddWork(out_index); }
+    }
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      remain_cnt -= 1;
+    }
+    cond.notify_all();
+  };
+  std::vector<int64_t> pooled_sources;
+  FOR_RANGE(int64_t, i, 0, node_cnt) {
+    if (is_pooled[i] && in_cnts[i] == 0) { pooled_sources.emplace_back(i); }
+  }
+  for (int64_t index : pooled_sources) { AddWork(index); }
+  FOR_RANGE(int64_t, i, 0, node_cnt) {
+    if (is_pooled[i]) { continue; }
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cond.wait(lock, [&]() { return in_cnts[i] == 0; });
+    }
+    Run(i);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [&]() { return remain_cnt == 0; });
+  }
+  if (error) { std::rethrow_exception(error); }
+}
+
 void TaskGraph::RemoveEmptyRegsts() {
   ForEachNode([&](TaskNode* node) { node->EraseUninitializedShapeProducedBlob(); });
   ForEachNode([&](TaskNode* node) { node->EraseZeroSizeConsumedRegst(); });
@@ -49,6 +49,10 @@ class TaskGraph final : public Graph<TaskNode, TaskEdge> {
   void RemoveEmptyRegsts();
   void MergeChainAndAddOrderingCtrlEdgeInSameChain();
   void DecideExecutionOrder();
+  // Same visiting constraint as TopoForEachNode, but handlers of compute task nodes run on up to
+  // thread_num threads. Other task nodes run on the calling thread in TopoForEachNode order.
+  void ParallelTopoForEachNode(int64_t thread_num,
+                               const std::function<void(TaskNode*)>& Handler) const;
 
   void EnableInplaceMemSharing(const std::function<bool(const std::string&, const std::string&)>&
                                    IsOpNameDataOrCtrlReachable);
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_GRAPH_TASK_ID_GENERATOR_H_
 
 #include "oneflow/core/graph/task_id.h"
+#include "oneflow/core/job/id_state.pb.h"
 
 namespace oneflow {
 
@@ -30,6 +31,9 @@ class TaskIdGenerator final {
 
   TaskId Generate(const StreamId& stream_id);
 
+  void ToProto(TaskIdGeneratorProto* proto) const;
+  void InitFromProto(const TaskIdGeneratorProto& proto);
+
  private:
   HashMap<StreamId, task_index_t> stream_id2task_index_counter_;
 };
@@ -39,6 +43,23 @@ inline TaskId TaskIdGenerator::Generate(const StreamId& stream_id) {
   return TaskId{stream_id, task_index};
 }
 
+inline void TaskIdGenerator::ToProto(TaskIdGeneratorProto* proto) const {
+  auto* counters = proto->mutable_stream_id2task_index_counter();
+  counters->clear();
+  for (const auto& pair : stream_id2task_index_counter_) {
+    (*counters)[EncodeStreamIdToInt64(pair.first)] = pair.second;
+  }
+}
+
+inline void TaskIdGenerator::InitFromProto(const TaskIdGeneratorProto& proto) {
+  stream_id2task_index_counter_.clear();
+  for (const auto& pair : proto.stream_id2task_index_counter()) {
+    CHECK_GE(pair.second, 0);
+    CHECK_LE(pair.second, static_cast<int64_t>(TaskId::kMaxTaskIndex) + 1);
+    stream_id2task_index_counter_.emplace(DecodeStreamIdFromInt64(pair.first), pair.second);
+  }
+}
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_GRAPH_TASK_ID_GENERATOR_H_
@@ -48,6 +48,28 @@ TaskStreamIndexManager::stream_index_t TaskStreamIndexManager::GetNamedTaskStrea
   return generator->GenerateNamed(name);
 }
 
+void TaskStreamIndexManager::ToProto(TaskStreamIndexManagerProto* proto) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  auto* device_id2generator = proto->mutable_device_id2generator();
+  device_id2generator->clear();
+  for (const auto& pair : generators_) {
+    const int64_t encoded_device_id = EncodeStreamIdToInt64(StreamId{pair.first, 0});
+    pair.second->ToProto(&(*device_id2generator)[encoded_device_id]);
+  }
+}
+
+void TaskStreamIndexManager::InitFromProto(const TaskStreamIndexManagerProto& proto) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  generators_.clear();
+  for (const auto& pair : proto.device_id2generator()) {
+    const StreamId stream_id = DecodeStreamIdFromInt64(pair.first);
+    CHECK_EQ(stream_id.stream_index(), 0);
+    auto generator = std::make_unique<StreamIndexGenerator>();
+    generator->InitFromProto(pair.second);
+    CHECK(generators_.emplace(stream_id.device_id(), std::move(generator)).second);
+  }
+}
+
 void TaskStreamIndexGetterRegistry::Register(const key_t& key, const stream_index_getter& getter) {
   bool insert_success = stream_index_getter_map_.emplace(key, getter).second;
   if (!insert_success) {
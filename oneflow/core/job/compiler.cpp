@@ -24,6 +24,7 @@ limitations under the License.
 #include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/common/cost_util.h"
 #include "oneflow/core/job/lazy_mode.h"
+#include "oneflow/core/common/env_var/env_var.h"
 
 namespace oneflow {
 
@@ -47,6 +48,12 @@ void CreateOpAttributeRef(Plan* plan, int64_t job_id, TaskProto* task_proto) {
   kernel_conf->set_allocated_op_attribute(nullptr);
 }
 
+int64_t GraphCompileThreadNum(int64_t work_num) {
+  int64_t thread_num = EnvInteger<ONEFLOW_GRAPH_COMPILE_THREAD_NUM>();
+  if (thread_num <= 0) { thread_num = std::thread::hardware_concurrency(); }
+  return std::max<int64_t>(std::min(thread_num, work_num), 1);
+}
+
 void Compiler::Compile(Job* job, Plan* plan) const {
   const auto& job_name = job->job_conf().job_name();
   auto compile_tc = std::make_unique<CostCounter<std::chrono::seconds>>(true, true);
@@ -63,9 +70,10 @@ void Compiler::Compile(Job* job, Plan* plan) const {
   task_gph->ForEachNode(std::bind(&TaskNode::ProduceAllRegstsAndBindEdges, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::ConsumeAllRegsts, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::PinConsumedRegst, _1));
-  task_gph->TopoForEachNode(&TaskNode::Build);
+  const int64_t build_thread_num = GraphCompileThreadNum(task_gph->node_num());
+  task_gph->ParallelTopoForEachNode(build_thread_num, &TaskNode::Build);
   task_gph->RemoveEmptyRegsts();
-  task_gph->TopoForEachNode(&TaskNode::InferTimeShapeIfMeaningful);
+  task_gph->ParallelTopoForEachNode(build_thread_num, &TaskNode::InferTimeShapeIfMeaningful);
   task_gph->DecideExecutionOrder();
   task_gph->MergeChainAndAddOrderingCtrlEdgeInSameChain();
   auto IsReachable = Singleton<OpGraph>::Get()->MakePredicatorIsOpNameDataOrCtrlReachable();
@@ -75,29 +83,36 @@ void Compiler::Compile(Job* job, Plan* plan) const {
 
   // Step3: put infomation from task_gph into plan.
   const int64_t node_num = task_gph->node_num();
-  const int64_t cpu_num = std::thread::hardware_concurrency();
-  const int64_t thread_pool_size = std::min(node_num, cpu_num);
-  BlockingCounter counter(node_num);
-  std::mutex mtx;
-  ThreadPool thread_pool(thread_pool_size);
-  task_gph->ForEachNode([&](TaskNode* task_node) {
-    thread_pool.AddWork([task_node, plan, &job_desc, &counter, &mtx]() {
-      if (!task_node->IsMeaningLess()) {
-        TaskProto task_proto;
-        task_node->ToProto(&task_proto);
-        {
-          std::unique_lock<std::mutex> guard(mtx);
-          if (task_node->GetTaskType() == kNormalForward || task_node->GetTaskType() == kRepeat
-              || task_node->GetTaskType() == kAcc) {
-            CreateOpAttributeRef(plan, job_desc.job_id(), &task_proto);
-          }
-          plan->mutable_task()->Add(std::move(task_proto));
-        }  // guard(mtx)
-      }
-      counter.Decrease();
-    } /* thread_pool.AddWork */);
-  } /* task_gph->ForEachNode */);
-  counter.WaitForeverUntilCntEqualZero();
+  std::vector<TaskNode*> task_nodes;
+  task_nodes.reserve(node_num);
+  task_gph->ForEachNode([&](TaskNode* task_node) { task_nodes.emplace_back(task_node); });
+  std::vector<std::unique_ptr<TaskProto>> task_protos(node_num);
+  {
+    BlockingCounter counter(node_num);
+    ThreadPool thread_pool(GraphCompileThreadNum(node_num));
+    FOR_RANGE(int64_t, i, 0, node_num) {
+      thread_pool.AddWork([i, &task_nodes, &task_protos, &counter]() {
+        TaskNode* task_node = task_nodes.at(i);
+        if (!task_node->IsMeaningLess()) {
+          task_protos.at(i).reset(new TaskProto());
+          task_node->ToProto(task_protos.at(i).get());
+        }
+        counter.Decrease();
+      } /* thread_pool.AddWork */);
+    }
+    counter.WaitForeverUntilCntEqualZero();
+  }
+  // NOTE: merge in the node order of task_gph rather than in the finishing order of the workers,
+  // so that both the task order and the op attribute picked for each op name are deterministic.
+  FOR_RANGE(int64_t, i, 0, node_num) {
+    if (!task_protos.at(i)) { continue; }
+    const TaskType task_type = task_nodes.at(i)->GetTaskType();
+    if (task_type == kNormalForward || task_type == kRepeat || task_type == kAcc) {
+      CreateOpAttributeRef(plan, job_desc.job_id(), task_protos.at(i).get());
+    }
+    plan->mutable_task()->Add(std::move(*task_protos.at(i)));
+    task_protos.at(i).reset();
+  }
   // NOTE(levi): release task_gph here to decrise memory peak.
   task_gph.reset();
   compile_tc->Count("[GraphCompile]" + job_name + " AddTaskToPlan", 1, true);
@@ -23,6 +23,10 @@ limitations under the License.
 
 namespace oneflow {
 
+// Number of threads for a compile stage with work_num independent works, bounded by
+// ONEFLOW_GRAPH_COMPILE_THREAD_NUM.
+int64_t GraphCompileThreadNum(int64_t work_num);
+
 class Compiler final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(Compiler);
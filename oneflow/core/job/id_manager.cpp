@@ -23,4 +23,18 @@ IDMgr::IDMgr() {
   chunk_id_count_ = 0;
 }
 
+void IDMgr::ToProto(IdStateProto* proto) const {
+  proto->set_regst_desc_id_count(regst_desc_id_count_);
+  proto->set_mem_block_id_count(mem_block_id_count_);
+  proto->set_chunk_id_count(chunk_id_count_);
+  task_id_gen_.ToProto(proto->mutable_task_id_generator());
+}
+
+void IDMgr::InitFromProto(const IdStateProto& proto) {
+  regst_desc_id_count_ = proto.regst_desc_id_count();
+  mem_block_id_count_ = proto.mem_block_id_count();
+  chunk_id_count_ = proto.chunk_id_count();
+  task_id_gen_.InitFromProto(proto.task_id_generator());
+}
+
 }  // namespace oneflow
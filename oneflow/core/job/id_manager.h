@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/graph/task_id_generator.h"
+#include "oneflow/core/job/id_state.pb.h"
 
 namespace oneflow {
 
@@ -35,6 +36,9 @@ class IDMgr final {
 
   TaskIdGenerator* GetTaskIdGenerator() { return &task_id_gen_; }
 
+  void ToProto(IdStateProto* proto) const;
+  void InitFromProto(const IdStateProto& proto);
+
  private:
   friend class Singleton<IDMgr>;
   IDMgr();
@@ -72,4 +72,28 @@ TEST(IDMgr, compile_regst_desc_id) {
   Delete();
 }
 
+TEST(IDMgr, id_state_proto) {
+  New();
+  const StreamId stream_id(0, DeviceType::kCPU, 0, 3);
+  auto* task_id_gen = Singleton<IDMgr>::Get()->GetTaskIdGenerator();
+  Singleton<IDMgr>::Get()->NewRegstDescId();
+  Singleton<IDMgr>::Get()->NewMemBlockId();
+  task_id_gen->Generate(stream_id);
+  IdStateProto id_state;
+  Singleton<IDMgr>::Get()->ToProto(&id_state);
+  const int64_t regst_desc_id = Singleton<IDMgr>::Get()->NewRegstDescId();
+  const int64_t mem_block_id = Singleton<IDMgr>::Get()->NewMemBlockId();
+  const int64_t chunk_id = Singleton<IDMgr>::Get()->NewChunkId();
+  const TaskId task_id = task_id_gen->Generate(stream_id);
+  Delete();
+
+  New();
+  Singleton<IDMgr>::Get()->InitFromProto(id_state);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewRegstDescId(), regst_desc_id);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewMemBlockId(), mem_block_id);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewChunkId(), chunk_id);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(stream_id), task_id);
+  Delete();
+}
+
 }  // namespace oneflow
@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/shape.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/job/compiler.h"
 #include "oneflow/core/job/id_manager.h"
 #include "oneflow/core/job/job_conf.pb.h"
 #include "oneflow/core/job/job_desc.h"
@@ -498,13 +499,29 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan) {
   // info for straighten
   HashMap<int64_t, size_t> mem_chain2peak_memory;
 
-  // step 1: generate regst alloc/free queue AND regst lifetimes
-  for (const auto& pair : mem_chain2mem_reused_regsts) {
-    GenRegstAllocFreeTimeLineAndRegstLifetimes(
-        mem_chain2sorted_tasks.at(pair.first), pair.second,
-        mem_chain2regst_desc_id2reuse_regst_desc.at(pair.first), mem_reused_regst2size,
-        &mem_chain2regst2lifetime[pair.first], &mem_chain2consumer2inplaced_regst[pair.first],
-        &mem_chain2peak_memory[pair.first]);
+  // step 1: multi-thread generate regst alloc/free queue AND regst lifetimes for each mem chain
+  {
+    // NOTE: insert all the entries ahead so that workers never rehash the shared maps.
+    for (int64_t mem_chain_id : mem_chains) {
+      mem_chain2regst2lifetime[mem_chain_id];
+      mem_chain2consumer2inplaced_regst[mem_chain_id];
+      mem_chain2peak_memory[mem_chain_id];
+    }
+    int64_t work_size = mem_chains.size();
+    BlockingCounter counter(work_size);
+    ThreadPool thread_pool(GraphCompileThreadNum(work_size));
+    for (int64_t mem_chain_id : mem_chains) {
+      thread_pool.AddWork([&, mem_chain_id]() {
+        GenRegstAllocFreeTimeLineAndRegstLifetimes(
+            mem_chain2sorted_tasks.at(mem_chain_id), mem_chain2mem_reused_regsts.at(mem_chain_id),
+            mem_chain2regst_desc_id2reuse_regst_desc.at(mem_chain_id), mem_reused_regst2size,
+            &mem_chain2regst2lifetime.at(mem_chain_id),
+            &mem_chain2consumer2inplaced_regst.at(mem_chain_id),
+            &mem_chain2peak_memory.at(mem_chain_id));
+        counter.Decrease();
+      });
+    }
+    counter.WaitForeverUntilCntEqualZero();
   }
 
   // step 2: multi-thread run several algorithm for each mem chain
@@ -512,9 +529,8 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan) {
       mem_chain2algo2result;
   {
     int64_t work_size = mem_chain2mem_reused_regsts.size() * CountMemAllocAlgoNum();
-    int64_t thread_pool_size = std::min<int64_t>(work_size, std::thread::hardware_concurrency());
     BlockingCounter counter(work_size);
-    ThreadPool thread_pool(thread_pool_size);
+    ThreadPool thread_pool(GraphCompileThreadNum(work_size));
     for (int64_t mem_chain_id : mem_chains) {
       InitAlgo2Result(&mem_chain2algo2result[mem_chain_id]);
       for (auto& pair : mem_chain2algo2result.at(mem_chain_id)) {
@@ -533,7 +549,8 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan) {
     counter.WaitForeverUntilCntEqualZero();
   }
 
-  // step 3: choose best one for each mem chain and set offset for inplace consumer regst
+  // step 3: choose best one for each mem chain
+  HashMap<int64_t, MemBlockResultInfo<RegstDescProto*>*> mem_chain2best_result;
   for (auto& pair : mem_chain2algo2result) {
     MemBlockResultInfo<RegstDescProto*>* best_result = nullptr;
     for (auto& algo_result_pair : pair.second) {
@@ -542,16 +559,34 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan) {
       }
     }
     CHECK(best_result != nullptr);
+    mem_chain2best_result.emplace(pair.first, best_result);
+  }
 
-    // Update the offset with a smaller total memory size if the current size is greater than the
-    // lower bound
-    if (GlobalJobDesc().job_conf().enable_compress_memory()) {
-      MemoryShareStrategy mss;
-      mss.AdaptivelyUpdateOffset(mem_reused_regst2size, mem_chain2regst2lifetime.at(pair.first),
-                                 mem_chain2peak_memory[pair.first], &best_result->mem_block_size,
-                                 &best_result->regst_desc2offset);
+  // step 4: multi-thread update the offset with a smaller total memory size if the current size is
+  // greater than the lower bound
+  if (GlobalJobDesc().job_conf().enable_compress_memory()) {
+    int64_t work_size = mem_chain2best_result.size();
+    BlockingCounter counter(work_size);
+    ThreadPool thread_pool(GraphCompileThreadNum(work_size));
+    for (const auto& pair : mem_chain2best_result) {
+      int64_t mem_chain_id = pair.first;
+      MemBlockResultInfo<RegstDescProto*>* best_result = pair.second;
+      thread_pool.AddWork([mem_chain_id, best_result, &mem_reused_regst2size,
+                           &mem_chain2regst2lifetime, &mem_chain2peak_memory, &counter]() {
+        MemoryShareStrategy mss;
+        mss.AdaptivelyUpdateOffset(mem_reused_regst2size, mem_chain2regst2lifetime.at(mem_chain_id),
+                                   mem_chain2peak_memory.at(mem_chain_id),
+                                   &best_result->mem_block_size, &best_result->regst_desc2offset);
+        counter.Decrease();
+      });
     }
+    counter.WaitForeverUntilCntEqualZero();
+  }
 
+  // step 5: set mem block id and offset for each mem chain and for inplace consumer regst.
+  // NOTE: mem block ids are allocated in the same order as before to keep the plan deterministic.
+  for (auto& pair : mem_chain2algo2result) {
+    MemBlockResultInfo<RegstDescProto*>* best_result = mem_chain2best_result.at(pair.first);
     int64_t mem_block_id = Singleton<IDMgr>::Get()->NewMemBlockId();
     CHECK_EQ(mem_chain2mem_reused_regsts.at(pair.first).size(),
              (best_result->regst_desc2offset.size()
@@ -0,0 +1,259 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/plan_cache.h"
+#include <cerrno>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/graph/task_stream_index_manager.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/plan_cache.pb.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/version.h"
+#include "oneflow/core/persistence/file_system.h"
+
+extern char** environ;
+
+namespace oneflow {
+
+namespace {
+
+constexpr char kPlanCacheDirEnvVar[] = "ONEFLOW_PLAN_CACHE_DIR";
+// bump it when the layout of cache files or the key changes
+constexpr char kMagicCode[] = "OFPLAN01";
+constexpr size_t kMagicCodeLen = sizeof(kMagicCode) - 1;
+constexpr size_t kHeaderSize = kMagicCodeLen + 2 * sizeof(uint64_t);
+
+// 64-bit FNV-1a, stable across builds and platforms unlike std::hash
+class Fnv1a64 final {
+ public:
+  Fnv1a64() : state_(14695981039346656037ULL) {}
+  ~Fnv1a64() = default;
+
+  void Update(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      state_ ^= static_cast<uint8_t>(data[i]);
+      state_ *= 1099511628211ULL;
+    }
+  }
+  // length-prefixed, so that consecutive fields can not be confused with each other
+  void UpdateField(const std::string& field) {
+    const uint64_t size = field.size();
+    Update(reinterpret_cast<const char*>(&size), sizeof(size));
+    Update(field.data(), field.size());
+  }
+  uint64_t Digest() const { return state_; }
+
+ private:
+  uint64_t state_;
+};
+
+uint64_t Checksum(const std::string& data) {
+  Fnv1a64 hash;
+  hash.Update(data.data(), data.size());
+  return hash.Digest();
+}
+
+// maps and repeated fields must serialize in a fixed order to be hashed
+std::string SerializeDeterministically(const PbMessage& msg) {
+  std::string serialized;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&serialized);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    CHECK(msg.SerializePartialToCodedStream(&coded_stream));
+  }
+  return serialized;
+}
+
+std::string GetFrameworkBuildId() {
+  std::string build_id = GetOneFlowGitVersion();
+  if (build_id != "N/A") { return build_id; }
+  // builds without version info are told apart by the library holding this code
+  Dl_info dl_info;
+  struct stat lib_stat;
+  if (dladdr(reinterpret_cast<void*>(&GetOneFlowGitVersion), &dl_info) != 0
+      && dl_info.dli_fname != nullptr && stat(dl_info.dli_fname, &lib_stat) == 0) {
+    build_id += std::string(":") + dl_info.dli_fname + ":" + std::to_string(lib_stat.st_size)
+                + ":" + std::to_string(lib_stat.st_mtime);
+  }
+  return build_id;
+}
+
+// ONEFLOW_* variables switch compiler and runtime features
+std::vector<std::string> GetOneFlowEnvVars() {
+  std::vector<std::string> env_vars;
+  const std::string prefix = "ONEFLOW_";
+  const std::string cache_dir_prefix = std::string(kPlanCacheDirEnvVar) + "=";
+  for (char** env = environ; env != nullptr && *env != nullptr; ++env) {
+    const std::string env_var(*env);
+    if (env_var.compare(0, prefix.size(), prefix) != 0) { continue; }
+    if (env_var.compare(0, cache_dir_prefix.size(), cache_dir_prefix) == 0) { continue; }
+    env_vars.emplace_back(env_var);
+  }
+  std::sort(env_vars.begin(), env_vars.end());
+  return env_vars;
+}
+
+std::string ToHexString(uint64_t value) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string hex(2 * sizeof(value), '0');
+  for (size_t i = hex.size(); i > 0; --i) {
+    hex[i - 1] = kHexDigits[value & 0xF];
+    value >>= 4;
+  }
+  return hex;
+}
+
+std::string MakeKey(const Job& job, int64_t job_id) {
+  Fnv1a64 hash;
+  hash.UpdateField(kMagicCode);
+  hash.UpdateField(GetFrameworkBuildId());
+  hash.UpdateField(SerializeDeterministically(job));
+  hash.UpdateField(std::to_string(job_id));
+  hash.UpdateField(
+      SerializeDeterministically(Singleton<ResourceDesc, ForSession>::Get()->resource()));
+  hash.UpdateField(std::to_string(GlobalProcessCtx::WorldSize()));
+  hash.UpdateField(std::to_string(GlobalProcessCtx::NodeSize()));
+  for (const std::string& env_var : GetOneFlowEnvVars()) { hash.UpdateField(env_var); }
+  IdStateProto id_state;
+  Singleton<IDMgr>::Get()->ToProto(&id_state);
+  hash.UpdateField(SerializeDeterministically(id_state));
+  TaskStreamIndexManagerProto task_stream_index_manager;
+  Singleton<TaskStreamIndexManager>::Get()->ToProto(&task_stream_index_manager);
+  hash.UpdateField(SerializeDeterministically(task_stream_index_manager));
+  return ToHexString(hash.Digest());
+}
+
+// Creates dir and its missing parents, like mkdir -p. Returns false with errno set on failure.
+bool CreateDirs(const std::string& dir) {
+  for (size_t pos = dir.find('/', 1);; pos = dir.find('/', pos + 1)) {
+    const std::string prefix = dir.substr(0, pos);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) { return false; }
+    if (pos == std::string::npos) { return true; }
+  }
+}
+
+// Returns false with errno set on failure.
+bool WriteFully(int fd, const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    const ssize_t n = write(fd, data.data() + offset, data.size() - offset);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return false;
+    }
+    offset += n;
+  }
+  return true;
+}
+
+}  // namespace
+
+PlanCache::PlanCache(const std::string& dir, const std::string& key)
+    : dir_(dir), key_(key), file_path_(JoinPath(dir, key + ".plan")) {}
+
+std::unique_ptr<PlanCache> PlanCache::New(const Job& job, int64_t job_id) {
+  const std::string dir = GetStringFromEnv(kPlanCacheDirEnvVar, "");
+  if (dir.empty()) { return nullptr; }
+  return std::unique_ptr<PlanCache>(new PlanCache(dir, MakeKey(job, job_id)));
+}
+
+bool PlanCache::TryLoad(Plan* plan) const {
+  fs::FileSystem* fs = LocalFS();
+  if (!fs->FileExists(file_path_)) { return false; }
+  const uint64_t file_size = fs->GetFileSize(file_path_);
+  if (file_size < kHeaderSize) {
+    LOG(WARNING) << "ignore truncated plan cache " << file_path_;
+    return false;
+  }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(file_path_, &file);
+  char header[kHeaderSize];
+  file->Read(0, kHeaderSize, header);
+  uint64_t payload_size = 0;
+  uint64_t checksum = 0;
+  std::memcpy(&payload_size, header + kMagicCodeLen, sizeof(uint64_t));
+  std::memcpy(&checksum, header + kMagicCodeLen + sizeof(uint64_t), sizeof(uint64_t));
+  if (std::memcmp(header, kMagicCode, kMagicCodeLen) != 0
+      || file_size != kHeaderSize + payload_size) {
+    LOG(WARNING) << "ignore invalid plan cache " << file_path_;
+    return false;
+  }
+  std::string payload(payload_size, '\0');
+  file->Read(kHeaderSize, payload_size, &payload[0]);
+  PlanCacheEntry entry;
+  if (Checksum(payload) != checksum || !entry.ParseFromString(payload) || entry.key() != key_) {
+    LOG(WARNING) << "ignore corrupted plan cache " << file_path_;
+    return false;
+  }
+  Singleton<IDMgr>::Get()->InitFromProto(entry.id_state());
+  Singleton<TaskStreamIndexManager>::Get()->InitFromProto(entry.task_stream_index_manager());
+  plan->Swap(entry.mutable_plan());
+  return true;
+}
+
+void PlanCache::Save(const Plan& plan) const {
+  PlanCacheEntry entry;
+  entry.set_key(key_);
+  Singleton<IDMgr>::Get()->ToProto(entry.mutable_id_state());
+  Singleton<TaskStreamIndexManager>::Get()->ToProto(entry.mutable_task_stream_index_manager());
+  *entry.mutable_plan() = plan;
+  std::string payload;
+  CHECK(entry.SerializeToString(&payload));
+  entry.Clear();
+  const uint64_t payload_size = payload.size();
+  const uint64_t checksum = Checksum(payload);
+
+  // failing to save only costs a recompilation next time, so it is not fatal
+  if (!CreateDirs(dir_)) {
+    PLOG(WARNING) << "can not create plan cache dir " << dir_;
+    return;
+  }
+  // processes sharing the cache directory may save the same entry, so write to a private file
+  // first and publish it by renaming
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+  const std::string tmp_file_path =
+      file_path_ + ".tmp." + hostname + "." + std::to_string(getpid());
+  const int fd = open(tmp_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    PLOG(WARNING) << "can not create plan cache " << tmp_file_path;
+    return;
+  }
+  std::string header(kMagicCode, kMagicCodeLen);
+  header.append(reinterpret_cast<const char*>(&payload_size), sizeof(uint64_t));
+  header.append(reinterpret_cast<const char*>(&checksum), sizeof(uint64_t));
+  if (!WriteFully(fd, header) || !WriteFully(fd, payload)) {
+    PLOG(WARNING) << "can not write plan cache " << tmp_file_path;
+    close(fd);
+    unlink(tmp_file_path.c_str());
+    return;
+  }
+  if (close(fd) != 0 || rename(tmp_file_path.c_str(), file_path_.c_str()) != 0) {
+    PLOG(WARNING) << "can not save plan cache " << file_path_;
+    unlink(tmp_file_path.c_str());
+  }
+}
+
+}  // namespace oneflow
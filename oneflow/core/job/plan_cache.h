@@ -0,0 +1,58 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_PLAN_CACHE_H_
+#define ONEFLOW_CORE_JOB_PLAN_CACHE_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/job/job.pb.h"
+#include "oneflow/core/job/plan.pb.h"
+
+namespace oneflow {
+
+// On-disk cache of compiled plans, enabled by setting ONEFLOW_PLAN_CACHE_DIR. An entry is keyed
+// by the job, its job id, the session resource, the process topology, the ONEFLOW_* environment,
+// the framework build and the state of the id generators before compiling, so a hit yields the
+// plan the compiler would have produced in this process.
+class PlanCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PlanCache);
+  ~PlanCache() = default;
+
+  // Returns nullptr if the plan cache is disabled.
+  // Must be called before compiling the job, since the key depends on the id generators.
+  static std::unique_ptr<PlanCache> New(const Job& job, int64_t job_id);
+
+  const std::string& key() const { return key_; }
+  const std::string& file_path() const { return file_path_; }
+
+  // Returns false if there is no valid entry. On a hit the id generators are advanced as if the
+  // plan had been compiled by this process.
+  bool TryLoad(Plan* plan) const;
+  // Must be called right after compiling the plan, before any other compilation. Failing to
+  // write the entry only logs a warning.
+  void Save(const Plan& plan) const;
+
+ private:
+  PlanCache(const std::string& dir, const std::string& key);
+
+  std::string dir_;
+  std::string key_;
+  std::string file_path_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_PLAN_CACHE_H_
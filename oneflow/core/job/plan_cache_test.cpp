@@ -0,0 +1,192 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include <unistd.h>
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/graph/task_stream_index_manager.h"
+#include "oneflow/core/job/env_desc.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/plan_cache.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+class PlanCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/oneflow_plan_cache_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+    setenv("ONEFLOW_PLAN_CACHE_DIR", dir_.c_str(), 1);
+    EnvProto env_proto;
+    auto* machine = env_proto.add_machine();
+    machine->set_id(0);
+    machine->set_addr("127.0.0.1");
+    env_proto.set_ctrl_port(9527);
+    Singleton<EnvDesc>::New(env_proto);
+    Singleton<ProcessCtx>::New();
+    Singleton<ProcessCtx>::Get()->mutable_ctrl_addr()->Add();
+    Singleton<ProcessCtx>::Get()->set_rank(0);
+    Singleton<ProcessCtx>::Get()->set_node_size(1);
+    Resource resource;
+    resource.set_machine_num(1);
+    resource.set_cpu_device_num(1);
+    Singleton<ResourceDesc, ForSession>::New(resource, GlobalProcessCtx::NumOfProcessPerNode());
+    NewIdGenerators();
+  }
+
+  void TearDown() override {
+    DeleteIdGenerators();
+    Singleton<ResourceDesc, ForSession>::Delete();
+    Singleton<ProcessCtx>::Delete();
+    Singleton<EnvDesc>::Delete();
+    unsetenv("ONEFLOW_PLAN_CACHE_DIR");
+    LocalFS()->RecursivelyDeleteDir(dir_);
+  }
+
+  void NewIdGenerators() {
+    Singleton<IDMgr>::New();
+    Singleton<TaskStreamIndexManager>::New();
+  }
+
+  void DeleteIdGenerators() {
+    Singleton<TaskStreamIndexManager>::Delete();
+    Singleton<IDMgr>::Delete();
+  }
+
+  // simulates compiling a plan with a few tasks
+  Plan CompileFakePlan() {
+    const DeviceId device_id(0, DeviceType::kCPU, 0);
+    StreamIndexGenerator* generator =
+        Singleton<TaskStreamIndexManager>::Get()->GetGenerator(device_id);
+    Plan plan;
+    for (const char* stream_name : {"compute", "copy", "compute"}) {
+      const StreamId stream_id(device_id, generator->GenerateNamed(stream_name));
+      const TaskId task_id = Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(stream_id);
+      TaskProto* task = plan.add_task();
+      task->set_task_id(EncodeTaskIdToInt64(task_id));
+      task->set_job_id(0);
+      task->set_machine_id(0);
+      task->set_thrd_id(EncodeStreamIdToInt64(stream_id));
+      task->set_task_type(kNormalForward);
+      task->mutable_exec_sequence();
+      task->set_chain_id(0);
+      task->set_order_in_chain(plan.task_size() - 1);
+      Singleton<IDMgr>::Get()->NewRegstDescId();
+      Singleton<IDMgr>::Get()->NewMemBlockId();
+    }
+    plan.mutable_block_chunk_list();
+    plan.mutable_job_confs();
+    plan.mutable_collective_boxing_plan();
+    plan.mutable_ctrl_regst_desc_info();
+    return plan;
+  }
+
+  Job MakeJob(const std::string& job_name) {
+    Job job;
+    job.mutable_job_conf()->set_job_name(job_name);
+    return job;
+  }
+
+  std::string dir_;
+};
+
+}  // namespace
+
+TEST_F(PlanCacheTest, miss_then_hit) {
+  const Job job = MakeJob("graph_0");
+  std::unique_ptr<PlanCache> plan_cache = PlanCache::New(job, 0);
+  ASSERT_NE(plan_cache, nullptr);
+  Plan plan;
+  ASSERT_FALSE(plan_cache->TryLoad(&plan));
+  const Plan compiled_plan = CompileFakePlan();
+  plan_cache->Save(compiled_plan);
+  const int64_t next_regst_desc_id = Singleton<IDMgr>::Get()->NewRegstDescId();
+  const int64_t next_stream_index =
+      Singleton<TaskStreamIndexManager>::Get()
+          ->GetGenerator(DeviceId(0, DeviceType::kCPU, 0))
+          ->GenerateAnonymous();
+
+  // a restarted process
+  DeleteIdGenerators();
+  NewIdGenerators();
+  plan_cache = PlanCache::New(job, 0);
+  ASSERT_TRUE(plan_cache->TryLoad(&plan));
+  ASSERT_EQ(plan.SerializeAsString(), compiled_plan.SerializeAsString());
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewRegstDescId(), next_regst_desc_id);
+  ASSERT_EQ(Singleton<TaskStreamIndexManager>::Get()
+                ->GetGenerator(DeviceId(0, DeviceType::kCPU, 0))
+                ->GenerateAnonymous(),
+            next_stream_index);
+}
+
+TEST_F(PlanCacheTest, key) {
+  const std::string key = PlanCache::New(MakeJob("graph_0"), 0)->key();
+  ASSERT_EQ(PlanCache::New(MakeJob("graph_0"), 0)->key(), key);
+  ASSERT_NE(PlanCache::New(MakeJob("graph_1"), 0)->key(), key);
+  ASSERT_NE(PlanCache::New(MakeJob("graph_0"), 1)->key(), key);
+  setenv("ONEFLOW_PLAN_CACHE_TEST_FLAG", "1", 1);
+  ASSERT_NE(PlanCache::New(MakeJob("graph_0"), 0)->key(), key);
+  unsetenv("ONEFLOW_PLAN_CACHE_TEST_FLAG");
+  // plans compiled after another one get different ids
+  CompileFakePlan();
+  ASSERT_NE(PlanCache::New(MakeJob("graph_0"), 0)->key(), key);
+}
+
+TEST_F(PlanCacheTest, reject_corrupted_entry) {
+  const Job job = MakeJob("graph_0");
+  std::unique_ptr<PlanCache> plan_cache = PlanCache::New(job, 0);
+  plan_cache->Save(CompileFakePlan());
+  DeleteIdGenerators();
+  NewIdGenerators();
+  plan_cache = PlanCache::New(job, 0);
+  FILE* file = fopen(plan_cache->file_path().c_str(), "r+b");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(fseek(file, -1, SEEK_END), 0);
+  const int last_byte = fgetc(file);
+  ASSERT_EQ(fseek(file, -1, SEEK_END), 0);
+  fputc(last_byte ^ 0x1, file);
+  fclose(file);
+  Plan plan;
+  ASSERT_FALSE(plan_cache->TryLoad(&plan));
+  ASSERT_EQ(plan.task_size(), 0);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewRegstDescId(), 0);
+}
+
+TEST_F(PlanCacheTest, save_failure_is_not_fatal) {
+  // the cache dir can not be created under a regular file
+  const std::string file_path = dir_ + "/file";
+  FILE* file = fopen(file_path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  fclose(file);
+  setenv("ONEFLOW_PLAN_CACHE_DIR", (file_path + "/cache").c_str(), 1);
+  const Job job = MakeJob("graph_0");
+  std::unique_ptr<PlanCache> plan_cache = PlanCache::New(job, 0);
+  plan_cache->Save(CompileFakePlan());
+  Plan plan;
+  ASSERT_FALSE(plan_cache->TryLoad(&plan));
+}
+
+TEST_F(PlanCacheTest, disabled) {
+  unsetenv("ONEFLOW_PLAN_CACHE_DIR");
+  ASSERT_EQ(PlanCache::New(MakeJob("graph_0"), 0), nullptr);
+}
+
+}  // namespace oneflow
@@ -17,26 +17,276 @@ limitations under the License.
 #include "oneflow/core/common/preprocessor.h"
 #include "oneflow/core/ndarray/ndarray_reduce_impl.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
-#define SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(struct_name)                                        \
-  template<typename T, template<typename> class binary_func>                                   \
-  struct struct_name<DeviceType::kCPU, T, binary_func> final {                                 \
-    using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;                        \
-    static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {       \
-      return false;                                                                            \
-    }                                                                                          \
-    static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,                       \
-                       const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) { \
-      UNIMPLEMENTED();                                                                         \
-    }                                                                                          \
+namespace {
+
+template<typename T>
+struct IsStdComplex : std::false_type {};
+template<typename U>
+struct IsStdComplex<std::complex<U>> : std::true_type {};
+
+// Number of independent accumulators of the innermost loops. They carry no dependency on each
+// other, so the compiler keeps them in vector registers.
+constexpr int64_t kReduceLanes = 8;
+// Contiguous runs up to this length are reduced directly, longer ones are split in halves.
+constexpr int64_t kPairwiseBlockSize = 128;
+// Elements handled by one parallel work item.
+constexpr int64_t kReduceGrainSize = 32768;
+// Columns handled by one work item of a column reduction.
+constexpr int64_t kColReduceTileSize = 256;
+constexpr int64_t kMaxNumPartials = 64;
+
+int64_t CeilDiv(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+template<typename T, template<typename> class binary_func>
+inline T Combine(T a, T b) {
+  return static_cast<T>(binary_func<T>::Invoke(a, b));
+}
+
+// Pairwise reduction of n contiguous elements: rounding errors of floating point sums grow with
+// log(n) instead of n, at no cost over a plain loop.
+template<typename T, template<typename> class binary_func>
+T ReduceContiguous(const T* x, int64_t n) {
+  if (n > kPairwiseBlockSize) {
+    const int64_t half = CeilDiv(n / 2, kReduceLanes) * kReduceLanes;
+    return Combine<T, binary_func>(ReduceContiguous<T, binary_func>(x, half),
+                                   ReduceContiguous<T, binary_func>(x + half, n - half));
+  }
+  T acc[kReduceLanes];
+  for (int64_t l = 0; l < kReduceLanes; ++l) { acc[l] = UnitOfBinaryFunc<T, binary_func>::Val(); }
+  int64_t i = 0;
+  for (; i + kReduceLanes <= n; i += kReduceLanes) {
+    for (int64_t l = 0; l < kReduceLanes; ++l) {
+      acc[l] = Combine<T, binary_func>(acc[l], x[i + l]);
+    }
+  }
+  for (; i < n; ++i) { acc[0] = Combine<T, binary_func>(acc[0], x[i]); }
+  for (int64_t width = kReduceLanes / 2; width > 0; width /= 2) {
+    for (int64_t l = 0; l < width; ++l) {
+      acc[l] = Combine<T, binary_func>(acc[l], acc[l + width]);
+    }
+  }
+  return acc[0];
+}
+
+// Splits x into fixed-size pieces, so the result does not depend on the number of threads.
+template<typename T, template<typename> class binary_func>
+T ParallelReduceContiguous(ep::CpuStream* stream, const T* x, int64_t n) {
+  const int64_t num_pieces = CeilDiv(n, kReduceGrainSize);
+  if (num_pieces <= 1) { return ReduceContiguous<T, binary_func>(x, n); }
+  std::unique_ptr<T[]> partials(new T[num_pieces]);
+  stream->ParallelFor(
+      0, num_pieces,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t offset = i * kReduceGrainSize;
+          partials[i] = ReduceContiguous<T, binary_func>(
+              x + offset, std::min(kReduceGrainSize, n - offset));
+        }
+      },
+      1);
+  return ReduceContiguous<T, binary_func>(partials.get(), num_pieces);
+}
+
+// acc[0, num_cols) = reduce(acc, x[row_begin, row_end) x [0, num_cols)), x has row stride ld.
+// Vectorized along the columns.
+template<typename T, template<typename> class binary_func>
+void AccumulateRows(const T* x, int64_t ld, int64_t row_begin, int64_t row_end, int64_t num_cols,
+                    T* acc) {
+  for (int64_t row = row_begin; row < row_end; ++row) {
+    const T* x_row = x + row * ld;
+    for (int64_t col = 0; col < num_cols; ++col) {
+      acc[col] = Combine<T, binary_func>(acc[col], x_row[col]);
+    }
+  }
+}
+
+// y[c] = reduce over r of x[r * num_cols + c]. The matrix is cut into row chunks and column tiles
+// of about kReduceGrainSize elements; row chunks write partial rows that are reduced afterwards.
+template<typename T, template<typename> class binary_func, typename RetT>
+void ReduceMatrixCols(ep::CpuStream* stream, const T* x, int64_t num_rows, int64_t num_cols,
+                      RetT* y) {
+  const int64_t tile_size = std::min(num_cols, kColReduceTileSize);
+  const int64_t num_tiles = CeilDiv(num_cols, tile_size);
+  const int64_t num_row_chunks = std::max<int64_t>(
+      1, std::min({CeilDiv(num_rows * num_cols, kReduceGrainSize) / num_tiles, num_rows,
+                   kMaxNumPartials}));
+  const int64_t rows_per_chunk = CeilDiv(num_rows, num_row_chunks);
+  std::unique_ptr<T[]> partials(new T[num_row_chunks * num_cols]);
+  stream->ParallelFor(
+      0, num_row_chunks * num_tiles,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t chunk = i / num_tiles;
+          const int64_t col_begin = (i % num_tiles) * tile_size;
+          const int64_t tile_cols = std::min(tile_size, num_cols - col_begin);
+          T* acc = partials.get() + chunk * num_cols + col_begin;
+          std::fill(acc, acc + tile_cols, UnitOfBinaryFunc<T, binary_func>::Val());
+          AccumulateRows<T, binary_func>(x + col_begin, num_cols, chunk * rows_per_chunk,
+                                         std::min(num_rows, (chunk + 1) * rows_per_chunk),
+                                         tile_cols, acc);
+        }
+      },
+      1);
+  stream->ParallelFor(
+      0, num_tiles,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t tile = begin; tile < end; ++tile) {
+          const int64_t col_begin = tile * tile_size;
+          const int64_t tile_cols = std::min(tile_size, num_cols - col_begin);
+          T* acc = partials.get() + col_begin;
+          AccumulateRows<T, binary_func>(acc, num_cols, 1, num_row_chunks, tile_cols, acc);
+          for (int64_t col = 0; col < tile_cols; ++col) {
+            y[col_begin + col] = static_cast<RetT>(acc[col]);
+          }
+        }
+      },
+      1);
+}
+
+// An empty x reduces to the unit of binary_func. Returns whether x was empty, so that the fast
+// paths below never divide by one of its zero dimensions.
+template<typename T, template<typename> class binary_func, typename RetT>
+bool ReduceEmpty(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+  if (x.shape().ElemNum() != 0) { return false; }
+  std::fill(y.ptr(), y.ptr() + y.shape().ElemNum(),
+            static_cast<RetT>(UnitOfBinaryFunc<T, binary_func>::Val()));
+  return true;
+}
+
+}  // namespace
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayScalarReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static constexpr bool kEnabled = !IsStdComplex<T>::value;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    return kEnabled && y.shape().ElemNum() == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    if constexpr (kEnabled) {
+      if (ReduceEmpty<T, binary_func>(y, x)) { return; }
+      *y.ptr() = static_cast<RetT>(ParallelReduceContiguous<T, binary_func>(
+          stream->As<ep::CpuStream>(), x.ptr(), x.shape().ElemNum()));
+    }
   }
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayScalarReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixRowReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixColReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeXZReduce);
-#undef SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixRowReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static constexpr bool kEnabled = !IsStdComplex<T>::value;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!kEnabled) { return false; }
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    if constexpr (kEnabled) {
+      if (ReduceEmpty<T, binary_func>(y, x)) { return; }
+      auto* cpu_stream = stream->As<ep::CpuStream>();
+      const int64_t num_rows = x.shape().At(0);
+      const int64_t num_cols = x.shape().At(1);
+      const T* x_ptr = x.ptr();
+      RetT* y_ptr = y.ptr();
+      if (num_cols >= kReduceGrainSize) {
+        // Few long rows: parallelize inside each row.
+        FOR_RANGE(int64_t, row, 0, num_rows) {
+          y_ptr[row] = static_cast<RetT>(ParallelReduceContiguous<T, binary_func>(
+              cpu_stream, x_ptr + row * num_cols, num_cols));
+        }
+        return;
+      }
+      cpu_stream->ParallelFor(
+          0, num_rows,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t row = begin; row < end; ++row) {
+              y_ptr[row] = static_cast<RetT>(
+                  ReduceContiguous<T, binary_func>(x_ptr + row * num_cols, num_cols));
+            }
+          },
+          std::max<int64_t>(1, kReduceGrainSize / num_cols));
+    }
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixColReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static constexpr bool kEnabled = !IsStdComplex<T>::value;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!kEnabled) { return false; }
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1);
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    if constexpr (kEnabled) {
+      if (ReduceEmpty<T, binary_func>(y, x)) { return; }
+      ReduceMatrixCols<T, binary_func, RetT>(stream->As<ep::CpuStream>(), x.ptr(),
+                                             x.shape().At(0), x.shape().At(1), y.ptr());
+    }
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeXZReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static constexpr bool kEnabled = !IsStdComplex<T>::value;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (!kEnabled) { return false; }
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1) && y.shape().At(2) == 1;
+  }
+
+  // Reduces every z-row into tmp_storage, which then holds an X x Y matrix whose columns are
+  // reduced like NdarrayMatrixColReduce.
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    if constexpr (kEnabled) {
+      if (ReduceEmpty<T, binary_func>(y, x)) { return; }
+      auto* cpu_stream = stream->As<ep::CpuStream>();
+      const int64_t dim_x = x.shape().At(0);
+      const int64_t dim_y = x.shape().At(1);
+      const int64_t dim_z = x.shape().At(2);
+      const int64_t num_segments = dim_x * dim_y;
+      CHECK_GE(tmp_storage.shape().ElemNum(), num_segments);
+      const T* x_ptr = x.ptr();
+      T* partials = tmp_storage.ptr();
+      if (dim_z >= kReduceGrainSize) {
+        FOR_RANGE(int64_t, i, 0, num_segments) {
+          partials[i] =
+              ParallelReduceContiguous<T, binary_func>(cpu_stream, x_ptr + i * dim_z, dim_z);
+        }
+      } else {
+        cpu_stream->ParallelFor(
+            0, num_segments,
+            [&](int64_t begin, int64_t end) {
+              for (int64_t i = begin; i < end; ++i) {
+                partials[i] = ReduceContiguous<T, binary_func>(x_ptr + i * dim_z, dim_z);
+              }
+            },
+            std::max<int64_t>(1, kReduceGrainSize / dim_z));
+      }
+      ReduceMatrixCols<T, binary_func, RetT>(cpu_stream, partials, dim_x, dim_y, y.ptr());
+    }
+  }
+};
 
 #define INSTANTIATE_NDARRAY_REDUCE_IMPL(dtype, binary_func)                                       \
   template struct NdarrayScalarReduce<DeviceType::kCPU, OF_PP_PAIR_FIRST(dtype), binary_func>;    \
@@ -0,0 +1,103 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <random>
+#include "oneflow/core/ndarray/ndarray_util.h"
+#include "oneflow/core/ep/include/device_manager_registry.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// Reduces x of x_shape to y_shape with ReduceSum and ReduceMax and checks against a naive loop.
+void TestReduce(const Shape& x_shape, const Shape& y_shape) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+
+  const int64_t x_elem_cnt = x_shape.elem_cnt();
+  const int64_t y_elem_cnt = y_shape.elem_cnt();
+  std::vector<float> x(x_elem_cnt);
+  std::mt19937 g(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  for (auto& v : x) { v = dist(g); }
+  std::vector<double> expect_sum(y_elem_cnt, 0);
+  std::vector<float> expect_max(y_elem_cnt, GetMinVal<float>());
+  const int64_t num_axes = x_shape.NumAxes();
+  FOR_RANGE(int64_t, i, 0, x_elem_cnt) {
+    int64_t remaining = i;
+    int64_t y_index = 0;
+    int64_t y_stride = 1;
+    for (int64_t axis = num_axes - 1; axis >= 0; --axis) {
+      const int64_t coord = remaining % x_shape.At(axis);
+      remaining /= x_shape.At(axis);
+      if (y_shape.At(axis) != 1) { y_index += coord * y_stride; }
+      y_stride *= y_shape.At(axis);
+    }
+    expect_sum[y_index] += x[i];
+    expect_max[y_index] = std::max(expect_max[y_index], x[i]);
+  }
+
+  std::vector<float> y(y_elem_cnt);
+  std::vector<float> tmp(x_elem_cnt);
+  XpuVarNdarray<float> y_ndarray(y_shape, y.data());
+  XpuVarNdarray<const float> x_ndarray(x_shape, x.data());
+  XpuVarNdarray<float> tmp_ndarray(x_shape, tmp.data());
+  NdarrayUtil<DeviceType::kCPU, float>::ReduceSum(stream, y_ndarray, x_ndarray, tmp_ndarray);
+  FOR_RANGE(int64_t, i, 0, y_elem_cnt) { ASSERT_NEAR(y[i], expect_sum[i], 1e-3) << i; }
+  NdarrayUtil<DeviceType::kCPU, float>::ReduceMax(stream, y_ndarray, x_ndarray, tmp_ndarray);
+  FOR_RANGE(int64_t, i, 0, y_elem_cnt) { ASSERT_EQ(y[i], expect_max[i]) << i; }
+  device->DestroyStream(stream);
+}
+
+}  // namespace
+
+TEST(NdarrayReduce, cpu_scalar) {
+  TestReduce(Shape{1LL, 100000LL}, Shape{1LL, 1LL});
+  TestReduce(Shape{300LL, 7LL}, Shape{1LL, 1LL});
+}
+
+TEST(NdarrayReduce, cpu_row) {
+  TestReduce(Shape{64LL, 1000LL}, Shape{64LL, 1LL});
+  TestReduce(Shape{3LL, 70000LL}, Shape{3LL, 1LL});
+}
+
+TEST(NdarrayReduce, cpu_col) {
+  TestReduce(Shape{1000LL, 3LL}, Shape{1LL, 3LL});
+  TestReduce(Shape{37LL, 1000LL}, Shape{1LL, 1000LL});
+}
+
+TEST(NdarrayReduce, cpu_xz) {
+  TestReduce(Shape{16LL, 32LL, 49LL}, Shape{1LL, 32LL, 1LL});
+  TestReduce(Shape{2LL, 3LL, 40000LL}, Shape{1LL, 3LL, 1LL});
+}
+
+TEST(NdarrayReduce, cpu_empty) {
+  TestReduce(Shape{0LL, 100LL}, Shape{1LL, 1LL});
+  TestReduce(Shape{64LL, 0LL}, Shape{64LL, 1LL});
+  TestReduce(Shape{0LL, 3LL}, Shape{1LL, 3LL});
+  TestReduce(Shape{3LL, 0LL}, Shape{1LL, 0LL});
+  TestReduce(Shape{2LL, 3LL, 0LL}, Shape{1LL, 3LL, 1LL});
+  TestReduce(Shape{0LL, 3LL, 5LL}, Shape{1LL, 3LL, 1LL});
+  TestReduce(Shape{2LL, 0LL, 5LL}, Shape{1LL, 0LL, 1LL});
+}
+
+}  // namespace test
+
+}  // namespace oneflow
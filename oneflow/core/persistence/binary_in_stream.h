@@ -34,6 +34,14 @@ class BinaryInStream {
   virtual void set_cur_file_pos(uint64_t val) = 0;
   virtual bool IsEof() const = 0;
 
+  // Memory-mapped streams return the address of the byte at cur_file_pos(), others nullptr.
+  virtual const char* mapped_cur_ptr() const { return nullptr; }
+  // Like Read, but hands out the next n bytes in place, only for memory-mapped streams.
+  virtual const char* ReadInPlace(size_t n) {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+
  protected:
   BinaryInStream() = default;
 };
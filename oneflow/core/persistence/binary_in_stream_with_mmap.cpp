@@ -0,0 +1,86 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/binary_in_stream_with_mmap.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+BinaryInStreamWithMmap::BinaryInStreamWithMmap(fs::FileSystem* fs, const std::string& file_path,
+                                               uint64_t readahead_size)
+    : mapped_(nullptr), cur_file_pos_(0), readahead_size_(readahead_size), readahead_end_(0) {
+  const std::string translated_path = fs->TranslateName(file_path);
+  int fd = open(translated_path.c_str(), O_RDONLY);
+  PCHECK(fd >= 0) << "Fail to open file " << file_path;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0) << "Fail to stat file " << file_path;
+  file_size_ = st.st_size;
+  // mmap doesn't accept an empty mapping
+  if (file_size_ > 0) {
+    void* ptr = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd, 0);
+    PCHECK(ptr != MAP_FAILED) << "Fail to map file " << file_path;
+    mapped_ = static_cast<const char*>(ptr);
+    // only a hint, the mapping is still usable if the kernel refuses it
+    if (madvise(ptr, file_size_, MADV_SEQUENTIAL) != 0) {
+      PLOG(WARNING) << "Fail to advise sequential access to file " << file_path;
+    }
+  }
+  PCHECK(close(fd) == 0);
+}
+
+BinaryInStreamWithMmap::~BinaryInStreamWithMmap() {
+  if (mapped_ != nullptr) { PCHECK(munmap(const_cast<char*>(mapped_), file_size_) == 0); }
+}
+
+int32_t BinaryInStreamWithMmap::Read(char* s, size_t n) {
+  if (IsEof()) { return -1; }
+  std::memcpy(s, ReadInPlace(n), n);
+  return 0;
+}
+
+const char* BinaryInStreamWithMmap::ReadInPlace(size_t n) {
+  CHECK_LE(cur_file_pos_ + n, file_size_);
+  Readahead(cur_file_pos_ + n);
+  const char* ptr = mapped_cur_ptr();
+  cur_file_pos_ += n;
+  return ptr;
+}
+
+void BinaryInStreamWithMmap::set_cur_file_pos(uint64_t val) {
+  CHECK_LE(val, file_size_);
+  // a jump backward or beyond the readahead window starts a new window
+  if (val < cur_file_pos_ || val > readahead_end_) { readahead_end_ = val; }
+  cur_file_pos_ = val;
+}
+
+void BinaryInStreamWithMmap::Readahead(uint64_t end) {
+  if (readahead_size_ == 0 || end + readahead_size_ / 2 <= readahead_end_) { return; }
+  static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t begin = std::max(readahead_end_, cur_file_pos_) / page_size * page_size;
+  readahead_end_ = std::min(end + readahead_size_, file_size_);
+  if (begin >= readahead_end_) { return; }
+  // only a hint, nothing to do if the kernel refuses it
+  madvise(const_cast<char*>(mapped_) + begin, readahead_end_ - begin, MADV_WILLNEED);
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
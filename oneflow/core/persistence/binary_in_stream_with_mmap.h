@@ -0,0 +1,62 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_BINARY_IN_STREAM_WITH_MMAP_H_
+#define ONEFLOW_CORE_PERSISTENCE_BINARY_IN_STREAM_WITH_MMAP_H_
+
+#include "oneflow/core/persistence/binary_in_stream.h"
+#include "oneflow/core/persistence/file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// Maps a local file into memory so that its bytes can be handed out in place. The kernel is
+// told that the file is read sequentially, and the next readahead_size bytes after every read
+// are requested in advance. The file must not be truncated while it is mapped, touching the
+// pages past the new end raises SIGBUS.
+class BinaryInStreamWithMmap final : public BinaryInStream {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(BinaryInStreamWithMmap);
+  BinaryInStreamWithMmap() = delete;
+  ~BinaryInStreamWithMmap() override;
+
+  BinaryInStreamWithMmap(fs::FileSystem* fs, const std::string& file_path,
+                         uint64_t readahead_size);
+
+  int32_t Read(char* s, size_t n) override;
+  const char* ReadInPlace(size_t n) override;
+
+  uint64_t file_size() const override { return file_size_; }
+  uint64_t cur_file_pos() const override { return cur_file_pos_; }
+  void set_cur_file_pos(uint64_t val) override;
+  bool IsEof() const override { return cur_file_pos_ == file_size_; }
+  const char* mapped_cur_ptr() const override { return mapped_ + cur_file_pos_; }
+
+ private:
+  void Readahead(uint64_t end);
+
+  const char* mapped_;
+  uint64_t file_size_;
+  uint64_t cur_file_pos_;
+  uint64_t readahead_size_;
+  uint64_t readahead_end_;
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_BINARY_IN_STREAM_WITH_MMAP_H_
@@ -16,6 +16,9 @@ limitations under the License.
 #include "oneflow/core/persistence/persistent_in_stream.h"
 #include "oneflow/core/persistence/binary_in_stream_with_local_copy.h"
 #include "oneflow/core/persistence/binary_in_stream_without_local_copy.h"
+#include "oneflow/core/persistence/binary_in_stream_with_mmap.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/core/common/env_var/data.h"
 #include "oneflow/core/job/job_set.pb.h"
 #include <cstring>
 #include "oneflow/core/common/constant.h"
@@ -41,6 +44,15 @@ size_t GetBufferSize() {
   return kDefaultBufferSize;
 }
 
+bool UseMmap(fs::FileSystem* fs, bool with_local_copy) {
+#ifdef OF_PLATFORM_POSIX
+  return !with_local_copy && EnvBool<ONEFLOW_PERSISTENT_IN_STREAM_USE_MMAP>()
+         && dynamic_cast<fs::PosixFileSystem*>(fs) != nullptr;
+#else
+  return false;
+#endif  // OF_PLATFORM_POSIX
+}
+
 }  // namespace
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -52,10 +64,16 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
                                        const std::vector<std::string>& file_paths, uint64_t offset,
                                        bool cyclic, bool with_local_copy) {
   if (with_local_copy) { CHECK_EQ(offset, 0); }
+  use_mmap_ = UseMmap(fs, with_local_copy);
+  mmap_window_size_ = EnvInteger<ONEFLOW_PERSISTENT_IN_STREAM_MMAP_READAHEAD_BYTES>();
   std::vector<std::shared_ptr<BinaryInStream>> streams;
   for (auto& file_path : file_paths) {
     if (with_local_copy) {
       streams.emplace_back(new BinaryInStreamWithLocalCopy(fs, file_path));
+    } else if (use_mmap_) {
+#ifdef OF_PLATFORM_POSIX
+      streams.emplace_back(new BinaryInStreamWithMmap(fs, file_path, mmap_window_size_));
+#endif  // OF_PLATFORM_POSIX
     } else {
       streams.emplace_back(new BinaryInStreamWithoutLocalCopy(fs, file_path));
     }
@@ -65,10 +83,15 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
   } else {
     stream_scanner_.reset(new AcyclicStreamScanner(fs, streams, offset));
   }
-  buffer_.resize(GetBufferSize() + 1);
-  cur_buf_begin_ = buffer_.data();
-  cur_buf_end_ = buffer_.data();
-  *cur_buf_end_ = '\0';
+  if (use_mmap_) {
+    CHECK_GT(mmap_window_size_, 0);
+    cur_buf_begin_ = nullptr;
+    cur_buf_end_ = nullptr;
+  } else {
+    buffer_.resize(GetBufferSize() + 1);
+    cur_buf_begin_ = buffer_.data();
+    cur_buf_end_ = buffer_.data();
+  }
 }
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -95,19 +118,22 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
 int32_t PersistentInStream::ReadLine(std::string* l) {
   if (IsEof()) { return -1; }
   l->clear();
-  while (*cur_buf_begin_ != '\n') {
+  while (true) {
     if (cur_buf_begin_ == cur_buf_end_) {
       UpdateBuffer();
-      if (cur_buf_begin_ == cur_buf_end_) {
-        return 0;
-      } else {
-        continue;
-      }
+      if (cur_buf_begin_ == cur_buf_end_) { return 0; }
+    }
+    const char* line_end = static_cast<const char*>(
+        std::memchr(cur_buf_begin_, '\n', cur_buf_end_ - cur_buf_begin_));
+    if (line_end == nullptr) {
+      l->append(cur_buf_begin_, cur_buf_end_);
+      cur_buf_begin_ = cur_buf_end_;
+    } else {
+      l->append(cur_buf_begin_, line_end);
+      cur_buf_begin_ = line_end + 1;
+      return 0;
     }
-    l->push_back(*cur_buf_begin_++);
   }
-  ++cur_buf_begin_;
-  return 0;
 }
 
 int32_t PersistentInStream::ReadFully(char* s, size_t n) {
@@ -124,12 +150,46 @@ int32_t PersistentInStream::ReadFully(char* s, size_t n) {
   return 0;
 }
 
+int32_t PersistentInStream::ReadView(size_t n, const char** view) {
+  if (IsEof()) { return -1; }
+  if (use_mmap_ && static_cast<size_t>(cur_buf_end_ - cur_buf_begin_) < n) {
+    if (cur_buf_begin_ == cur_buf_end_) { UpdateBuffer(); }
+    TryExtendMappedWindow(n);
+  }
+  if (static_cast<size_t>(cur_buf_end_ - cur_buf_begin_) >= n) {
+    *view = cur_buf_begin_;
+    cur_buf_begin_ += n;
+    return 0;
+  }
+  view_buffer_.resize(n);
+  CHECK_EQ(ReadFully(view_buffer_.data(), n), 0);
+  *view = view_buffer_.data();
+  return 0;
+}
+
+bool PersistentInStream::TryExtendMappedWindow(size_t n) {
+  const uint64_t window_size = cur_buf_end_ - cur_buf_begin_;
+  if (window_size >= n) { return true; }
+  uint64_t size_in_stream = 0;
+  const char* next = stream_scanner_->PeekView(&size_in_stream);
+  if (next != cur_buf_end_ || size_in_stream < n - window_size) { return false; }
+  CHECK_EQ(stream_scanner_->UpdateView(&next, n - window_size), n - window_size);
+  cur_buf_end_ += n - window_size;
+  return true;
+}
+
 void PersistentInStream::UpdateBuffer() {
   CHECK_EQ(cur_buf_begin_, cur_buf_end_);
+  if (use_mmap_) {
+    const char* view = nullptr;
+    uint64_t n = stream_scanner_->UpdateView(&view, mmap_window_size_);
+    cur_buf_begin_ = view;
+    cur_buf_end_ = view + n;
+    return;
+  }
   uint64_t n = stream_scanner_->UpdateBuffer(&buffer_);
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data() + n;
-  *cur_buf_end_ = '\0';
 }
 
 bool PersistentInStream::IsEof() const {
@@ -43,16 +43,27 @@ class PersistentInStream {
   // -1: eof
   int32_t ReadLine(std::string* l);
   int32_t ReadFully(char* s, size_t n);
+  // Like ReadFully, but sets *view to the address of the n bytes instead of copying them out.
+  // The bytes are borrowed from the mapped file if they are contiguous in it, otherwise they
+  // are gathered into an internal buffer, which is valid until the next ReadView.
+  int32_t ReadView(size_t n, const char** view);
 
  private:
   bool IsEof() const;
   void UpdateBuffer();
+  // Extends the current window of the mapped file to n bytes if they are contiguous.
+  bool TryExtendMappedWindow(size_t n);
 
   std::unique_ptr<StreamScanner> stream_scanner_;
 
+  // Local files are mapped into memory and the window [cur_buf_begin_, cur_buf_end_) points to
+  // the mapping, other files are copied into buffer_ first.
+  bool use_mmap_;
+  uint64_t mmap_window_size_;
   std::vector<char> buffer_;
-  char* cur_buf_begin_;
-  char* cur_buf_end_;
+  std::vector<char> view_buffer_;
+  const char* cur_buf_begin_;
+  const char* cur_buf_end_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/persistent_in_stream.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+namespace oneflow {
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace {
+
+std::vector<std::string> WriteFiles(fs::FileSystem* fs, const std::string& dir,
+                                    const std::vector<std::string>& contents) {
+  fs->RecursivelyCreateDirIfNotExist(dir);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < contents.size(); ++i) {
+    paths.emplace_back(JoinPath(dir, "file_" + std::to_string(i)));
+    std::unique_ptr<fs::WritableFile> file;
+    fs->NewWritableFile(paths.back(), &file);
+    file->Append(contents.at(i).data(), contents.at(i).size());
+    file->Close();
+  }
+  return paths;
+}
+
+// Reads the files as a sequence of records, each of which is a one byte length followed by
+// that many bytes, with ReadFully and ReadView alternately.
+std::vector<std::string> ReadRecords(fs::FileSystem* fs, const std::vector<std::string>& paths) {
+  PersistentInStream in_stream(fs, paths, false, false);
+  std::vector<std::string> records;
+  char size = 0;
+  while (in_stream.ReadFully(&size, 1) == 0) {
+    if (records.size() % 2 == 0) {
+      std::string record(size, '\0');
+      CHECK_EQ(in_stream.ReadFully(&record[0], size), 0);
+      records.emplace_back(record);
+    } else {
+      const char* view = nullptr;
+      CHECK_EQ(in_stream.ReadView(size, &view), 0);
+      records.emplace_back(view, size);
+    }
+  }
+  return records;
+}
+
+std::vector<std::string> ReadLines(fs::FileSystem* fs, const std::vector<std::string>& paths) {
+  PersistentInStream in_stream(fs, paths, false, false);
+  std::vector<std::string> lines;
+  std::string line;
+  while (in_stream.ReadLine(&line) == 0) { lines.emplace_back(line); }
+  return lines;
+}
+
+}  // namespace
+
+TEST(PersistentInStream, MmapAndBufferedReadsAgree) {
+  std::unique_ptr<fs::FileSystem> fs(new fs::PosixFileSystem());
+  const std::string dir = JoinPath(GetCwd(), "tmp_persistent_in_stream_test");
+  std::vector<std::string> contents(3);
+  for (int32_t i = 0; i < 300; ++i) {
+    std::string record(i % 13 + 1, static_cast<char>('a' + i % 26));
+    contents.at(i % 7 == 0 ? 2 : i / 150).append(1, static_cast<char>(record.size()));
+    contents.at(i % 7 == 0 ? 2 : i / 150).append(record);
+  }
+  const std::vector<std::string> paths = WriteFiles(fs.get(), dir, contents);
+  std::vector<std::vector<std::string>> results;
+  std::vector<std::vector<std::string>> line_results;
+  for (const char* use_mmap : {"false", "true"}) {
+    for (const char* window_size : {"1", "7", "4096"}) {
+      setenv("ONEFLOW_PERSISTENT_IN_STREAM_USE_MMAP", use_mmap, 1);
+      setenv("ONEFLOW_PERSISTENT_IN_STREAM_BUFFER_SIZE_BYTES", window_size, 1);
+      setenv("ONEFLOW_PERSISTENT_IN_STREAM_MMAP_READAHEAD_BYTES", window_size, 1);
+      results.emplace_back(ReadRecords(fs.get(), paths));
+      line_results.emplace_back(ReadLines(fs.get(), paths));
+    }
+  }
+  unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_USE_MMAP");
+  unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_BUFFER_SIZE_BYTES");
+  unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_MMAP_READAHEAD_BYTES");
+  ASSERT_EQ(results.front().size(), 300);
+  for (const auto& result : results) { ASSERT_EQ(result, results.front()); }
+  for (const auto& lines : line_results) { ASSERT_EQ(lines, line_results.front()); }
+  fs->RecursivelyDeleteDir(dir);
+}
+
+#endif  // OF_PLATFORM_POSIX
+
+}  // namespace oneflow
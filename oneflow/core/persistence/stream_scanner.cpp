@@ -64,6 +64,25 @@ uint64_t StreamScanner::UpdateBuffer(std::vector<char>* buffer) {
   return n;
 }
 
+uint64_t StreamScanner::UpdateView(const char** view, uint64_t max_size) {
+  if (cur_stream_id_ == stream_num_) return 0;
+  uint64_t n = std::min<uint64_t>(
+      max_size, streams_[cur_stream_id_]->file_size() - streams_[cur_stream_id_]->cur_file_pos());
+  if (n == 0) { return 0; }
+  *view = streams_[cur_stream_id_]->ReadInPlace(n);
+  AddNForCurFilePos(n);
+  return n;
+}
+
+const char* StreamScanner::PeekView(uint64_t* size) const {
+  if (cur_stream_id_ == stream_num_) {
+    *size = 0;
+    return nullptr;
+  }
+  *size = streams_[cur_stream_id_]->file_size() - streams_[cur_stream_id_]->cur_file_pos();
+  return streams_[cur_stream_id_]->mapped_cur_ptr();
+}
+
 void AcyclicStreamScanner::AddNForCurFilePos(uint64_t n) {
   whole_file_pos_ += n;
   if (streams_[cur_stream_id_]->IsEof()) { ++cur_stream_id_; }
@@ -32,6 +32,12 @@ class StreamScanner {
                 uint64_t offset);
   bool IsEof() const;
   uint64_t UpdateBuffer(std::vector<char>* buffer);
+  // For memory-mapped streams, hands out at most max_size bytes of the current stream in place
+  // instead of copying them into a buffer.
+  uint64_t UpdateView(const char** view, uint64_t max_size);
+  // For memory-mapped streams, returns the address of the next byte and sets *size to the
+  // number of bytes left in the current stream.
+  const char* PeekView(uint64_t* size) const;
 
  protected:
   virtual void AddNForCurFilePos(uint64_t n) = 0;
@@ -0,0 +1,73 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <map>
+#include <memory>
+#include <mutex>
+#include "nlohmann/json.hpp"
+#include "oneflow/core/profiler/counter.h"
+
+using json = nlohmann::json;
+
+namespace oneflow {
+
+namespace profiler {
+
+namespace {
+
+class CounterRegistry final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CounterRegistry);
+  CounterRegistry() = default;
+  ~CounterRegistry() = default;
+
+  static CounterRegistry* Singleton() {
+    // Leaked on purpose: counters may still be touched by threads joined during static destruction.
+    static CounterRegistry* registry = new CounterRegistry();
+    return registry;
+  }
+
+  Counter* Get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = name2counter_.find(name);
+    if (it == name2counter_.end()) {
+      it = name2counter_.emplace(name, std::make_unique<Counter>(name)).first;
+    }
+    return it->second.get();
+  }
+
+  json Dump() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    json j = json::object();
+    for (const auto& pair : name2counter_) {
+      j[pair.first] = {{"value", pair.second->value()}, {"peak", pair.second->peak()}};
+    }
+    return j;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> name2counter_;
+};
+
+}  // namespace
+
+Counter* GetCounter(const std::string& name) { return CounterRegistry::Singleton()->Get(name); }
+
+std::string DumpCountersJson() { return CounterRegistry::Singleton()->Dump().dump(); }
+
+}  // namespace profiler
+
+}  // namespace oneflow
@@ -0,0 +1,92 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PROFILER_COUNTER_H_
+#define ONEFLOW_CORE_PROFILER_COUNTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/profiler/util.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+// A named process-wide counter. Counters are never destroyed, so the pointer returned by
+// GetCounter can be cached by the caller and updated without any lock.
+class Counter final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(Counter);
+  explicit Counter(const std::string& name) : name_(name), value_(0), peak_(0) {}
+  ~Counter() = default;
+
+  const std::string& name() const { return name_; }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+  int64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+  // For monotonic quantities such as bytes, messages or nanoseconds.
+  void Add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+
+  // For levels such as queue depths, also keeps track of the highest value seen.
+  void Update(int64_t delta) {
+    const int64_t cur = value_.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t peak = peak_.load(std::memory_order_relaxed);
+    while (cur > peak && !peak_.compare_exchange_weak(peak, cur, std::memory_order_relaxed)) {}
+  }
+
+ private:
+  std::string name_;
+  std::atomic<int64_t> value_;
+  std::atomic<int64_t> peak_;
+};
+
+// Returns the counter registered under `name`, creating it on first use.
+Counter* GetCounter(const std::string& name);
+
+// Returns {"name": {"value": v, "peak": p}, ...} for every registered counter.
+std::string DumpCountersJson();
+
+// Adds the wall time spent in the enclosing scope to a counter, in nanoseconds.
+class CounterTimeGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CounterTimeGuard);
+  explicit CounterTimeGuard(Counter* counter)
+      : counter_(counter), start_(GetTimeNow(/*allow_monotonic=*/true)) {}
+  ~CounterTimeGuard() { counter_->Add(GetTimeNow(/*allow_monotonic=*/true) - start_); }
+
+ private:
+  Counter* counter_;
+  time_t start_;
+};
+
+}  // namespace profiler
+
+}  // namespace oneflow
+
+#define OF_COUNTER(name)                                                                  \
+  ([]() -> ::oneflow::profiler::Counter* {                                                \
+    static ::oneflow::profiler::Counter* counter = ::oneflow::profiler::GetCounter(name); \
+    return counter;                                                                       \
+  }())
+
+#define OF_COUNTER_ADD(name, delta) OF_COUNTER(name)->Add(delta)
+#define OF_COUNTER_UPDATE(name, delta) OF_COUNTER(name)->Update(delta)
+#define OF_COUNTER_TIME_GUARD(name)                                                 \
+  ::oneflow::profiler::CounterTimeGuard OF_PP_CAT(_of_counter_time_guard_, __COUNTER__)( \
+      OF_COUNTER(name))
+
+#endif  // ONEFLOW_CORE_PROFILER_COUNTER_H_
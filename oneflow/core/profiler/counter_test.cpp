@@ -0,0 +1,60 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "oneflow/core/profiler/counter.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+namespace test {
+
+TEST(Counter, same_name_same_counter) {
+  Counter* counter = GetCounter("test.counter.same_name");
+  ASSERT_EQ(GetCounter("test.counter.same_name"), counter);
+  ASSERT_NE(GetCounter("test.counter.other_name"), counter);
+  OF_COUNTER_ADD("test.counter.same_name", 3);
+  ASSERT_EQ(counter->value(), 3);
+}
+
+TEST(Counter, concurrent_update_keeps_peak) {
+  Counter* counter = GetCounter("test.counter.depth");
+  constexpr int kThreadNum = 4;
+  constexpr int kLoopNum = 10000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadNum; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < kLoopNum; ++j) {
+        OF_COUNTER_UPDATE("test.counter.depth", 1);
+        OF_COUNTER_UPDATE("test.counter.depth", -1);
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  ASSERT_EQ(counter->value(), 0);
+  ASSERT_GE(counter->peak(), 1);
+  ASSERT_LE(counter->peak(), kThreadNum);
+  const std::string json = DumpCountersJson();
+  ASSERT_NE(json.find("\"test.counter.depth\":{\"peak\":"), std::string::npos);
+}
+
+}  // namespace test
+
+}  // namespace profiler
+
+}  // namespace oneflow
@@ -13,34 +13,146 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <deque>
 #include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/thread/work_stealing_deque.h"
+#include "oneflow/core/common/cpu_relax.h"
+#include "oneflow/core/common/env_var/env_var.h"
 #include "oneflow/core/vm/sync_vm_mode_guard.h"
 
 namespace oneflow {
 
+namespace {
+
+constexpr size_t kWorkDequeCapacity = 4096;
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int32_t current_worker_id = -1;
+
+uint64_t NextRandom(uint64_t* state) {
+  // xorshift64
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+}  // namespace
+
+struct alignas(64) ThreadPool::Worker {
+  WorkStealingDeque<Work, kWorkDequeCapacity> deque;
+  std::mutex inbox_mutex;
+  std::deque<Work*> inbox;
+  std::atomic<size_t> inbox_size{0};
+};
+
 ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    : threads_(thread_num),
+      work_cnt_(0),
+      num_pending_works_(0),
+      num_parked_workers_(0),
+      spin_count_(EnvInteger<ONEFLOW_THREAD_POOL_SPIN_COUNT>()),
+      stopped_(false) {
+  FOR_RANGE(int32_t, i, 0, thread_num) { workers_.emplace_back(new Worker()); }
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      SyncVmModeGuard guard(SyncVmMode::kEnable);
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    threads_[i] = std::thread([this, i]() { WorkerLoop(i); });
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
+  {
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    stopped_ = true;
   }
+  park_cond_.notify_all();
+  for (auto& thread : threads_) { thread.join(); }
 }
 
 void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+  Work* item = new Work(work);
+  const bool from_worker = current_pool == this;
+  if (!from_worker || !workers_.at(current_worker_id)->deque.Push(item)) {
+    const size_t worker_id =
+        from_worker ? current_worker_id
+                    : work_cnt_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    Worker* worker = workers_.at(worker_id).get();
+    std::unique_lock<std::mutex> lock(worker->inbox_mutex);
+    worker->inbox.push_back(item);
+    worker->inbox_size.fetch_add(1, std::memory_order_release);
+  }
+  // Pairs with the parking protocol in WorkerLoop: either the parking worker sees the new pending
+  // work, or this thread sees the parked worker and wakes it up under park_mutex_.
+  num_pending_works_.fetch_add(1, std::memory_order_seq_cst);
+  if (num_parked_workers_.load(std::memory_order_seq_cst) > 0) {
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    park_cond_.notify_one();
+  }
+}
+
+bool ThreadPool::InWorkerThread() const { return current_pool == this; }
+
+ThreadPool::Work* ThreadPool::TakeFromInbox(Worker* worker) {
+  if (worker->inbox_size.load(std::memory_order_acquire) == 0) { return nullptr; }
+  std::unique_lock<std::mutex> lock(worker->inbox_mutex);
+  if (worker->inbox.empty()) { return nullptr; }
+  Work* item = worker->inbox.front();
+  worker->inbox.pop_front();
+  worker->inbox_size.fetch_sub(1, std::memory_order_relaxed);
+  return item;
+}
+
+ThreadPool::Work* ThreadPool::FindWork(int32_t worker_id, uint64_t* rand_state) {
+  Worker* self = workers_.at(worker_id).get();
+  Work* item = self->deque.Pop();
+  if (item == nullptr) { item = TakeFromInbox(self); }
+  if (item == nullptr) {
+    const size_t num_workers = workers_.size();
+    const size_t start = NextRandom(rand_state) % num_workers;
+    for (size_t i = 0; i < num_workers && item == nullptr; ++i) {
+      const size_t victim_id = (start + i) % num_workers;
+      if (victim_id == worker_id) { continue; }
+      Worker* victim = workers_.at(victim_id).get();
+      item = victim->deque.Steal();
+      if (item == nullptr) { item = TakeFromInbox(victim); }
+    }
+  }
+  if (item != nullptr) { num_pending_works_.fetch_sub(1, std::memory_order_relaxed); }
+  return item;
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id) {
+  SyncVmModeGuard guard(SyncVmMode::kEnable);
+  current_pool = this;
+  current_worker_id = worker_id;
+  uint64_t rand_state = 0x9E3779B97F4A7C15ULL * (worker_id + 1);
+  while (true) {
+    std::unique_ptr<Work> work(FindWork(worker_id, &rand_state));
+    if (work) {
+      (*work)();
+      continue;
+    }
+    bool has_pending_works = false;
+    for (int64_t i = 0; i < spin_count_; ++i) {
+      if (num_pending_works_.load(std::memory_order_relaxed) > 0) {
+        has_pending_works = true;
+        break;
+      }
+      CpuRelax();
+    }
+    if (has_pending_works) { continue; }
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    num_parked_workers_.fetch_add(1, std::memory_order_seq_cst);
+    park_cond_.wait(lock, [this]() {
+      return num_pending_works_.load(std::memory_order_seq_cst) > 0 || stopped_;
+    });
+    num_parked_workers_.fetch_sub(1, std::memory_order_relaxed);
+    // Work added before the destructor ran is drained before the worker exits.
+    if (stopped_ && num_pending_works_.load(std::memory_order_seq_cst) <= 0) { break; }
+  }
+  current_pool = nullptr;
+  current_worker_id = -1;
 }
 
 }  // namespace oneflow
@@ -17,10 +17,12 @@ limitations under the License.
 #define ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 
 #include "oneflow/core/common/util.h"
-#include "oneflow/core/common/channel.h"
 
 namespace oneflow {
 
+// Work-stealing thread pool. Every worker owns a lock-free deque that work added from inside the
+// pool goes to, plus a small inbox that takes work added from outside. An idle worker first drains
+// its own queues, then steals from random victims, spins for a while and finally parks.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
@@ -30,12 +32,27 @@ class ThreadPool final {
 
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
+  // Whether the calling thread is one of this pool's workers.
+  bool InWorkerThread() const;
 
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
+  using Work = std::function<void()>;
+  struct Worker;
+
+  void WorkerLoop(int32_t worker_id);
+  Work* FindWork(int32_t worker_id, uint64_t* rand_state);
+  Work* TakeFromInbox(Worker* worker);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
   std::vector<std::thread> threads_;
 
   std::atomic<size_t> work_cnt_;
+  std::atomic<int64_t> num_pending_works_;
+  std::atomic<int32_t> num_parked_workers_;
+  const int64_t spin_count_;
+  std::mutex park_mutex_;
+  std::condition_variable park_cond_;
+  bool stopped_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,61 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+namespace test {
+
+TEST(ThreadPool, AddWorkFromOutsideAndInside) {
+  const int64_t num_works = 10000;
+  const int64_t num_nested = 10;
+  std::atomic<int64_t> sum(0);
+  {
+    ThreadPool pool(8);
+    for (int64_t i = 0; i < num_works; ++i) {
+      pool.AddWork([&pool, &sum, i]() {
+        sum += i;
+        for (int64_t j = 0; j < num_nested; ++j) {
+          pool.AddWork([&sum]() { sum += 1; });
+        }
+      });
+    }
+    // The destructor runs every work added before it, including nested ones.
+  }
+  ASSERT_EQ(sum, num_works * (num_works - 1) / 2 + num_works * num_nested);
+}
+
+TEST(ThreadPool, SlowWorkDoesNotBlockOthers) {
+  ThreadPool pool(4);
+  std::atomic<bool> release(false);
+  BlockingCounter slow_counter(1);
+  pool.AddWork([&]() {
+    while (!release) { std::this_thread::yield(); }
+    slow_counter.Decrease();
+  });
+  const int64_t num_works = 1000;
+  BlockingCounter counter(num_works);
+  for (int64_t i = 0; i < num_works; ++i) {
+    pool.AddWork([&counter]() { counter.Decrease(); });
+  }
+  counter.WaitForeverUntilCntEqualZero();
+  release = true;
+  slow_counter.WaitForeverUntilCntEqualZero();
+}
+
+}  // namespace test
+}  // namespace oneflow
@@ -16,9 +16,12 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_THREAD_THREAD_RUNTIME_H_
 #define ONEFLOW_CORE_THREAD_THREAD_RUNTIME_H_
 
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/cpu_relax.h"
 #include "oneflow/core/thread/thread.h"
 #include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/platform/include/pthread_fork.h"
@@ -70,27 +73,89 @@ class SeqRuntime final : public RuntimeBase {
 
 class OfRuntime final : public RuntimeBase {
  private:
+  // Chunks handed out per participating thread; more than one lets threads that finish early take
+  // over work from slow ones on irregular workloads.
+  static constexpr size_t kChunksPerThread = 4;
+  // The caller spins this long for the chunks of other threads, then sleeps until the last one
+  // is done.
+  static constexpr int64_t kWaitSpinCount = 1024;
+
+  struct State {
+    State(int64_t begin, int64_t end, size_t chunk_size, size_t num_chunks, const CallableT* func)
+        : begin(begin),
+          end(end),
+          chunk_size(chunk_size),
+          num_chunks(num_chunks),
+          func(func),
+          next_chunk(0),
+          num_done(0) {}
+    const int64_t begin;
+    const int64_t end;
+    const size_t chunk_size;
+    const size_t num_chunks;
+    const CallableT* func;
+    std::atomic<size_t> next_chunk;
+    std::atomic<size_t> num_done;
+    std::mutex mutex;
+    std::condition_variable done_cond;
+  };
+
+  // Claims chunks until none is left. Pool tasks that start after every chunk has been claimed
+  // return without touching func, which may already be gone.
+  static void RunChunks(State* state) {
+    const bool prev_in_parallel_for = in_parallel_for_;
+    in_parallel_for_ = true;
+    while (true) {
+      const size_t chunk_id = state->next_chunk.fetch_add(1, std::memory_order_relaxed);
+      if (chunk_id >= state->num_chunks) { break; }
+      const int64_t chunk_begin = state->begin + chunk_id * state->chunk_size;
+      const int64_t chunk_end = std::min<int64_t>(chunk_begin + state->chunk_size, state->end);
+      SeqFor(chunk_begin, chunk_end, *state->func);
+      if (state->num_done.fetch_add(1, std::memory_order_acq_rel) + 1 == state->num_chunks) {
+        // Taking the mutex orders the notification after a caller that found the chunks not yet
+        // done has started waiting.
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done_cond.notify_one();
+      }
+    }
+    in_parallel_for_ = prev_in_parallel_for;
+  }
+
   void ParallelForImpl(int64_t begin, int64_t end, const CallableT& func, size_t num_threads,
                        size_t grain_size) override {
-    if (unlikely(pthread_fork::IsForkedSubProcess()) || Singleton<ThreadPool>::Get() == nullptr) {
+    ThreadPool* pool = Singleton<ThreadPool>::Get();
+    if (unlikely(pthread_fork::IsForkedSubProcess()) || pool == nullptr) {
       return SeqFor(begin, end, func);
     }
+    // Nested calls run inline: the outer loop already keeps every thread busy, and waiting on
+    // pool work from inside the pool could deadlock.
+    if (in_parallel_for_ || pool->InWorkerThread()) { return SeqFor(begin, end, func); }
     const size_t num_elements = end - begin;
-    num_threads = std::min(num_elements, num_threads);
-    BalancedSplitter bs(num_elements, num_threads);
-    BlockingCounter bc(num_threads);
-
-    FOR_RANGE(size_t, range_id, 0, num_threads) {
-      Singleton<ThreadPool>::Get()->AddWork([&bc, &bs, range_id, func] {
-        const size_t begin_ = bs.At(range_id).begin();
-        const size_t end_ = bs.At(range_id).end();
-        SeqFor(begin_, end_, func);
-        bc.Decrease();
-      });
+    grain_size = std::max<size_t>(grain_size, 1);
+    num_threads = std::min<size_t>(num_threads, pool->thread_num() + 1);
+    const size_t max_num_chunks = DivUp(num_elements, grain_size);
+    if (max_num_chunks <= 1 || num_threads <= 1) { return SeqFor(begin, end, func); }
+    const size_t num_chunks = std::min(max_num_chunks, num_threads * kChunksPerThread);
+    const size_t chunk_size = DivUp(num_elements, num_chunks);
+    auto state = std::make_shared<State>(begin, end, chunk_size, DivUp(num_elements, chunk_size),
+                                         &func);
+    const size_t num_workers = std::min(num_threads, state->num_chunks) - 1;
+    FOR_RANGE(size_t, i, 0, num_workers) {
+      pool->AddWork([state] { RunChunks(state.get()); });
     }
-    // buzy loop wait.
-    bc.WaitForeverUntilCntEqualZero();
+    RunChunks(state.get());
+    const auto IsDone = [&state]() {
+      return state->num_done.load(std::memory_order_acquire) == state->num_chunks;
+    };
+    for (int64_t spin = 0; spin < kWaitSpinCount; ++spin) {
+      if (IsDone()) { return; }
+      CpuRelax();
+    }
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done_cond.wait(lock, IsDone);
   }
+
+  inline static thread_local bool in_parallel_for_ = false;
 };
 
 #if WITH_TBB
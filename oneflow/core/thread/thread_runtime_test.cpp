@@ -0,0 +1,106 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <time.h>
+#include <chrono>
+#include "oneflow/core/thread/thread_runtime.h"
+
+namespace oneflow {
+namespace test {
+
+class OfRuntimeTest : public testing::Test {
+ protected:
+  void SetUp() override { Singleton<ThreadPool>::New(4); }
+  void TearDown() override { Singleton<ThreadPool>::Delete(); }
+  thread::OfRuntime runtime_;
+};
+
+TEST_F(OfRuntimeTest, CoversRangeOnce) {
+  const int64_t begin = 3;
+  const int64_t end = 100003;
+  std::vector<std::atomic<int32_t>> visits(end);
+  for (auto& visit : visits) { visit = 0; }
+  runtime_.ParallelFor(
+      begin, end,
+      [&](int64_t b, int64_t e) {
+        for (int64_t i = b; i < e; ++i) { visits[i] += 1; }
+      },
+      8, 1000);
+  for (int64_t i = 0; i < end; ++i) { ASSERT_EQ(visits[i], i >= begin ? 1 : 0); }
+}
+
+TEST_F(OfRuntimeTest, SmallRangeRunsInline) {
+  std::atomic<int32_t> num_calls(0);
+  const std::thread::id caller = std::this_thread::get_id();
+  runtime_.ParallelFor(
+      0, 100,
+      [&](int64_t b, int64_t e) {
+        num_calls += 1;
+        ASSERT_EQ(std::this_thread::get_id(), caller);
+      },
+      8, 1000);
+  ASSERT_EQ(num_calls, 1);
+}
+
+TEST_F(OfRuntimeTest, NestedCallsRunInline) {
+  const int64_t n = 64;
+  std::vector<std::atomic<int64_t>> sums(n);
+  for (auto& sum : sums) { sum = 0; }
+  runtime_.ParallelFor(
+      0, n,
+      [&](int64_t b, int64_t e) {
+        for (int64_t i = b; i < e; ++i) {
+          const std::thread::id outer = std::this_thread::get_id();
+          runtime_.ParallelFor(
+              0, 1000,
+              [&](int64_t ib, int64_t ie) {
+                ASSERT_EQ(std::this_thread::get_id(), outer);
+                sums[i] += ie - ib;
+              },
+              8, 1);
+        }
+      },
+      8, 1);
+  for (int64_t i = 0; i < n; ++i) { ASSERT_EQ(sums[i], 1000); }
+}
+
+TEST_F(OfRuntimeTest, CallerSleepsWhileWaiting) {
+  const auto ThreadCpuSeconds = []() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  };
+  const std::thread::id caller = std::this_thread::get_id();
+  std::atomic<bool> worker_started(false);
+  const double cpu_begin = ThreadCpuSeconds();
+  // The chunk of the worker takes long, the caller finishes its own chunk once the worker has
+  // started and then must not burn its core while waiting.
+  runtime_.ParallelFor(
+      0, 2,
+      [&](int64_t b, int64_t e) {
+        if (std::this_thread::get_id() == caller) {
+          while (!worker_started) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        } else {
+          worker_started = true;
+          std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        }
+      },
+      2, 1);
+  ASSERT_LT(ThreadCpuSeconds() - cpu_begin, 0.05);
+}
+
+}  // namespace test
+}  // namespace oneflow
@@ -0,0 +1,80 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#ifndef ONEFLOW_CORE_TRANSPORT_SHM_DOORBELL_H_
+#define ONEFLOW_CORE_TRANSPORT_SHM_DOORBELL_H_
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// ShmDoorbell lets one thread sleep until another thread or process rings it. It is a futex word
+// in memory shared between processes, so it works across them, and only rings that find the
+// waiter asleep make a system call.
+//
+// The waiter reads seq() before it looks for work and passes it to Wait() if it found none. Wait()
+// returns right away if the doorbell was rung since then, so no ring is lost.
+//
+// ShmDoorbell doesn't own the memory. One side lays it out with Create(), the others find it in
+// the same memory with Attach().
+class ShmDoorbell final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmDoorbell);
+  ~ShmDoorbell() = default;
+
+  static ShmDoorbell* Create(char* memory) { return new (memory) ShmDoorbell(); }
+  static ShmDoorbell* Attach(char* memory) { return reinterpret_cast<ShmDoorbell*>(memory); }
+
+  uint32_t seq() const { return seq_.load(std::memory_order_seq_cst); }
+
+  void Ring() {
+    seq_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst) != 0) { Futex(FUTEX_WAKE, 1); }
+  }
+
+  // Only one thread waits on a doorbell. It may also return spuriously.
+  void Wait(uint32_t seq) {
+    sleeping_.store(1, std::memory_order_seq_cst);
+    Futex(FUTEX_WAIT, seq);
+    sleeping_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  ShmDoorbell() : seq_(0), sleeping_(0) {}
+
+  // Not FUTEX_PRIVATE_FLAG, the word is shared between processes.
+  void Futex(int op, uint32_t value) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_), op, value, nullptr, nullptr, 0);
+  }
+
+  std::atomic<uint32_t> seq_;
+  std::atomic<uint32_t> sleeping_;
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t)
+                  && std::atomic<uint32_t>::is_always_lock_free,
+              "the futex word of ShmDoorbell is a plain uint32_t shared between processes");
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_TRANSPORT_SHM_DOORBELL_H_
+
+#endif  // __linux__
@@ -0,0 +1,149 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_TRANSPORT_SHM_RING_H_
+#define ONEFLOW_CORE_TRANSPORT_SHM_RING_H_
+
+#include <atomic>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// ShmRing is a single-producer single-consumer queue of fixed size slots, laid out in a piece of
+// memory shared by two processes. The producer only advances tail and the consumer only advances
+// head, so neither side takes a lock, and a message is copied into the ring and out of it again.
+//
+// A message larger than a slot is split over consecutive slots, each carrying the token, the size
+// of the whole message and the offset of its part.
+//
+// A producer finding the ring full can ask to be told when a slot is freed, see
+// RequestSpaceNotification().
+//
+// ShmRing doesn't own the memory. One side lays the ring out with Create(), the other side finds
+// it in the same memory with Attach().
+class ShmRing final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmRing);
+  ~ShmRing() = default;
+
+  struct SlotHeader {
+    uint64_t token;
+    uint64_t total_size;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  static size_t MemorySize(size_t slot_num, size_t slot_size) {
+    return sizeof(Layout) + slot_num * SlotStride(slot_size);
+  }
+
+  static std::unique_ptr<ShmRing> Create(char* memory, size_t slot_num, size_t slot_size) {
+    Layout* layout = new (memory) Layout();
+    layout->slot_num = slot_num;
+    layout->slot_size = slot_size;
+    return std::unique_ptr<ShmRing>(new ShmRing(memory));
+  }
+
+  static std::unique_ptr<ShmRing> Attach(char* memory) {
+    return std::unique_ptr<ShmRing>(new ShmRing(memory));
+  }
+
+  size_t slot_size() const { return slot_size_; }
+
+  // Producer side, returns false if the ring is full. size is at most slot_size().
+  bool TryPush(uint64_t token, size_t total_size, size_t offset, const void* data, size_t size) {
+    CHECK_LE(size, slot_size_);
+    const uint64_t tail = layout_->tail.load(std::memory_order_relaxed);
+    if (tail - layout_->head.load(std::memory_order_acquire) == slot_num_) { return false; }
+    char* slot = Slot(tail);
+    SlotHeader* header = reinterpret_cast<SlotHeader*>(slot);
+    header->token = token;
+    header->total_size = total_size;
+    header->offset = offset;
+    header->size = size;
+    if (size > 0) { std::memcpy(slot + sizeof(SlotHeader), data, size); }
+    layout_->tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns nullptr if the ring is empty. The slot stays valid until Pop().
+  const SlotHeader* Front(const char** data) const {
+    const uint64_t head = layout_->head.load(std::memory_order_relaxed);
+    if (head == layout_->tail.load(std::memory_order_acquire)) { return nullptr; }
+    const char* slot = Slot(head);
+    *data = slot + sizeof(SlotHeader);
+    return reinterpret_cast<const SlotHeader*>(slot);
+  }
+
+  // Sequentially consistent, so that TakeSpaceNotification() sees a request made by a producer
+  // that hasn't seen this slot being freed.
+  void Pop() {
+    layout_->head.store(layout_->head.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_seq_cst);
+  }
+
+  // Producer side, after TryPush() failed: asks the consumer to notify the producer once it frees a
+  // slot. Returns false if a slot was freed meanwhile, in which case the producer should push again
+  // instead of waiting.
+  bool RequestSpaceNotification() {
+    layout_->producer_waiting.store(1, std::memory_order_seq_cst);
+    const uint64_t tail = layout_->tail.load(std::memory_order_relaxed);
+    return tail - layout_->head.load(std::memory_order_seq_cst) == slot_num_;
+  }
+
+  // Consumer side, after Pop(): returns whether the producer asked to be notified, and clears the
+  // request.
+  bool TakeSpaceNotification() {
+    if (layout_->producer_waiting.load(std::memory_order_seq_cst) == 0) { return false; }
+    return layout_->producer_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+  }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  struct Layout {
+    alignas(kCacheLineSize) std::atomic<uint64_t> head{0};
+    alignas(kCacheLineSize) std::atomic<uint64_t> tail{0};
+    alignas(kCacheLineSize) std::atomic<uint32_t> producer_waiting{0};
+    alignas(kCacheLineSize) uint64_t slot_num = 0;
+    uint64_t slot_size = 0;
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free
+                    && std::atomic<uint32_t>::is_always_lock_free,
+                "the atomics of ShmRing are shared between processes");
+
+  static size_t SlotStride(size_t slot_size) {
+    return RoundUp(sizeof(SlotHeader) + slot_size, kCacheLineSize);
+  }
+
+  explicit ShmRing(char* memory)
+      : layout_(reinterpret_cast<Layout*>(memory)),
+        slots_(memory + sizeof(Layout)),
+        slot_num_(layout_->slot_num),
+        slot_size_(layout_->slot_size),
+        slot_stride_(SlotStride(slot_size_)) {}
+
+  char* Slot(uint64_t index) const { return slots_ + (index % slot_num_) * slot_stride_; }
+
+  Layout* layout_;
+  char* slots_;
+  const uint64_t slot_num_;
+  const size_t slot_size_;
+  const size_t slot_stride_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_TRANSPORT_SHM_RING_H_
@@ -0,0 +1,79 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/transport/shm_ring.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(ShmRing, push_until_full) {
+  std::vector<char> memory(ShmRing::MemorySize(2, 8) + 64);
+  char* aligned = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(memory.data()), 64));
+  auto producer = ShmRing::Create(aligned, 2, 8);
+  auto consumer = ShmRing::Attach(aligned);
+  const char* data = nullptr;
+  ASSERT_EQ(consumer->Front(&data), nullptr);
+  ASSERT_TRUE(producer->TryPush(1, 12, 0, "abcdefgh", 8));
+  ASSERT_TRUE(producer->TryPush(1, 12, 8, "ijkl", 4));
+  ASSERT_FALSE(producer->TryPush(2, 0, 0, nullptr, 0));
+  const ShmRing::SlotHeader* header = consumer->Front(&data);
+  ASSERT_NE(header, nullptr);
+  ASSERT_EQ(header->token, 1);
+  ASSERT_EQ(header->total_size, 12);
+  ASSERT_EQ(header->offset, 0);
+  ASSERT_EQ(std::string(data, header->size), "abcdefgh");
+  consumer->Pop();
+  ASSERT_TRUE(producer->TryPush(2, 0, 0, nullptr, 0));
+  header = consumer->Front(&data);
+  ASSERT_EQ(header->offset, 8);
+  ASSERT_EQ(std::string(data, header->size), "ijkl");
+  consumer->Pop();
+  header = consumer->Front(&data);
+  ASSERT_EQ(header->token, 2);
+  ASSERT_EQ(header->size, 0);
+  consumer->Pop();
+  ASSERT_EQ(consumer->Front(&data), nullptr);
+}
+
+TEST(ShmRing, producer_and_consumer_threads) {
+  constexpr int64_t kMsgNum = 10000;
+  std::vector<char> memory(ShmRing::MemorySize(4, sizeof(int64_t)) + 64);
+  char* aligned = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(memory.data()), 64));
+  auto producer = ShmRing::Create(aligned, 4, sizeof(int64_t));
+  auto consumer = ShmRing::Attach(aligned);
+  std::thread producer_thread([&]() {
+    for (int64_t i = 0; i < kMsgNum; ++i) {
+      while (!producer->TryPush(i, sizeof(int64_t), 0, &i, sizeof(int64_t))) {}
+    }
+  });
+  for (int64_t i = 0; i < kMsgNum; ++i) {
+    const char* data = nullptr;
+    const ShmRing::SlotHeader* header = nullptr;
+    while ((header = consumer->Front(&data)) == nullptr) {}
+    ASSERT_EQ(header->token, i);
+    int64_t value = 0;
+    std::memcpy(&value, data, sizeof(int64_t));
+    ASSERT_EQ(value, i);
+    consumer->Pop();
+  }
+  producer_thread.join();
+}
+
+}  // namespace test
+
+}  // namespace oneflow
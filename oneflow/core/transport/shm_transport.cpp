@@ -0,0 +1,336 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include "oneflow/core/transport/shm_transport.h"
+#include "oneflow/core/common/cpu_relax.h"
+#include "oneflow/core/common/env_var/env_var.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/profiler/counter.h"
+
+namespace oneflow {
+
+namespace {
+
+// The poller keeps polling for a moment after the last piece of work before it sleeps on its
+// doorbell, so that a message following closely doesn't pay for a wake-up.
+constexpr int64_t kSpinPollCount = 256;
+
+std::string GenPairSuffix(int64_t src_machine_id, int64_t dst_machine_id) {
+  return std::to_string(src_machine_id) + "/" + std::to_string(dst_machine_id);
+}
+
+std::string GenDoorbellNameKey(int64_t machine_id) {
+  return "ShmTransportDoorbell/" + std::to_string(machine_id);
+}
+
+std::string GenRingNameKey(int64_t src_machine_id, int64_t dst_machine_id) {
+  return "ShmTransportRing/" + GenPairSuffix(src_machine_id, dst_machine_id);
+}
+
+std::string GenAttachedKey(int64_t src_machine_id, int64_t dst_machine_id) {
+  return "ShmTransportAttached/" + GenPairSuffix(src_machine_id, dst_machine_id);
+}
+
+std::vector<int64_t> GetPeersOnThisNode() {
+  std::vector<int64_t> peers;
+  const int64_t world_size = GlobalProcessCtx::WorldSize();
+  for (int64_t machine_id = 0; machine_id < world_size; ++machine_id) {
+    if (machine_id != GlobalProcessCtx::Rank()
+        && GlobalProcessCtx::NodeId(machine_id) == GlobalProcessCtx::ThisNodeId()) {
+      peers.emplace_back(machine_id);
+    }
+  }
+  return peers;
+}
+
+}  // namespace
+
+ShmTransport::ShmTransport()
+    : ShmTransport(GlobalProcessCtx::Rank(), GetPeersOnThisNode(), Singleton<CtrlClient>::Get()) {}
+
+ShmTransport::ShmTransport(int64_t this_machine_id, const std::vector<int64_t>& peers,
+                           CtrlClient* ctrl_client)
+    : this_machine_id_(this_machine_id), doorbell_(nullptr), shutdown_(false) {
+  if (peers.empty()) { return; }
+  SetUpChannels(peers, ctrl_client);
+  if (in_channels_.empty() && out_channels_.empty()) { return; }
+  poller_ = std::thread([this]() { PollChannels(); });
+}
+
+ShmTransport::~ShmTransport() {
+  shutdown_.store(true, std::memory_order_release);
+  if (poller_.joinable()) {
+    doorbell_->Ring();
+    poller_.join();
+  }
+}
+
+void ShmTransport::SetUpChannels(const std::vector<int64_t>& peers, CtrlClient* ctrl_client) {
+  const size_t slot_num = EnvInteger<ONEFLOW_TRANSPORT_SHM_SLOT_NUM>();
+  const size_t slot_size = EnvInteger<ONEFLOW_TRANSPORT_SHM_SLOT_BYTES>();
+  CHECK_GT(slot_num, 0);
+  CHECK_GT(slot_size, 0);
+  // Every process lays out the doorbell its poller sleeps on, without it there are no rings.
+  {
+    const auto& shm = ipc::SharedMemory::Open(sizeof(ShmDoorbell), true);
+    std::string name;
+    if (shm.IsOk()) {
+      doorbell_shm_ = shm.GetPtrOrThrow();
+      doorbell_ = ShmDoorbell::Create(doorbell_shm_->mut_buf());
+      name = doorbell_shm_->name();
+    } else {
+      LOG(WARNING) << "ShmTransport falls back to CommNet:\n" << shm.GetSerializedError();
+    }
+    ctrl_client->PushKV(GenDoorbellNameKey(this_machine_id_), name);
+  }
+  // The receiver of a pair maps the doorbell of the sender, lays out its ring and publishes the
+  // name of the shared memory.
+  for (int64_t src_machine_id : peers) {
+    std::string name;
+    ShmDoorbell* peer_doorbell =
+        doorbell_ == nullptr ? nullptr : OpenPeerDoorbell(src_machine_id, ctrl_client);
+    if (peer_doorbell != nullptr) {
+      const auto& shm = ipc::SharedMemory::Open(ShmRing::MemorySize(slot_num, slot_size), true);
+      if (shm.IsOk()) {
+        Channel* channel = &in_channels_[src_machine_id];
+        channel->shm = shm.GetPtrOrThrow();
+        channel->ring = ShmRing::Create(channel->shm->mut_buf(), slot_num, slot_size);
+        channel->peer_doorbell = peer_doorbell;
+        name = channel->shm->name();
+      } else {
+        LOG(WARNING) << "ShmTransport falls back to CommNet from machine " << src_machine_id
+                     << ":\n"
+                     << shm.GetSerializedError();
+      }
+    }
+    ctrl_client->PushKV(GenRingNameKey(src_machine_id, this_machine_id_), name);
+  }
+  // The sender maps the doorbell of the receiver, attaches to the ring and tells whether that
+  // worked.
+  for (int64_t dst_machine_id : peers) {
+    std::string name;
+    ctrl_client->PullKV(GenRingNameKey(this_machine_id_, dst_machine_id),
+                        [&](const std::string& v) { name = v; });
+    bool attached = false;
+    ShmDoorbell* peer_doorbell =
+        name.empty() ? nullptr : OpenPeerDoorbell(dst_machine_id, ctrl_client);
+    if (peer_doorbell != nullptr) {
+      const auto& shm = ipc::SharedMemory::Open(name, false);
+      if (shm.IsOk()) {
+        Channel* channel = &out_channels_[dst_machine_id];
+        channel->shm = shm.GetPtrOrThrow();
+        channel->ring = ShmRing::Attach(channel->shm->mut_buf());
+        channel->peer_doorbell = peer_doorbell;
+        attached = true;
+      } else {
+        LOG(WARNING) << "ShmTransport falls back to CommNet to machine " << dst_machine_id
+                     << ":\n"
+                     << shm.GetSerializedError();
+      }
+    }
+    ctrl_client->PushKV(GenAttachedKey(this_machine_id_, dst_machine_id), attached ? "1" : "0");
+  }
+  for (int64_t src_machine_id : peers) {
+    bool attached = false;
+    ctrl_client->PullKV(GenAttachedKey(src_machine_id, this_machine_id_),
+                        [&](const std::string& v) { attached = (v == "1"); });
+    auto it = in_channels_.find(src_machine_id);
+    if (it != in_channels_.end()) {
+      // Both sides have mapped the memory, so nothing is left behind if either of them dies.
+      CHECK_JUST(it->second.shm->Unlink());
+      if (!attached) { in_channels_.erase(it); }
+    }
+    ctrl_client->ClearKV(GenRingNameKey(src_machine_id, this_machine_id_));
+    ctrl_client->ClearKV(GenAttachedKey(src_machine_id, this_machine_id_));
+  }
+  // Every peer maps the doorbell of this process before publishing the name of its ring from here
+  // or telling whether it attached to the ring to here, both of which were pulled above.
+  ctrl_client->ClearKV(GenDoorbellNameKey(this_machine_id_));
+  if (doorbell_shm_) { CHECK_JUST(doorbell_shm_->Unlink()); }
+}
+
+ShmDoorbell* ShmTransport::OpenPeerDoorbell(int64_t machine_id, CtrlClient* ctrl_client) {
+  auto it = peer_doorbell_shms_.find(machine_id);
+  if (it == peer_doorbell_shms_.end()) {
+    std::string name;
+    ctrl_client->PullKV(GenDoorbellNameKey(machine_id), [&](const std::string& v) { name = v; });
+    std::shared_ptr<ipc::SharedMemory> shm;
+    if (!name.empty()) {
+      const auto& opened = ipc::SharedMemory::Open(name, false);
+      if (opened.IsOk()) {
+        shm = opened.GetPtrOrThrow();
+      } else {
+        LOG(WARNING) << "ShmTransport can't map the doorbell of machine " << machine_id << ":\n"
+                     << opened.GetSerializedError();
+      }
+    }
+    it = peer_doorbell_shms_.emplace(machine_id, shm).first;
+  }
+  return it->second ? ShmDoorbell::Attach(it->second->mut_buf()) : nullptr;
+}
+
+bool ShmTransport::CanSendTo(int64_t dst_machine_id) const {
+  return out_channels_.find(dst_machine_id) != out_channels_.end();
+}
+
+bool ShmTransport::CanReceiveFrom(int64_t src_machine_id) const {
+  return in_channels_.find(src_machine_id) != in_channels_.end();
+}
+
+void ShmTransport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size,
+                        std::function<void()> callback) {
+  CHECK(CanSendTo(dst_machine_id));
+  PendingSend send{token, static_cast<const char*>(ptr), size, 0, std::move(callback)};
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    new_sends_.emplace_back(dst_machine_id, std::move(send));
+  }
+  OF_COUNTER_UPDATE("transport.shm_pending_sends", 1);
+  doorbell_->Ring();
+}
+
+void ShmTransport::Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::size_t max_size,
+                           std::function<void()> callback) {
+  CHECK(CanReceiveFrom(src_machine_id));
+  PendingRecv recv{token, static_cast<char*>(ptr), max_size, std::move(callback)};
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    new_recvs_.emplace_back(std::move(recv));
+  }
+  doorbell_->Ring();
+}
+
+void ShmTransport::PostReceive(PendingRecv* recv, std::vector<std::function<void()>>* callbacks) {
+  auto it = token2recv_status_.emplace(recv->token, RecvStatus()).first;
+  RecvStatus* status = &it->second;
+  CHECK(!status->is_recv_ready);
+  status->is_recv_ready = true;
+  status->ptr = recv->ptr;
+  status->max_size = recv->max_size;
+  status->callback = std::move(recv->callback);
+  if (status->is_send_ready) {
+    // NOTE: Receive max_size may larger than Send size.
+    CHECK_LE(status->total_size, status->max_size);
+    if (status->received_size > 0) {
+      std::memcpy(status->ptr, status->staged.data(), status->received_size);
+    }
+    std::vector<char>().swap(status->staged);
+    if (status->received_size == status->total_size) {
+      callbacks->emplace_back(std::move(status->callback));
+      token2recv_status_.erase(it);
+    }
+  }
+}
+
+bool ShmTransport::PollOnce(std::vector<std::function<void()>>* callbacks) {
+  bool busy = false;
+  std::vector<std::pair<int64_t, PendingSend>> new_sends;
+  std::vector<PendingRecv> new_recvs;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    new_sends.swap(new_sends_);
+    new_recvs.swap(new_recvs_);
+  }
+  if (!new_sends.empty() || !new_recvs.empty()) { busy = true; }
+  for (auto& pair : new_sends) {
+    out_channels_.at(pair.first).sends.emplace_back(std::move(pair.second));
+  }
+  for (auto& recv : new_recvs) { PostReceive(&recv, callbacks); }
+  for (auto& pair : out_channels_) {
+    Channel* channel = &pair.second;
+    ShmRing* ring = channel->ring.get();
+    bool pushed = false;
+    while (!channel->sends.empty()) {
+      PendingSend* send = &channel->sends.front();
+      const size_t size = std::min(ring->slot_size(), send->size - send->offset);
+      if (!ring->TryPush(send->token, send->size, send->offset, send->ptr + send->offset, size)) {
+        if (!ring->RequestSpaceNotification()) { continue; }
+        OF_COUNTER_ADD("transport.shm_ring_full", 1);
+        break;
+      }
+      pushed = true;
+      send->offset += size;
+      if (send->offset == send->size) {
+        // The data is in the ring, so the buffer of the sender is free again.
+        callbacks->emplace_back(std::move(send->callback));
+        channel->sends.pop_front();
+        OF_COUNTER_UPDATE("transport.shm_pending_sends", -1);
+      }
+    }
+    if (pushed) {
+      busy = true;
+      channel->peer_doorbell->Ring();
+    }
+  }
+  for (auto& pair : in_channels_) {
+    Channel* channel = &pair.second;
+    ShmRing* ring = channel->ring.get();
+    bool popped = false;
+    const char* data = nullptr;
+    while (const ShmRing::SlotHeader* header = ring->Front(&data)) {
+      popped = true;
+      auto it = token2recv_status_.emplace(header->token, RecvStatus()).first;
+      RecvStatus* status = &it->second;
+      if (!status->is_send_ready) {
+        status->is_send_ready = true;
+        status->total_size = header->total_size;
+        if (status->is_recv_ready) {
+          CHECK_LE(status->total_size, status->max_size);
+        } else {
+          status->staged.resize(status->total_size);
+        }
+      }
+      char* dst = status->is_recv_ready ? status->ptr : status->staged.data();
+      if (header->size > 0) { std::memcpy(dst + header->offset, data, header->size); }
+      status->received_size += header->size;
+      ring->Pop();
+      if (status->is_recv_ready && status->received_size == status->total_size) {
+        callbacks->emplace_back(std::move(status->callback));
+        token2recv_status_.erase(it);
+      }
+    }
+    if (popped) {
+      busy = true;
+      if (ring->TakeSpaceNotification()) { channel->peer_doorbell->Ring(); }
+    }
+  }
+  return busy;
+}
+
+void ShmTransport::PollChannels() {
+  std::vector<std::function<void()>> callbacks;
+  int64_t idle_count = 0;
+  while (true) {
+    const uint32_t seq = doorbell_->seq();
+    if (shutdown_.load(std::memory_order_acquire)) { break; }
+    if (PollOnce(&callbacks)) {
+      idle_count = 0;
+      for (const auto& callback : callbacks) { callback(); }
+      callbacks.clear();
+    } else if (++idle_count < kSpinPollCount) {
+      CpuRelax();
+    } else {
+      idle_count = 0;
+      doorbell_->Wait(seq);
+    }
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
@@ -0,0 +1,130 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#ifndef ONEFLOW_CORE_TRANSPORT_SHM_TRANSPORT_H_
+#define ONEFLOW_CORE_TRANSPORT_SHM_TRANSPORT_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "oneflow/core/ipc/shared_memory.h"
+#include "oneflow/core/transport/shm_doorbell.h"
+#include "oneflow/core/transport/shm_ring.h"
+
+namespace oneflow {
+
+class CtrlClient;
+
+// ShmTransport moves the data of Transport between the processes on this node through a ShmRing
+// for every ordered pair of them, instead of the loopback sockets of CommNet.
+//
+// Send() and Receive() only queue the request for the poller thread, which serves both directions
+// of all pairs. The poller copies a message into the ring of the pair slot by slot, and copies the
+// slots arriving on the other rings out into the buffer of the Receive() with the same token, or
+// keeps them aside until that Receive() is queued. Every process has a ShmDoorbell that its poller
+// sleeps on when there is nothing to do, rung by the peers after pushing to one of its rings or
+// freeing a slot it waits for, and by Send() and Receive().
+//
+// The rings are set up by the constructor, which all processes have to call. A pair whose ring
+// can't be set up (e.g. /dev/shm is too small) keeps using CommNet, both sides agree on that.
+class ShmTransport final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmTransport);
+  ShmTransport();
+  // Sets up the rings with the given peers, exchanging their names through ctrl_client.
+  ShmTransport(int64_t this_machine_id, const std::vector<int64_t>& peers,
+               CtrlClient* ctrl_client);
+  ~ShmTransport();
+
+  bool CanSendTo(int64_t dst_machine_id) const;
+  bool CanReceiveFrom(int64_t src_machine_id) const;
+
+  void Send(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size,
+            std::function<void()> callback);
+  void Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::size_t max_size,
+               std::function<void()> callback);
+
+ private:
+  struct PendingSend {
+    uint64_t token;
+    const char* ptr;
+    std::size_t size;
+    std::size_t offset;
+    std::function<void()> callback;
+  };
+
+  struct PendingRecv {
+    uint64_t token;
+    char* ptr;
+    std::size_t max_size;
+    std::function<void()> callback;
+  };
+
+  // A message being received, is_send_ready once its first part arrived and is_recv_ready once
+  // Receive() is called. Parts arriving before that are kept in staged.
+  struct RecvStatus {
+    bool is_send_ready = false;
+    bool is_recv_ready = false;
+    char* ptr = nullptr;
+    std::size_t max_size = 0;
+    std::size_t total_size = 0;
+    std::size_t received_size = 0;
+    std::function<void()> callback;
+    std::vector<char> staged;
+  };
+
+  struct Channel {
+    std::shared_ptr<ipc::SharedMemory> shm;
+    std::unique_ptr<ShmRing> ring;
+    ShmDoorbell* peer_doorbell = nullptr;
+    // The sends to the peer in order, only touched by the poller.
+    std::deque<PendingSend> sends;
+  };
+
+  void SetUpChannels(const std::vector<int64_t>& peers, CtrlClient* ctrl_client);
+  // Maps the doorbell of a peer once, returns nullptr if that fails.
+  ShmDoorbell* OpenPeerDoorbell(int64_t machine_id, CtrlClient* ctrl_client);
+  void PollChannels();
+  // Returns whether there was anything to do.
+  bool PollOnce(std::vector<std::function<void()>>* callbacks);
+  void PostReceive(PendingRecv* recv, std::vector<std::function<void()>>* callbacks);
+
+  int64_t this_machine_id_;
+  std::shared_ptr<ipc::SharedMemory> doorbell_shm_;
+  ShmDoorbell* doorbell_;
+  HashMap<int64_t, std::shared_ptr<ipc::SharedMemory>> peer_doorbell_shms_;
+  HashMap<int64_t, Channel> in_channels_;
+  HashMap<int64_t, Channel> out_channels_;
+
+  // Protects new_sends_ and new_recvs_, which the poller takes over.
+  std::mutex mutex_;
+  std::vector<std::pair<int64_t, PendingSend>> new_sends_;
+  std::vector<PendingRecv> new_recvs_;
+
+  // Only touched by the poller.
+  HashMap<uint64_t, RecvStatus> token2recv_status_;
+
+  std::atomic<bool> shutdown_;
+  std::thread poller_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_TRANSPORT_SHM_TRANSPORT_H_
+
+#endif  // __linux__
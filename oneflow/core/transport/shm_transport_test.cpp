@@ -0,0 +1,217 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include <future>
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/control/ctrl_bootstrap.pb.h"
+#include "oneflow/core/rpc/include/local.h"
+#include "oneflow/core/transport/shm_transport.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+ProcessCtx GetProcessCtx() {
+  ProcessCtx ctx;
+  ctx.add_ctrl_addr();
+  ctx.set_rank(0);
+  ctx.set_node_size(1);
+  return ctx;
+}
+
+class ShmEnvGuard final {
+ public:
+  ShmEnvGuard(const std::string& slot_num, const std::string& slot_bytes) {
+    setenv("ONEFLOW_TRANSPORT_SHM_SLOT_NUM", slot_num.c_str(), 1);
+    setenv("ONEFLOW_TRANSPORT_SHM_SLOT_BYTES", slot_bytes.c_str(), 1);
+  }
+  ~ShmEnvGuard() {
+    unsetenv("ONEFLOW_TRANSPORT_SHM_SLOT_NUM");
+    unsetenv("ONEFLOW_TRANSPORT_SHM_SLOT_BYTES");
+  }
+};
+
+// Drops the name of the ring from src to dst, as if the receiver failed to lay it out.
+class DroppingCtrlClient final : public LocalCtrlClient {
+ public:
+  DroppingCtrlClient(int64_t src, int64_t dst)
+      : LocalCtrlClient(GetProcessCtx()),
+        dropped_key_("ShmTransportRing/" + std::to_string(src) + "/" + std::to_string(dst)) {}
+
+  using LocalCtrlClient::PushKV;
+  void PushKV(const std::string& k, const std::string& v) override {
+    LocalCtrlClient::PushKV(k, k == dropped_key_ ? std::string() : v);
+  }
+
+ private:
+  std::string dropped_key_;
+};
+
+// Constructs one ShmTransport per machine concurrently, as the processes of a node do.
+std::vector<std::unique_ptr<ShmTransport>> NewTransports(int64_t machine_num,
+                                                          CtrlClient* ctrl_client) {
+  std::vector<std::unique_ptr<ShmTransport>> transports(machine_num);
+  std::vector<std::thread> threads;
+  for (int64_t i = 0; i < machine_num; ++i) {
+    threads.emplace_back([&, i]() {
+      std::vector<int64_t> peers;
+      for (int64_t j = 0; j < machine_num; ++j) {
+        if (j != i) { peers.emplace_back(j); }
+      }
+      transports.at(i).reset(new ShmTransport(i, peers, ctrl_client));
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  return transports;
+}
+
+std::vector<char> GenData(size_t size, int seed) {
+  std::vector<char> data(size);
+  for (size_t i = 0; i < size; ++i) { data[i] = static_cast<char>(i * 13 + seed); }
+  return data;
+}
+
+// Sends data from src to dst, posting the Receive() before or after the Send().
+void SendAndReceive(ShmTransport* src, int64_t src_id, ShmTransport* dst, int64_t dst_id,
+                    uint64_t token, const std::vector<char>& data, bool receive_first) {
+  std::vector<char> received(data.size() + 3);
+  std::promise<void> sent;
+  std::promise<void> done;
+  auto send = [&]() {
+    src->Send(token, dst_id, data.data(), data.size(), [&]() { sent.set_value(); });
+  };
+  auto receive = [&]() {
+    dst->Receive(token, src_id, received.data(), received.size(), [&]() { done.set_value(); });
+  };
+  if (receive_first) {
+    receive();
+    send();
+  } else {
+    send();
+    receive();
+  }
+  sent.get_future().wait();
+  done.get_future().wait();
+  ASSERT_TRUE(std::equal(data.begin(), data.end(), received.begin()));
+}
+
+}  // namespace
+
+TEST(ShmTransport, handshake) {
+  LocalCtrlClient ctrl_client(GetProcessCtx());
+  auto transports = NewTransports(3, &ctrl_client);
+  for (int64_t i = 0; i < 3; ++i) {
+    for (int64_t j = 0; j < 3; ++j) {
+      if (i == j) { continue; }
+      ASSERT_TRUE(transports.at(i)->CanSendTo(j));
+      ASSERT_TRUE(transports.at(i)->CanReceiveFrom(j));
+    }
+  }
+}
+
+TEST(ShmTransport, messages_larger_than_a_slot) {
+  ShmEnvGuard guard("2", "64");
+  LocalCtrlClient ctrl_client(GetProcessCtx());
+  auto transports = NewTransports(2, &ctrl_client);
+  uint64_t token = 0;
+  for (size_t size : std::vector<size_t>{0, 1, 64, 65, 1000, 100000}) {
+    for (bool receive_first : {false, true}) {
+      SendAndReceive(transports.at(0).get(), 0, transports.at(1).get(), 1, token,
+                     GenData(size, token), receive_first);
+      token += 1;
+      SendAndReceive(transports.at(1).get(), 1, transports.at(0).get(), 0, token,
+                     GenData(size, token), receive_first);
+      token += 1;
+    }
+  }
+}
+
+TEST(ShmTransport, interleaved_tokens) {
+  ShmEnvGuard guard("2", "64");
+  LocalCtrlClient ctrl_client(GetProcessCtx());
+  auto transports = NewTransports(2, &ctrl_client);
+  constexpr int kMsgNum = 16;
+  std::vector<std::vector<char>> data;
+  std::vector<std::vector<char>> received;
+  for (int i = 0; i < kMsgNum; ++i) {
+    data.emplace_back(GenData(100 * i + 7, i));
+    received.emplace_back(data.back().size());
+  }
+  std::atomic<int> pending(2 * kMsgNum);
+  for (int i = 0; i < kMsgNum; ++i) {
+    transports.at(0)->Send(i, 1, data.at(i).data(), data.at(i).size(), [&]() { --pending; });
+  }
+  // The receives come in the reverse order, so most messages are staged first.
+  for (int i = kMsgNum - 1; i >= 0; --i) {
+    transports.at(1)->Receive(i, 0, received.at(i).data(), received.at(i).size(),
+                              [&]() { --pending; });
+  }
+  while (pending > 0) { std::this_thread::yield(); }
+  for (int i = 0; i < kMsgNum; ++i) { ASSERT_EQ(data.at(i), received.at(i)); }
+}
+
+TEST(ShmTransport, wake_up_after_idle) {
+  LocalCtrlClient ctrl_client(GetProcessCtx());
+  auto transports = NewTransports(2, &ctrl_client);
+  for (uint64_t token = 0; token < 4; ++token) {
+    // Long enough for both pollers to fall asleep on their doorbells.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    SendAndReceive(transports.at(0).get(), 0, transports.at(1).get(), 1, token,
+                   GenData(4096, token), token % 2 == 0);
+  }
+}
+
+TEST(ShmTransport, fall_back_to_comm_net) {
+  DroppingCtrlClient ctrl_client(1, 2);
+  auto transports = NewTransports(3, &ctrl_client);
+  ASSERT_FALSE(transports.at(1)->CanSendTo(2));
+  ASSERT_FALSE(transports.at(2)->CanReceiveFrom(1));
+  ASSERT_TRUE(transports.at(2)->CanSendTo(1));
+  ASSERT_TRUE(transports.at(1)->CanReceiveFrom(2));
+  SendAndReceive(transports.at(2).get(), 2, transports.at(1).get(), 1, 0, GenData(1000, 0), true);
+  SendAndReceive(transports.at(0).get(), 0, transports.at(2).get(), 2, 1, GenData(1000, 1), false);
+}
+
+TEST(ShmDoorbell, wait_returns_once_rung) {
+  alignas(64) char memory[64];
+  ShmDoorbell* doorbell = ShmDoorbell::Create(memory);
+  const uint32_t seq = doorbell->seq();
+  doorbell->Ring();
+  // Rung since seq was read, so this doesn't block.
+  doorbell->Wait(seq);
+  std::atomic<bool> woken(false);
+  std::thread waiter([&]() {
+    uint32_t seq = doorbell->seq();
+    while (!woken.load()) {
+      doorbell->Wait(seq);
+      seq = doorbell->seq();
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  woken.store(true);
+  ShmDoorbell::Attach(memory)->Ring();
+  waiter.join();
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // __linux__
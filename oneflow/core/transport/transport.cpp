@@ -15,8 +15,10 @@ limitations under the License.
 */
 #ifdef __linux__
 
+#include "oneflow/core/common/env_var/env_var.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/transport/transport.h"
+#include "oneflow/core/profiler/counter.h"
 
 namespace oneflow {
 
@@ -26,10 +28,12 @@ Transport::Transport() {
   CHECK(comm_net_ != nullptr);
   // maybe need new read id for each dst machine id, maybe need 2 * machine num read ids
   read_id_ = comm_net_->NewActorReadId();
+  if (EnvBool<ONEFLOW_TRANSPORT_USE_SHM>()) { shm_transport_.reset(new ShmTransport()); }
   msg_poller_ = std::thread([this]() { PollMsgChannel(); });
 }
 
 Transport::~Transport() {
+  shm_transport_.reset();
   msg_channel_.Close();
   msg_poller_.join();
   comm_net_->DeleteActorReadId(read_id_);
@@ -165,6 +169,8 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
 void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size,
                      std::function<void()> callback) {
   void* mut_ptr = const_cast<void*>(ptr);
+  OF_COUNTER_ADD("transport.send_msgs", 1);
+  OF_COUNTER_ADD("transport.send_bytes", size);
 
   // handler for send to local machine
   if (dst_machine_id == this_machine_id_) {
@@ -172,6 +178,12 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
     return;
   }
 
+  // handler for send to the same node
+  if (shm_transport_ && shm_transport_->CanSendTo(dst_machine_id)) {
+    shm_transport_->Send(token, dst_machine_id, ptr, size, std::move(callback));
+    return;
+  }
+
   // prepare transport status for this token.
   // store callback.
   TransportStatus* stat = nullptr;
@@ -205,12 +217,19 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
 
 void Transport::Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::size_t max_size,
                         std::function<void()> callback) {
+  OF_COUNTER_ADD("transport.recv_msgs", 1);
   // handler for receive from local machine
   if (src_machine_id == this_machine_id_) {
     RecvFromLocalMachine(token, ptr, max_size, callback);
     return;
   }
 
+  // handler for receive from the same node
+  if (shm_transport_ && shm_transport_->CanReceiveFrom(src_machine_id)) {
+    shm_transport_->Receive(token, src_machine_id, ptr, max_size, std::move(callback));
+    return;
+  }
+
   // prepare transport status for this token.
   // store callback.
   TransportStatus* stat = nullptr;
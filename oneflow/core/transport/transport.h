@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/transport/shm_transport.h"
 #include "oneflow/core/transport/transport_message.h"
 
 namespace oneflow {
@@ -45,6 +46,9 @@ namespace oneflow {
 //
 // Transport supports send and receive data on local machine.
 //
+// Data between processes on the same node goes through ShmTransport unless
+// ONEFLOW_TRANSPORT_USE_SHM is off.
+//
 class Transport {
  public:
   OF_DISALLOW_COPY_AND_MOVE(Transport);
@@ -132,6 +136,7 @@ class Transport {
   int64_t this_machine_id_;
   void* read_id_;
   EpollCommNet* comm_net_;
+  std::unique_ptr<ShmTransport> shm_transport_;
 
   Channel<TransportMsg> msg_channel_;
   std::thread msg_poller_;
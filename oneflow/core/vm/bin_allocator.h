@@ -40,6 +40,10 @@ class BinAllocator final : public CachingAllocator {
     typename ThreadLock::RAIIGuard guard(thread_lock_);
     DeallocateFreeBlockForGarbageCollection();
   }
+  size_t total_memory_bytes() {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    return total_memory_bytes_;
+  }
 
  private:
   static constexpr int32_t kInvalidBinNum = -1;
@@ -370,8 +374,9 @@ bool BinAllocator<ThreadLock>::DeallocateFreeBlockForGarbageCollection() {
       }
       CHECK_EQ(block.size, piece_size_sum);
 
+      const size_t block_size = block.size;
       mem_ptr2block_.erase(it);
-      backend_->Deallocate(ptr, block.size);
+      backend_->Deallocate(ptr, block_size);
     }
   }
   return total_free_bytes > 0;
@@ -22,6 +22,8 @@ limitations under the License.
 #include "oneflow/core/vm/thread_ctx.h"
 #include "oneflow/core/vm/ep_optional_event_record_status_querier.h"
 #include "oneflow/core/vm/ep_backend_allocator.h"
+#include "oneflow/core/vm/thread_caching_host_allocator.h"
+#include "oneflow/core/common/env_var/vm.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/vm/remat/util.h"
 
@@ -42,6 +44,11 @@ std::unique_ptr<vm::Allocator> CreateEpBackendDeviceAllocator(Symbol<Device> dev
         Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(device_type, device_index);
     auto ep_backend_allocator =
         std::make_unique<EpBackendAllocator>(ep_device, ep::AllocationOptions{});
+    if (device_type == DeviceType::kCPU
+        && EnvBool<ONEFLOW_VM_ENABLE_THREAD_CACHING_HOST_ALLOCATOR>()) {
+      return std::make_unique<ThreadCachingHostAllocator>(ep::kMaxAlignmentRequirement,
+                                                          std::move(ep_backend_allocator));
+    }
     return std::make_unique<BinAllocator<ThreadSafeLock>>(ep::kMaxAlignmentRequirement,
                                                           std::move(ep_backend_allocator));
   }
@@ -0,0 +1,426 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/thread_caching_host_allocator.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+namespace oneflow {
+namespace vm {
+
+struct ThreadCachingHostAllocator::FreeBlock {
+  FreeBlock* next;
+};
+
+struct ThreadCachingHostAllocator::FreeList {
+  FreeBlock* head = nullptr;
+  int64_t num_blocks = 0;
+};
+
+namespace {
+
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+// Small blocks of one size class are carved out of slabs of this size.
+constexpr size_t kSlabSize = 256 * 1024;
+// A thread cache moves about this many bytes at once from or to the central free list.
+constexpr size_t kTransferBatchBytes = 32 * 1024;
+constexpr int64_t kMaxTransferBatchSize = 64;
+// Size classes are multiples of kSmallBlockAlignment up to this size, four classes per
+// power of two above it.
+constexpr size_t kMaxLinearClassSize = 4096;
+constexpr int32_t kNumLinearClasses = 8;
+
+using FreeBlock = ThreadCachingHostAllocator::FreeBlock;
+using FreeList = ThreadCachingHostAllocator::FreeList;
+
+int64_t TransferBatchSize(int32_t size_class) {
+  const int64_t num_blocks =
+      kTransferBatchBytes / ThreadCachingHostAllocator::Size4SizeClass(size_class);
+  return std::min(std::max<int64_t>(num_blocks, 2), kMaxTransferBatchSize);
+}
+
+// Detaches the first num_blocks blocks of list, which must have at least num_blocks blocks.
+FreeList PopFront(FreeList* list, int64_t num_blocks) {
+  CHECK_GT(num_blocks, 0);
+  CHECK_GE(list->num_blocks, num_blocks);
+  FreeList front;
+  front.head = list->head;
+  front.num_blocks = num_blocks;
+  FreeBlock* tail = list->head;
+  for (int64_t i = 1; i < num_blocks; ++i) { tail = tail->next; }
+  list->head = tail->next;
+  list->num_blocks -= num_blocks;
+  tail->next = nullptr;
+  return front;
+}
+
+void PushFront(FreeList* list, FreeList* blocks) {
+  if (blocks->num_blocks == 0) { return; }
+  FreeBlock* tail = blocks->head;
+  while (tail->next != nullptr) { tail = tail->next; }
+  tail->next = list->head;
+  list->head = blocks->head;
+  list->num_blocks += blocks->num_blocks;
+  blocks->head = nullptr;
+  blocks->num_blocks = 0;
+}
+
+// Counters of a thread cache are only written by the owner thread and read by GetStats.
+void AddToCounter(std::atomic<int64_t>* counter, int64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+double Ratio(int64_t numerator, int64_t denominator) {
+  return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+}  // namespace
+
+struct ThreadCachingHostAllocator::Central {
+  struct alignas(64) LockedFreeList {
+    std::mutex mutex;
+    FreeList list;
+  };
+  std::array<LockedFreeList, kNumSizeClasses> free_lists;
+  std::atomic<int64_t> reserved_bytes{0};
+
+  // guards the fields below
+  std::mutex mutex;
+  // false once the allocator starts destructing, its memory must not be touched any more
+  bool alive = true;
+  std::vector<ThreadCache*> caches;
+  int64_t exited_in_use_bytes = 0;
+  int64_t exited_class_bytes = 0;
+};
+
+struct ThreadCachingHostAllocator::ThreadCache {
+  OF_DISALLOW_COPY_AND_MOVE(ThreadCache);
+  ThreadCache(const std::shared_ptr<Central>& central, ThreadCacheRegistry* registry)
+      : central(central), registry(registry) {}
+  ~ThreadCache() = default;
+
+  // Gives all cached blocks back when the owner thread exits.
+  void ReturnToCentral() {
+    std::shared_ptr<Central> locked_central = central.lock();
+    if (!locked_central) { return; }
+    std::unique_lock<std::mutex> lock(locked_central->mutex);
+    if (!locked_central->alive) { return; }
+    std::unique_lock<std::mutex> cache_lock(mutex);
+    for (int32_t size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+      auto* central_list = &locked_central->free_lists.at(size_class);
+      std::unique_lock<std::mutex> list_lock(central_list->mutex);
+      PushFront(&central_list->list, &free_lists.at(size_class));
+    }
+    locked_central->exited_in_use_bytes += in_use_bytes.load(std::memory_order_relaxed);
+    locked_central->exited_class_bytes += class_bytes.load(std::memory_order_relaxed);
+    auto& caches = locked_central->caches;
+    caches.erase(std::remove(caches.begin(), caches.end(), this), caches.end());
+  }
+
+  // Taken by the owner thread around every access to free_lists and by Shrink of other
+  // threads. Lock order: Central::mutex, ThreadCache::mutex, Central::LockedFreeList::mutex.
+  std::mutex mutex;
+  std::array<FreeList, kNumSizeClasses> free_lists;
+  std::atomic<int64_t> in_use_bytes{0};
+  std::atomic<int64_t> class_bytes{0};
+  std::weak_ptr<Central> central;
+  ThreadCacheRegistry* const registry;
+};
+
+// The thread caches of one thread, one per allocator. The destructor of an allocator removes
+// its entries from the registries of all threads.
+struct ThreadCachingHostAllocator::ThreadCacheRegistry {
+  ThreadCacheRegistry() = default;
+  ~ThreadCacheRegistry() {
+    std::vector<std::pair<uint64_t, std::unique_ptr<ThreadCache>>> exited_caches;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      exited_caches.swap(caches);
+    }
+    for (const auto& pair : exited_caches) { pair.second->ReturnToCentral(); }
+  }
+
+  // only accessed by the owner thread, uids are never reused so a stale entry never matches
+  uint64_t last_uid = std::numeric_limits<uint64_t>::max();
+  ThreadCache* last_cache = nullptr;
+  // guards caches, which destructing allocators update from other threads
+  std::mutex mutex;
+  std::vector<std::pair<uint64_t, std::unique_ptr<ThreadCache>>> caches;
+};
+
+namespace {
+
+uint64_t NewAllocatorUid() {
+  static std::atomic<uint64_t> next_uid(0);
+  return next_uid.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Maybe<void> HugePageHostBackendAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  const size_t aligned_size = RoundUp(size, kHugePageSize);
+  // over-map by one huge page so that the result can be aligned to a huge page boundary
+  const size_t map_size = aligned_size + kHugePageSize;
+  void* ptr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    // BinAllocator reports the out of memory error
+    *mem_ptr = nullptr;
+    return Maybe<void>::Ok();
+  }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t aligned_begin = RoundUp(begin, kHugePageSize);
+  const uintptr_t aligned_end = aligned_begin + aligned_size;
+  if (aligned_begin > begin) {
+    PCHECK(munmap(ptr, aligned_begin - begin) == 0);
+  }
+  if (begin + map_size > aligned_end) {
+    PCHECK(munmap(reinterpret_cast<void*>(aligned_end), begin + map_size - aligned_end) == 0);
+  }
+#ifdef MADV_HUGEPAGE
+  // only a hint, the memory is still usable if transparent huge pages are disabled
+  madvise(reinterpret_cast<void*>(aligned_begin), aligned_size, MADV_HUGEPAGE);
+#endif  // MADV_HUGEPAGE
+  *mem_ptr = reinterpret_cast<char*>(aligned_begin);
+  return Maybe<void>::Ok();
+}
+
+void HugePageHostBackendAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  PCHECK(munmap(mem_ptr, RoundUp(size, kHugePageSize)) == 0);
+}
+
+std::string ThreadCachingHostAllocatorStats::ToString() const {
+  std::ostringstream ss;
+  ss << "small blocks: in use " << small_in_use_bytes << " bytes, size classes "
+     << small_class_bytes << " bytes, thread caches " << small_thread_cached_bytes
+     << " bytes, slabs " << small_reserved_bytes
+     << " bytes, internal fragmentation "
+     << 1.0 - Ratio(small_in_use_bytes, small_class_bytes) << ", external fragmentation "
+     << 1.0 - Ratio(small_class_bytes, small_reserved_bytes) << "; bin blocks: in use "
+     << bin_in_use_bytes << " bytes, reserved " << bin_reserved_bytes
+     << " bytes, fragmentation " << 1.0 - Ratio(bin_in_use_bytes, bin_reserved_bytes);
+  return ss.str();
+}
+
+ThreadCachingHostAllocator::ThreadCachingHostAllocator(size_t alignment,
+                                                       std::unique_ptr<Allocator>&& backend)
+    : uid_(NewAllocatorUid()),
+      mid_allocator_(new BinAllocator<ThreadSafeLock>(alignment, std::move(backend))),
+      // slabs of small blocks are taken from the large allocator
+      large_allocator_(new BinAllocator<ThreadSafeLock>(
+          std::max(alignment, kSmallBlockAlignment),
+          std::make_unique<HugePageHostBackendAllocator>())),
+      central_(std::make_shared<Central>()),
+      bin_in_use_bytes_(0) {
+  CHECK_LE(alignment, kHugePageSize);
+  CHECK_EQ(Size4SizeClass(kNumSizeClasses - 1), kMaxSmallBlockSize);
+  CHECK_EQ(kSlabSize % kSmallBlockAlignment, 0);
+}
+
+ThreadCachingHostAllocator::~ThreadCachingHostAllocator() {
+  VLOG(1) << "ThreadCachingHostAllocator " << uid_ << " " << GetStats().ToString();
+  // destroyed after the lock is released
+  std::vector<std::unique_ptr<ThreadCache>> caches;
+  std::unique_lock<std::mutex> lock(central_->mutex);
+  central_->alive = false;
+  for (ThreadCache* cache : central_->caches) {
+    // A registry whose thread is exiting may have detached the cache already. It then blocks
+    // in ReturnToCentral on central_->mutex, so the registry outlives this loop.
+    ThreadCacheRegistry* registry = cache->registry;
+    std::unique_lock<std::mutex> registry_lock(registry->mutex);
+    auto it = std::find_if(registry->caches.begin(), registry->caches.end(),
+                           [&](const auto& pair) { return pair.first == uid_; });
+    if (it == registry->caches.end()) { continue; }
+    caches.emplace_back(std::move(it->second));
+    registry->caches.erase(it);
+  }
+  central_->caches.clear();
+}
+
+/*static*/ int32_t ThreadCachingHostAllocator::SizeClass4Size(size_t size) {
+  CHECK_GT(size, 0);
+  CHECK_LE(size, kMaxSmallBlockSize);
+  if (size <= kMaxLinearClassSize) {
+    return static_cast<int32_t>((size + kSmallBlockAlignment - 1) / kSmallBlockAlignment) - 1;
+  }
+  const uint64_t value = size - 1;
+  const int32_t log2 = 63 ^ __builtin_clzll(value);
+  return kNumLinearClasses + (log2 - 12) * 4 + static_cast<int32_t>((value >> (log2 - 2)) & 3);
+}
+
+/*static*/ size_t ThreadCachingHostAllocator::Size4SizeClass(int32_t size_class) {
+  if (size_class < kNumLinearClasses) { return (size_class + 1) * kSmallBlockAlignment; }
+  const int32_t log2 = 12 + (size_class - kNumLinearClasses) / 4;
+  const size_t step = static_cast<size_t>(1) << (log2 - 2);
+  return (static_cast<size_t>(1) << log2) + ((size_class - kNumLinearClasses) % 4 + 1) * step;
+}
+
+ThreadCachingHostAllocator::ThreadCache* ThreadCachingHostAllocator::GetThreadCache() {
+  static thread_local ThreadCacheRegistry registry;
+  if (registry.last_uid == uid_) { return registry.last_cache; }
+  ThreadCache* cache = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    for (const auto& pair : registry.caches) {
+      if (pair.first == uid_) {
+        cache = pair.second.get();
+        break;
+      }
+    }
+  }
+  if (cache == nullptr) {
+    // only the owner thread adds entries, registry.mutex is never held while locking Central
+    auto new_cache = std::make_unique<ThreadCache>(central_, &registry);
+    cache = new_cache.get();
+    {
+      std::unique_lock<std::mutex> lock(central_->mutex);
+      central_->caches.emplace_back(cache);
+    }
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    registry.caches.emplace_back(uid_, std::move(new_cache));
+  }
+  registry.last_uid = uid_;
+  registry.last_cache = cache;
+  return cache;
+}
+
+Maybe<void> ThreadCachingHostAllocator::Refill(ThreadCache* cache, int32_t size_class) {
+  auto* central_list = &central_->free_lists.at(size_class);
+  std::unique_lock<std::mutex> lock(central_list->mutex);
+  if (central_list->list.num_blocks == 0) {
+    char* slab = nullptr;
+    JUST(large_allocator_->Allocate(&slab, kSlabSize));
+    central_->reserved_bytes.fetch_add(kSlabSize, std::memory_order_relaxed);
+    const size_t block_size = Size4SizeClass(size_class);
+    for (size_t offset = 0; offset + block_size <= kSlabSize; offset += block_size) {
+      auto* block = reinterpret_cast<FreeBlock*>(slab + offset);
+      block->next = central_list->list.head;
+      central_list->list.head = block;
+      central_list->list.num_blocks += 1;
+    }
+  }
+  FreeList blocks = PopFront(
+      &central_list->list, std::min(TransferBatchSize(size_class), central_list->list.num_blocks));
+  lock.unlock();
+  PushFront(&cache->free_lists.at(size_class), &blocks);
+  return Maybe<void>::Ok();
+}
+
+void ThreadCachingHostAllocator::Release(ThreadCache* cache, int32_t size_class,
+                                         int64_t num_blocks) {
+  FreeList blocks = PopFront(&cache->free_lists.at(size_class), num_blocks);
+  auto* central_list = &central_->free_lists.at(size_class);
+  std::unique_lock<std::mutex> lock(central_list->mutex);
+  PushFront(&central_list->list, &blocks);
+}
+
+Maybe<void> ThreadCachingHostAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  if (size == 0) {
+    *mem_ptr = nullptr;
+    return Maybe<void>::Ok();
+  }
+  if (size <= kMaxSmallBlockSize) {
+    const int32_t size_class = SizeClass4Size(size);
+    ThreadCache* cache = GetThreadCache();
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    FreeList* list = &cache->free_lists.at(size_class);
+    if (list->num_blocks == 0) { JUST(Refill(cache, size_class)); }
+    FreeBlock* block = list->head;
+    list->head = block->next;
+    list->num_blocks -= 1;
+    AddToCounter(&cache->in_use_bytes, size);
+    AddToCounter(&cache->class_bytes, Size4SizeClass(size_class));
+    *mem_ptr = reinterpret_cast<char*>(block);
+    return Maybe<void>::Ok();
+  }
+  if (size >= kMinLargeBlockSize) {
+    JUST(large_allocator_->Allocate(mem_ptr, size));
+  } else {
+    JUST(mid_allocator_->Allocate(mem_ptr, size));
+  }
+  bin_in_use_bytes_.fetch_add(size, std::memory_order_relaxed);
+  return Maybe<void>::Ok();
+}
+
+void ThreadCachingHostAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  if (mem_ptr == nullptr) { return; }
+  if (size <= kMaxSmallBlockSize) {
+    const int32_t size_class = SizeClass4Size(size);
+    ThreadCache* cache = GetThreadCache();
+    std::unique_lock<std::mutex> lock(cache->mutex);
+    FreeList* list = &cache->free_lists.at(size_class);
+    auto* block = reinterpret_cast<FreeBlock*>(mem_ptr);
+    block->next = list->head;
+    list->head = block;
+    list->num_blocks += 1;
+    AddToCounter(&cache->in_use_bytes, -static_cast<int64_t>(size));
+    AddToCounter(&cache->class_bytes, -static_cast<int64_t>(Size4SizeClass(size_class)));
+    const int64_t batch_size = TransferBatchSize(size_class);
+    if (list->num_blocks > 2 * batch_size) { Release(cache, size_class, batch_size); }
+    return;
+  }
+  if (size >= kMinLargeBlockSize) {
+    large_allocator_->Deallocate(mem_ptr, size);
+  } else {
+    mid_allocator_->Deallocate(mem_ptr, size);
+  }
+  bin_in_use_bytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void ThreadCachingHostAllocator::Shrink() {
+  {
+    std::unique_lock<std::mutex> lock(central_->mutex);
+    for (ThreadCache* cache : central_->caches) {
+      std::unique_lock<std::mutex> cache_lock(cache->mutex);
+      for (int32_t size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+        const int64_t num_blocks = cache->free_lists.at(size_class).num_blocks;
+        if (num_blocks > 0) { Release(cache, size_class, num_blocks); }
+      }
+    }
+  }
+  mid_allocator_->Shrink();
+  large_allocator_->Shrink();
+}
+
+ThreadCachingHostAllocatorStats ThreadCachingHostAllocator::GetStats() {
+  ThreadCachingHostAllocatorStats stats;
+  {
+    std::unique_lock<std::mutex> lock(central_->mutex);
+    stats.small_in_use_bytes = central_->exited_in_use_bytes;
+    stats.small_class_bytes = central_->exited_class_bytes;
+    for (ThreadCache* cache : central_->caches) {
+      stats.small_in_use_bytes += cache->in_use_bytes.load(std::memory_order_relaxed);
+      stats.small_class_bytes += cache->class_bytes.load(std::memory_order_relaxed);
+      std::unique_lock<std::mutex> cache_lock(cache->mutex);
+      for (int32_t size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+        stats.small_thread_cached_bytes +=
+            cache->free_lists.at(size_class).num_blocks * Size4SizeClass(size_class);
+      }
+    }
+  }
+  stats.small_reserved_bytes = central_->reserved_bytes.load(std::memory_order_relaxed);
+  stats.bin_in_use_bytes = bin_in_use_bytes_.load(std::memory_order_relaxed);
+  // the slabs of small blocks are part of the memory reserved by the large block allocator
+  stats.bin_reserved_bytes = mid_allocator_->total_memory_bytes()
+                             + large_allocator_->total_memory_bytes()
+                             - stats.small_reserved_bytes;
+  return stats;
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -0,0 +1,115 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_THREAD_CACHING_HOST_ALLOCATOR_H_
+#define ONEFLOW_CORE_VM_THREAD_CACHING_HOST_ALLOCATOR_H_
+
+#include "oneflow/core/ep/include/device.h"
+#include "oneflow/core/vm/bin_allocator.h"
+#include "oneflow/core/vm/thread_safe_guard.h"
+
+namespace oneflow {
+namespace vm {
+
+// Backend which maps anonymous memory in multiples of 2MB and asks the kernel to back it with
+// transparent huge pages.
+class HugePageHostBackendAllocator final : public Allocator {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HugePageHostBackendAllocator);
+  HugePageHostBackendAllocator() = default;
+  ~HugePageHostBackendAllocator() override = default;
+
+  Maybe<void> Allocate(char** mem_ptr, std::size_t size) override;
+  void Deallocate(char* mem_ptr, std::size_t size) override;
+  void DeviceReset() override {}
+};
+
+struct ThreadCachingHostAllocatorStats {
+  // requested bytes of the live small blocks
+  int64_t small_in_use_bytes = 0;
+  // size class bytes of the live small blocks
+  int64_t small_class_bytes = 0;
+  // size class bytes of the free small blocks held by thread caches
+  int64_t small_thread_cached_bytes = 0;
+  // bytes of the slabs which are carved into small blocks
+  int64_t small_reserved_bytes = 0;
+  // requested bytes of the live mid-size and large blocks
+  int64_t bin_in_use_bytes = 0;
+  // bytes reserved by the mid-size and large BinAllocators
+  int64_t bin_reserved_bytes = 0;
+
+  std::string ToString() const;
+};
+
+// Host allocator for eager mode, where many small tensors are created and freed on several
+// stream threads.
+//
+//   - Small blocks (<= kMaxSmallBlockSize) are rounded up to one of kNumSizeClasses size
+//     classes and served by a per-thread cache. The lock of a cache is only contended by
+//     Shrink. A cache refills from and releases to a central free list of its size class in
+//     batches. The central lists carve new blocks out of slabs taken from the large block
+//     allocator.
+//   - Mid-size blocks are served by a BinAllocator on top of the given backend.
+//   - Large blocks (>= kMinLargeBlockSize) are served by a BinAllocator on top of
+//     HugePageHostBackendAllocator.
+//
+// Deallocate must be called with the size passed to Allocate, which decides the tier of a
+// block. Every size class is a multiple of kSmallBlockAlignment, so small blocks keep the
+// alignment of ep::kMaxAlignmentRequirement as well.
+class ThreadCachingHostAllocator final : public CachingAllocator {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ThreadCachingHostAllocator);
+  ThreadCachingHostAllocator(size_t alignment, std::unique_ptr<Allocator>&& backend);
+  ~ThreadCachingHostAllocator() override;
+
+  Maybe<void> Allocate(char** mem_ptr, std::size_t size) override;
+  void Deallocate(char* mem_ptr, std::size_t size) override;
+  void DeviceReset() override { mid_allocator_->DeviceReset(); }
+  // Releases the caches of all threads and the free blocks of the BinAllocators. Slabs of
+  // small blocks are kept.
+  void Shrink() override;
+
+  ThreadCachingHostAllocatorStats GetStats();
+
+  static constexpr size_t kSmallBlockAlignment = ep::kMaxAlignmentRequirement;
+  static constexpr size_t kMaxSmallBlockSize = 32 * 1024;
+  static constexpr size_t kMinLargeBlockSize = 1024 * 1024;
+  static constexpr int32_t kNumSizeClasses = 20;
+
+  static int32_t SizeClass4Size(size_t size);
+  static size_t Size4SizeClass(int32_t size_class);
+
+  struct FreeBlock;
+  struct FreeList;
+  struct Central;
+  struct ThreadCache;
+  struct ThreadCacheRegistry;
+
+ private:
+  ThreadCache* GetThreadCache();
+  Maybe<void> Refill(ThreadCache* cache, int32_t size_class);
+  void Release(ThreadCache* cache, int32_t size_class, int64_t num_blocks);
+
+  const uint64_t uid_;
+  std::unique_ptr<BinAllocator<ThreadSafeLock>> mid_allocator_;
+  std::unique_ptr<BinAllocator<ThreadSafeLock>> large_allocator_;
+  std::shared_ptr<Central> central_;
+  std::atomic<int64_t> bin_in_use_bytes_;
+};
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_THREAD_CACHING_HOST_ALLOCATOR_H_
@@ -0,0 +1,216 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/vm/thread_caching_host_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+class MallocBackendAllocator final : public Allocator {
+ public:
+  MallocBackendAllocator() = default;
+  ~MallocBackendAllocator() override = default;
+
+  Maybe<void> Allocate(char** mem_ptr, std::size_t size) override {
+    *mem_ptr = static_cast<char*>(aligned_alloc(512, RoundUp(size, 512)));
+    return Maybe<void>::Ok();
+  }
+  void Deallocate(char* mem_ptr, std::size_t size) override { free(mem_ptr); }
+  void DeviceReset() override {}
+};
+
+std::unique_ptr<ThreadCachingHostAllocator> NewAllocator() {
+  return std::make_unique<ThreadCachingHostAllocator>(512,
+                                                      std::make_unique<MallocBackendAllocator>());
+}
+
+}  // namespace
+
+TEST(ThreadCachingHostAllocator, SizeClass) {
+  using Allocator = ThreadCachingHostAllocator;
+  size_t prev_size = 0;
+  for (int32_t size_class = 0; size_class < Allocator::kNumSizeClasses; ++size_class) {
+    const size_t size = Allocator::Size4SizeClass(size_class);
+    ASSERT_GT(size, prev_size);
+    ASSERT_EQ(size % Allocator::kSmallBlockAlignment, 0);
+    ASSERT_EQ(Allocator::SizeClass4Size(size), size_class);
+    ASSERT_EQ(Allocator::SizeClass4Size(prev_size + 1), size_class);
+    prev_size = size;
+  }
+  ASSERT_EQ(prev_size, Allocator::kMaxSmallBlockSize);
+}
+
+TEST(ThreadCachingHostAllocator, AllocateAndDeallocate) {
+  auto allocator = NewAllocator();
+  const std::vector<size_t> sizes = {1,    63,   64,   65,    1000,   1025,   4096,
+                                     9999, 32768, 32769, 500000, 1048576, 3000000};
+  std::vector<char*> ptrs;
+  for (int i = 0; i < 64; ++i) {
+    for (size_t size : sizes) {
+      char* ptr = nullptr;
+      CHECK_JUST(allocator->Allocate(&ptr, size));
+      ASSERT_NE(ptr, nullptr);
+      ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % ThreadCachingHostAllocator::kSmallBlockAlignment,
+                0);
+      std::memset(ptr, i, size);
+      ptrs.emplace_back(ptr);
+    }
+  }
+  for (int i = 0; i < 64; ++i) {
+    for (size_t j = 0; j < sizes.size(); ++j) {
+      const char* ptr = ptrs.at(i * sizes.size() + j);
+      ASSERT_EQ(ptr[0], static_cast<char>(i));
+      ASSERT_EQ(ptr[sizes.at(j) - 1], static_cast<char>(i));
+    }
+  }
+  auto stats = allocator->GetStats();
+  size_t small_bytes = 0;
+  size_t bin_bytes = 0;
+  for (size_t size : sizes) {
+    (size <= ThreadCachingHostAllocator::kMaxSmallBlockSize ? small_bytes : bin_bytes) += size * 64;
+  }
+  ASSERT_EQ(stats.small_in_use_bytes, small_bytes);
+  ASSERT_GE(stats.small_class_bytes, stats.small_in_use_bytes);
+  ASSERT_GE(stats.small_reserved_bytes, stats.small_class_bytes);
+  ASSERT_EQ(stats.bin_in_use_bytes, bin_bytes);
+  ASSERT_GE(stats.bin_reserved_bytes, stats.bin_in_use_bytes);
+  for (int i = 0; i < 64; ++i) {
+    for (size_t j = 0; j < sizes.size(); ++j) {
+      allocator->Deallocate(ptrs.at(i * sizes.size() + j), sizes.at(j));
+    }
+  }
+  ASSERT_GT(allocator->GetStats().small_thread_cached_bytes, 0);
+  allocator->Shrink();
+  stats = allocator->GetStats();
+  ASSERT_EQ(stats.small_in_use_bytes, 0);
+  ASSERT_EQ(stats.small_class_bytes, 0);
+  ASSERT_EQ(stats.small_thread_cached_bytes, 0);
+  ASSERT_EQ(stats.bin_in_use_bytes, 0);
+}
+
+TEST(ThreadCachingHostAllocator, CrossThreadDeallocate) {
+  auto allocator = NewAllocator();
+  const int num_threads = 4;
+  const int num_blocks = 10000;
+  std::vector<std::vector<char*>> ptrs(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < num_blocks; ++i) {
+        char* ptr = nullptr;
+        CHECK_JUST(allocator->Allocate(&ptr, 16 + i % 2048));
+        *reinterpret_cast<int*>(ptr) = t * num_blocks + i;
+        ptrs.at(t).emplace_back(ptr);
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  threads.clear();
+  std::set<char*> unique_ptrs;
+  for (int t = 0; t < num_threads; ++t) {
+    for (int i = 0; i < num_blocks; ++i) {
+      ASSERT_EQ(*reinterpret_cast<int*>(ptrs.at(t).at(i)), t * num_blocks + i);
+      ASSERT_TRUE(unique_ptrs.insert(ptrs.at(t).at(i)).second);
+    }
+  }
+  // every thread frees the blocks allocated by its neighbour
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      const auto& thread_ptrs = ptrs.at((t + 1) % num_threads);
+      for (int i = 0; i < num_blocks; ++i) {
+        allocator->Deallocate(thread_ptrs.at(i), 16 + i % 2048);
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  const auto stats = allocator->GetStats();
+  ASSERT_EQ(stats.small_in_use_bytes, 0);
+  ASSERT_EQ(stats.small_class_bytes, 0);
+}
+
+TEST(ThreadCachingHostAllocator, ShrinkOtherThreads) {
+  auto allocator = NewAllocator();
+  const int num_threads = 4;
+  std::mutex mutex;
+  std::condition_variable cond;
+  int num_done = 0;
+  bool shrunk = false;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&]() {
+      std::vector<char*> ptrs;
+      for (int i = 0; i < 1000; ++i) {
+        char* ptr = nullptr;
+        CHECK_JUST(allocator->Allocate(&ptr, 1 + i % 4096));
+        ptrs.emplace_back(ptr);
+      }
+      for (int i = 0; i < 1000; ++i) { allocator->Deallocate(ptrs.at(i), 1 + i % 4096); }
+      std::unique_lock<std::mutex> lock(mutex);
+      num_done += 1;
+      cond.notify_all();
+      // keep the thread and its cache alive until the main thread has called Shrink
+      cond.wait(lock, [&]() { return shrunk; });
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return num_done == num_threads; });
+  }
+  ASSERT_GT(allocator->GetStats().small_thread_cached_bytes, 0);
+  allocator->Shrink();
+  const auto stats = allocator->GetStats();
+  ASSERT_EQ(stats.small_thread_cached_bytes, 0);
+  ASSERT_EQ(stats.small_in_use_bytes, 0);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    shrunk = true;
+    cond.notify_all();
+  }
+  for (auto& thread : threads) { thread.join(); }
+}
+
+TEST(ThreadCachingHostAllocator, DestroyWhileThreadsAlive) {
+  const int num_threads = 4;
+  const int num_allocators = 16;
+  std::vector<std::thread> threads;
+  std::atomic<int> round(0);
+  std::atomic<int> num_ready(0);
+  std::unique_ptr<ThreadCachingHostAllocator> allocator;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&]() {
+      for (int r = 1; r <= num_allocators; ++r) {
+        while (round.load() < r) {}
+        char* ptr = nullptr;
+        CHECK_JUST(allocator->Allocate(&ptr, 100));
+        allocator->Deallocate(ptr, 100);
+        num_ready.fetch_add(1);
+      }
+    });
+  }
+  // every allocator leaves a cache in each thread and is destroyed before the threads exit
+  for (int r = 1; r <= num_allocators; ++r) {
+    allocator = NewAllocator();
+    round.store(r);
+    while (num_ready.load() < r * num_threads) {}
+    allocator.reset();
+  }
+  for (auto& thread : threads) { thread.join(); }
+}
+
+}  // namespace vm
+}  // namespace oneflow
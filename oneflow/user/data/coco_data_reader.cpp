@@ -51,7 +51,10 @@ COCODataReader::COCODataReader(user_op::KernelInitContext* ctx) : DataReader<COC
     loader_.reset(new BatchDataset<COCOImage>(batch_size_, std::move(loader_)));
   }
 
-  parser_.reset(new COCOParser(meta));
+  parser_.reset(new COCOParser(
+      meta, ctx->Attr<int64_t>("session_id"), ctx->has_output("gt_bbox", 0),
+      ctx->has_output("gt_label", 0),
+      ctx->has_output("gt_segm", 0) && ctx->has_output("gt_segm_index", 0)));
   StartLoadThread();
 }
 
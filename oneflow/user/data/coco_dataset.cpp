@@ -15,8 +15,6 @@ limitations under the License.
 */
 #include "oneflow/user/data/coco_dataset.h"
 #include "oneflow/user/data/coco_data_reader.h"
-#include "oneflow/core/persistence/file_system.h"
-#include "oneflow/core/persistence/persistent_in_stream.h"
 
 namespace oneflow {
 namespace data {
@@ -29,11 +27,6 @@ COCODataset::BatchType COCODataset::At(int64_t index) const {
   sample.id = meta_->GetImageId(index);
   sample.height = meta_->GetImageHeight(index);
   sample.width = meta_->GetImageWidth(index);
-  const std::string& image_file_path = meta_->GetImageFilePath(index);
-  PersistentInStream in_stream(session_id_, DataFS(), image_file_path);
-  int64_t file_size = DataFS()->GetFileSize(image_file_path);
-  sample.data.Resize(Shape({file_size}), DataType::kChar);
-  CHECK_EQ(in_stream.ReadFully(sample.data.mut_data<char>(), sample.data.nbytes()), 0);
   return batch;
 }
 
@@ -28,6 +28,11 @@ struct COCOImage {
   int64_t id;
   int32_t height;
   int32_t width;
+  // data and the annotations below are filled by COCOParser::Prepare
+  TensorBuffer bbox;
+  TensorBuffer label;
+  TensorBuffer segm;
+  TensorBuffer segm_index;
 };
 
 class COCOMeta;
@@ -39,7 +44,7 @@ class COCODataset final : public RandomAccessDataset<COCOImage> {
   using BatchType = typename Base::BatchType;
 
   COCODataset(user_op::KernelInitContext* ctx, const std::shared_ptr<const COCOMeta>& meta)
-      : meta_(meta), session_id_(ctx->Attr<int64_t>("session_id")) {}
+      : meta_(meta) {}
   ~COCODataset() = default;
 
   BatchType At(int64_t index) const override;
@@ -47,7 +52,6 @@ class COCODataset final : public RandomAccessDataset<COCOImage> {
 
  private:
   std::shared_ptr<const COCOMeta> meta_;
-  int64_t session_id_;
 };
 
 }  // namespace data
@@ -30,13 +30,27 @@ class COCOParser final : public Parser<COCOImage> {
   using SampleType = typename Base::SampleType;
   using BatchType = typename Base::BatchType;
 
-  COCOParser(const std::shared_ptr<const COCOMeta>& meta) : meta_(meta){};
+  COCOParser(const std::shared_ptr<const COCOMeta>& meta, int64_t session_id, bool has_bbox,
+             bool has_label, bool has_segm)
+      : meta_(meta),
+        session_id_(session_id),
+        has_bbox_(has_bbox),
+        has_label_(has_label),
+        has_segm_(has_segm){};
   ~COCOParser() = default;
 
+  // Reads the image file and builds the annotations of every sample which have an output.
+  // The samples are handled one after another, DataReader prepares batches in parallel.
+  bool HasPrepare() const override { return true; }
+  void Prepare(BatchType* batch_data) const override;
   void Parse(BatchType& batch_data, user_op::KernelComputeContext* ctx) override;
 
  private:
   std::shared_ptr<const COCOMeta> meta_;
+  int64_t session_id_;
+  bool has_bbox_;
+  bool has_label_;
+  bool has_segm_;
 };
 
 }  // namespace data
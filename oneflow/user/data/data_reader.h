@@ -16,16 +16,51 @@ limitations under the License.
 #ifndef ONEFLOW_USER_DATA_DATA_READER_H_
 #define ONEFLOW_USER_DATA_DATA_READER_H_
 
+#include <chrono>
+#include <map>
 #include "oneflow/user/data/dataset.h"
 #include "oneflow/user/data/parser.h"
-#include "oneflow/core/common/buffer.h"
+#include "oneflow/core/common/env_var/data.h"
 
 namespace oneflow {
 
 namespace data {
 
-static const int32_t kDataReaderBatchBufferSize = 4;
+struct DataReaderStats {
+  int64_t num_batches = 0;
+  // time spent by the load thread in Dataset::Next
+  int64_t load_ns = 0;
+  // time spent by the workers in Parser::Prepare, summed over all workers
+  int64_t prepare_ns = 0;
+  // time Read waited for a prepared batch
+  int64_t wait_ns = 0;
+  // time spent by Read in Parser::Parse
+  int64_t parse_ns = 0;
+  int64_t prefetch_depth = 0;
 
+  std::string ToString() const {
+    std::ostringstream ss;
+    const double num = std::max<int64_t>(num_batches, 1) * 1e6;
+    ss << "batches: " << num_batches << ", prefetch depth: " << prefetch_depth
+       << ", load ms/batch: " << load_ns / num << ", prepare ms/batch: " << prepare_ns / num
+       << ", wait ms/batch: " << wait_ns / num << ", parse ms/batch: " << parse_ns / num;
+    return ss.str();
+  }
+};
+
+// Runs the batches of loader_ through a pipeline:
+//
+//   - a load thread calls loader_->Next(), datasets are sequential so there is only one;
+//   - ONEFLOW_DATA_READER_NUM_WORKERS workers run parser_->Prepare on different batches at the
+//     same time, their batches are handed out in load order or, if ONEFLOW_DATA_READER_ORDERED
+//     is false, in the order they finish. Without parser_->HasPrepare() there are no workers
+//     and the load thread hands its batches out directly;
+//   - Read waits for the next prepared batch and runs parser_->Parse, which only has to move
+//     the prepared results into the output tensors.
+//
+// At most prefetch depth batches are between loaded and read. The depth starts at
+// ONEFLOW_DATA_READER_MIN_PREFETCH_DEPTH, grows whenever Read has to wait and shrinks again
+// after Read found its batch ready for a while, up to ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH.
 template<typename LoadTarget>
 class DataReader {
  public:
@@ -33,52 +68,207 @@ class DataReader {
   using BatchType = std::vector<SampleType>;
 
   DataReader(user_op::KernelInitContext* ctx)
-      : is_closed_(false), batch_buffer_(kDataReaderBatchBufferSize) {}
+      : is_closed_(false),
+        num_workers_(std::max<int64_t>(EnvInteger<ONEFLOW_DATA_READER_NUM_WORKERS>(), 1)),
+        ordered_(EnvBool<ONEFLOW_DATA_READER_ORDERED>()),
+        min_prefetch_depth_(
+            std::max<int64_t>(EnvInteger<ONEFLOW_DATA_READER_MIN_PREFETCH_DEPTH>(), 1)),
+        max_prefetch_depth_(std::max<int64_t>(EnvInteger<ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH>(),
+                                              min_prefetch_depth_)),
+        prefetch_depth_(min_prefetch_depth_),
+        num_in_flight_(0),
+        next_load_id_(0),
+        next_prepared_id_(0),
+        next_read_id_(0),
+        num_ready_reads_(0),
+        num_batches_(0),
+        load_ns_(0),
+        prepare_ns_(0),
+        wait_ns_(0),
+        parse_ns_(0) {}
 
   virtual ~DataReader() {
     Close();
     if (load_thrd_.joinable()) { load_thrd_.join(); }
+    for (auto& worker_thrd : worker_thrds_) { worker_thrd.join(); }
+    if (num_batches_ > 0) { VLOG(1) << "DataReader " << GetStats().ToString(); }
   }
 
   void Read(user_op::KernelComputeContext* ctx) {
     CHECK(load_thrd_.joinable()) << "You should call StartLoadThread before read data";
     auto batch = FetchBatchData();
+    const auto start = std::chrono::steady_clock::now();
     parser_->Parse(batch, ctx);
+    parse_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
   }
 
   void Close() {
-    if (!is_closed_.load()) {
-      is_closed_.store(true);
-      batch_buffer_.Close();
-    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_closed_) { return; }
+    is_closed_ = true;
+    load_cond_.notify_all();
+    work_cond_.notify_all();
+    ready_cond_.notify_all();
+  }
+
+  DataReaderStats GetStats() {
+    DataReaderStats stats;
+    stats.num_batches = num_batches_.load(std::memory_order_relaxed);
+    stats.load_ns = load_ns_.load(std::memory_order_relaxed);
+    stats.prepare_ns = prepare_ns_.load(std::memory_order_relaxed);
+    stats.wait_ns = wait_ns_.load(std::memory_order_relaxed);
+    stats.parse_ns = parse_ns_.load(std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats.prefetch_depth = prefetch_depth_;
+    return stats;
   }
 
  protected:
   void StartLoadThread() {
     if (load_thrd_.joinable()) { return; }
-    load_thrd_ = std::thread([this] {
-      while (!is_closed_.load() && LoadBatch()) {}
-    });
+    if (parser_->HasPrepare()) {
+      for (int64_t i = 0; i < num_workers_; ++i) {
+        worker_thrds_.emplace_back([this] { PrepareBatches(); });
+      }
+    }
+    load_thrd_ = std::thread([this] { LoadBatches(); });
   }
 
   std::unique_ptr<Dataset<LoadTarget>> loader_;
   std::unique_ptr<Parser<LoadTarget>> parser_;
 
  private:
+  // Read grows the prefetch depth when it has to wait and shrinks it after this many reads in
+  // a row found their batch ready.
+  static constexpr int64_t kNumReadyReadsToShrink = 64;
+
+  static int64_t ElapsedNs(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                - start)
+        .count();
+  }
+
+  void LoadBatches() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        load_cond_.wait(lock, [&]() { return is_closed_ || num_in_flight_ < prefetch_depth_; });
+        if (is_closed_) { return; }
+        num_in_flight_ += 1;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      BatchType batch = loader_->Next();
+      load_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+      // worker_thrds_ is not changed after the load thread starts
+      if (worker_thrds_.empty()) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          if (is_closed_) { return; }
+          const int64_t id = next_load_id_++;
+          prepared_batches_.emplace(id, std::move(batch));
+          if (id != next_read_id_) { continue; }
+        }
+        ready_cond_.notify_one();
+        continue;
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (is_closed_) { return; }
+        work_queue_.emplace_back(next_load_id_++, std::move(batch));
+      }
+      work_cond_.notify_one();
+    }
+  }
+
+  void PrepareBatches() {
+    while (true) {
+      std::pair<int64_t, BatchType> work;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cond_.wait(lock, [&]() { return is_closed_ || !work_queue_.empty(); });
+        if (is_closed_) { return; }
+        work = std::move(work_queue_.front());
+        work_queue_.pop_front();
+      }
+      const auto start = std::chrono::steady_clock::now();
+      parser_->Prepare(&work.second);
+      prepare_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (is_closed_) { return; }
+        const int64_t id = ordered_ ? work.first : next_prepared_id_++;
+        prepared_batches_.emplace(id, std::move(work.second));
+        if (id != next_read_id_) { continue; }
+      }
+      ready_cond_.notify_one();
+    }
+  }
+
   BatchType FetchBatchData() {
     BatchType batch;
-    CHECK_EQ(batch_buffer_.Pull(&batch), BufferStatus::kBufferStatusSuccess);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto it = prepared_batches_.find(next_read_id_);
+      const bool ready = it != prepared_batches_.end();
+      if (!ready) {
+        const auto start = std::chrono::steady_clock::now();
+        ready_cond_.wait(lock, [&]() {
+          it = prepared_batches_.find(next_read_id_);
+          return is_closed_ || it != prepared_batches_.end();
+        });
+        wait_ns_.fetch_add(ElapsedNs(start), std::memory_order_relaxed);
+        CHECK(it != prepared_batches_.end()) << "DataReader is closed";
+      }
+      batch = std::move(it->second);
+      prepared_batches_.erase(it);
+      next_read_id_ += 1;
+      num_in_flight_ -= 1;
+      AdaptPrefetchDepth(ready);
+    }
+    num_batches_.fetch_add(1, std::memory_order_relaxed);
+    load_cond_.notify_one();
     return batch;
   }
 
-  bool LoadBatch() {
-    BatchType batch = loader_->Next();
-    return batch_buffer_.Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
+  void AdaptPrefetchDepth(bool ready) {
+    if (!ready) {
+      num_ready_reads_ = 0;
+      prefetch_depth_ = std::min(prefetch_depth_ + 1, max_prefetch_depth_);
+    } else if (++num_ready_reads_ >= kNumReadyReadsToShrink) {
+      num_ready_reads_ = 0;
+      prefetch_depth_ = std::max(prefetch_depth_ - 1, min_prefetch_depth_);
+    }
   }
 
-  std::atomic<bool> is_closed_;
-  Buffer<BatchType> batch_buffer_;
+  std::mutex mutex_;
+  std::condition_variable load_cond_;
+  std::condition_variable work_cond_;
+  std::condition_variable ready_cond_;
+  bool is_closed_;
+
+  const int64_t num_workers_;
+  const bool ordered_;
+  const int64_t min_prefetch_depth_;
+  const int64_t max_prefetch_depth_;
+  int64_t prefetch_depth_;
+  // batches loaded but not read yet
+  int64_t num_in_flight_;
+  int64_t next_load_id_;
+  int64_t next_prepared_id_;
+  int64_t next_read_id_;
+  int64_t num_ready_reads_;
+  std::deque<std::pair<int64_t, BatchType>> work_queue_;
+  // prepared batches by load id, or by finish order if not ordered
+  std::map<int64_t, BatchType> prepared_batches_;
+
+  std::atomic<int64_t> num_batches_;
+  std::atomic<int64_t> load_ns_;
+  std::atomic<int64_t> prepare_ns_;
+  std::atomic<int64_t> wait_ns_;
+  std::atomic<int64_t> parse_ns_;
+
   std::thread load_thrd_;
+  std::vector<std::thread> worker_thrds_;
 };
 
 }  // namespace data
@@ -0,0 +1,132 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cmath>
+#include "gtest/gtest.h"
+#include "oneflow/user/data/data_reader.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+class CountingDataset final : public Dataset<int64_t> {
+ public:
+  CountingDataset() : cur_(0) {}
+  ~CountingDataset() override = default;
+
+  BatchType Next() override { return BatchType{cur_++}; }
+
+ private:
+  int64_t cur_;
+};
+
+// Prepare squares the sample and takes longer for some of them, so that the workers finish
+// out of order. Without has_prepare, Parse squares the sample instead and a batch running
+// through Prepare anyway comes out squared twice.
+class SquareParser final : public Parser<int64_t> {
+ public:
+  explicit SquareParser(bool has_prepare) : has_prepare_(has_prepare) {}
+  ~SquareParser() override = default;
+
+  bool HasPrepare() const override { return has_prepare_; }
+  void Prepare(BatchType* batch_data) const override {
+    for (auto& sample : *batch_data) {
+      std::this_thread::sleep_for(std::chrono::microseconds(sample % 3 * 200));
+      sample *= sample;
+    }
+  }
+
+  void Parse(BatchType& batch_data, user_op::KernelComputeContext* ctx) override {
+    for (int64_t sample : batch_data) {
+      parsed.emplace_back(has_prepare_ ? sample : sample * sample);
+    }
+  }
+
+  std::vector<int64_t> parsed;
+
+ private:
+  bool has_prepare_;
+};
+
+class TestDataReader final : public DataReader<int64_t> {
+ public:
+  explicit TestDataReader(bool has_prepare) : DataReader<int64_t>(nullptr) {
+    loader_.reset(new CountingDataset());
+    parser_.reset(new SquareParser(has_prepare));
+    StartLoadThread();
+  }
+  ~TestDataReader() override = default;
+
+  const std::vector<int64_t>& parsed() const {
+    return static_cast<const SquareParser*>(parser_.get())->parsed;
+  }
+};
+
+std::vector<int64_t> ReadBatches(int64_t num_batches, bool has_prepare = true) {
+  TestDataReader reader(has_prepare);
+  FOR_RANGE(int64_t, i, 0, num_batches) { reader.Read(nullptr); }
+  const DataReaderStats stats = reader.GetStats();
+  CHECK_EQ(stats.num_batches, num_batches);
+  CHECK_GE(stats.prefetch_depth, EnvInteger<ONEFLOW_DATA_READER_MIN_PREFETCH_DEPTH>());
+  CHECK_LE(stats.prefetch_depth, EnvInteger<ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH>());
+  return reader.parsed();
+}
+
+}  // namespace
+
+TEST(DataReader, Ordered) {
+  for (const char* num_workers : {"1", "3", "8"}) {
+    setenv("ONEFLOW_DATA_READER_NUM_WORKERS", num_workers, 1);
+    const std::vector<int64_t> parsed = ReadBatches(200);
+    ASSERT_EQ(parsed.size(), 200U);
+    FOR_RANGE(int64_t, i, 0, 200) { ASSERT_EQ(parsed.at(i), i * i); }
+  }
+  unsetenv("ONEFLOW_DATA_READER_NUM_WORKERS");
+}
+
+TEST(DataReader, WithoutPrepare) {
+  for (const char* ordered : {"true", "false"}) {
+    setenv("ONEFLOW_DATA_READER_ORDERED", ordered, 1);
+    setenv("ONEFLOW_DATA_READER_NUM_WORKERS", "4", 1);
+    const std::vector<int64_t> parsed = ReadBatches(200, /*has_prepare=*/false);
+    ASSERT_EQ(parsed.size(), 200U);
+    FOR_RANGE(int64_t, i, 0, 200) { ASSERT_EQ(parsed.at(i), i * i); }
+  }
+  unsetenv("ONEFLOW_DATA_READER_ORDERED");
+  unsetenv("ONEFLOW_DATA_READER_NUM_WORKERS");
+}
+
+TEST(DataReader, Unordered) {
+  setenv("ONEFLOW_DATA_READER_ORDERED", "false", 1);
+  setenv("ONEFLOW_DATA_READER_NUM_WORKERS", "4", 1);
+  std::vector<int64_t> parsed = ReadBatches(200);
+  ASSERT_EQ(parsed.size(), 200U);
+  // the workers may have prepared batches past the last one read, but every batch read is a
+  // distinct prepared one and none is held back longer than the prefetch window
+  std::sort(parsed.begin(), parsed.end());
+  ASSERT_TRUE(std::adjacent_find(parsed.begin(), parsed.end()) == parsed.end());
+  const int64_t max_depth = EnvInteger<ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH>();
+  FOR_RANGE(int64_t, i, 0, 200) {
+    const int64_t root = std::llround(std::sqrt(parsed.at(i)));
+    ASSERT_EQ(root * root, parsed.at(i));
+    ASSERT_LT(root, 200 + max_depth);
+  }
+  unsetenv("ONEFLOW_DATA_READER_ORDERED");
+  unsetenv("ONEFLOW_DATA_READER_NUM_WORKERS");
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,207 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/indexed_ofrecord_dataset.h"
+#include <numeric>
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/env_var/data.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+
+namespace oneflow {
+namespace data {
+
+constexpr int64_t IndexedOFRecordDataset::kMaxCoalesceGap;
+
+// One pread covering [offset, offset + size) of a part file, which holds the records to be
+// stored to the given samples of a window.
+struct IndexedOFRecordDataset::ReadTask {
+  struct Record {
+    size_t sample_index;
+    int64_t offset;
+    int64_t size;
+  };
+  int32_t file_index;
+  int64_t offset;
+  int64_t size;
+  std::vector<Record> records;
+};
+
+struct IndexedOFRecordDataset::Window {
+  Window(size_t num_samples, int64_t num_reads)
+      : samples(num_samples), num_pending_reads(num_reads) {}
+  std::vector<TensorBuffer> samples;
+  BlockingCounter num_pending_reads;
+};
+
+IndexedOFRecordDataset::IndexedOFRecordDataset(user_op::KernelInitContext* ctx)
+    : shuffle_after_epoch_(ctx->Attr<bool>("shuffle_after_epoch")) {
+  GetOFRecordParallelIdAndNum(ctx, &parallel_id_, &parallel_num_);
+  Init(DataFS(), GetOFRecordPartFilePaths(ctx));
+}
+
+IndexedOFRecordDataset::IndexedOFRecordDataset(fs::FileSystem* fs,
+                                               const std::vector<std::string>& data_file_paths,
+                                               int32_t parallel_id, int32_t parallel_num,
+                                               bool shuffle_after_epoch)
+    : parallel_id_(parallel_id),
+      parallel_num_(parallel_num),
+      shuffle_after_epoch_(shuffle_after_epoch) {
+  Init(fs, data_file_paths);
+}
+
+IndexedOFRecordDataset::~IndexedOFRecordDataset() {
+  for (const auto& window : windows_) { window->num_pending_reads.WaitForeverUntilCntEqualZero(); }
+  io_thread_pool_.reset();
+}
+
+void IndexedOFRecordDataset::Init(fs::FileSystem* fs,
+                                  const std::vector<std::string>& data_file_paths) {
+  CHECK_GE(parallel_id_, 0);
+  CHECK_LT(parallel_id_, parallel_num_);
+  current_epoch_ = 0;
+  window_size_ = EnvInteger<ONEFLOW_DATA_OFRECORD_READ_WINDOW_SIZE>();
+  num_prefetch_windows_ = EnvInteger<ONEFLOW_DATA_OFRECORD_NUM_PREFETCH_WINDOWS>();
+  max_read_bytes_ = EnvInteger<ONEFLOW_DATA_OFRECORD_MAX_READ_BYTES>();
+  CHECK_GT(window_size_, 0);
+  CHECK_GT(num_prefetch_windows_, 0);
+  io_thread_pool_.reset(new ThreadPool(EnvInteger<ONEFLOW_DATA_OFRECORD_NUM_IO_THREADS>()));
+
+  // every rank needs the index of all part files, load or build them on the I/O threads
+  const size_t num_files = data_file_paths.size();
+  CHECK_GT(num_files, 0);
+  files_.resize(num_files);
+  indices_.resize(num_files);
+  const bool save_index = EnvBool<ONEFLOW_DATA_OFRECORD_SAVE_INDEX>();
+  BlockingCounter counter(num_files);
+  for (size_t i = 0; i < num_files; ++i) {
+    io_thread_pool_->AddWork([&, i]() {
+      fs->NewRandomAccessFile(data_file_paths.at(i), &files_.at(i));
+      indices_.at(i) = OFRecordIndex::LoadOrBuild(fs, data_file_paths.at(i), save_index);
+      counter.Decrease();
+    });
+  }
+  counter.WaitForeverUntilCntEqualZero();
+  file_record_begin_.resize(num_files + 1);
+  file_record_begin_.at(0) = 0;
+  for (size_t i = 0; i < num_files; ++i) {
+    file_record_begin_.at(i + 1) = file_record_begin_.at(i) + indices_.at(i)->num_records();
+  }
+  CHECK_GE(num_records(), parallel_num_) << "too few records to split among ranks";
+
+  InitEpoch();
+  next_sample_ = 0;
+  for (int64_t i = 0; i < num_prefetch_windows_; ++i) { ScheduleWindow(); }
+}
+
+void IndexedOFRecordDataset::InitEpoch() {
+  const Range range = BalancedSplitter(num_records(), parallel_num_).At(parallel_id_);
+  epoch_records_.resize(range.size());
+  if (shuffle_after_epoch_) {
+    std::vector<int64_t> permutation(num_records());
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::mt19937 g(kOneflowDatasetSeed + current_epoch_);
+    std::shuffle(permutation.begin(), permutation.end(), g);
+    std::copy(permutation.begin() + range.begin(), permutation.begin() + range.end(),
+              epoch_records_.begin());
+  } else {
+    std::iota(epoch_records_.begin(), epoch_records_.end(), range.begin());
+  }
+  next_record_ = 0;
+}
+
+int64_t IndexedOFRecordDataset::NextRecord() {
+  if (next_record_ == epoch_records_.size()) {
+    current_epoch_ += 1;
+    InitEpoch();
+  }
+  return epoch_records_.at(next_record_++);
+}
+
+void IndexedOFRecordDataset::ScheduleWindow() {
+  // (global record, sample index), sorting by global record sorts by file and offset
+  std::vector<std::pair<int64_t, size_t>> records(window_size_);
+  for (size_t i = 0; i < records.size(); ++i) { records.at(i) = std::make_pair(NextRecord(), i); }
+  std::sort(records.begin(), records.end());
+  std::vector<ReadTask> tasks;
+  int32_t file_index = 0;
+  for (const auto& pair : records) {
+    while (pair.first >= file_record_begin_.at(file_index + 1)) { ++file_index; }
+    const OFRecordIndex& index = *indices_.at(file_index);
+    const size_t record_index = pair.first - file_record_begin_.at(file_index);
+    const int64_t offset = index.record_offset(record_index);
+    const int64_t size = index.record_size(record_index);
+    bool merged = false;
+    if (!tasks.empty() && tasks.back().file_index == file_index) {
+      ReadTask* task = &tasks.back();
+      const int64_t end = std::max(task->offset + task->size, offset + size);
+      if (offset - (task->offset + task->size) <= kMaxCoalesceGap
+          && end - task->offset <= max_read_bytes_) {
+        task->size = end - task->offset;
+        merged = true;
+      }
+    }
+    if (!merged) {
+      tasks.emplace_back();
+      tasks.back().file_index = file_index;
+      tasks.back().offset = offset;
+      tasks.back().size = size;
+    }
+    tasks.back().records.emplace_back(ReadTask::Record{pair.second, offset, size});
+  }
+  windows_.emplace_back(new Window(records.size(), tasks.size()));
+  Window* window = windows_.back().get();
+  for (auto& task : tasks) {
+    io_thread_pool_->AddWork([this, window, task]() {
+      Read(task, window);
+      window->num_pending_reads.Decrease();
+    });
+  }
+}
+
+void IndexedOFRecordDataset::Read(const ReadTask& task, Window* window) const {
+  const fs::RandomAccessFile* file = files_.at(task.file_index).get();
+  if (task.records.size() == 1) {
+    TensorBuffer* sample = &window->samples.at(task.records.front().sample_index);
+    sample->Resize(Shape({task.size}), DataType::kChar);
+    file->Read(task.offset, task.size, sample->mut_data<char>());
+    return;
+  }
+  static thread_local std::vector<char> buffer;
+  buffer.resize(task.size);
+  file->Read(task.offset, task.size, buffer.data());
+  for (const auto& record : task.records) {
+    TensorBuffer* sample = &window->samples.at(record.sample_index);
+    sample->Resize(Shape({record.size}), DataType::kChar);
+    std::memcpy(sample->mut_data<char>(), buffer.data() + (record.offset - task.offset),
+                record.size);
+  }
+}
+
+IndexedOFRecordDataset::BatchType IndexedOFRecordDataset::Next() {
+  Window* window = windows_.front().get();
+  window->num_pending_reads.WaitForeverUntilCntEqualZero();
+  BatchType batch;
+  batch.push_back(std::move(window->samples.at(next_sample_)));
+  next_sample_ += 1;
+  if (next_sample_ == window->samples.size()) {
+    windows_.pop_front();
+    next_sample_ = 0;
+    ScheduleWindow();
+  }
+  return batch;
+}
+
+}  // namespace data
+}  // namespace oneflow
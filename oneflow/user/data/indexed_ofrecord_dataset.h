@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
+#define ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
+
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/ofrecord_index.h"
+
+namespace oneflow {
+
+namespace user_op {
+class KernelInitContext;
+}  // namespace user_op
+
+namespace data {
+
+// Reads OFRecord part files through their OFRecordIndex, so that records rather than part files
+// are the unit of shuffling and sharding:
+//
+//   - all records of all part files are numbered globally, every epoch is split among the
+//     parallel ranks by record, with shuffle_after_epoch every epoch (the first one included)
+//     is a global permutation seeded by the epoch, which is identical on all ranks;
+//   - records are read window by window on a pool of I/O threads, a window is sorted by
+//     position and neighbouring records are fetched by one coalesced read, several windows are
+//     in flight while the samples of the oldest one are handed out in order.
+class IndexedOFRecordDataset final : public Dataset<TensorBuffer> {
+ public:
+  using Base = Dataset<TensorBuffer>;
+  using SampleType = typename Base::SampleType;
+  using BatchType = typename Base::BatchType;
+
+  OF_DISALLOW_COPY_AND_MOVE(IndexedOFRecordDataset);
+  explicit IndexedOFRecordDataset(user_op::KernelInitContext* ctx);
+  IndexedOFRecordDataset(fs::FileSystem* fs, const std::vector<std::string>& data_file_paths,
+                         int32_t parallel_id, int32_t parallel_num, bool shuffle_after_epoch);
+  ~IndexedOFRecordDataset() override;
+
+  BatchType Next() override;
+
+  int64_t num_records() const { return file_record_begin_.back(); }
+
+  // Reads within this distance are merged, fetching a small hole costs less than another pread.
+  static constexpr int64_t kMaxCoalesceGap = 64 * 1024;
+
+ private:
+  struct ReadTask;
+  struct Window;
+
+  void Init(fs::FileSystem* fs, const std::vector<std::string>& data_file_paths);
+  void InitEpoch();
+  int64_t NextRecord();
+  void ScheduleWindow();
+  void Read(const ReadTask& task, Window* window) const;
+
+  int32_t parallel_id_;
+  int32_t parallel_num_;
+  bool shuffle_after_epoch_;
+  int64_t current_epoch_;
+
+  std::vector<std::unique_ptr<fs::RandomAccessFile>> files_;
+  std::vector<std::unique_ptr<OFRecordIndex>> indices_;
+  // global number of the first record of each part file, the last element is the total
+  std::vector<int64_t> file_record_begin_;
+  // records of this rank in the current epoch
+  std::vector<int64_t> epoch_records_;
+  size_t next_record_;
+
+  int64_t window_size_;
+  int64_t num_prefetch_windows_;
+  int64_t max_read_bytes_;
+  std::deque<std::unique_ptr<Window>> windows_;
+  size_t next_sample_;
+  std::unique_ptr<ThreadPool> io_thread_pool_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
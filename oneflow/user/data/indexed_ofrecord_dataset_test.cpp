@@ -0,0 +1,121 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/user/data/indexed_ofrecord_dataset.h"
+
+namespace oneflow {
+namespace data {
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace {
+
+// Record j of part file i consists of (j % 7 + 1) copies of the int32 value 1000 * i + j.
+std::vector<std::string> WritePartFiles(fs::FileSystem* fs, const std::string& dir,
+                                        const std::vector<int32_t>& num_records_per_file) {
+  fs->RecursivelyCreateDirIfNotExist(dir);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < num_records_per_file.size(); ++i) {
+    paths.emplace_back(JoinPath(dir, "part-" + std::to_string(i)));
+    std::unique_ptr<fs::WritableFile> file;
+    fs->NewWritableFile(paths.back(), &file);
+    for (int32_t j = 0; j < num_records_per_file.at(i); ++j) {
+      const std::vector<int32_t> record(j % 7 + 1, 1000 * i + j);
+      const int64_t size = record.size() * sizeof(int32_t);
+      file->Append(reinterpret_cast<const char*>(&size), sizeof(int64_t));
+      file->Append(reinterpret_cast<const char*>(record.data()), size);
+    }
+    file->Close();
+  }
+  return paths;
+}
+
+int32_t CheckAndGetRecordValue(const TensorBuffer& sample) {
+  const int64_t num = sample.nbytes() / sizeof(int32_t);
+  const int32_t* data = sample.data<int32_t>();
+  CHECK_EQ(num, data[0] % 1000 % 7 + 1);
+  for (int64_t k = 1; k < num; ++k) { CHECK_EQ(data[k], data[0]); }
+  return data[0];
+}
+
+}  // namespace
+
+TEST(OFRecordIndex, BuildSaveAndLoad) {
+  std::unique_ptr<fs::FileSystem> fs(new fs::PosixFileSystem());
+  const std::string dir = JoinPath(GetCwd(), "tmp_ofrecord_index_test");
+  const std::vector<std::string> paths = WritePartFiles(fs.get(), dir, {100, 0});
+  ASSERT_TRUE(OFRecordIndex::Load(fs.get(), paths.at(0)) == nullptr);
+  auto index = OFRecordIndex::LoadOrBuild(fs.get(), paths.at(0), true);
+  ASSERT_EQ(index->num_records(), 100);
+  ASSERT_EQ(index->file_size(), fs->GetFileSize(paths.at(0)));
+  ASSERT_EQ(index->record_size(9), 3 * sizeof(int32_t));
+  auto loaded = OFRecordIndex::Load(fs.get(), paths.at(0));
+  ASSERT_TRUE(loaded != nullptr);
+  ASSERT_EQ(loaded->num_records(), 100);
+  for (size_t i = 0; i < index->num_records(); ++i) {
+    ASSERT_EQ(loaded->record_offset(i), index->record_offset(i));
+    ASSERT_EQ(loaded->record_size(i), index->record_size(i));
+  }
+  ASSERT_EQ(OFRecordIndex::Build(fs.get(), paths.at(1))->num_records(), 0);
+  // the index goes stale once the part file changes
+  WritePartFiles(fs.get(), dir, {99});
+  ASSERT_TRUE(OFRecordIndex::Load(fs.get(), paths.at(0)) == nullptr);
+  fs->RecursivelyDeleteDir(dir);
+}
+
+TEST(IndexedOFRecordDataset, ShardAndShuffleByRecord) {
+  std::unique_ptr<fs::FileSystem> fs(new fs::PosixFileSystem());
+  const std::string dir = JoinPath(GetCwd(), "tmp_indexed_ofrecord_dataset_test");
+  const std::vector<int32_t> num_records_per_file = {300, 1, 0, 250};
+  const std::vector<std::string> paths = WritePartFiles(fs.get(), dir, num_records_per_file);
+  const int32_t num_records = 551;
+  const int32_t parallel_num = 3;
+  for (bool shuffle : {false, true}) {
+    std::vector<std::vector<int32_t>> epochs(2);
+    for (int32_t parallel_id = 0; parallel_id < parallel_num; ++parallel_id) {
+      IndexedOFRecordDataset dataset(fs.get(), paths, parallel_id, parallel_num, shuffle);
+      ASSERT_EQ(dataset.num_records(), num_records);
+      const int32_t num_local_records = BalancedSplitter(num_records, parallel_num)
+                                            .At(parallel_id)
+                                            .size();
+      for (auto& epoch : epochs) {
+        for (int32_t i = 0; i < num_local_records; ++i) {
+          auto batch = dataset.Next();
+          ASSERT_EQ(batch.size(), 1);
+          epoch.emplace_back(CheckAndGetRecordValue(batch.front()));
+        }
+      }
+    }
+    for (const auto& epoch : epochs) {
+      std::vector<int32_t> sorted(epoch);
+      std::sort(sorted.begin(), sorted.end());
+      ASSERT_TRUE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+      ASSERT_EQ(sorted.size(), num_records);
+    }
+    ASSERT_EQ(epochs.at(0) != epochs.at(1), shuffle);
+    ASSERT_EQ(std::is_sorted(epochs.at(0).begin(), epochs.at(0).end()), !shuffle);
+  }
+  fs->RecursivelyDeleteDir(dir);
+}
+
+#endif  // OF_PLATFORM_POSIX
+
+}  // namespace data
+}  // namespace oneflow
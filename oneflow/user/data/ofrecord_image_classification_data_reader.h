@@ -35,7 +35,7 @@ class OFRecordImageClassificationDataReader final
       : DataReader<ImageClassificationDataInstance>(ctx) {
     batch_size_ = ctx->TensorDesc4ArgNameAndIndex("image", 0)->shape().elem_cnt();
     if (auto* pool = TensorBufferPool::TryGet()) { pool->IncreasePoolSizeByBase(batch_size_); }
-    std::unique_ptr<Dataset<TensorBuffer>> base(new OFRecordDataset(ctx));
+    std::unique_ptr<Dataset<TensorBuffer>> base = NewOFRecordDataset(ctx);
     if (ctx->Attr<bool>("random_shuffle")) {
       base.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(base)));
     }
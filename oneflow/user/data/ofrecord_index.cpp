@@ -0,0 +1,127 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_index.h"
+#include <unistd.h>
+
+namespace oneflow {
+namespace data {
+
+constexpr char OFRecordIndex::kMagicCode[];
+
+namespace {
+
+constexpr size_t kIndexHeaderSize = OFRecordIndex::kMagicCodeLen + 2 * sizeof(int64_t);
+constexpr int64_t kLengthFieldSize = sizeof(int64_t);
+
+bool IsValidOffsets(const std::vector<int64_t>& offsets) {
+  if (offsets.empty() || offsets.front() != 0) { return false; }
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets.at(i) - offsets.at(i - 1) <= kLengthFieldSize) { return false; }
+  }
+  return true;
+}
+
+}  // namespace
+
+OFRecordIndex::OFRecordIndex(std::vector<int64_t>&& offsets) : offsets_(std::move(offsets)) {
+  CHECK(IsValidOffsets(offsets_));
+}
+
+std::unique_ptr<OFRecordIndex> OFRecordIndex::Build(fs::FileSystem* fs,
+                                                    const std::string& data_file) {
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(data_file, &file);
+  const int64_t file_size = fs->GetFileSize(data_file);
+  std::vector<int64_t> offsets;
+  int64_t offset = 0;
+  while (offset < file_size) {
+    offsets.emplace_back(offset);
+    CHECK_LE(offset + kLengthFieldSize, file_size) << "truncated record in " << data_file;
+    int64_t record_size = -1;
+    file->Read(offset, kLengthFieldSize, reinterpret_cast<char*>(&record_size));
+    CHECK_GT(record_size, 0) << "bad record size at offset " << offset << " of " << data_file;
+    offset += kLengthFieldSize + record_size;
+    CHECK_LE(offset, file_size) << "truncated record in " << data_file;
+  }
+  offsets.emplace_back(file_size);
+  return std::make_unique<OFRecordIndex>(std::move(offsets));
+}
+
+std::unique_ptr<OFRecordIndex> OFRecordIndex::Load(fs::FileSystem* fs,
+                                                   const std::string& data_file) {
+  const std::string index_file = IndexFilePath(data_file);
+  if (!fs->FileExists(index_file)) { return nullptr; }
+  const uint64_t index_file_size = fs->GetFileSize(index_file);
+  if (index_file_size < kIndexHeaderSize + sizeof(int64_t)) {
+    LOG(WARNING) << "ignore truncated OFRecord index " << index_file;
+    return nullptr;
+  }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(index_file, &file);
+  char header[kIndexHeaderSize];
+  file->Read(0, kIndexHeaderSize, header);
+  int64_t data_file_size = 0;
+  int64_t num_records = 0;
+  std::memcpy(&data_file_size, header + kMagicCodeLen, sizeof(int64_t));
+  std::memcpy(&num_records, header + kMagicCodeLen + sizeof(int64_t), sizeof(int64_t));
+  if (std::memcmp(header, kMagicCode, kMagicCodeLen) != 0 || num_records < 0
+      || index_file_size != kIndexHeaderSize + (num_records + 1) * sizeof(int64_t)) {
+    LOG(WARNING) << "ignore invalid OFRecord index " << index_file;
+    return nullptr;
+  }
+  if (data_file_size != static_cast<int64_t>(fs->GetFileSize(data_file))) {
+    LOG(WARNING) << "ignore stale OFRecord index " << index_file;
+    return nullptr;
+  }
+  std::vector<int64_t> offsets(num_records + 1);
+  file->Read(kIndexHeaderSize, offsets.size() * sizeof(int64_t),
+             reinterpret_cast<char*>(offsets.data()));
+  if (!IsValidOffsets(offsets) || offsets.back() != data_file_size) {
+    LOG(WARNING) << "ignore invalid OFRecord index " << index_file;
+    return nullptr;
+  }
+  return std::make_unique<OFRecordIndex>(std::move(offsets));
+}
+
+std::unique_ptr<OFRecordIndex> OFRecordIndex::LoadOrBuild(fs::FileSystem* fs,
+                                                          const std::string& data_file,
+                                                          bool save_if_built) {
+  std::unique_ptr<OFRecordIndex> index = Load(fs, data_file);
+  if (index) { return index; }
+  index = Build(fs, data_file);
+  if (save_if_built) { index->Save(fs, data_file); }
+  return index;
+}
+
+void OFRecordIndex::Save(fs::FileSystem* fs, const std::string& data_file) const {
+  const std::string index_file = IndexFilePath(data_file);
+  // several processes may index the same part file, so write to a private file first and
+  // publish it by renaming
+  const std::string tmp_file = index_file + ".tmp." + std::to_string(getpid());
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(tmp_file, &file);
+  const int64_t data_file_size = file_size();
+  const int64_t num_records = this->num_records();
+  file->Append(kMagicCode, kMagicCodeLen);
+  file->Append(reinterpret_cast<const char*>(&data_file_size), sizeof(int64_t));
+  file->Append(reinterpret_cast<const char*>(&num_records), sizeof(int64_t));
+  file->Append(reinterpret_cast<const char*>(offsets_.data()), offsets_.size() * sizeof(int64_t));
+  file->Close();
+  fs->RenameFile(tmp_file, index_file);
+}
+
+}  // namespace data
+}  // namespace oneflow
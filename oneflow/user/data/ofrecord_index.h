@@ -0,0 +1,67 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+namespace data {
+
+// Offsets of the records in an OFRecord part file. A part file is a sequence of records, each
+// of which is an int64 length followed by that many bytes of serialized OFRecord.
+//
+// The index is kept in a sidecar file "<part file>.idx":
+//   char[8] magic, int64 part file size, int64 num records, int64 offsets[num records + 1]
+// where offsets[i] is the position of the length of record i and the last offset equals the
+// part file size. A sidecar whose part file size doesn't match is considered stale.
+class OFRecordIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndex);
+  explicit OFRecordIndex(std::vector<int64_t>&& offsets);
+  ~OFRecordIndex() = default;
+
+  static constexpr char kMagicCode[] = "OFRIDX\x01\x00";
+  static constexpr size_t kMagicCodeLen = sizeof(kMagicCode) - 1;
+
+  static std::string IndexFilePath(const std::string& data_file) { return data_file + ".idx"; }
+  // Scans the length fields of all records of data_file.
+  static std::unique_ptr<OFRecordIndex> Build(fs::FileSystem* fs, const std::string& data_file);
+  // Returns nullptr if the sidecar doesn't exist or is invalid.
+  static std::unique_ptr<OFRecordIndex> Load(fs::FileSystem* fs, const std::string& data_file);
+  // Loads the sidecar, or builds the index and saves it if save_if_built is true.
+  static std::unique_ptr<OFRecordIndex> LoadOrBuild(fs::FileSystem* fs,
+                                                    const std::string& data_file,
+                                                    bool save_if_built);
+  void Save(fs::FileSystem* fs, const std::string& data_file) const;
+
+  size_t num_records() const { return offsets_.size() - 1; }
+  int64_t file_size() const { return offsets_.back(); }
+  // Position and size of the serialized OFRecord, the length field excluded.
+  int64_t record_offset(size_t index) const { return offsets_.at(index) + sizeof(int64_t); }
+  int64_t record_size(size_t index) const {
+    return offsets_.at(index + 1) - offsets_.at(index) - sizeof(int64_t);
+  }
+
+ private:
+  std::vector<int64_t> offsets_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
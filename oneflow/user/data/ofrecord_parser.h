@@ -17,7 +17,9 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_OFRECORD_PARSER_H_
 
 #include "oneflow/user/data/parser.h"
+#include "oneflow/user/data/ofrecord_view.h"
 #include "oneflow/core/common/tensor_buffer.h"
+#include "oneflow/core/common/env_var/data.h"
 #include "oneflow/core/record/record.pb.h"
 #include "oneflow/core/thread/thread_manager.h"
 
@@ -30,7 +32,7 @@ class OFRecordParser final : public Parser<TensorBuffer> {
   using SampleType = typename Base::SampleType;
   using BatchType = typename Base::BatchType;
 
-  OFRecordParser() = default;
+  OFRecordParser() : lazy_(EnvBool<ONEFLOW_DATA_OFRECORD_LAZY_PARSE>()) {}
   ~OFRecordParser() = default;
 
   void Parse(BatchType& batch_data, user_op::KernelComputeContext* ctx) override {
@@ -38,13 +40,20 @@ class OFRecordParser final : public Parser<TensorBuffer> {
     OFRecord* dptr = out_tensor->mut_dptr<OFRecord>();
     MultiThreadLoop(batch_data.size(), [&](size_t i) {
       auto& sample = batch_data[i];
-      CHECK(dptr[i].ParseFromArray(sample.data(), sample.nbytes()));
+      if (lazy_) {
+        WrapSerializedOFRecord(sample.data<char>(), sample.nbytes(), dptr + i);
+      } else {
+        CHECK(dptr[i].ParseFromArray(sample.data(), sample.nbytes()));
+      }
     });
     if (batch_data.size() != out_tensor->shape_view().elem_cnt()) {
       CHECK_EQ(out_tensor->mut_shape_view().NumAxes(), 1);
       out_tensor->mut_shape_view().Set(0, batch_data.size());
     }
   }
+
+ private:
+  bool lazy_;
 };
 
 }  // namespace data
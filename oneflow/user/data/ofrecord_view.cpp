@@ -0,0 +1,348 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_view.h"
+
+namespace oneflow {
+namespace data {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "fixed width protobuf values are read in host layout");
+
+namespace {
+
+enum WireType : int {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Reads the protobuf wire format, see https://protobuf.dev/programming-guides/encoding/
+class WireReader final {
+ public:
+  WireReader(const char* data, size_t size) : cur_(data), end_(data + size) {}
+  ~WireReader() = default;
+
+  bool done() const { return cur_ == end_; }
+
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      CHECK(cur_ < end_) << "Truncated OFRecord";
+      const uint8_t byte = static_cast<uint8_t>(*cur_++);
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) { return value; }
+    }
+    LOG(FATAL) << "Malformed varint in OFRecord";
+    return 0;
+  }
+
+  void ReadTag(int* field, int* wire_type) {
+    const uint64_t tag = ReadVarint();
+    *field = static_cast<int>(tag >> 3);
+    *wire_type = static_cast<int>(tag & 0x7);
+  }
+
+  const char* Read(size_t size) {
+    CHECK_LE(size, static_cast<size_t>(end_ - cur_)) << "Truncated OFRecord";
+    const char* data = cur_;
+    cur_ += size;
+    return data;
+  }
+
+  const char* ReadLengthDelimited(size_t* size) {
+    *size = ReadVarint();
+    return Read(*size);
+  }
+
+  void SkipField(int wire_type) {
+    switch (wire_type) {
+      case kVarint: ReadVarint(); break;
+      case kFixed64: Read(8); break;
+      case kLengthDelimited: Read(ReadVarint()); break;
+      case kFixed32: Read(4); break;
+      default: UNIMPLEMENTED() << "Unsupported wire type " << wire_type << " in OFRecord";
+    }
+  }
+
+ private:
+  const char* cur_;
+  const char* end_;
+};
+
+// Wire type of one unpacked value of a numeric list, and its size if fixed.
+void GetValueWireType(Feature::KindCase kind, int* wire_type, size_t* fixed_size) {
+  switch (kind) {
+    case Feature::kFloatList: *wire_type = kFixed32, *fixed_size = sizeof(float); return;
+    case Feature::kDoubleList: *wire_type = kFixed64, *fixed_size = sizeof(double); return;
+    case Feature::kInt32List:
+    case Feature::kInt64List: *wire_type = kVarint, *fixed_size = 0; return;
+    default: UNIMPLEMENTED();
+  }
+}
+
+template<typename SrcT>
+constexpr int ValueWireType() {
+  if constexpr (std::is_same<SrcT, float>::value) {
+    return kFixed32;
+  } else if constexpr (std::is_same<SrcT, double>::value) {
+    return kFixed64;
+  } else {
+    return kVarint;
+  }
+}
+
+template<typename SrcT>
+SrcT ReadValue(WireReader* reader) {
+  if constexpr (std::is_floating_point<SrcT>::value) {
+    SrcT value;
+    std::memcpy(&value, reader->Read(sizeof(SrcT)), sizeof(SrcT));
+    return value;
+  } else {
+    // negative int32 are sign extended to 64 bits on the wire
+    return static_cast<SrcT>(reader->ReadVarint());
+  }
+}
+
+}  // namespace
+
+void WrapSerializedOFRecord(const char* data, size_t size, OFRecord* record) {
+  auto* features = record->mutable_feature();
+  if (features->size() != 1 || features->begin()->first != kSerializedOFRecordFeatureName) {
+    record->Clear();
+  }
+  BytesList* list = (*features)[kSerializedOFRecordFeatureName].mutable_bytes_list();
+  if (list->value_size() != 1) {
+    list->Clear();
+    list->add_value();
+  }
+  list->mutable_value(0)->assign(data, size);
+}
+
+bool OFRecordFeatureView::Find(const OFRecord& record, const std::string& name) {
+  const auto& features = record.feature();
+  auto it = features.find(kSerializedOFRecordFeatureName);
+  if (it != features.end()) {
+    const BytesList& list = it->second.bytes_list();
+    CHECK_EQ(list.value_size(), 1);
+    return Find(list.value(0).data(), list.value(0).size(), name);
+  }
+  it = features.find(name);
+  if (it == features.end()) { return false; }
+  InitFromFeature(it->second);
+  return true;
+}
+
+bool OFRecordFeatureView::Find(const char* data, size_t size, const std::string& name) {
+  // OFRecord is a map<string, Feature> in field 1, whose entries are messages with the key in
+  // field 1 and the value in field 2. Like protobuf, the last entry of a key wins.
+  bool found = false;
+  WireReader reader(data, size);
+  while (!reader.done()) {
+    int field = 0;
+    int wire_type = 0;
+    reader.ReadTag(&field, &wire_type);
+    if (field != 1 || wire_type != kLengthDelimited) {
+      reader.SkipField(wire_type);
+      continue;
+    }
+    size_t entry_size = 0;
+    const char* entry = reader.ReadLengthDelimited(&entry_size);
+    WireReader entry_reader(entry, entry_size);
+    bool key_matched = name.empty();
+    const char* value = nullptr;
+    size_t value_size = 0;
+    while (!entry_reader.done()) {
+      entry_reader.ReadTag(&field, &wire_type);
+      if (field == 1 && wire_type == kLengthDelimited) {
+        size_t key_size = 0;
+        const char* key = entry_reader.ReadLengthDelimited(&key_size);
+        key_matched = key_size == name.size() && std::memcmp(key, name.data(), key_size) == 0;
+        if (!key_matched) { break; }
+      } else if (field == 2 && wire_type == kLengthDelimited) {
+        value = entry_reader.ReadLengthDelimited(&value_size);
+      } else {
+        entry_reader.SkipField(wire_type);
+      }
+    }
+    if (key_matched) {
+      InitFromWire(value, value_size);
+      found = true;
+    }
+  }
+  return found;
+}
+
+const char* OFRecordFeatureView::bytes_data() const {
+  CHECK_EQ(kind_, Feature::kBytesList);
+  CHECK_GT(value_size_, 0);
+  return data_;
+}
+
+size_t OFRecordFeatureView::bytes_size() const {
+  CHECK_EQ(kind_, Feature::kBytesList);
+  CHECK_GT(value_size_, 0);
+  return size_;
+}
+
+void OFRecordFeatureView::InitFromFeature(const Feature& feature) {
+  const auto InitNumericList = [&](const auto& list) {
+    value_size_ = list.value_size();
+    data_ = reinterpret_cast<const char*>(list.value().data());
+    size_ = value_size_ * sizeof(*list.value().data());
+  };
+  kind_ = feature.kind_case();
+  contiguous_ = true;
+  switch (kind_) {
+    case Feature::kBytesList: {
+      const BytesList& list = feature.bytes_list();
+      value_size_ = list.value_size();
+      data_ = value_size_ > 0 ? list.value(0).data() : nullptr;
+      size_ = value_size_ > 0 ? list.value(0).size() : 0;
+      break;
+    }
+    case Feature::kFloatList: InitNumericList(feature.float_list()); break;
+    case Feature::kDoubleList: InitNumericList(feature.double_list()); break;
+    case Feature::kInt32List: InitNumericList(feature.int32_list()); break;
+    case Feature::kInt64List: InitNumericList(feature.int64_list()); break;
+    default: {
+      value_size_ = 0;
+      data_ = nullptr;
+      size_ = 0;
+    }
+  }
+}
+
+void OFRecordFeatureView::InitFromWire(const char* data, size_t size) {
+  // Feature is a oneof of the lists in fields 1 to 5, the last one set wins.
+  kind_ = Feature::KIND_NOT_SET;
+  const char* list = nullptr;
+  size_t list_size = 0;
+  WireReader reader(data, size);
+  while (!reader.done()) {
+    int field = 0;
+    int wire_type = 0;
+    reader.ReadTag(&field, &wire_type);
+    if (field >= Feature::kBytesList && field <= Feature::kInt64List
+        && wire_type == kLengthDelimited) {
+      // protobuf would merge the two lists
+      CHECK_NE(field, kind_) << "Feature with a list split into several messages isn't supported";
+      kind_ = static_cast<Feature::KindCase>(field);
+      list = reader.ReadLengthDelimited(&list_size);
+    } else {
+      reader.SkipField(wire_type);
+    }
+  }
+  InitListFromWire(list, list_size);
+}
+
+void OFRecordFeatureView::InitListFromWire(const char* data, size_t size) {
+  value_size_ = 0;
+  data_ = nullptr;
+  size_ = 0;
+  contiguous_ = false;
+  if (kind_ == Feature::KIND_NOT_SET) { return; }
+  WireReader reader(data, size);
+  if (kind_ == Feature::kBytesList) {
+    while (!reader.done()) {
+      int field = 0;
+      int wire_type = 0;
+      reader.ReadTag(&field, &wire_type);
+      if (field == 1 && wire_type == kLengthDelimited) {
+        size_t value_size = 0;
+        const char* value = reader.ReadLengthDelimited(&value_size);
+        if (value_size_ == 0) {
+          data_ = value;
+          size_ = value_size;
+        }
+        value_size_ += 1;
+      } else {
+        reader.SkipField(wire_type);
+      }
+    }
+    return;
+  }
+  // Numeric values are usually written as one packed chunk, but parsers have to accept any mix
+  // of packed chunks and unpacked values.
+  int value_wire_type = 0;
+  size_t fixed_size = 0;
+  GetValueWireType(kind_, &value_wire_type, &fixed_size);
+  int64_t num_chunks = 0;
+  const char* chunk = nullptr;
+  size_t chunk_size = 0;
+  while (!reader.done()) {
+    int field = 0;
+    int wire_type = 0;
+    reader.ReadTag(&field, &wire_type);
+    if (field == 1 && wire_type == kLengthDelimited) {
+      chunk = reader.ReadLengthDelimited(&chunk_size);
+      num_chunks += 1;
+      if (fixed_size > 0) {
+        CHECK_EQ(chunk_size % fixed_size, 0) << "Malformed packed field in OFRecord";
+        value_size_ += chunk_size / fixed_size;
+      } else {
+        for (size_t i = 0; i < chunk_size; ++i) {
+          if ((static_cast<uint8_t>(chunk[i]) & 0x80) == 0) { value_size_ += 1; }
+        }
+      }
+    } else if (field == 1 && wire_type == value_wire_type) {
+      reader.SkipField(wire_type);
+      num_chunks += 1;
+      value_size_ += 1;
+      chunk = nullptr;
+    } else {
+      reader.SkipField(wire_type);
+    }
+  }
+  if (fixed_size > 0 && num_chunks == 1 && chunk != nullptr) {
+    contiguous_ = true;
+    data_ = chunk;
+    size_ = chunk_size;
+  } else {
+    data_ = data;
+    size_ = size;
+  }
+}
+
+template<typename SrcT>
+void OFRecordFeatureView::DecodeValues(SrcT* dst, int64_t n) const {
+  int64_t i = 0;
+  WireReader reader(data_, size_);
+  while (i < n && !reader.done()) {
+    int field = 0;
+    int wire_type = 0;
+    reader.ReadTag(&field, &wire_type);
+    if (field == 1 && wire_type == kLengthDelimited) {
+      size_t chunk_size = 0;
+      const char* chunk = reader.ReadLengthDelimited(&chunk_size);
+      WireReader chunk_reader(chunk, chunk_size);
+      while (i < n && !chunk_reader.done()) { dst[i++] = ReadValue<SrcT>(&chunk_reader); }
+    } else if (field == 1 && wire_type == ValueWireType<SrcT>()) {
+      dst[i++] = ReadValue<SrcT>(&reader);
+    } else {
+      reader.SkipField(wire_type);
+    }
+  }
+  CHECK_EQ(i, n);
+}
+
+template void OFRecordFeatureView::DecodeValues<float>(float* dst, int64_t n) const;
+template void OFRecordFeatureView::DecodeValues<double>(double* dst, int64_t n) const;
+template void OFRecordFeatureView::DecodeValues<int32_t>(int32_t* dst, int64_t n) const;
+template void OFRecordFeatureView::DecodeValues<int64_t>(int64_t* dst, int64_t n) const;
+
+}  // namespace data
+}  // namespace oneflow
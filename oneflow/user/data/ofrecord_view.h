@@ -0,0 +1,122 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_VIEW_H_
+#define ONEFLOW_USER_DATA_OFRECORD_VIEW_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/record/record.pb.h"
+
+namespace oneflow {
+namespace data {
+
+// With ONEFLOW_DATA_OFRECORD_LAZY_PARSE OFRecordParser doesn't parse the records. Each output
+// OFRecord only holds this feature, whose single bytes value is the serialized record, and the
+// decoders look up their own feature in it with OFRecordFeatureView.
+constexpr char kSerializedOFRecordFeatureName[] = "__serialized_ofrecord__";
+
+// Copies a serialized OFRecord into record, reusing the memory record already holds.
+void WrapSerializedOFRecord(const char* data, size_t size, OFRecord* record);
+
+// Values of one feature, without copying them. The view points either into a parsed Feature or
+// into the wire format of a serialized OFRecord, which must outlive the view.
+class OFRecordFeatureView final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordFeatureView);
+  OFRecordFeatureView() = default;
+  ~OFRecordFeatureView() = default;
+
+  // Finds feature name of a parsed record or of a record wrapped by WrapSerializedOFRecord.
+  // Returns false if the record has no such feature.
+  bool Find(const OFRecord& record, const std::string& name);
+  // Scans a serialized OFRecord, only the map entry of name is looked into.
+  bool Find(const char* data, size_t size, const std::string& name);
+
+  Feature::KindCase kind() const { return kind_; }
+  // Number of values in the list.
+  int64_t value_size() const { return value_size_; }
+  // The first value of a bytes_list.
+  const char* bytes_data() const;
+  size_t bytes_size() const;
+  // Converts the first n values of a numeric list to T.
+  template<typename T>
+  void CopyValuesTo(T* dst, int64_t n) const;
+
+ private:
+  void InitFromFeature(const Feature& feature);
+  void InitFromWire(const char* data, size_t size);
+  void InitListFromWire(const char* data, size_t size);
+  template<typename SrcT, typename T>
+  void CopyValuesAs(T* dst, int64_t n) const;
+  // Decodes the first n values of a list which isn't contiguous.
+  template<typename SrcT>
+  void DecodeValues(SrcT* dst, int64_t n) const;
+
+  Feature::KindCase kind_ = Feature::KIND_NOT_SET;
+  int64_t value_size_ = 0;
+  // The first value of a bytes_list. The values of a numeric list if contiguous_, otherwise
+  // the wire format of the list message.
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  // Values of a parsed list, and values of a serialized float or double list written as a
+  // single packed chunk, are contiguous in host layout.
+  bool contiguous_ = false;
+};
+
+// Converts n values of SrcT, which may be unaligned, to T. Plain loops so that the compiler
+// vectorizes them.
+template<typename SrcT, typename T>
+void CastValues(const char* src, int64_t n, T* dst) {
+  if constexpr (std::is_same<SrcT, T>::value) {
+    std::memcpy(dst, src, n * sizeof(T));
+  } else {
+    for (int64_t i = 0; i < n; ++i) {
+      SrcT value;
+      std::memcpy(&value, src + i * sizeof(SrcT), sizeof(SrcT));
+      dst[i] = static_cast<T>(value);
+    }
+  }
+}
+
+template<typename T>
+void OFRecordFeatureView::CopyValuesTo(T* dst, int64_t n) const {
+  CHECK_LE(n, value_size_);
+  if (n == 0) { return; }
+  switch (kind_) {
+    case Feature::kFloatList: return CopyValuesAs<float>(dst, n);
+    case Feature::kDoubleList: return CopyValuesAs<double>(dst, n);
+    case Feature::kInt32List: return CopyValuesAs<int32_t>(dst, n);
+    case Feature::kInt64List: return CopyValuesAs<int64_t>(dst, n);
+    default: UNIMPLEMENTED();
+  }
+}
+
+template<typename SrcT, typename T>
+void OFRecordFeatureView::CopyValuesAs(T* dst, int64_t n) const {
+  if (contiguous_) {
+    CastValues<SrcT>(data_, n, dst);
+  } else if constexpr (std::is_same<SrcT, T>::value) {
+    DecodeValues(dst, n);
+  } else {
+    std::vector<SrcT> values(n);
+    DecodeValues(values.data(), n);
+    CastValues<SrcT>(reinterpret_cast<const char*>(values.data()), n, dst);
+  }
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_VIEW_H_
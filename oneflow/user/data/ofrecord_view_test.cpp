@@ -0,0 +1,161 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/user/data/ofrecord_view.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendLengthDelimited(int field, const std::string& payload, std::string* out) {
+  AppendVarint(field << 3 | 2, out);
+  AppendVarint(payload.size(), out);
+  out->append(payload);
+}
+
+OFRecord MakeRecord() {
+  OFRecord record;
+  auto* features = record.mutable_feature();
+  (*features)["image"].mutable_bytes_list()->add_value(std::string("\x01\xff\x7f\x80", 4));
+  for (int i = 0; i < 10; ++i) {
+    (*features)["float"].mutable_float_list()->add_value(i * 0.5f - 1.f);
+    (*features)["double"].mutable_double_list()->add_value(i * 0.25 - 2.);
+    (*features)["int32"].mutable_int32_list()->add_value(i * 1000 - 3000);
+    (*features)["int64"].mutable_int64_list()->add_value((i - 5) * (int64_t{1} << 40));
+  }
+  (*features)["empty"].mutable_int32_list();
+  return record;
+}
+
+template<typename T>
+std::vector<T> CopyValues(const OFRecordFeatureView& view) {
+  std::vector<T> values(view.value_size());
+  view.CopyValuesTo(values.data(), values.size());
+  return values;
+}
+
+void CheckSameView(const OFRecordFeatureView& lhs, const OFRecordFeatureView& rhs) {
+  ASSERT_EQ(lhs.kind(), rhs.kind());
+  ASSERT_EQ(lhs.value_size(), rhs.value_size());
+  if (lhs.kind() == Feature::kBytesList) {
+    ASSERT_EQ(std::string(lhs.bytes_data(), lhs.bytes_size()),
+              std::string(rhs.bytes_data(), rhs.bytes_size()));
+  } else {
+    ASSERT_EQ(CopyValues<double>(lhs), CopyValues<double>(rhs));
+    ASSERT_EQ(CopyValues<int64_t>(lhs), CopyValues<int64_t>(rhs));
+    ASSERT_EQ(CopyValues<float>(lhs), CopyValues<float>(rhs));
+  }
+}
+
+}  // namespace
+
+TEST(OFRecordFeatureView, SerializedAndParsedRecordsAgree) {
+  const OFRecord record = MakeRecord();
+  const std::string serialized = record.SerializeAsString();
+  OFRecord wrapped;
+  WrapSerializedOFRecord(serialized.data(), serialized.size(), &wrapped);
+  for (const auto& pair : record.feature()) {
+    OFRecordFeatureView parsed_view;
+    OFRecordFeatureView serialized_view;
+    OFRecordFeatureView wrapped_view;
+    ASSERT_TRUE(parsed_view.Find(record, pair.first));
+    ASSERT_TRUE(serialized_view.Find(serialized.data(), serialized.size(), pair.first));
+    ASSERT_TRUE(wrapped_view.Find(wrapped, pair.first));
+    CheckSameView(parsed_view, serialized_view);
+    CheckSameView(parsed_view, wrapped_view);
+  }
+  OFRecordFeatureView view;
+  ASSERT_FALSE(view.Find(serialized.data(), serialized.size(), "missing"));
+  ASSERT_FALSE(view.Find(wrapped, "missing"));
+  ASSERT_TRUE(view.Find(wrapped, "int32"));
+  ASSERT_EQ(CopyValues<int32_t>(view).at(0), -3000);
+  ASSERT_TRUE(view.Find(wrapped, "float"));
+  ASSERT_EQ(CopyValues<double>(view).at(1), -0.5);
+}
+
+TEST(OFRecordFeatureView, WrapReusesRecord) {
+  const std::string first = MakeRecord().SerializeAsString();
+  OFRecord record = MakeRecord();
+  WrapSerializedOFRecord(first.data(), first.size(), &record);
+  ASSERT_EQ(record.feature_size(), 1);
+  OFRecord other;
+  (*other.mutable_feature())["image"].mutable_bytes_list()->add_value("abc");
+  const std::string second = other.SerializeAsString();
+  WrapSerializedOFRecord(second.data(), second.size(), &record);
+  ASSERT_EQ(record.feature_size(), 1);
+  OFRecordFeatureView view;
+  ASSERT_FALSE(view.Find(record, "int32"));
+  ASSERT_TRUE(view.Find(record, "image"));
+  ASSERT_EQ(std::string(view.bytes_data(), view.bytes_size()), "abc");
+}
+
+TEST(OFRecordFeatureView, UnpackedAndSplitLists) {
+  // int32 list {7, -1} unpacked followed by a packed chunk {300}, and a float list in two
+  // packed chunks
+  std::string int32_list;
+  AppendVarint(1 << 3 | 0, &int32_list);
+  AppendVarint(7, &int32_list);
+  AppendVarint(1 << 3 | 0, &int32_list);
+  AppendVarint(static_cast<uint64_t>(int64_t{-1}), &int32_list);
+  std::string packed;
+  AppendVarint(300, &packed);
+  AppendLengthDelimited(1, packed, &int32_list);
+  std::string float_list;
+  const float values[3] = {1.5f, -2.f, 8.f};
+  AppendLengthDelimited(1, std::string(reinterpret_cast<const char*>(values), 8), &float_list);
+  AppendLengthDelimited(1, std::string(reinterpret_cast<const char*>(values + 2), 4),
+                        &float_list);
+
+  std::string serialized;
+  for (const auto& pair : {std::make_pair(std::string("a"), std::make_pair(4, int32_list)),
+                           std::make_pair(std::string("b"), std::make_pair(2, float_list)),
+                           // a later entry of the same key wins
+                           std::make_pair(std::string("a"), std::make_pair(4, int32_list))}) {
+    std::string feature;
+    AppendLengthDelimited(pair.second.first, pair.second.second, &feature);
+    std::string entry;
+    AppendLengthDelimited(1, pair.first, &entry);
+    AppendLengthDelimited(2, feature, &entry);
+    AppendLengthDelimited(1, entry, &serialized);
+  }
+  OFRecord parsed;
+  ASSERT_TRUE(parsed.ParseFromString(serialized));
+  ASSERT_EQ(parsed.feature().at("a").int32_list().value_size(), 3);
+
+  OFRecordFeatureView view;
+  ASSERT_TRUE(view.Find(serialized.data(), serialized.size(), "a"));
+  ASSERT_EQ(view.kind(), Feature::kInt32List);
+  ASSERT_EQ(CopyValues<int32_t>(view), std::vector<int32_t>({7, -1, 300}));
+  ASSERT_EQ(CopyValues<float>(view), std::vector<float>({7.f, -1.f, 300.f}));
+  ASSERT_TRUE(view.Find(serialized.data(), serialized.size(), "b"));
+  ASSERT_EQ(view.kind(), Feature::kFloatList);
+  ASSERT_EQ(CopyValues<float>(view), std::vector<float>({1.5f, -2.f, 8.f}));
+  std::vector<int64_t> first(2);
+  view.CopyValuesTo(first.data(), 2);
+  ASSERT_EQ(first, std::vector<int64_t>({1, -2}));
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -31,6 +31,11 @@ class Parser {
   Parser() = default;
   virtual ~Parser() = default;
 
+  // The part of parsing which doesn't need the output tensors. DataReader runs it on its
+  // workers ahead of Parse, possibly for several batches at the same time. Parsers overriding
+  // it must return true from HasPrepare, otherwise DataReader starts no workers.
+  virtual bool HasPrepare() const { return false; }
+  virtual void Prepare(BatchType* batch_data) const {}
   virtual void Parse(BatchType& batch_data, user_op::KernelComputeContext* ctx) = 0;
 };
 
@@ -0,0 +1,284 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/raw_batch_reader.h"
+#include <deque>
+
+#ifdef __linux__
+
+namespace oneflow {
+namespace data {
+
+// A read of one file span of a block.
+struct BatchReader::BlockRead {
+  int fd;
+  size_t offset;
+  size_t size;
+  unsigned char* buf;
+  // The read is done once min_size bytes are read. Direct reads of the tail of a file ask for
+  // the rounded up size and come back short.
+  size_t min_size;
+  size_t num_read;
+  // A direct read which isn't aligned goes to the bounce buffer of its request, copy_size bytes
+  // from copy_offset are copied to dst once it is done.
+  bool bounced;
+  size_t bounce_offset;
+  size_t copy_offset;
+  size_t copy_size;
+  unsigned char* dst;
+  PendingRequest* request;
+};
+
+struct BatchReader::PendingRequest {
+  BatchReaderRequest request;
+  std::vector<BlockRead> reads;
+  std::unique_ptr<unsigned char[]> bounce_storage;
+  size_t num_pending_reads = 0;
+};
+
+BatchReader::BatchReader(std::vector<std::unique_ptr<embedding::PosixFile>>&& files,
+                         std::vector<RawBlock>&& blocks, size_t block_size_bytes,
+                         size_t num_workers, size_t queue_depth, const NewEngine& new_engine,
+                         bool direct_io)
+    : head_(0),
+      tail_(0),
+      files_(std::move(files)),
+      blocks_(std::move(blocks)),
+      block_size_bytes_(block_size_bytes),
+      num_workers_(num_workers),
+      direct_io_(direct_io),
+      start_time_(std::chrono::steady_clock::now()),
+      num_bytes_read_(0),
+      num_reads_(0),
+      num_sync_reads_in_flight_(0),
+      queue_depth_sum_(0),
+      num_queue_depth_samples_(0),
+      max_queue_depth_(0) {
+  for (size_t i = 0; i < num_workers_; ++i) {
+    Worker worker;
+    // At most queue_depth requests are in flight, so neither channel can block the sender.
+    auto* sq = new SpscBoundedChannel<BatchReaderRequest>(queue_depth);
+    auto* cq = new SpscBoundedChannel<BatchReaderRequest>(queue_depth);
+    worker.sq.reset(sq);
+    worker.cq.reset(cq);
+    std::shared_ptr<embedding::AsyncReadEngine> engine = new_engine ? new_engine() : nullptr;
+    if (engine) {
+      worker.thread = std::thread([sq, cq, engine, this]() { AsyncPoll(sq, cq, engine.get()); });
+    } else {
+      worker.thread = std::thread([sq, cq, this]() { SyncPoll(sq, cq); });
+    }
+    workers_.emplace_back(std::move(worker));
+  }
+}
+
+BatchReader::~BatchReader() {
+  for (auto& work : workers_) { work.Close(); }
+}
+
+void BatchReader::SubmitRequest(BatchReaderRequest&& request) {
+  size_t worker_id = head_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  workers_.at(worker_id).sq->Send(std::move(request));
+}
+
+void BatchReader::WaitCompleted(BatchReaderRequest* request) {
+  size_t worker_id = tail_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  workers_.at(worker_id).cq->Receive(request);
+}
+
+std::string BatchReader::StatsString() const {
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+  const int64_t num_samples = std::max<int64_t>(num_queue_depth_samples_.load(), 1);
+  std::ostringstream ss;
+  ss << "read " << num_bytes_read_.load() << " bytes in " << num_reads_.load() << " reads, "
+     << num_bytes_read_.load() / std::max(seconds, 1e-9) / 1e9 << " GB/s, queue depth avg "
+     << static_cast<double>(queue_depth_sum_.load()) / num_samples << " max "
+     << max_queue_depth_.load();
+  return ss.str();
+}
+
+void BatchReader::SyncPoll(SpscBoundedChannel<BatchReaderRequest>* sq,
+                           SpscBoundedChannel<BatchReaderRequest>* cq) {
+  PendingRequest pending;
+  while (true) {
+    auto status = sq->Receive(&pending.request);
+    if (status == kChannelStatusErrorClosed) { break; }
+    CHECK_EQ(status, kChannelStatusSuccess) << "channel error";
+    PlanReads(&pending);
+    for (auto& read : pending.reads) {
+      SampleQueueDepth(num_sync_reads_in_flight_.fetch_add(1, std::memory_order_relaxed) + 1);
+      while (read.num_read < read.min_size) {
+        const ssize_t ret = pread(read.fd, read.buf + read.num_read, read.size - read.num_read,
+                                  read.offset + read.num_read);
+        PCHECK(ret >= 0) << "file read error";
+        OnReadCompleted(&read, ret);
+      }
+      num_sync_reads_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    FinishRequest(&pending);
+    CHECK(cq->Send(std::move(pending.request)) == kChannelStatusSuccess) << "channel error";
+  }
+}
+
+void BatchReader::AsyncPoll(SpscBoundedChannel<BatchReaderRequest>* sq,
+                            SpscBoundedChannel<BatchReaderRequest>* cq,
+                            embedding::AsyncReadEngine* engine) {
+  const size_t io_queue_depth = engine->queue_depth();
+  // requests complete in the order they are received, elements of a deque stay in place
+  std::deque<PendingRequest> pendings;
+  std::deque<BlockRead*> reads_to_submit;
+  std::vector<std::pair<uint64_t, int64_t>> completions;
+  size_t num_reads_in_flight = 0;
+  while (true) {
+    while (reads_to_submit.size() < io_queue_depth) {
+      BatchReaderRequest request;
+      if (pendings.empty()) {
+        auto status = sq->Receive(&request);
+        if (status == kChannelStatusErrorClosed) { return; }
+        CHECK_EQ(status, kChannelStatusSuccess) << "channel error";
+      } else if (!sq->TryReceive(&request)) {
+        break;
+      }
+      pendings.emplace_back();
+      PendingRequest* pending = &pendings.back();
+      pending->request = std::move(request);
+      PlanReads(pending);
+      for (auto& read : pending->reads) { reads_to_submit.push_back(&read); }
+    }
+    size_t num_submitting = 0;
+    while (num_reads_in_flight + num_submitting < io_queue_depth && !reads_to_submit.empty()) {
+      BlockRead* read = reads_to_submit.front();
+      reads_to_submit.pop_front();
+      engine->PrepRead(read->fd, read->buf + read->num_read, read->size - read->num_read,
+                       read->offset + read->num_read, reinterpret_cast<uint64_t>(read));
+      num_submitting += 1;
+    }
+    if (num_submitting > 0) {
+      engine->Submit();
+      num_reads_in_flight += num_submitting;
+      SampleQueueDepth(num_reads_in_flight);
+    }
+    if (num_reads_in_flight > 0) {
+      completions.clear();
+      engine->Reap(&completions);
+      for (const auto& completion : completions) {
+        auto* read = reinterpret_cast<BlockRead*>(completion.first);
+        num_reads_in_flight -= 1;
+        CHECK_GE(completion.second, 0) << "file read error: " << strerror(-completion.second);
+        OnReadCompleted(read, completion.second);
+        if (read->num_read < read->min_size) { reads_to_submit.push_front(read); }
+      }
+    }
+    while (!pendings.empty() && pendings.front().num_pending_reads == 0) {
+      FinishRequest(&pendings.front());
+      CHECK(cq->Send(std::move(pendings.front().request)) == kChannelStatusSuccess)
+          << "channel error";
+      pendings.pop_front();
+    }
+  }
+}
+
+// Splits the blocks of a request into reads of file spans.
+void BatchReader::PlanReads(PendingRequest* pending) const {
+  pending->reads.clear();
+  size_t bounce_size = 0;
+  size_t buffer_offset = 0;
+  auto* buffer = reinterpret_cast<unsigned char*>(pending->request.buffer);
+  for (size_t i = 0; i < pending->request.blocks->size(); ++i) {
+    size_t block_index = pending->request.blocks->at(i);
+    const RawBlock& block = blocks_[block_index];
+    size_t remaining = block_size_bytes_;
+    size_t file_index = block.file_index;
+    size_t file_offset = block.offset_in_file;
+    while (remaining != 0) {
+      const size_t bytes_to_read = std::min(remaining, files_.at(file_index)->Size() - file_offset);
+      AddRead(files_[file_index]->fd(), file_offset, bytes_to_read, buffer + buffer_offset,
+              &bounce_size, pending);
+      remaining -= bytes_to_read;
+      buffer_offset += bytes_to_read;
+      if (remaining != 0) {
+        file_index = (file_index + 1) % files_.size();
+        file_offset = 0;
+      }
+    }
+  }
+  unsigned char* bounce = nullptr;
+  if (bounce_size > 0) {
+    pending->bounce_storage.reset(new unsigned char[bounce_size + kDirectIoAlignment]);
+    bounce = reinterpret_cast<unsigned char*>(
+        RoundUp(reinterpret_cast<uintptr_t>(pending->bounce_storage.get()), kDirectIoAlignment));
+  }
+  for (auto& read : pending->reads) {
+    if (read.bounced) { read.buf = bounce + read.bounce_offset; }
+  }
+  pending->num_pending_reads = pending->reads.size();
+}
+
+void BatchReader::AddRead(int fd, size_t offset, size_t size, unsigned char* dst,
+                          size_t* bounce_size, PendingRequest* pending) const {
+  if (!direct_io_) {
+    pending->reads.push_back(
+        BlockRead{fd, offset, size, dst, size, 0, false, 0, 0, 0, dst, pending});
+    return;
+  }
+  if (offset % kDirectIoAlignment == 0
+      && reinterpret_cast<uintptr_t>(dst) % kDirectIoAlignment == 0) {
+    const size_t aligned_size = size / kDirectIoAlignment * kDirectIoAlignment;
+    if (aligned_size > 0) {
+      pending->reads.push_back(BlockRead{fd, offset, aligned_size, dst, aligned_size, 0, false, 0,
+                                         0, 0, dst, pending});
+    }
+    offset += aligned_size;
+    dst += aligned_size;
+    size -= aligned_size;
+    if (size == 0) { return; }
+  }
+  const size_t begin = offset / kDirectIoAlignment * kDirectIoAlignment;
+  const size_t end = RoundUp(offset + size, kDirectIoAlignment);
+  pending->reads.push_back(BlockRead{fd, begin, end - begin, nullptr, offset + size - begin, 0,
+                                     true, *bounce_size, offset - begin, size, dst, pending});
+  *bounce_size += end - begin;
+}
+
+void BatchReader::OnReadCompleted(BlockRead* read, int64_t num_read) {
+  CHECK(num_read > 0 || read->num_read >= read->min_size) << "unexpected end of file";
+  read->num_read += num_read;
+  num_bytes_read_.fetch_add(num_read, std::memory_order_relaxed);
+  if (read->num_read >= read->min_size) {
+    num_reads_.fetch_add(1, std::memory_order_relaxed);
+    read->request->num_pending_reads -= 1;
+  }
+}
+
+void BatchReader::FinishRequest(PendingRequest* pending) const {
+  CHECK_EQ(pending->num_pending_reads, 0);
+  for (const auto& read : pending->reads) {
+    if (read.bounced) { std::memcpy(read.dst, read.buf + read.copy_offset, read.copy_size); }
+  }
+}
+
+void BatchReader::SampleQueueDepth(int64_t depth) {
+  queue_depth_sum_.fetch_add(depth, std::memory_order_relaxed);
+  num_queue_depth_samples_.fetch_add(1, std::memory_order_relaxed);
+  int64_t max_depth = max_queue_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth
+         && !max_queue_depth_.compare_exchange_weak(max_depth, depth,
+                                                    std::memory_order_relaxed)) {}
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // __linux__
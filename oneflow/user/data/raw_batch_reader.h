@@ -0,0 +1,116 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_RAW_BATCH_READER_H_
+#define ONEFLOW_USER_DATA_RAW_BATCH_READER_H_
+
+#include <chrono>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/bounded_channel.h"
+#include "oneflow/core/embedding/async_read_engine.h"
+#include "oneflow/core/embedding/posix_file.h"
+
+#ifdef __linux__
+
+namespace oneflow {
+namespace data {
+
+// A block of the raw_reader op starts at offset_in_file of a file and continues in the next
+// files if it doesn't fit.
+struct RawBlock {
+  size_t file_index;
+  size_t offset_in_file;
+};
+
+struct BatchReaderRequest {
+  std::shared_ptr<std::vector<size_t>> blocks;
+  void* buffer{};
+};
+
+// Reads the blocks of a request one after another into its buffer, on one of num_workers
+// workers. Requests complete in the order they are submitted.
+//
+// A worker for which new_engine returns nullptr reads with pread, one block after another.
+// Otherwise it submits the reads of all the requests it has through its engine, up to the queue
+// depth of the engine in flight, and resubmits the rest of short reads.
+//
+// With direct_io the files are opened with O_DIRECT. The aligned prefix of a file span is read
+// straight into the buffer, unaligned spans and file tails go through a bounce buffer.
+class BatchReader final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(BatchReader);
+  using NewEngine = std::function<std::unique_ptr<embedding::AsyncReadEngine>()>;
+  BatchReader(std::vector<std::unique_ptr<embedding::PosixFile>>&& files,
+              std::vector<RawBlock>&& blocks, size_t block_size_bytes, size_t num_workers,
+              size_t queue_depth, const NewEngine& new_engine, bool direct_io);
+  ~BatchReader();
+
+  void SubmitRequest(BatchReaderRequest&& request);
+  void WaitCompleted(BatchReaderRequest* request);
+
+  std::string StatsString() const;
+
+  // O_DIRECT needs the file offset, the size and the memory of a read aligned to the logical
+  // block size of the device, 4096 covers all of them.
+  static constexpr size_t kDirectIoAlignment = 4096;
+
+ private:
+  struct BlockRead;
+  struct PendingRequest;
+  struct Worker {
+    std::thread thread;
+    std::unique_ptr<SpscBoundedChannel<BatchReaderRequest>> sq;
+    std::unique_ptr<SpscBoundedChannel<BatchReaderRequest>> cq;
+    void Close() {
+      sq->Close();
+      cq->Close();
+      thread.join();
+    }
+  };
+
+  void SyncPoll(SpscBoundedChannel<BatchReaderRequest>* sq,
+                SpscBoundedChannel<BatchReaderRequest>* cq);
+  void AsyncPoll(SpscBoundedChannel<BatchReaderRequest>* sq,
+                 SpscBoundedChannel<BatchReaderRequest>* cq, embedding::AsyncReadEngine* engine);
+  void PlanReads(PendingRequest* pending) const;
+  void AddRead(int fd, size_t offset, size_t size, unsigned char* dst, size_t* bounce_size,
+               PendingRequest* pending) const;
+  void OnReadCompleted(BlockRead* read, int64_t num_read);
+  void FinishRequest(PendingRequest* pending) const;
+  void SampleQueueDepth(int64_t depth);
+
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  std::vector<Worker> workers_;
+  std::vector<std::unique_ptr<embedding::PosixFile>> files_;
+  std::vector<RawBlock> blocks_;
+  size_t block_size_bytes_;
+  size_t num_workers_;
+  bool direct_io_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::atomic<int64_t> num_bytes_read_;
+  std::atomic<int64_t> num_reads_;
+  std::atomic<int64_t> num_sync_reads_in_flight_;
+  std::atomic<int64_t> queue_depth_sum_;
+  std::atomic<int64_t> num_queue_depth_samples_;
+  std::atomic<int64_t> max_queue_depth_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // __linux__
+
+#endif  // ONEFLOW_USER_DATA_RAW_BATCH_READER_H_
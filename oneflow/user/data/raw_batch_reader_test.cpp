@@ -0,0 +1,209 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <numeric>
+#include "gtest/gtest.h"
+#include "oneflow/user/data/raw_batch_reader.h"
+
+namespace oneflow {
+namespace data {
+
+#ifdef __linux__
+
+namespace {
+
+unsigned char ByteAt(size_t global_offset) {
+  return static_cast<unsigned char>(global_offset * 31 + global_offset / 509);
+}
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_raw_batch_reader_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+// Serves reads with pread, at most kMaxReadSize bytes each so that the reader has to resubmit
+// the rest, and completes them in the reverse order of submission. kMaxReadSize keeps the
+// resubmitted reads aligned for O_DIRECT.
+class ShortReadEngine final : public embedding::AsyncReadEngine {
+ public:
+  static constexpr size_t kMaxReadSize = BatchReader::kDirectIoAlignment;
+
+  ShortReadEngine() = default;
+  ~ShortReadEngine() override = default;
+
+  void PrepRead(int fd, void* buf, size_t count, size_t offset, uint64_t tag) override {
+    prepared_.emplace_back(Read{fd, buf, count, offset, tag});
+    CHECK_LE(prepared_.size() + submitted_.size(), queue_depth());
+  }
+  void Submit() override {
+    submitted_.insert(submitted_.end(), prepared_.begin(), prepared_.end());
+    prepared_.clear();
+  }
+  void Reap(std::vector<std::pair<uint64_t, int64_t>>* completions) override {
+    CHECK(!submitted_.empty());
+    const size_t num_completed = (submitted_.size() + 1) / 2;
+    for (size_t i = 0; i < num_completed; ++i) {
+      const Read read = submitted_.back();
+      submitted_.pop_back();
+      const ssize_t ret =
+          pread(read.fd, read.buf, std::min(read.count, kMaxReadSize), read.offset);
+      completions->emplace_back(read.tag, ret < 0 ? -errno : ret);
+      if (ret == kMaxReadSize && read.count > kMaxReadSize) { num_short_reads_ += 1; }
+    }
+  }
+  size_t queue_depth() const override { return 4; }
+
+  static int64_t num_short_reads() { return num_short_reads_; }
+
+ private:
+  struct Read {
+    int fd;
+    void* buf;
+    size_t count;
+    size_t offset;
+    uint64_t tag;
+  };
+  std::vector<Read> prepared_;
+  std::vector<Read> submitted_;
+  static std::atomic<int64_t> num_short_reads_;
+};
+
+std::atomic<int64_t> ShortReadEngine::num_short_reads_(0);
+
+// Writes files of the given sizes whose concatenation is ByteAt(0), ByteAt(1), ..., splits it
+// into blocks the way the raw_reader kernel does and reads every block back, several blocks per
+// request and in shuffled order.
+void TestBatchReader(const BatchReader::NewEngine& new_engine, bool direct_io,
+                     size_t block_size_bytes, size_t num_workers) {
+  const std::vector<size_t> file_sizes = {100000, 4096 * 5, 77700, 30100};
+  const std::string dir = CreateTempDirectory();
+  std::vector<std::unique_ptr<embedding::PosixFile>> files;
+  size_t total_size = 0;
+  for (size_t i = 0; i < file_sizes.size(); ++i) {
+    const std::string path = embedding::PosixFile::JoinPath(dir, std::to_string(i));
+    {
+      embedding::PosixFile file(path, O_RDWR | O_CREAT, 0644);
+      std::vector<unsigned char> data(file_sizes[i]);
+      for (size_t j = 0; j < data.size(); ++j) { data[j] = ByteAt(total_size + j); }
+      PCHECK(write(file.fd(), data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    }
+    total_size += file_sizes[i];
+    const int flags = O_RDONLY | (direct_io ? O_DIRECT : 0);
+    const int fd = open(path.c_str(), flags);
+    if (fd < 0 && direct_io && errno == EINVAL) {
+      embedding::PosixFile::RecursiveDelete(dir);
+      GTEST_SKIP() << "the file system doesn't support O_DIRECT";
+    }
+    PCHECK(fd >= 0);
+    PCHECK(close(fd) == 0);
+    files.emplace_back(new embedding::PosixFile(path, flags, 0644));
+  }
+  std::vector<RawBlock> blocks;
+  std::vector<size_t> block_offsets;
+  size_t file_index = 0;
+  size_t offset_in_file = 0;
+  for (size_t offset = 0; offset + block_size_bytes <= total_size; offset += block_size_bytes) {
+    blocks.emplace_back(RawBlock{file_index, offset_in_file});
+    block_offsets.emplace_back(offset);
+    offset_in_file += block_size_bytes;
+    while (file_index < files.size() && offset_in_file >= files[file_index]->Size()) {
+      offset_in_file -= files[file_index]->Size();
+      file_index += 1;
+    }
+  }
+  const size_t num_blocks = blocks.size();
+  std::vector<size_t> order(num_blocks);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(0));
+  const size_t num_blocks_per_request = 3;
+  const size_t num_requests = num_blocks / num_blocks_per_request;
+  const size_t request_size = num_blocks_per_request * block_size_bytes;
+  BatchReader reader(std::move(files), std::move(blocks), block_size_bytes, num_workers,
+                     num_requests, new_engine, direct_io);
+  std::vector<std::unique_ptr<unsigned char, decltype(&free)>> buffers;
+  for (size_t r = 0; r < num_requests; ++r) {
+    BatchReaderRequest request;
+    const auto begin = order.begin() + r * num_blocks_per_request;
+    request.blocks = std::make_shared<std::vector<size_t>>(begin, begin + num_blocks_per_request);
+    request.buffer = aligned_alloc(BatchReader::kDirectIoAlignment,
+                                   RoundUp(request_size, BatchReader::kDirectIoAlignment));
+    buffers.emplace_back(static_cast<unsigned char*>(request.buffer), &free);
+    reader.SubmitRequest(std::move(request));
+  }
+  for (size_t r = 0; r < num_requests; ++r) {
+    BatchReaderRequest request;
+    reader.WaitCompleted(&request);
+    // requests complete in submission order
+    ASSERT_EQ(request.buffer, buffers.at(r).get());
+    const auto* buffer = static_cast<const unsigned char*>(request.buffer);
+    for (size_t i = 0; i < num_blocks_per_request; ++i) {
+      const size_t block_offset = block_offsets.at(request.blocks->at(i));
+      for (size_t j = 0; j < block_size_bytes; ++j) {
+        ASSERT_EQ(buffer[i * block_size_bytes + j], ByteAt(block_offset + j))
+            << "block " << request.blocks->at(i) << " byte " << j;
+      }
+    }
+  }
+  embedding::PosixFile::RecursiveDelete(dir);
+}
+
+BatchReader::NewEngine PreadEngine() { return nullptr; }
+
+BatchReader::NewEngine ShortEngine() {
+  return []() { return std::make_unique<ShortReadEngine>(); };
+}
+
+BatchReader::NewEngine AioEngine() {
+  return []() { return embedding::NewAioReadEngine(8); };
+}
+
+}  // namespace
+
+TEST(BatchReader, Pread) {
+  TestBatchReader(PreadEngine(), false, 3000, 1);
+  TestBatchReader(PreadEngine(), false, 8192, 2);
+}
+
+TEST(BatchReader, ShortReads) {
+  const int64_t num_short_reads = ShortReadEngine::num_short_reads();
+  TestBatchReader(ShortEngine(), false, 8192, 1);
+  TestBatchReader(ShortEngine(), false, 4096 * 3 + 100, 3);
+  // the reads of more than kMaxReadSize bytes were completed by resubmissions
+  ASSERT_GT(ShortReadEngine::num_short_reads(), num_short_reads);
+}
+
+TEST(BatchReader, Aio) {
+  TestBatchReader(AioEngine(), false, 3000, 1);
+  TestBatchReader(AioEngine(), false, 8192, 2);
+}
+
+// Blocks which start at unaligned offsets or cross the unaligned end of a file go through the
+// bounce buffer, aligned prefixes are read in place.
+TEST(BatchReader, DirectIo) {
+  for (const auto& new_engine : {PreadEngine(), ShortEngine(), AioEngine()}) {
+    TestBatchReader(new_engine, true, 3000, 1);
+    TestBatchReader(new_engine, true, 8192, 2);
+    TestBatchReader(new_engine, true, 4096 * 3 + 100, 1);
+  }
+}
+
+#endif  // __linux__
+
+}  // namespace data
+}  // namespace oneflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/common/data_type.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/all_gather.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
@@ -26,6 +27,28 @@ namespace ccl {
 
 namespace {
 
+// Bruck all-gather in ceil(log2(parallel_num)) steps for any parallel_num: in step k every rank
+// passes the 2^k parts it has gathered so far to the rank 2^k before it. The parts are gathered
+// rotated by parallel_id and put in place at the end.
+Maybe<void> BruckAllGather(const void* in, char* out, size_t part_size, int64_t parallel_id,
+                           Symbol<ParallelDesc> parallel_desc, const TransportToken& token) {
+  const int64_t parallel_num = parallel_desc->parallel_num();
+  const RecvBuffer recv(part_size * parallel_num);
+  char* buffer = recv.Get<char>();
+  std::memcpy(buffer, in, part_size);
+  for (int64_t distance = 1; distance < parallel_num; distance *= 2) {
+    const int64_t part_num = std::min(distance, parallel_num - distance);
+    JUST(SendRecv(parallel_desc, token, (parallel_id - distance + parallel_num) % parallel_num,
+                  buffer, part_num * part_size, (parallel_id + distance) % parallel_num,
+                  buffer + distance * part_size, part_num * part_size));
+  }
+  for (int64_t i = 0; i < parallel_num; ++i) {
+    std::memcpy(out + ((parallel_id + i) % parallel_num) * part_size, buffer + i * part_size,
+                part_size);
+  }
+  return Maybe<void>::Ok();
+}
+
 Maybe<void> AllGatherImpl(const void* in, void* out, size_t elem_cnt, DataType dtype,
                           Symbol<ParallelDesc> parallel_desc) {
   int64_t parallel_num = parallel_desc->parallel_num();
@@ -41,6 +64,9 @@ Maybe<void> AllGatherImpl(const void* in, void* out, size_t elem_cnt, DataType d
   const auto& rank_group = JUST(RankGroup::New(parallel_desc));
   TransportToken transport_token = JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
   int64_t parallel_id = JUST(*opt_parallel_id);
+  if (UseLatencyOptimizedAlgorithm(chunk_size * parallel_num, parallel_num)) {
+    return BruckAllGather(in, char_out, chunk_size, parallel_id, parallel_desc, transport_token);
+  }
   // In-place operation will happen if in == out + parallel_id * chunk_size
   if (in != &char_out[parallel_id * chunk_size]) {
     memcpy(&char_out[parallel_id * chunk_size], in, chunk_size);
@@ -92,6 +118,9 @@ class CpuAllGather final : public AllGather {
     const auto& cpu_communication_ctx =
         std::dynamic_pointer_cast<CpuCommunicationContext>(communication_ctx);
     CHECK(cpu_communication_ctx);
+    OF_COUNTER_ADD("ccl.cpu.all_gather.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.all_gather.bytes", elem_cnt * GetSizeOfDataType(datatype_));
+    OF_COUNTER_TIME_GUARD("ccl.cpu.all_gather.ns");
     CHECK_JUST(AllGatherImpl(in, out, elem_cnt, datatype_, cpu_communication_ctx->parallel_desc()));
   }
 
@@ -13,9 +13,16 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/env_var/env_var.h"
+#include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/all_reduce.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
@@ -26,6 +33,314 @@ namespace ccl {
 
 namespace {
 
+// The chunk of a transfer, a finished transfer calls done.
+class ChunkTransportCtx final : public AsyncTransportCtx {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ChunkTransportCtx);
+  ChunkTransportCtx(const TransportToken& transport_token, void* buffer, size_t size,
+                    std::function<void()>&& done)
+      : AsyncTransportCtx(transport_token), buffer_(buffer), size_(size), done_(std::move(done)) {}
+  ~ChunkTransportCtx() override = default;
+
+  Maybe<void> PrepareSendBufferAndCallback(int64_t rank, void** buffer, std::size_t* size,
+                                           std::function<void()>* Callback) override {
+    *buffer = buffer_;
+    *size = size_;
+    *Callback = done_;
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> PrepareRecvBufferAndCallback(int64_t rank, void** buffer, std::size_t* size,
+                                           std::function<void()>* Callback) override {
+    return PrepareSendBufferAndCallback(rank, buffer, size, Callback);
+  }
+
+ private:
+  void* buffer_;
+  size_t size_;
+  std::function<void()> done_;
+};
+
+// Ring all-reduce in 2 * (parallel_num - 1) steps, the reduce-scatter steps followed by the
+// all-gather steps. Every part is split into chunks and the chunks of all steps form one stream:
+// chunk c of step s is sent once chunk c of step s - 1 is reduced or received, so the chunks
+// following the one being reduced are in transit meanwhile. Sends and receives are issued in
+// stream order on every rank, which keeps the transport tokens of both sides matched.
+template<typename T, ReduceType reduce_type>
+Maybe<void> RingAllReduce(const T* in, T* out, size_t elem_cnt, int64_t rank_id,
+                          Symbol<ParallelDesc> parallel_desc,
+                          const TransportToken& transport_token) {
+  const int64_t parallel_num = parallel_desc->parallel_num();
+  BalancedSplitter bs(elem_cnt, parallel_num);
+  const size_t max_part_size = bs.At(0).size();
+  const int64_t chunk_bytes = EnvInteger<ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES>();
+  const size_t chunk_size =
+      std::max<size_t>(chunk_bytes > 0 ? chunk_bytes / sizeof(T) : max_part_size, 1);
+  const int64_t num_chunks = std::max<int64_t>(RoundUp(max_part_size, chunk_size) / chunk_size, 1);
+  const int64_t max_chunks_in_flight =
+      std::max<int64_t>(EnvInteger<ONEFLOW_CCL_CPU_ALL_REDUCE_MAX_CHUNKS_IN_FLIGHT>(), 1);
+  const int64_t num_reduce_scatter_units = (parallel_num - 1) * num_chunks;
+  const int64_t num_units = 2 * num_reduce_scatter_units;
+  const RecvBuffer recv(max_chunks_in_flight * chunk_size * sizeof(T));
+  T* recv_buffer = recv.Get<T>();
+  const auto& rank_group = JUST(RankGroup::New(parallel_desc));
+
+  const auto PartId = [&](int64_t offset) {
+    return ((rank_id + offset) % parallel_num + parallel_num) % parallel_num;
+  };
+  // Range of the chunk of unit in out, as sent or as received.
+  const auto ChunkRange = [&](int64_t unit, bool send, size_t* begin, size_t* size) {
+    const int64_t step = unit / num_chunks;
+    const int64_t offset = step < parallel_num - 1 ? -step : parallel_num - step;
+    const int64_t part_id = send ? PartId(offset) : PartId(offset - 1);
+    const size_t offset_in_part = (unit % num_chunks) * chunk_size;
+    const Range& part = bs.At(part_id);
+    *begin = part.begin() + offset_in_part;
+    *size = offset_in_part < part.size() ? std::min(chunk_size, part.size() - offset_in_part) : 0;
+  };
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<char> send_done(num_units, 0);
+  std::vector<char> recv_done(num_units, 0);
+  // The ctxs handed to the transport.
+  std::vector<std::unique_ptr<ChunkTransportCtx>> ctxs;
+  ctxs.reserve(2 * num_units);
+  const auto MarkDone = [&](std::vector<char>* done, int64_t unit) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done->at(unit) = 1;
+    }
+    cond.notify_all();
+  };
+  const auto IsDone = [&](const std::vector<char>& done, int64_t unit) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return done.at(unit) != 0;
+  };
+  const auto WaitDone = [&](const std::vector<char>& done, int64_t unit) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return done.at(unit) != 0; });
+  };
+  const auto Send = [&](int64_t unit) -> Maybe<void> {
+    size_t begin = 0;
+    size_t size = 0;
+    ChunkRange(unit, true, &begin, &size);
+    if (size == 0) {
+      MarkDone(&send_done, unit);
+      return Maybe<void>::Ok();
+    }
+    const T* send_ptr = unit < num_chunks ? in + begin : out + begin;
+    auto ctx = std::make_unique<ChunkTransportCtx>(transport_token, const_cast<T*>(send_ptr),
+                                                   size * sizeof(T),
+                                                   [&, unit]() { MarkDone(&send_done, unit); });
+    JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, ctx.get()));
+    ctxs.emplace_back(std::move(ctx));
+    return Maybe<void>::Ok();
+  };
+  const auto Recv = [&](int64_t unit) -> Maybe<void> {
+    size_t begin = 0;
+    size_t size = 0;
+    ChunkRange(unit, false, &begin, &size);
+    if (size == 0) {
+      MarkDone(&recv_done, unit);
+      return Maybe<void>::Ok();
+    }
+    T* recv_ptr = unit < num_reduce_scatter_units
+                      ? recv_buffer + (unit % max_chunks_in_flight) * chunk_size
+                      : out + begin;
+    auto ctx = std::make_unique<ChunkTransportCtx>(transport_token, recv_ptr, size * sizeof(T),
+                                                   [&, unit]() { MarkDone(&recv_done, unit); });
+    JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, ctx.get()));
+    ctxs.emplace_back(std::move(ctx));
+    return Maybe<void>::Ok();
+  };
+
+  const Maybe<void> status = [&]() -> Maybe<void> {
+    int64_t next_recv = 0;
+    int64_t next_send = 0;
+    int64_t next_done = 0;
+    while (next_done < num_units) {
+      while (next_recv < num_units && next_recv < next_done + max_chunks_in_flight) {
+        // An all-gather chunk is received into out, where this rank sent the same chunk from
+        // during reduce-scatter.
+        if (next_recv >= num_reduce_scatter_units
+            && !IsDone(send_done, next_recv - num_reduce_scatter_units)) {
+          break;
+        }
+        JUST(Recv(next_recv));
+        next_recv += 1;
+      }
+      while (next_send < num_units && next_send < next_done + num_chunks) {
+        JUST(Send(next_send));
+        next_send += 1;
+      }
+      if (next_done == next_recv) {
+        WaitDone(send_done, next_recv - num_reduce_scatter_units);
+        continue;
+      }
+      WaitDone(recv_done, next_done);
+      if (next_done < num_reduce_scatter_units) {
+        size_t begin = 0;
+        size_t size = 0;
+        ChunkRange(next_done, false, &begin, &size);
+        if (size > 0) {
+          ReduceFunctor<T, reduce_type>::Call(
+              size, out + begin, in + begin,
+              recv_buffer + (next_done % max_chunks_in_flight) * chunk_size);
+        }
+      }
+      next_done += 1;
+    }
+    return Maybe<void>::Ok();
+  }();
+  // The chunks in flight write to recv_buffer and out and call back into this frame, so they are
+  // waited for also when posting a later chunk failed. The transport touches every ctx after its
+  // callback, so the sends are waited for too.
+  for (const auto& ctx : ctxs) { JUST(ctx->WaitDone()); }
+  return status;
+}
+
+// Reduce-scatter by recursive halving and all-gather by recursive doubling over the blocks of the
+// power of two fold, the bandwidth of the ring in 2 * log2(parallel_num) steps.
+template<typename T, ReduceType reduce_type>
+Maybe<void> RabenseifnerAllReduce(const T* in, T* out, size_t elem_cnt, int64_t parallel_id,
+                                  Symbol<ParallelDesc> parallel_desc, const TransportToken& token) {
+  if (in != out) { std::memcpy(out, in, elem_cnt * sizeof(T)); }
+  const RecvBuffer recv(elem_cnt * sizeof(T));
+  T* recv_buffer = recv.Get<T>();
+  const PowerOfTwoFold fold(parallel_desc->parallel_num());
+  JUST(FoldAllReduceInput<T, reduce_type>(out, elem_cnt, parallel_id, fold, recv_buffer,
+                                          parallel_desc, token));
+  const int64_t folded_id = fold.FoldedId(parallel_id);
+  if (folded_id >= 0) {
+    BalancedSplitter bs(elem_cnt, fold.pof2());
+    // Elements of the blocks [block_begin, block_begin + block_num).
+    const auto BlockRange = [&](int64_t block_begin, int64_t block_num) {
+      return Range(bs.At(block_begin).begin(), bs.At(block_begin + block_num - 1).end());
+    };
+    int64_t block_begin = 0;
+    for (int64_t mask = fold.pof2() / 2; mask >= 1; mask /= 2) {
+      const int64_t peer = fold.ParallelId(folded_id ^ mask);
+      const int64_t keep_begin = (folded_id & mask) ? block_begin + mask : block_begin;
+      const int64_t send_begin = (folded_id & mask) ? block_begin : block_begin + mask;
+      const Range keep = BlockRange(keep_begin, mask);
+      const Range send = BlockRange(send_begin, mask);
+      JUST(SendRecv(parallel_desc, token, peer, out + send.begin(), send.size() * sizeof(T), peer,
+                    recv_buffer, keep.size() * sizeof(T)));
+      ReduceFunctor<T, reduce_type>::Call(keep.size(), out + keep.begin(), out + keep.begin(),
+                                          recv_buffer);
+      block_begin = keep_begin;
+    }
+    for (int64_t mask = 1; mask < fold.pof2(); mask *= 2) {
+      const int64_t peer = fold.ParallelId(folded_id ^ mask);
+      const int64_t peer_block_begin = block_begin ^ mask;
+      const Range send = BlockRange(block_begin, mask);
+      const Range recv = BlockRange(peer_block_begin, mask);
+      JUST(SendRecv(parallel_desc, token, peer, out + send.begin(), send.size() * sizeof(T), peer,
+                    out + recv.begin(), recv.size() * sizeof(T)));
+      block_begin = std::min(block_begin, peer_block_begin);
+    }
+  }
+  JUST(UnfoldAllReduceResult(out, elem_cnt, parallel_id, fold, parallel_desc, token));
+  return Maybe<void>::Ok();
+}
+
+// Ring reduce-scatter among the ranks of group, after which block index of buffer holds the
+// reduction of the group. recv_buffer holds the largest block.
+template<typename T, ReduceType reduce_type>
+Maybe<void> GroupRingReduceScatter(T* buffer, const BalancedSplitter& bs,
+                                   const std::vector<int64_t>& group, int64_t index,
+                                   T* recv_buffer, Symbol<ParallelDesc> parallel_desc,
+                                   const TransportToken& token) {
+  const int64_t group_size = group.size();
+  const int64_t next = group.at((index + 1) % group_size);
+  const int64_t prev = group.at((index + group_size - 1) % group_size);
+  for (int64_t i = 0; i < group_size - 1; ++i) {
+    const Range send = bs.At((index - i - 1 + 2 * group_size) % group_size);
+    const Range recv = bs.At((index - i - 2 + 2 * group_size) % group_size);
+    JUST(SendRecv(parallel_desc, token, next, buffer + send.begin(), send.size() * sizeof(T), prev,
+                  recv_buffer, recv.size() * sizeof(T)));
+    ReduceFunctor<T, reduce_type>::Call(recv.size(), buffer + recv.begin(), buffer + recv.begin(),
+                                        recv_buffer);
+  }
+  return Maybe<void>::Ok();
+}
+
+// Ring all-gather among the ranks of group, each of which holds block index of buffer.
+template<typename T>
+Maybe<void> GroupRingAllGather(T* buffer, const BalancedSplitter& bs,
+                               const std::vector<int64_t>& group, int64_t index,
+                               Symbol<ParallelDesc> parallel_desc, const TransportToken& token) {
+  const int64_t group_size = group.size();
+  const int64_t next = group.at((index + 1) % group_size);
+  const int64_t prev = group.at((index + group_size - 1) % group_size);
+  for (int64_t i = 0; i < group_size - 1; ++i) {
+    const Range send = bs.At((index - i + group_size) % group_size);
+    const Range recv = bs.At((index - i - 1 + group_size) % group_size);
+    JUST(SendRecv(parallel_desc, token, next, buffer + send.begin(), send.size() * sizeof(T), prev,
+                  buffer + recv.begin(), recv.size() * sizeof(T)));
+  }
+  return Maybe<void>::Ok();
+}
+
+// The ranks on the node of parallel_id and the ranks with the same index on the other nodes. Both
+// are left empty unless there are several nodes holding the same number (> 1) of ranks each.
+Maybe<void> GetHierarchicalGroups(Symbol<ParallelDesc> parallel_desc, int64_t parallel_id,
+                                  std::vector<int64_t>* local_group,
+                                  std::vector<int64_t>* cross_group) {
+  local_group->clear();
+  cross_group->clear();
+  std::map<int64_t, std::vector<int64_t>> node_id2parallel_ids;
+  for (int64_t i = 0; i < parallel_desc->parallel_num(); ++i) {
+    const int64_t node_id = GlobalProcessCtx::NodeId(JUST(parallel_desc->MachineId4ParallelId(i)));
+    node_id2parallel_ids[node_id].emplace_back(i);
+  }
+  if (node_id2parallel_ids.size() <= 1) { return Maybe<void>::Ok(); }
+  const size_t local_size = node_id2parallel_ids.begin()->second.size();
+  if (local_size <= 1) { return Maybe<void>::Ok(); }
+  for (const auto& pair : node_id2parallel_ids) {
+    if (pair.second.size() != local_size) { return Maybe<void>::Ok(); }
+  }
+  const int64_t node_id =
+      GlobalProcessCtx::NodeId(JUST(parallel_desc->MachineId4ParallelId(parallel_id)));
+  *local_group = node_id2parallel_ids.at(node_id);
+  const int64_t local_index =
+      std::find(local_group->begin(), local_group->end(), parallel_id) - local_group->begin();
+  for (const auto& pair : node_id2parallel_ids) {
+    cross_group->emplace_back(pair.second.at(local_index));
+  }
+  return Maybe<void>::Ok();
+}
+
+// Reduce-scatter among the ranks of each node, all-reduce of its block with the ranks holding the
+// same block on the other nodes, then all-gather on the node again. Only 1 / local_size of the
+// buffer crosses the network per rank, and the steps on the node go through shared memory.
+template<typename T, ReduceType reduce_type>
+Maybe<void> HierarchicalAllReduce(const T* in, T* out, size_t elem_cnt, int64_t parallel_id,
+                                  const std::vector<int64_t>& local_group,
+                                  const std::vector<int64_t>& cross_group,
+                                  Symbol<ParallelDesc> parallel_desc,
+                                  const TransportToken& token) {
+  if (in != out) { std::memcpy(out, in, elem_cnt * sizeof(T)); }
+  const int64_t local_index =
+      std::find(local_group.begin(), local_group.end(), parallel_id) - local_group.begin();
+  const int64_t cross_index =
+      std::find(cross_group.begin(), cross_group.end(), parallel_id) - cross_group.begin();
+  BalancedSplitter local_bs(elem_cnt, local_group.size());
+  const RecvBuffer recv(local_bs.At(0).size() * sizeof(T));
+  T* recv_buffer = recv.Get<T>();
+  JUST(GroupRingReduceScatter<T, reduce_type>(out, local_bs, local_group, local_index,
+                                              recv_buffer, parallel_desc, token));
+  const Range block = local_bs.At(local_index);
+  BalancedSplitter cross_bs(block.size(), cross_group.size());
+  JUST(GroupRingReduceScatter<T, reduce_type>(out + block.begin(), cross_bs, cross_group,
+                                              cross_index, recv_buffer, parallel_desc, token));
+  JUST(GroupRingAllGather(out + block.begin(), cross_bs, cross_group, cross_index, parallel_desc,
+                          token));
+  JUST(GroupRingAllGather(out, local_bs, local_group, local_index, parallel_desc, token));
+  return Maybe<void>::Ok();
+}
+
 template<typename T, ReduceType reduce_type>
 struct AllReduceImpl final {
   static Maybe<void> Call(const void* void_in, void* void_out, size_t elem_cnt,
@@ -37,84 +352,33 @@ struct AllReduceImpl final {
     }
     const T* in = reinterpret_cast<const T*>(void_in);
     T* out = reinterpret_cast<T*>(void_out);
-    BalancedSplitter bs(elem_cnt, parallel_num);
-    auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
     Optional<int64_t> parallel_id;
     JUST(GetTensorDevice4CurrentProcessCtx(parallel_desc, &parallel_id));
-    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
     TransportToken transport_token =
         JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
-    for (int64_t i = 0, part_id = JUST(parallel_id); i < parallel_num - 1;
-         ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = nullptr;
-      if (i == 0) {
-        send_ptr = &in[bs.At(send_part_id).begin()];
-      } else {
-        send_ptr = &out[bs.At(send_part_id).begin()];
-      }
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = recv_buffer.get();
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
-      }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
-      const T* cur_in = &in[bs.At(recv_part_id).begin()];
-      T* cur_out = &out[bs.At(recv_part_id).begin()];
-      if (recv_size > 0) {
-        ReduceFunctor<T, reduce_type>::Call(recv_size, cur_out, cur_in, recv_ptr);
-      }
+    // Every rank has to pick the same algorithm, so the thresholds must agree between them.
+    const size_t buffer_size = elem_cnt * sizeof(T);
+    if (UseLatencyOptimizedAlgorithm(buffer_size, parallel_num)) {
+      return RecursiveDoublingAllReduce<T, reduce_type>(in, out, elem_cnt, JUST(parallel_id),
+                                                        parallel_desc, transport_token);
     }
-    for (int64_t i = 0, part_id = RingIncrease(JUST(parallel_id), parallel_num);
-         i < parallel_num - 1; ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = &out[bs.At(send_part_id).begin()];
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = &out[bs.At(recv_part_id).begin()];
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
+    if (EnvBool<ONEFLOW_CCL_CPU_HIERARCHICAL_ALL_REDUCE>()) {
+      std::vector<int64_t> local_group;
+      std::vector<int64_t> cross_group;
+      JUST(GetHierarchicalGroups(parallel_desc, JUST(parallel_id), &local_group, &cross_group));
+      if (!local_group.empty()) {
+        return HierarchicalAllReduce<T, reduce_type>(in, out, elem_cnt, JUST(parallel_id),
+                                                     local_group, cross_group, parallel_desc,
+                                                     transport_token);
       }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
     }
-    return Maybe<void>::Ok();
+    if (static_cast<int64_t>(buffer_size)
+        <= EnvInteger<ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES>()) {
+      return RabenseifnerAllReduce<T, reduce_type>(in, out, elem_cnt, JUST(parallel_id),
+                                                   parallel_desc, transport_token);
+    }
+    return RingAllReduce<T, reduce_type>(in, out, elem_cnt, JUST(parallel_id), parallel_desc,
+                                         transport_token);
   }
 };
 
@@ -144,6 +408,9 @@ class CpuAllReduce final : public AllReduce {
     const auto& cpu_communication_ctx =
         std::dynamic_pointer_cast<CpuCommunicationContext>(communication_ctx);
     CHECK(cpu_communication_ctx) << kOfBugIssueUploadPrompt;
+    OF_COUNTER_ADD("ccl.cpu.all_reduce.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.all_reduce.bytes", elem_cnt * GetSizeOfDataType(datatype_));
+    OF_COUNTER_TIME_GUARD("ccl.cpu.all_reduce.ns");
     CHECK_JUST(SwitchAllReduceImpl(SwitchCase(datatype_, reduce_type_), in, out, elem_cnt,
                                    cpu_communication_ctx->parallel_desc()));
   }
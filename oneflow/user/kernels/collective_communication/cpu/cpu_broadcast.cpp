@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/ccl/ccl.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/broadcast.h"
 
@@ -42,6 +43,9 @@ class CpuBroadcastImpl final : public Broadcast {
         std::dynamic_pointer_cast<CpuCommunicationContext>(communication_ctx);
     CHECK(cpu_communication_ctx);
     size_t buffer_size = elem_cnt * size_of_dtype_;
+    OF_COUNTER_ADD("ccl.cpu.broadcast.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.broadcast.bytes", buffer_size);
+    OF_COUNTER_TIME_GUARD("ccl.cpu.broadcast.ns");
     const auto& transport_token =
         CHECK_JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
     CHECK_JUST(CpuBroadcast(in, out, buffer_size, root, cpu_communication_ctx->parallel_desc(),
@@ -16,8 +16,12 @@ limitations under the License.
 #ifndef ONEFLOW_USER_KERNELS_COLLECTIVE_COMMUNICATION_CPU_CPU_COLLECTIVE_COMMUNICATION_UTIL_H_
 #define ONEFLOW_USER_KERNELS_COLLECTIVE_COMMUNICATION_CPU_CPU_COLLECTIVE_COMMUNICATION_UTIL_H_
 
+#include <memory>
 #include "oneflow/core/thread/thread_manager.h"
 #include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/env_var/env_var.h"
+#include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/job/parallel_desc.h"
 
 namespace oneflow {
 
@@ -27,17 +31,32 @@ inline int64_t RingDecrease(int64_t n, int64_t size) { return (n - 1 + size) % s
 
 inline int64_t RingIncrease(int64_t n, int64_t size) { return (n + 1 + size) % size; }
 
+// Each thread reduces at least this many elements, so that reducing a small chunk isn't
+// dominated by handing it out to the thread pool.
+constexpr size_t kReduceGrainSize = 32 * 1024;
+
+template<typename DoRangeT>
+void ReduceInParallel(size_t size, const DoRangeT& DoRange) {
+  const size_t thread_num = std::min<size_t>(Singleton<ThreadPool>::Get()->thread_num(),
+                                             RoundUp(size, kReduceGrainSize) / kReduceGrainSize);
+  if (thread_num <= 1) {
+    DoRange(0, size);
+    return;
+  }
+  BalancedSplitter bs(size, thread_num);
+  MultiThreadLoop(thread_num, [&](size_t thread_idx) {
+    DoRange(bs.At(thread_idx).begin(), bs.At(thread_idx).end());
+  });
+}
+
 template<typename T, ReduceType reduce_type>
 struct ReduceFunctor;
 
 template<typename T>
 struct ReduceFunctor<T, kSum> {
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
-    size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
-    BalancedSplitter bs(size, thread_num);
-    MultiThreadLoop(thread_num, [&](size_t thread_idx) {
-      size_t end = bs.At(thread_idx).end();
-      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) { out[i] = in0[i] + in1[i]; }
+    ReduceInParallel(size, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) { out[i] = in0[i] + in1[i]; }
     });
   }
 };
@@ -45,17 +64,172 @@ struct ReduceFunctor<T, kSum> {
 template<typename T>
 struct ReduceFunctor<T, kMax> {
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
-    size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
-    BalancedSplitter bs(size, thread_num);
-    MultiThreadLoop(thread_num, [&](size_t thread_idx) {
-      size_t end = bs.At(thread_idx).end();
-      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) {
-        out[i] = std::max(in0[i], in1[i]);
-      }
+    ReduceInParallel(size, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) { out[i] = std::max(in0[i], in1[i]); }
     });
   }
 };
 
+// Below parallel_num times this many bytes a collective moves the whole buffer in log2 steps
+// instead of 2 * (parallel_num - 1) ring steps of one part each, the steps are latency bound then.
+inline bool UseLatencyOptimizedAlgorithm(size_t buffer_size, int64_t parallel_num) {
+  return static_cast<int64_t>(buffer_size)
+         <= EnvInteger<ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK>() * parallel_num;
+}
+
+// Receive buffers up to this size are kept by the calling thread for its next calls, which covers
+// the ring and Rabenseifner with the default chunk size and thresholds.
+constexpr size_t kMaxCachedRecvBufferSize = 4 * 1024 * 1024;
+
+// The receive buffer of one call, a thread holds at most one at a time. A buffer larger than
+// kMaxCachedRecvBufferSize is freed when the call returns.
+class RecvBuffer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RecvBuffer);
+  explicit RecvBuffer(size_t size) {
+    thread_local std::unique_ptr<char[]> cached_buffer;
+    thread_local size_t cached_buffer_size = 0;
+    if (size > kMaxCachedRecvBufferSize) {
+      buffer_.reset(new char[size]);
+      ptr_ = buffer_.get();
+      return;
+    }
+    if (size > cached_buffer_size) {
+      cached_buffer.reset(new char[size]);
+      cached_buffer_size = size;
+    }
+    ptr_ = cached_buffer.get();
+  }
+  ~RecvBuffer() = default;
+
+  template<typename T>
+  T* Get() const {
+    return reinterpret_cast<T*>(ptr_);
+  }
+
+ private:
+  std::unique_ptr<char[]> buffer_;
+  char* ptr_;
+};
+
+// Sends to and receives from the processes of the given parallel ids, an empty side is skipped.
+inline Maybe<void> SendRecv(Symbol<ParallelDesc> parallel_desc, const TransportToken& token,
+                            int64_t dst_parallel_id, const void* send_ptr, size_t send_size,
+                            int64_t src_parallel_id, void* recv_ptr, size_t recv_size) {
+  NaiveAsyncTransportCtx ctx(
+      token,
+      [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
+        *buffer = const_cast<void*>(send_ptr);
+        *size = send_size;
+        *Cb = [] {};
+        return Maybe<void>::Ok();
+      },
+      [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
+        *buffer = recv_ptr;
+        *size = recv_size;
+        *Cb = [] {};
+        return Maybe<void>::Ok();
+      });
+  const int64_t dst_rank =
+      send_size > 0 ? JUST(parallel_desc->MachineId4ParallelId(dst_parallel_id)) : -1;
+  const int64_t src_rank =
+      recv_size > 0 ? JUST(parallel_desc->MachineId4ParallelId(src_parallel_id)) : -1;
+  if (send_size > 0) { JUST(TransportUtil::SendDataToRank(dst_rank, token, &ctx)); }
+  const Maybe<void> status = recv_size > 0
+                                 ? TransportUtil::ReceiveDataFromRank(src_rank, token, &ctx)
+                                 : Maybe<void>::Ok();
+  // The send in flight still reads send_ptr and calls back into ctx.
+  JUST(ctx.WaitDone());
+  return status;
+}
+
+// Folds parallel_num ranks into the largest power of two not above it: of the first 2 * rem
+// ranks the odd ones take the data of their even neighbours, which sit out the power of two
+// exchange and get the result back from them at the end.
+class PowerOfTwoFold final {
+ public:
+  explicit PowerOfTwoFold(int64_t parallel_num) : pof2_(1) {
+    while (pof2_ * 2 <= parallel_num) { pof2_ *= 2; }
+    rem_ = parallel_num - pof2_;
+  }
+
+  int64_t pof2() const { return pof2_; }
+  bool IsFolded(int64_t parallel_id) const { return parallel_id < 2 * rem_; }
+  // -1 for the ranks sitting out.
+  int64_t FoldedId(int64_t parallel_id) const {
+    if (!IsFolded(parallel_id)) { return parallel_id - rem_; }
+    return parallel_id % 2 == 1 ? parallel_id / 2 : -1;
+  }
+  int64_t ParallelId(int64_t folded_id) const {
+    return folded_id < rem_ ? folded_id * 2 + 1 : folded_id + rem_;
+  }
+
+ private:
+  int64_t pof2_;
+  int64_t rem_;
+};
+
+// Reduces the buffers of the ranks sitting out of the power of two fold into their neighbours,
+// recv_buffer holds elem_cnt elements.
+template<typename T, ReduceType reduce_type>
+Maybe<void> FoldAllReduceInput(T* out, size_t elem_cnt, int64_t parallel_id,
+                               const PowerOfTwoFold& fold, T* recv_buffer,
+                               Symbol<ParallelDesc> parallel_desc, const TransportToken& token) {
+  if (!fold.IsFolded(parallel_id)) { return Maybe<void>::Ok(); }
+  const size_t buffer_size = elem_cnt * sizeof(T);
+  if (fold.FoldedId(parallel_id) < 0) {
+    JUST(SendRecv(parallel_desc, token, parallel_id + 1, out, buffer_size, parallel_id + 1,
+                  nullptr, 0));
+  } else {
+    JUST(SendRecv(parallel_desc, token, parallel_id - 1, nullptr, 0, parallel_id - 1, recv_buffer,
+                  buffer_size));
+    ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, out, recv_buffer);
+  }
+  return Maybe<void>::Ok();
+}
+
+// Hands the result back to the ranks sitting out of the power of two fold.
+template<typename T>
+Maybe<void> UnfoldAllReduceResult(T* out, size_t elem_cnt, int64_t parallel_id,
+                                  const PowerOfTwoFold& fold, Symbol<ParallelDesc> parallel_desc,
+                                  const TransportToken& token) {
+  if (!fold.IsFolded(parallel_id)) { return Maybe<void>::Ok(); }
+  const size_t buffer_size = elem_cnt * sizeof(T);
+  if (fold.FoldedId(parallel_id) < 0) {
+    JUST(SendRecv(parallel_desc, token, parallel_id + 1, nullptr, 0, parallel_id + 1, out,
+                  buffer_size));
+  } else {
+    JUST(SendRecv(parallel_desc, token, parallel_id - 1, out, buffer_size, parallel_id - 1,
+                  nullptr, 0));
+  }
+  return Maybe<void>::Ok();
+}
+
+// Recursive doubling all-reduce, the partners exchange and reduce the whole buffer in each of
+// the log2(parallel_num) steps. in and out may be the same buffer.
+template<typename T, ReduceType reduce_type>
+Maybe<void> RecursiveDoublingAllReduce(const T* in, T* out, size_t elem_cnt, int64_t parallel_id,
+                                       Symbol<ParallelDesc> parallel_desc,
+                                       const TransportToken& token) {
+  if (in != out) { std::memcpy(out, in, elem_cnt * sizeof(T)); }
+  const RecvBuffer recv(elem_cnt * sizeof(T));
+  T* recv_buffer = recv.Get<T>();
+  const PowerOfTwoFold fold(parallel_desc->parallel_num());
+  JUST(FoldAllReduceInput<T, reduce_type>(out, elem_cnt, parallel_id, fold, recv_buffer,
+                                          parallel_desc, token));
+  const int64_t folded_id = fold.FoldedId(parallel_id);
+  if (folded_id >= 0) {
+    const size_t buffer_size = elem_cnt * sizeof(T);
+    for (int64_t mask = 1; mask < fold.pof2(); mask *= 2) {
+      const int64_t peer = fold.ParallelId(folded_id ^ mask);
+      JUST(SendRecv(parallel_desc, token, peer, out, buffer_size, peer, recv_buffer, buffer_size));
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, out, recv_buffer);
+    }
+  }
+  JUST(UnfoldAllReduceResult(out, elem_cnt, parallel_id, fold, parallel_desc, token));
+  return Maybe<void>::Ok();
+}
+
 }  // namespace ccl
 
 }  // namespace oneflow
@@ -0,0 +1,77 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace ccl {
+
+namespace test {
+
+TEST(PowerOfTwoFold, FoldedIds) {
+  for (int64_t parallel_num = 1; parallel_num <= 33; ++parallel_num) {
+    const PowerOfTwoFold fold(parallel_num);
+    const int64_t pof2 = fold.pof2();
+    ASSERT_LE(pof2, parallel_num);
+    ASSERT_GT(pof2 * 2, parallel_num);
+    ASSERT_EQ(pof2 & (pof2 - 1), 0);
+    const int64_t rem = parallel_num - pof2;
+    std::vector<int64_t> parallel_ids;
+    for (int64_t parallel_id = 0; parallel_id < parallel_num; ++parallel_id) {
+      ASSERT_EQ(fold.IsFolded(parallel_id), parallel_id < 2 * rem);
+      const int64_t folded_id = fold.FoldedId(parallel_id);
+      if (folded_id < 0) {
+        // A rank sitting out hands its data to the next rank, which takes part.
+        ASSERT_TRUE(fold.IsFolded(parallel_id));
+        ASSERT_EQ(parallel_id % 2, 0);
+        ASSERT_GE(fold.FoldedId(parallel_id + 1), 0);
+        continue;
+      }
+      ASSERT_LT(folded_id, pof2);
+      ASSERT_EQ(fold.ParallelId(folded_id), parallel_id);
+      parallel_ids.push_back(parallel_id);
+    }
+    ASSERT_EQ(static_cast<int64_t>(parallel_ids.size()), pof2);
+    for (int64_t folded_id = 0; folded_id < pof2; ++folded_id) {
+      ASSERT_EQ(fold.FoldedId(fold.ParallelId(folded_id)), folded_id);
+    }
+  }
+}
+
+TEST(RecvBuffer, CachedUpToLimit) {
+  const char* cached = nullptr;
+  {
+    const RecvBuffer recv(kMaxCachedRecvBufferSize);
+    cached = recv.Get<char>();
+  }
+  {
+    const RecvBuffer recv(1);
+    ASSERT_EQ(recv.Get<char>(), cached);
+  }
+  {
+    const RecvBuffer recv(kMaxCachedRecvBufferSize + 1);
+    ASSERT_NE(recv.Get<char>(), cached);
+  }
+  const RecvBuffer recv(kMaxCachedRecvBufferSize / 2);
+  ASSERT_EQ(recv.Get<char>(), cached);
+}
+
+}  // namespace test
+
+}  // namespace ccl
+
+}  // namespace oneflow
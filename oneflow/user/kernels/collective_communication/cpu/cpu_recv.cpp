@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/ccl/ccl.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/include/recv.h"
 
 namespace oneflow {
@@ -37,6 +38,9 @@ class CpuRecvImpl final : public Recv {
 
   void Launch(ep::Stream* stream, void* out, size_t elem_cnt, int64_t src) const override {
     size_t buffer_size = elem_cnt * size_of_dtype_;
+    OF_COUNTER_ADD("ccl.cpu.recv.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.recv.bytes", buffer_size);
+    OF_COUNTER_TIME_GUARD("ccl.cpu.recv.ns");
     CHECK_JUST(CpuRecv(out, buffer_size, src));
   }
 
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/reduce.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
@@ -27,6 +28,51 @@ namespace ccl {
 
 namespace {
 
+// Binomial tree reduce in ceil(log2(parallel_num)) steps. Counted from the root, a rank collects
+// the partial results of rank + 2^k for the low k bits of its id being clear and then passes its
+// own to rank - 2^k.
+template<typename T, ReduceType reduce_type>
+Maybe<void> BinomialTreeReduce(const T* in, T* out, size_t elem_cnt, int64_t root,
+                               Symbol<ParallelDesc> parallel_desc) {
+  const int64_t parallel_num = parallel_desc->parallel_num();
+  const int64_t parallel_id_of_root =
+      JUST(parallel_desc->ParallelId4MachineDeviceId(root, GlobalProcessCtx::LocalRank(root)));
+  Optional<int64_t> parallel_id;
+  JUST(GetTensorDevice4CurrentProcessCtx(parallel_desc, &parallel_id));
+  TransportToken transport_token = JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
+  const int64_t relative_id =
+      (JUST(parallel_id) - parallel_id_of_root + parallel_num) % parallel_num;
+  const auto ParallelId = [&](int64_t relative) {
+    return (relative + parallel_id_of_root) % parallel_num;
+  };
+  const size_t buffer_size = elem_cnt * sizeof(T);
+  // out is only used on rank root and ignored for other ranks.
+  std::unique_ptr<T[]> partial_buffer;
+  T* partial = out;
+  if (relative_id != 0) {
+    partial_buffer = std::make_unique<T[]>(elem_cnt);
+    partial = partial_buffer.get();
+  }
+  if (partial != in) { std::memcpy(partial, in, buffer_size); }
+  const RecvBuffer recv(buffer_size);
+  T* recv_buffer = recv.Get<T>();
+  for (int64_t mask = 1; mask < parallel_num; mask *= 2) {
+    if (relative_id & mask) {
+      const int64_t parent = ParallelId(relative_id - mask);
+      JUST(SendRecv(parallel_desc, transport_token, parent, partial, buffer_size, parent, nullptr,
+                    0));
+      break;
+    }
+    if (relative_id + mask < parallel_num) {
+      const int64_t child = ParallelId(relative_id + mask);
+      JUST(SendRecv(parallel_desc, transport_token, child, nullptr, 0, child, recv_buffer,
+                    buffer_size));
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, partial, partial, recv_buffer);
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
 template<typename T, ReduceType reduce_type>
 struct ReduceImpl final {
   static Maybe<void> Call(const void* void_in, void* void_out, size_t elem_cnt, int64_t root,
@@ -35,19 +81,17 @@ struct ReduceImpl final {
     T* out = reinterpret_cast<T*>(void_out);
 
     int64_t parallel_num = parallel_desc->parallel_num();
+    if (parallel_num == 1 || UseLatencyOptimizedAlgorithm(elem_cnt * sizeof(T), parallel_num)) {
+      return BinomialTreeReduce<T, reduce_type>(in, out, elem_cnt, root, parallel_desc);
+    }
     BalancedSplitter bs(elem_cnt, parallel_num);
 
-    size_t size = root == GlobalProcessCtx::Rank() && void_in != void_out ? 0 : bs.At(0).size();
-    T* tmp_out = nullptr;
-    // void_out is only used on rank root and ignored for other ranks.
-    auto tmp_out_buffer = std::make_unique<T[]>(size);
+    // void_out is only used on rank root and ignored for other ranks. The partial results are
+    // reduced into tmp_out, a part of out may be smaller than them.
+    auto tmp_out_buffer = std::make_unique<T[]>(bs.At(0).size());
+    T* tmp_out = tmp_out_buffer.get();
     int64_t parallel_id_of_root =
         JUST(parallel_desc->ParallelId4MachineDeviceId(root, GlobalProcessCtx::LocalRank(root)));
-    if (root == GlobalProcessCtx::Rank() && void_in != void_out) {
-      tmp_out = &reinterpret_cast<T*>(void_out)[bs.At(parallel_id_of_root).begin()];
-    } else {
-      tmp_out = tmp_out_buffer.get();
-    }
 
     auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
     Optional<int64_t> parallel_id;
@@ -95,7 +139,7 @@ struct ReduceImpl final {
       }
     }
 
-    if (root == GlobalProcessCtx::Rank() && void_in == void_out) {
+    if (root == GlobalProcessCtx::Rank()) {
       memcpy(&out[bs.At(parallel_id_of_root).begin()], tmp_out,
              bs.At(parallel_id_of_root).size() * sizeof(T));
     }
@@ -171,6 +215,9 @@ class CpuReduce final : public Reduce {
     const auto& cpu_communication_ctx =
         std::dynamic_pointer_cast<CpuCommunicationContext>(communication_ctx);
     CHECK(cpu_communication_ctx) << kOfBugIssueUploadPrompt;
+    OF_COUNTER_ADD("ccl.cpu.reduce.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.reduce.bytes", elem_cnt * GetSizeOfDataType(datatype_));
+    OF_COUNTER_TIME_GUARD("ccl.cpu.reduce.ns");
     CHECK_JUST(SwitchReduceImpl(SwitchCase(datatype_, reduce_type_), in, out, elem_cnt, root,
                                 cpu_communication_ctx->parallel_desc()));
   }
@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/common/data_type.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/reduce_scatter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
@@ -44,11 +45,20 @@ struct ReduceScatterImpl final {
     CHECK_OR_RETURN(opt_parallel_id->has_value()) << kOfBugIssueUploadPrompt;
     int64_t parallel_id = JUST(*opt_parallel_id);
 
-    auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
-    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
-
     TransportToken transport_token =
         JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
+    // Small buffers are all-reduced in log2(parallel_num) steps, of which each rank keeps its part.
+    if (UseLatencyOptimizedAlgorithm(elem_cnt * parallel_num * sizeof(T), parallel_num)) {
+      auto reduced = std::make_unique<T[]>(elem_cnt * parallel_num);
+      JUST(RecursiveDoublingAllReduce<T, reduce_type>(in, reduced.get(), elem_cnt * parallel_num,
+                                                      parallel_id, parallel_desc,
+                                                      transport_token));
+      std::memcpy(out, &reduced[bs.At(parallel_id).begin()], elem_cnt * sizeof(T));
+      return Maybe<void>::Ok();
+    }
+
+    auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
+    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
     for (int64_t i = 0, part_id = RingDecrease(parallel_id, parallel_num); i < parallel_num - 1;
          ++i, part_id = RingDecrease(part_id, parallel_num)) {
       int64_t send_part_id = part_id;
@@ -116,6 +126,9 @@ class CpuReduceScatter final : public ReduceScatter {
     const auto& cpu_communication_ctx =
         std::dynamic_pointer_cast<CpuCommunicationContext>(communication_ctx);
     CHECK(cpu_communication_ctx) << kOfBugIssueUploadPrompt;
+    OF_COUNTER_ADD("ccl.cpu.reduce_scatter.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.reduce_scatter.bytes", elem_cnt * GetSizeOfDataType(datatype_));
+    OF_COUNTER_TIME_GUARD("ccl.cpu.reduce_scatter.ns");
     CHECK_JUST(SwitchReduceScatterImpl(SwitchCase(datatype_, reduce_type_), in, out, elem_cnt,
                                        cpu_communication_ctx->parallel_desc()));
   }
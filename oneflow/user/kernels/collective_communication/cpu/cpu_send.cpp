@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/ccl/ccl.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
+#include "oneflow/core/profiler/counter.h"
 #include "oneflow/user/kernels/collective_communication/include/send.h"
 
 namespace oneflow {
@@ -37,6 +38,9 @@ class CpuSendImpl final : public Send {
 
   void Launch(ep::Stream* stream, const void* in, size_t elem_cnt, int64_t dst) const override {
     size_t buffer_size = elem_cnt * size_of_dtype_;
+    OF_COUNTER_ADD("ccl.cpu.send.calls", 1);
+    OF_COUNTER_ADD("ccl.cpu.send.bytes", buffer_size);
+    OF_COUNTER_TIME_GUARD("ccl.cpu.send.ns");
     CHECK_JUST(CpuSend(in, buffer_size, dst));
   }
 
@@ -18,6 +18,9 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/include/primitive/quantized_matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/common/env_var/env_var.h"
 
 namespace oneflow {
 
@@ -335,10 +338,23 @@ struct ConvKernelUtil final {
                           const ShapeView& weight_shape, const ShapeView& out_shape,
                           const int32_t* strides, const int32_t* dilation_rate,
                           const int32_t* padding_before, T* col_buf_ptr) {
+    NCDHWIm2ColRange(in_dptr, in_shape, weight_shape, out_shape, strides, dilation_rate,
+                     padding_before, 0, weight_shape.At(1), col_buf_ptr);
+  }
+
+  // Only writes the rows of col_buf which belong to input channels [c_begin, c_end), so that
+  // disjoint channel ranges of one image can be expanded concurrently.
+  static void NCDHWIm2ColRange(const T* in_dptr, const ShapeView& in_shape,
+                               const ShapeView& weight_shape, const ShapeView& out_shape,
+                               const int32_t* strides, const int32_t* dilation_rate,
+                               const int32_t* padding_before, int64_t c_begin, int64_t c_end,
+                               T* col_buf_ptr) {
     ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
-    Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr, in_shape.Count(2), in_shape.Count(3),
-                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
-    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
+    Im2ColWriter<T> col_buf_writer(
+        in_dptr + c_begin * in_shape.Count(2),
+        col_buf_ptr + c_begin * weight_shape.Count(2) * out_shape.Count(2), in_shape.Count(2),
+        in_shape.Count(3), in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
+    DoNCDWHFunc(weight_shape, c_begin, c_end, col_buf_util, &col_buf_writer);
   }
 
   static void NDHWCIm2Col(const T* in_dptr, const ShapeView& in_shape,
@@ -356,10 +372,22 @@ struct ConvKernelUtil final {
                           const ShapeView& weight_shape, const ShapeView& out_shape,
                           const int32_t* strides, const int32_t* dilation_rate,
                           const int32_t* padding_before, T* in_diff_ptr) {
+    NCDHWCol2ImRange(col_buf_ptr, in_shape, weight_shape, out_shape, strides, dilation_rate,
+                     padding_before, 0, weight_shape.At(1), in_diff_ptr);
+  }
+
+  // Only accumulates into input channels [c_begin, c_end) of in_diff.
+  static void NCDHWCol2ImRange(const T* col_buf_ptr, const ShapeView& in_shape,
+                               const ShapeView& weight_shape, const ShapeView& out_shape,
+                               const int32_t* strides, const int32_t* dilation_rate,
+                               const int32_t* padding_before, int64_t c_begin, int64_t c_end,
+                               T* in_diff_ptr) {
     ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
-    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(3),
-                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
-    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
+    Col2ImWriter<T> col_buf_writer(
+        col_buf_ptr + c_begin * weight_shape.Count(2) * out_shape.Count(2),
+        in_diff_ptr + c_begin * in_shape.Count(2), in_shape.Count(2), in_shape.Count(3),
+        in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
+    DoNCDWHFunc(weight_shape, c_begin, c_end, col_buf_util, &col_buf_writer);
   }
 
   static void NDHWCCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
@@ -374,9 +402,9 @@ struct ConvKernelUtil final {
   }
 
  private:
-  static void DoNCDWHFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
-                          ColBufWriter<T>* col_buf_writer) {
-    for (int64_t c = 0; c != weight_shape.At(1); col_buf_writer->NextImCSize(), ++c) {
+  static void DoNCDWHFunc(const ShapeView& weight_shape, int64_t c_begin, int64_t c_end,
+                          ColBufUtil<T>& col_buf_util, ColBufWriter<T>* col_buf_writer) {
+    for (int64_t c = c_begin; c != c_end; col_buf_writer->NextImCSize(), ++c) {
       for (int64_t kd = 0; kd != weight_shape.At(2); ++kd) {
         for (int64_t kh = 0; kh != weight_shape.At(3); ++kh) {
           for (int64_t kw = 0; kw != weight_shape.At(4); ++kw) {
@@ -418,8 +446,83 @@ struct ConvOpKernelCache final : public user_op::OpKernelCache {
 
   int32_t idx_offset_{};
   bool is_dynamic_{};
+  bool is_pointwise_{};
 };
 
+// 1x1 convolutions with unit strides and no padding in channels_first format, whose im2col is
+// the identity, so the image itself can be used as the col buffer.
+template<typename Context>
+bool IsPointwiseConv(Context* ctx) {
+  if (ctx->template Attr<std::string>("data_format") != "channels_first") { return false; }
+  for (int32_t kernel_size : ctx->template Attr<std::vector<int32_t>>("kernel_size")) {
+    if (kernel_size != 1) { return false; }
+  }
+  for (int32_t stride : ctx->template Attr<std::vector<int32_t>>("strides")) {
+    if (stride != 1) { return false; }
+  }
+  for (int32_t padding : ctx->template Attr<std::vector<int32_t>>("padding_before")) {
+    if (padding != 0) { return false; }
+  }
+  return true;
+}
+
+// Every thread working on a part of the batch owns a col buffer of its own. The number of
+// buffers is fixed when the tmp buffer size is inferred and is bounded by the batch size and
+// by the memory budget.
+int64_t GetNumColBufs(int64_t batch_size, size_t col_buf_size) {
+  int64_t num_col_bufs =
+      std::min<int64_t>(batch_size, EnvInteger<ONEFLOW_CPU_CONV_MAX_NUM_COL_BUFS>());
+  if (col_buf_size > 0) {
+    num_col_bufs = std::min<int64_t>(
+        num_col_bufs, EnvInteger<ONEFLOW_CPU_CONV_COL_BUF_MAX_BYTES>() / col_buf_size);
+  }
+  return std::max<int64_t>(num_col_bufs, 1);
+}
+
+int64_t GetCpuNumThreads(ep::Stream* stream) {
+  return stream->As<ep::CpuStream>()->device()->GetNumThreads();
+}
+
+// Small batches can not keep all threads busy, so the work of each sample is split instead:
+// im2col/col2im by input channels and the gemm by output channels. Both splits need the
+// channels_first layout.
+bool UseIntraSampleParallel(ep::Stream* stream, int32_t idx_offset, int64_t batch_size) {
+  return idx_offset == 2 && batch_size < GetCpuNumThreads(stream);
+}
+
+// Splits [0, n) into num_parts balanced ranges, func(part_id, begin, end) is called once for
+// every part.
+template<typename F>
+void ParallelForEachPart(ep::Stream* stream, int64_t n, int64_t num_parts, const F& func) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_parts,
+      [&](int64_t part_begin, int64_t part_end) {
+        for (int64_t part = part_begin; part < part_end; ++part) {
+          func(part, n * part / num_parts, n * (part + 1) / num_parts);
+        }
+      },
+      1);
+}
+
+// GEMMs of at most this many multiply-adds are too small to be threaded inside BLAS, so several of
+// them may be issued from the stream threads at once. Larger ones are issued one at a time from the
+// calling thread and left to the thread pool of the BLAS library, which the stream threads would
+// oversubscribe otherwise.
+constexpr int64_t kConvSmallGemmMaxMacs = 128 * 128 * 128;
+
+bool IsSmallGemm(int64_t m, int64_t n, int64_t k) { return m * n * k <= kConvSmallGemmMaxMacs; }
+
+// Calls func(i) for every sample in [begin, end) on the stream threads.
+template<typename F>
+void ParallelForEachSample(ep::Stream* stream, int64_t begin, int64_t end, const F& func) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      begin, end,
+      [&](int64_t sample_begin, int64_t sample_end) {
+        FOR_RANGE(int64_t, i, sample_begin, sample_end) { func(i); }
+      },
+      1);
+}
+
 template<typename T>
 std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCacheContext* ctx,
                                                               const std::string& in_name,
@@ -462,6 +565,7 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
   cache->strides_3d_ = Gen3DVec(ctx->Attr<std::vector<int32_t>>("strides"));
   cache->dilation_rate_3d_ = Gen3DVec(ctx->Attr<std::vector<int32_t>>("dilation_rate"));
   cache->is_dynamic_ = ctx->TensorDesc4ArgNameAndIndex(in_name, 0)->is_dynamic();
+  cache->is_pointwise_ = IsPointwiseConv(ctx);
   const auto& padding_before = ctx->Attr<std::vector<int32_t>>("padding_before");
   FOR_RANGE(uint8_t, dim, 0, 3) {
     int64_t index = static_cast<int64_t>(dim) - (3 - padding_before.size());
@@ -501,13 +605,10 @@ class ConvCpuKernel final : public user_op::OpKernel {
 
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
     user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
 
-    T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
-
-    bool is_bias_mul_inited = false;
-
     const auto& data_format = ctx->Attr<std::string>("data_format");
     std::unique_ptr<ep::primitive::Matmul> matmul;
     if (data_format == "channels_first") {
@@ -528,44 +629,107 @@ class ConvCpuKernel final : public user_op::OpKernel {
       beta = 1;
     }
 
-    for (int64_t i = 0; i < in->shape_view().At(0); ++i) {
+    const int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t batch_size = in->shape_view().At(0);
+    const int64_t filter = conv_cache->weight_5d_shape_.At(0);
+    const int64_t spatial = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+    const int64_t col_rows = conv_cache->weight_5d_shape_.Count(1);
+
+    // tmp buffer: bias_mul (only if bias exists) | col_buf * num_col_bufs
+    T* bias_mul_dptr = tmp_buffer != nullptr ? tmp_buffer->mut_dptr<T>() : nullptr;
+    T* col_buf_dptr = bias_mul_dptr;
+    int64_t tmp_buffer_size = tmp_buffer != nullptr ? tmp_buffer->shape_view().elem_cnt() : 0;
+    if (bias != nullptr) {
+      InitBiasMulBuf(bias_mul_dptr, spatial);
+      col_buf_dptr += spatial;
+      tmp_buffer_size -= spatial * sizeof(T);
+    }
+    const int64_t col_buf_elem_cnt =
+        conv_cache->is_pointwise_
+            ? 0
+            : CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
+    int64_t num_col_bufs = batch_size;
+    if (col_buf_elem_cnt > 0) {
+      num_col_bufs = tmp_buffer_size / (col_buf_elem_cnt * sizeof(T));
+      CHECK_GT(num_col_bufs, 0);
+    }
+
+    auto Im2Col = [&](int64_t i, T* col_buf) {
       conv_cache->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
                                ShapeView(conv_cache->weight_5d_shape_),
                                ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
                                conv_cache->dilation_rate_3d_.data(),
-                               conv_cache->padding_before_3d_.data(), col_buf_dptr);
-
+                               conv_cache->padding_before_3d_.data(), col_buf);
+    };
+    auto Gemm = [&](int64_t i, const T* col_buf) {
+      T* out_dptr = GetImgMutDptr<T>(out, i);
       // channels first: out = weight * col_buf
       // channels last:  out = (weight * col_buf)(T)
-      int32_t idx_offset = conv_cache->idx_offset_;
       matmul->Launch(ctx->stream(),
-                     conv_cache->weight_5d_shape_.At(0),                           // filter
-                     conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-                     conv_cache->weight_5d_shape_.Count(1),  // ci * kd * kh * kw
-                     static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, beta,
-                     GetImgMutDptr<T>(out, i));
-
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+                     filter,    // filter
+                     spatial,   // od * oh * ow
+                     col_rows,  // ci * kd * kh * kw
+                     static_cast<T>(1), weight->dptr<T>(), col_buf, beta, out_dptr);
       if (bias != nullptr) {
-        int64_t num_of_col_buf =
-            CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
-        int64_t num_of_bias_mul =
-            (tmp_buffer->shape_view().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
-        if (!is_bias_mul_inited) {
-          InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
-          is_bias_mul_inited = true;
-        }
-
         // channels first:  out += bias * bias_mul
         // channels last:   out += (bias * bias_mul)(T)
         matmul->Launch(ctx->stream(),
-                       conv_cache->weight_5d_shape_.At(0),                           // filter
-                       conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-                       1,                                                            // 1
+                       filter,   // filter
+                       spatial,  // od * oh * ow
+                       1,        // 1
                        static_cast<T>(1), bias->dptr<T>(), bias_mul_dptr, static_cast<T>(1),
-                       GetImgMutDptr<T>(out, i));
+                       out_dptr);
+      }
+    };
+
+    if (UseIntraSampleParallel(ctx->stream(), idx_offset, batch_size)) {
+      // im2col is split by input channels, the gemm is left to the blas library
+      auto* cpu_stream = ctx->stream()->As<ep::CpuStream>();
+      FOR_RANGE(int64_t, i, 0, batch_size) {
+        const T* col_buf = GetImgDptr<T>(in, i);
+        if (!conv_cache->is_pointwise_) {
+          cpu_stream->ParallelFor(
+              0, conv_cache->weight_5d_shape_.At(1),
+              [&](int64_t c_begin, int64_t c_end) {
+                ConvKernelUtil<T>::NCDHWIm2ColRange(
+                    GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
+                    ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+                    conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+                    conv_cache->padding_before_3d_.data(), c_begin, c_end, col_buf_dptr);
+              },
+              1);
+          col_buf = col_buf_dptr;
+        }
+        Gemm(i, col_buf);
+      }
+    } else if (IsSmallGemm(filter, spatial, col_rows)) {
+      auto ForwardPart = [&](int64_t part, int64_t begin, int64_t end) {
+        T* col_buf = col_buf_dptr + part * col_buf_elem_cnt;
+        FOR_RANGE(int64_t, i, begin, end) {
+          if (conv_cache->is_pointwise_) {
+            Gemm(i, GetImgDptr<T>(in, i));
+          } else {
+            Im2Col(i, col_buf);
+            Gemm(i, col_buf);
+          }
+        }
+      };
+      const int64_t num_parts = std::min(num_col_bufs, GetCpuNumThreads(ctx->stream()));
+      ParallelForEachPart(ctx->stream(), batch_size, num_parts, ForwardPart);
+    } else {
+      // im2col of up to num_col_bufs samples runs on the stream threads, then their gemms are
+      // issued from this thread
+      for (int64_t group = 0; group < batch_size; group += num_col_bufs) {
+        const int64_t group_end = std::min(group + num_col_bufs, batch_size);
+        if (!conv_cache->is_pointwise_) {
+          ParallelForEachSample(ctx->stream(), group, group_end, [&](int64_t i) {
+            Im2Col(i, col_buf_dptr + (i - group) * col_buf_elem_cnt);
+          });
+        }
+        FOR_RANGE(int64_t, i, group, group_end) {
+          Gemm(i, conv_cache->is_pointwise_ ? GetImgDptr<T>(in, i)
+                                            : col_buf_dptr + (i - group) * col_buf_elem_cnt);
+        }
       }
     }
   }
@@ -585,8 +749,11 @@ class ConvCpuKernel final : public user_op::OpKernel {
         const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();               \
                                                                                             \
         int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
-        tmp_buffer_size +=                                                                  \
-            CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);       \
+        if (!IsPointwiseConv(ctx)) {                                                        \
+          const size_t col_buf_size =                                                       \
+              CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);     \
+          tmp_buffer_size += GetNumColBufs(out_shape.At(0), col_buf_size) * col_buf_size;   \
+        }                                                                                   \
         bool has_bias = ctx->has_input("bias", 0);                                          \
         if (has_bias) {                                                                     \
           int64_t bias_mul_cnt = 1;                                                         \
@@ -611,6 +778,150 @@ REGISTER_CONV_KERNEL(conv1d, double, 1);
 REGISTER_CONV_KERNEL(conv2d, double, 2);
 REGISTER_CONV_KERNEL(conv3d, double, 3);
 
+// channels first: out = weight * col_buf, the output channels are the rows of out
+// channels last:  out = col_buf(T) * weight(T), the output channels are the columns of out
+template<typename Context>
+std::unique_ptr<ep::primitive::QuantizedMatmul> NewQuantizedConvMatmulPrimitive(Context* ctx) {
+  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("out", 0)->data_type();
+  const bool channels_first = ctx->template Attr<std::string>("data_format") == "channels_first";
+  const auto transpose = GetBlasTransposeType(!channels_first);
+  return ep::primitive::NewPrimitive<ep::primitive::QuantizedMatmulFactory>(
+      ctx->device_type(), data_type, transpose, transpose,
+      channels_first ? ep::primitive::QuantizedMatmulChannelAxis::kM
+                     : ep::primitive::QuantizedMatmulChannelAxis::kN);
+}
+
+auto QuantizedConvMatmulPrimitiveExists() {
+  return hob::make_custom("QuantizedConvMatmulPrimitiveExists",
+                          [](const user_op::KernelRegContext& ctx) {
+                            return NewQuantizedConvMatmulPrimitive(&ctx).operator bool();
+                          });
+}
+
+// int8 convolution with int32 accumulation. Padding is filled with 0, which is the quantized zero
+// of the symmetric quantization the int8 inputs come from. Scale and bias are applied by the
+// epilogue of the gemm, so the output is written once.
+class QuantizedConvCpuKernel final : public user_op::OpKernel {
+ public:
+  QuantizedConvCpuKernel() = default;
+  ~QuantizedConvCpuKernel() = default;
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+  std::shared_ptr<user_op::OpKernelCache> InitOpKernelCache(
+      user_op::KernelCacheContext* ctx) const override {
+    return CreateConvOpKernelCache<int8_t>(ctx, "in", "out", "weight");
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const auto* conv_cache = dynamic_cast<const ConvOpKernelCache<int8_t>*>(cache);
+    CHECK_NOTNULL(conv_cache);
+
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const float* scale = nullptr;
+    if (ctx->has_input("scale", 0)) {
+      scale = ctx->Tensor4ArgNameAndIndex("scale", 0)->dptr<float>();
+    }
+    const float* bias = nullptr;
+    if (ctx->has_input("bias", 0)) { bias = ctx->Tensor4ArgNameAndIndex("bias", 0)->dptr<float>(); }
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+
+    std::unique_ptr<ep::primitive::QuantizedMatmul> matmul = NewQuantizedConvMatmulPrimitive(ctx);
+    CHECK(matmul);
+
+    const int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t batch_size = in->shape_view().At(0);
+    const int64_t filter = conv_cache->weight_5d_shape_.At(0);
+    const int64_t spatial = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+    const int64_t col_rows = conv_cache->weight_5d_shape_.Count(1);
+    const size_t out_img_size = out->shape_view().Count(1) * GetSizeOfDataType(out->data_type());
+
+    int8_t* col_buf_dptr = tmp_buffer != nullptr ? tmp_buffer->mut_dptr<int8_t>() : nullptr;
+    const int64_t col_buf_elem_cnt =
+        conv_cache->is_pointwise_
+            ? 0
+            : CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
+    int64_t num_col_bufs = batch_size;
+    if (col_buf_elem_cnt > 0) {
+      num_col_bufs = tmp_buffer->shape_view().elem_cnt() / col_buf_elem_cnt;
+      CHECK_GT(num_col_bufs, 0);
+    }
+
+    auto Im2Col = [&](int64_t i, int8_t* col_buf) {
+      conv_cache->im2col_func_(GetImgDptr<int8_t>(in, i), ShapeView(conv_cache->in_5d_shape_),
+                               ShapeView(conv_cache->weight_5d_shape_),
+                               ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
+                               conv_cache->dilation_rate_3d_.data(),
+                               conv_cache->padding_before_3d_.data(), col_buf);
+    };
+    auto Gemm = [&](int64_t i, const int8_t* col_buf) {
+      char* out_dptr = out->mut_dptr<char>() + i * out_img_size;
+      if (idx_offset == 2) {
+        matmul->Launch(ctx->stream(), filter, spatial, col_rows, weight->dptr(), col_buf, scale,
+                       bias, out_dptr);
+      } else {
+        matmul->Launch(ctx->stream(), spatial, filter, col_rows, col_buf, weight->dptr(), scale,
+                       bias, out_dptr);
+      }
+    };
+
+    if (UseIntraSampleParallel(ctx->stream(), idx_offset, batch_size)) {
+      // The gemm of one sample is parallelized by the primitive itself.
+      auto* cpu_stream = ctx->stream()->As<ep::CpuStream>();
+      FOR_RANGE(int64_t, i, 0, batch_size) {
+        const int8_t* col_buf = GetImgDptr<int8_t>(in, i);
+        if (!conv_cache->is_pointwise_) {
+          cpu_stream->ParallelFor(
+              0, conv_cache->weight_5d_shape_.At(1),
+              [&](int64_t c_begin, int64_t c_end) {
+                ConvKernelUtil<int8_t>::NCDHWIm2ColRange(
+                    GetImgDptr<int8_t>(in, i), ShapeView(conv_cache->in_5d_shape_),
+                    ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+                    conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+                    conv_cache->padding_before_3d_.data(), c_begin, c_end, col_buf_dptr);
+              },
+              1);
+          col_buf = col_buf_dptr;
+        }
+        Gemm(i, col_buf);
+      }
+    } else {
+      auto ForwardPart = [&](int64_t part, int64_t begin, int64_t end) {
+        int8_t* col_buf = col_buf_dptr + part * col_buf_elem_cnt;
+        FOR_RANGE(int64_t, i, begin, end) {
+          if (conv_cache->is_pointwise_) {
+            Gemm(i, GetImgDptr<int8_t>(in, i));
+          } else {
+            Im2Col(i, col_buf);
+            Gemm(i, col_buf);
+          }
+        }
+      };
+      const int64_t num_parts = std::min(num_col_bufs, GetCpuNumThreads(ctx->stream()));
+      ParallelForEachPart(ctx->stream(), batch_size, num_parts, ForwardPart);
+    }
+  }
+};
+
+REGISTER_USER_KERNEL("quantized_conv2d")
+    .SetCreateFn<QuantizedConvCpuKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobAttr<int32_t>("groups") == 1)
+                     && QuantizedConvMatmulPrimitiveExists())
+    .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {
+      if (IsPointwiseConv(ctx)) { return 0; }
+      const auto& out_shape = ctx->OutputTensorDesc("out", 0).shape();
+      const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();
+      const int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));
+      const size_t col_buf_size =
+          CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(int8_t);
+      return GetNumColBufs(out_shape.At(0), col_buf_size) * col_buf_size;
+    });
+
 template<typename T>
 class ConvDataGradCpuKernel final : public user_op::OpKernel {
  public:
@@ -636,9 +947,6 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
     user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
     user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    Memset<DeviceType::kCPU>(ctx->stream(), dx->mut_dptr<T>(), 0,
-                             dx->shape_view().elem_cnt() * sizeof(T));
-
     std::unique_ptr<ep::primitive::Matmul> matmul;
     if (conv_cache->is_out_diff_need_trans_) {
       matmul = NewConvDataGradTransATransBMatmulPrimitive(ctx);
@@ -647,23 +955,99 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
     }
     CHECK(matmul);
 
-    int32_t idx_offset = conv_cache->idx_offset_;
-    FOR_RANGE(int64_t, i, 0, dy->shape_view().At(0)) {
+    const int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t batch_size = dy->shape_view().At(0);
+    // pointwise conv writes the gemm result to dx directly, the others accumulate into dx by
+    // col2im
+    if (!conv_cache->is_pointwise_) {
+      Memset<DeviceType::kCPU>(ctx->stream(), dx->mut_dptr<T>(), 0,
+                               dx->shape_view().elem_cnt() * sizeof(T));
+    }
+    const int64_t col_buf_elem_cnt =
+        conv_cache->is_pointwise_
+            ? 0
+            : CalcElemNumOfColBuf(dy->shape_view(), filter->shape_view(), idx_offset);
+    int64_t num_col_bufs = batch_size;
+    if (col_buf_elem_cnt > 0) {
+      num_col_bufs = col_buf->shape_view().elem_cnt() / (col_buf_elem_cnt * sizeof(T));
+      CHECK_GT(num_col_bufs, 0);
+    }
+
+    const int64_t col_rows = conv_cache->weight_5d_shape_.Count(1);
+    const int64_t spatial = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+    const int64_t num_filters = conv_cache->weight_5d_shape_.At(0);
+    auto Gemm = [&](int64_t i, T* col_buf_dptr) {
       // channels first:  col_buf' = weight(T) * out[i]'
       // channels last :  col_buf' = weight(T) * out[i]'(T)
       matmul->Launch(ctx->stream(),
-                     conv_cache->weight_5d_shape_.Count(1),  //  ci * kd * kh * kw
-                     conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  //  od * oh * ow
-                     conv_cache->weight_5d_shape_.At(0),                           //  filter
+                     col_rows,     //  ci * kd * kh * kw
+                     spatial,      //  od * oh * ow
+                     num_filters,  //  filter
                      static_cast<T>(1), filter->dptr<T>(), GetImgDptr<T>(dy, i), static_cast<T>(0),
-                     col_buf->mut_dptr<T>());
-
+                     col_buf_dptr);
+    };
+    auto Col2Im = [&](int64_t i, const T* col_buf_dptr) {
       // in' = col2im(col_buf')
-      conv_cache->col2im_func_(col_buf->dptr<T>(), ShapeView(conv_cache->in_5d_shape_),
-                               ShapeView(conv_cache->weight_5d_shape_),
-                               ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
-                               conv_cache->dilation_rate_3d_.data(),
-                               conv_cache->padding_before_3d_.data(), GetImgMutDptr<T>(dx, i));
+      conv_cache->col2im_func_(
+          col_buf_dptr, ShapeView(conv_cache->in_5d_shape_),
+          ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+          conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+          conv_cache->padding_before_3d_.data(), GetImgMutDptr<T>(dx, i));
+    };
+
+    if (UseIntraSampleParallel(ctx->stream(), idx_offset, batch_size)) {
+      // the gemm is left to the blas library, col2im is split by input channels
+      auto* cpu_stream = ctx->stream()->As<ep::CpuStream>();
+      FOR_RANGE(int64_t, i, 0, batch_size) {
+        if (conv_cache->is_pointwise_) {
+          Gemm(i, GetImgMutDptr<T>(dx, i));
+          continue;
+        }
+        Gemm(i, col_buf->mut_dptr<T>());
+        cpu_stream->ParallelFor(
+            0, conv_cache->weight_5d_shape_.At(1),
+            [&](int64_t c_begin, int64_t c_end) {
+              ConvKernelUtil<T>::NCDHWCol2ImRange(
+                  col_buf->dptr<T>(), ShapeView(conv_cache->in_5d_shape_),
+                  ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+                  conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+                  conv_cache->padding_before_3d_.data(), c_begin, c_end, GetImgMutDptr<T>(dx, i));
+            },
+            1);
+      }
+    } else if (IsSmallGemm(col_rows, spatial, num_filters)) {
+      auto BackwardPart = [&](int64_t part, int64_t begin, int64_t end) {
+        T* col_buf_dptr = col_buf_elem_cnt > 0 ? col_buf->mut_dptr<T>() + part * col_buf_elem_cnt
+                                               : nullptr;
+        FOR_RANGE(int64_t, i, begin, end) {
+          if (conv_cache->is_pointwise_) {
+            Gemm(i, GetImgMutDptr<T>(dx, i));
+            continue;
+          }
+          Gemm(i, col_buf_dptr);
+          Col2Im(i, col_buf_dptr);
+        }
+      };
+      const int64_t num_parts = std::min(num_col_bufs, GetCpuNumThreads(ctx->stream()));
+      ParallelForEachPart(ctx->stream(), batch_size, num_parts, BackwardPart);
+    } else {
+      // the gemms of up to num_col_bufs samples are issued from this thread, then their col2im
+      // runs on the stream threads
+      for (int64_t group = 0; group < batch_size; group += num_col_bufs) {
+        const int64_t group_end = std::min(group + num_col_bufs, batch_size);
+        FOR_RANGE(int64_t, i, group, group_end) {
+          if (conv_cache->is_pointwise_) {
+            Gemm(i, GetImgMutDptr<T>(dx, i));
+          } else {
+            Gemm(i, col_buf->mut_dptr<T>() + (i - group) * col_buf_elem_cnt);
+          }
+        }
+        if (!conv_cache->is_pointwise_) {
+          ParallelForEachSample(ctx->stream(), group, group_end, [&](int64_t i) {
+            Col2Im(i, col_buf->dptr<T>() + (i - group) * col_buf_elem_cnt);
+          });
+        }
+      }
     }
     if (ctx->has_input("_add_to_output", 0)) {
       const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
@@ -679,23 +1063,26 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
   }
 };
 
-#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                     \
-  REGISTER_USER_KERNEL(#op_name)                                                           \
-      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                         \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
-                       && (user_op::HobAttr<int32_t>("groups") == 1)                       \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)     \
-                       && ConvDataGradTransATransBMatmulPrimitiveExists()                  \
-                       && ConvDataGradTransANoTransBMatmulPrimitiveExists())               \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                        \
-        size_t tmp_buffer_size = 0;                                                        \
-        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                \
-        const auto& weight_shape = ctx->InputTensorDesc("filter", 0).shape();              \
-                                                                                           \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));             \
-        tmp_buffer_size +=                                                                 \
-            CalcElemNumOfColBuf(out_diff_shape, weight_shape, idx_offset) * sizeof(dtype); \
-        return tmp_buffer_size;                                                            \
+#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                         \
+  REGISTER_USER_KERNEL(#op_name)                                                               \
+      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                          \
+                       && (user_op::HobAttr<int32_t>("groups") == 1)                           \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)         \
+                       && ConvDataGradTransATransBMatmulPrimitiveExists()                      \
+                       && ConvDataGradTransANoTransBMatmulPrimitiveExists())                   \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                            \
+        size_t tmp_buffer_size = 0;                                                            \
+        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                    \
+        const auto& weight_shape = ctx->InputTensorDesc("filter", 0).shape();                  \
+                                                                                               \
+        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));                 \
+        if (!IsPointwiseConv(ctx)) {                                                           \
+          const size_t col_buf_size =                                                          \
+              CalcElemNumOfColBuf(out_diff_shape, weight_shape, idx_offset) * sizeof(dtype);   \
+          tmp_buffer_size += GetNumColBufs(out_diff_shape.At(0), col_buf_size) * col_buf_size; \
+        }                                                                                      \
+        return tmp_buffer_size;                                                                \
       })
 
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, float);
@@ -726,8 +1113,6 @@ class ConvFilterGradCpuKernel final : public user_op::OpKernel {
     user_op::Tensor* filter_diff = ctx->Tensor4ArgNameAndIndex("filter_diff", 0);
     user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    Memset<DeviceType::kCPU>(ctx->stream(), filter_diff->mut_dptr<T>(), 0,
-                             filter_diff->shape_view().elem_cnt() * sizeof(T));
     std::unique_ptr<ep::primitive::Matmul> matmul;
     if (conv_cache->is_out_diff_need_trans_) {
       matmul = NewConvWeightGradTransATransBMatmulPrimitive(ctx);
@@ -736,43 +1121,148 @@ class ConvFilterGradCpuKernel final : public user_op::OpKernel {
     }
     CHECK(matmul);
 
-    int32_t idx_offset = conv_cache->idx_offset_;
-    FOR_RANGE(int64_t, i, 0, dy->shape_view().At(0)) {
+    const int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t batch_size = dy->shape_view().At(0);
+    const int64_t filter = conv_cache->weight_5d_shape_.At(0);
+    const int64_t spatial = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+    const int64_t col_rows = conv_cache->weight_5d_shape_.Count(1);
+    const int64_t filter_diff_elem_cnt = filter_diff->shape_view().elem_cnt();
+
+    // tmp buffer: col_buf * num_parts | partial filter_diff * (num_parts - 1)
+    const int64_t col_buf_elem_cnt =
+        conv_cache->is_pointwise_
+            ? 0
+            : CalcElemNumOfColBuf(dy->shape_view(), filter_diff->shape_view(), idx_offset);
+    const int64_t tmp_buffer_size = col_buf != nullptr ? col_buf->shape_view().elem_cnt() : 0;
+    const int64_t max_num_parts = (tmp_buffer_size + filter_diff_elem_cnt * sizeof(T))
+                                  / ((col_buf_elem_cnt + filter_diff_elem_cnt) * sizeof(T));
+    CHECK_GT(max_num_parts, 0);
+    T* col_buf_dptr = col_buf != nullptr ? col_buf->mut_dptr<T>() : nullptr;
+    T* partial_filter_diff_dptr =
+        col_buf_dptr == nullptr ? nullptr : col_buf_dptr + max_num_parts * col_buf_elem_cnt;
+
+    Memset<DeviceType::kCPU>(ctx->stream(), filter_diff->mut_dptr<T>(), 0,
+                             filter_diff_elem_cnt * sizeof(T));
+
+    auto Im2Col = [&](int64_t i, T* col_buf) {
       conv_cache->im2col_func_(GetImgDptr<T>(x, i), ShapeView(conv_cache->in_5d_shape_),
                                ShapeView(conv_cache->weight_5d_shape_),
                                ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
                                conv_cache->dilation_rate_3d_.data(),
-                               conv_cache->padding_before_3d_.data(), col_buf->mut_dptr<T>());
-
+                               conv_cache->padding_before_3d_.data(), col_buf);
+    };
+    // Accumulates the i-th sample into weight_diff.
+    auto Gemm = [&](int64_t i, const T* col_buf, T* weight_diff) {
       // channels first:  weight' += out[i]' * col_buf(T)
       // channels last :  weight' += out[i]'(T) * col_buf(T)
       matmul->Launch(ctx->stream(),
-                     conv_cache->weight_5d_shape_.At(0),     //  filter
-                     conv_cache->weight_5d_shape_.Count(1),  //  ci * kd * kh * kw
-                     conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  //  od * oh * ow
-                     static_cast<T>(1), GetImgDptr<T>(dy, i), col_buf->dptr<T>(), static_cast<T>(1),
-                     filter_diff->mut_dptr<T>());
+                     filter,    //  filter
+                     col_rows,  //  ci * kd * kh * kw
+                     spatial,   //  od * oh * ow
+                     static_cast<T>(1), GetImgDptr<T>(dy, i), col_buf, static_cast<T>(1),
+                     weight_diff);
+    };
+
+    if (UseIntraSampleParallel(ctx->stream(), idx_offset, batch_size)) {
+      // im2col is split by input channels, the gemm is left to the blas library
+      auto* cpu_stream = ctx->stream()->As<ep::CpuStream>();
+      FOR_RANGE(int64_t, i, 0, batch_size) {
+        const T* col_buf = GetImgDptr<T>(x, i);
+        if (!conv_cache->is_pointwise_) {
+          cpu_stream->ParallelFor(
+              0, conv_cache->weight_5d_shape_.At(1),
+              [&](int64_t c_begin, int64_t c_end) {
+                ConvKernelUtil<T>::NCDHWIm2ColRange(
+                    GetImgDptr<T>(x, i), ShapeView(conv_cache->in_5d_shape_),
+                    ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+                    conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+                    conv_cache->padding_before_3d_.data(), c_begin, c_end, col_buf_dptr);
+              },
+              1);
+          col_buf = col_buf_dptr;
+        }
+        Gemm(i, col_buf, filter_diff->mut_dptr<T>());
+      }
+      return;
+    }
+
+    if (!IsSmallGemm(filter, col_rows, spatial)) {
+      // im2col of up to max_num_parts samples runs on the stream threads, then their gemms
+      // accumulate into filter_diff from this thread
+      for (int64_t group = 0; group < batch_size; group += max_num_parts) {
+        const int64_t group_end = std::min(group + max_num_parts, batch_size);
+        if (!conv_cache->is_pointwise_) {
+          ParallelForEachSample(ctx->stream(), group, group_end, [&](int64_t i) {
+            Im2Col(i, col_buf_dptr + (i - group) * col_buf_elem_cnt);
+          });
+        }
+        FOR_RANGE(int64_t, i, group, group_end) {
+          Gemm(i,
+               conv_cache->is_pointwise_ ? GetImgDptr<T>(x, i)
+                                         : col_buf_dptr + (i - group) * col_buf_elem_cnt,
+               filter_diff->mut_dptr<T>());
+        }
+      }
+      return;
+    }
+
+    // Every part accumulates its samples into a filter_diff of its own, the first part uses
+    // filter_diff itself and the others are summed into it at last.
+    const int64_t num_parts = std::min(max_num_parts, GetCpuNumThreads(ctx->stream()));
+    auto BackwardPart = [&](int64_t part, int64_t begin, int64_t end) {
+      T* col_buf = col_buf_dptr + part * col_buf_elem_cnt;
+      T* weight_diff = filter_diff->mut_dptr<T>();
+      if (part > 0) {
+        weight_diff = partial_filter_diff_dptr + (part - 1) * filter_diff_elem_cnt;
+        std::fill(weight_diff, weight_diff + filter_diff_elem_cnt, static_cast<T>(0));
+      }
+      FOR_RANGE(int64_t, i, begin, end) {
+        if (conv_cache->is_pointwise_) {
+          Gemm(i, GetImgDptr<T>(x, i), weight_diff);
+        } else {
+          Im2Col(i, col_buf);
+          Gemm(i, col_buf, weight_diff);
+        }
+      }
+    };
+    ParallelForEachPart(ctx->stream(), batch_size, num_parts, BackwardPart);
+    if (num_parts > 1) {
+      T* filter_diff_dptr = filter_diff->mut_dptr<T>();
+      ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+          0, filter_diff_elem_cnt, [&](int64_t begin, int64_t end) {
+            FOR_RANGE(int64_t, part, 1, num_parts) {
+              const T* partial = partial_filter_diff_dptr + (part - 1) * filter_diff_elem_cnt;
+              FOR_RANGE(int64_t, j, begin, end) { filter_diff_dptr[j] += partial[j]; }
+            }
+          });
     }
   }
 };
 
-#define REGISTER_CONV_FILTER_GRAD_KERNEL(op_name, dtype)                                        \
-  REGISTER_USER_KERNEL(#op_name)                                                                \
-      .SetCreateFn<ConvFilterGradCpuKernel<dtype>>()                                            \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
-                       && (user_op::HobAttr<int32_t>("groups") == 1)                            \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)          \
-                       && ConvWeightGradTransATransBMatmulPrimitiveExists()                     \
-                       && ConvWeightGradNoTransATransBMatmulPrimitiveExists())                  \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                             \
-        size_t tmp_buffer_size = 0;                                                             \
-        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                     \
-        const auto& weight_diff_shape = ctx->OutputTensorDesc("filter_diff", 0).shape();        \
-                                                                                                \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));                  \
-        tmp_buffer_size +=                                                                      \
-            CalcElemNumOfColBuf(out_diff_shape, weight_diff_shape, idx_offset) * sizeof(dtype); \
-        return tmp_buffer_size;                                                                 \
+#define REGISTER_CONV_FILTER_GRAD_KERNEL(op_name, dtype)                                          \
+  REGISTER_USER_KERNEL(#op_name)                                                                  \
+      .SetCreateFn<ConvFilterGradCpuKernel<dtype>>()                                              \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                             \
+                       && (user_op::HobAttr<int32_t>("groups") == 1)                              \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)            \
+                       && ConvWeightGradTransATransBMatmulPrimitiveExists()                       \
+                       && ConvWeightGradNoTransATransBMatmulPrimitiveExists())                    \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                               \
+        size_t tmp_buffer_size = 0;                                                               \
+        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                       \
+        const auto& weight_diff_shape = ctx->OutputTensorDesc("filter_diff", 0).shape();          \
+                                                                                                  \
+        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));                    \
+        size_t col_buf_size = 0;                                                                  \
+        if (!IsPointwiseConv(ctx)) {                                                              \
+          col_buf_size =                                                                          \
+              CalcElemNumOfColBuf(out_diff_shape, weight_diff_shape, idx_offset) * sizeof(dtype); \
+        }                                                                                         \
+        const size_t weight_diff_size = weight_diff_shape.elem_cnt() * sizeof(dtype);             \
+        const int64_t num_parts =                                                                 \
+            GetNumColBufs(out_diff_shape.At(0), col_buf_size + weight_diff_size);                 \
+        tmp_buffer_size += num_parts * col_buf_size + (num_parts - 1) * weight_diff_size;         \
+        return tmp_buffer_size;                                                                   \
       })
 
 REGISTER_CONV_FILTER_GRAD_KERNEL(conv_filter_grad, float);
@@ -0,0 +1,273 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+namespace {
+
+// Parallel chunks of elementwise work get at least this many elements.
+constexpr int64_t kParallelMinElemCnt = 32768;
+// Number of output features computed by one task of the fused linear kernel.
+constexpr int64_t kFusedLinearBlockSize = 16;
+
+// The i-th integer of a tensor of num_bits-bit integers. 4-bit integers are packed in pairs, the
+// first one in the high nibble, as in groupwise_quantization_kernels.cu.
+template<typename U, int num_bits>
+int32_t LoadQuantized(const U* in, int64_t i) {
+  if (num_bits == 8) { return in[i]; }
+  const U q = in[i / 2];
+  if (i % 2 == 0) { return q >> 4; }
+  return static_cast<U>(static_cast<uint8_t>(q) << 4) >> 4;
+}
+
+// Dequantized values are q * scale + zero. The zero of symmetric quantization is 0 for int8 and
+// -scale * (2^(num_bits - 1) - 1) for uint8.
+template<typename T, typename U, int num_bits>
+T GetZero(bool symmetric, T scale, const T* zero, int64_t i) {
+  if (!symmetric) { return zero[i]; }
+  if (std::is_same<U, uint8_t>::value) {
+    return -scale * static_cast<T>((1 << (num_bits - 1)) - 1);
+  }
+  return 0;
+}
+
+template<typename T, typename U, int num_bits>
+void Dequantize(ep::CpuStream* stream, bool symmetric, int64_t outer_size, int64_t group_size,
+                int64_t inner_size, const U* in, const T* scale, const T* zero, T* out) {
+  const int64_t group_elem_cnt = group_size * inner_size;
+  stream->ParallelFor(
+      0, outer_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t outer = begin; outer < end; ++outer) {
+          for (int64_t g = 0; g < group_size; ++g) {
+            const int64_t offset = outer * group_elem_cnt + g * inner_size;
+            for (int64_t inner = 0; inner < inner_size; ++inner) {
+              const int64_t scale_idx = outer * inner_size + inner;
+              const T group_scale = scale[scale_idx];
+              const T group_zero = GetZero<T, U, num_bits>(symmetric, group_scale, zero, scale_idx);
+              out[offset + inner] =
+                  static_cast<T>(LoadQuantized<U, num_bits>(in, offset + inner)) * group_scale
+                  + group_zero;
+            }
+          }
+        }
+      },
+      std::max<int64_t>(kParallelMinElemCnt / std::max<int64_t>(group_elem_cnt, 1), 1));
+}
+
+template<typename T, typename U>
+void DispatchDequantize(ep::CpuStream* stream, int32_t num_bits, bool symmetric,
+                        int64_t outer_size, int64_t group_size, int64_t inner_size, const U* in,
+                        const T* scale, const T* zero, T* out) {
+  if (num_bits == 4) {
+    Dequantize<T, U, 4>(stream, symmetric, outer_size, group_size, inner_size, in, scale, zero,
+                        out);
+  } else if (num_bits == 8) {
+    Dequantize<T, U, 8>(stream, symmetric, outer_size, group_size, inner_size, in, scale, zero,
+                        out);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T>
+class GroupwiseDequantizeCpuKernel final : public user_op::OpKernel {
+ public:
+  GroupwiseDequantizeCpuKernel() = default;
+  ~GroupwiseDequantizeCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* scale = ctx->Tensor4ArgNameAndIndex("scale", 0);
+    const user_op::Tensor* zero = nullptr;
+    if (ctx->has_input("zero", 0)) { zero = ctx->Tensor4ArgNameAndIndex("zero", 0); }
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t group_size = ctx->Attr<int64_t>("group_size");
+    const int64_t group_dim = ctx->Attr<int64_t>("group_dim");
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const bool symmetric = ctx->Attr<bool>("symmetric");
+    CHECK_GE(group_dim, 0);
+    CHECK_LT(group_dim, out->shape_view().NumAxes());
+    const int64_t group_dim_size = out->shape_view().At(group_dim);
+    CHECK_GT(group_size, 0);
+    CHECK_EQ(group_dim_size % group_size, 0);
+    const int64_t num_groups = group_dim_size / group_size;
+    CHECK_EQ(scale->shape_view().elem_cnt() * group_size, out->shape_view().elem_cnt());
+    const int64_t outer_size = out->shape_view().Count(0, group_dim) * num_groups;
+    const int64_t inner_size = out->shape_view().Count(group_dim + 1);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    const T* zero_ptr = zero == nullptr ? nullptr : zero->dptr<T>();
+    if (in->data_type() == DataType::kUInt8) {
+      DispatchDequantize<T, uint8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                     inner_size, in->dptr<uint8_t>(), scale->dptr<T>(), zero_ptr,
+                                     out->mut_dptr<T>());
+    } else if (in->data_type() == DataType::kInt8) {
+      DispatchDequantize<T, int8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                    inner_size, in->dptr<int8_t>(), scale->dptr<T>(), zero_ptr,
+                                    out->mut_dptr<T>());
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_GROUPWISE_DEQUANTIZE_CPU_KERNEL(dtype)               \
+  REGISTER_USER_KERNEL("groupwise_dequantize")                        \
+      .SetCreateFn<GroupwiseDequantizeCpuKernel<dtype>>()             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("scale", 0) == GetDataType<dtype>::value))
+
+REGISTER_GROUPWISE_DEQUANTIZE_CPU_KERNEL(float);
+
+struct QuantizedWeight {
+  int64_t k;
+  int64_t group_dim;
+  int64_t group_size;
+  bool symmetric;
+};
+
+// Dequantizes rows [j_begin, j_end) of the (n, k) weight, element (j, p) is written to
+// out[(j - j_begin) * row_stride + p * col_stride].
+template<typename T, typename U, int num_bits>
+void DequantizeWeightRows(const QuantizedWeight& weight, const U* w, const T* scale,
+                          const T* zero, int64_t j_begin, int64_t j_end, int64_t row_stride,
+                          int64_t col_stride, T* out) {
+  const int64_t k = weight.k;
+  for (int64_t j = j_begin; j < j_end; ++j) {
+    T* out_row = out + (j - j_begin) * row_stride;
+    for (int64_t p = 0; p < k; ++p) {
+      const int64_t scale_idx = weight.group_dim == 0
+                                    ? (j / weight.group_size) * k + p
+                                    : j * (k / weight.group_size) + p / weight.group_size;
+      const T group_scale = scale[scale_idx];
+      out_row[p * col_stride] =
+          static_cast<T>(LoadQuantized<U, num_bits>(w, j * k + p)) * group_scale
+          + GetZero<T, U, num_bits>(weight.symmetric, group_scale, zero, scale_idx);
+    }
+  }
+}
+
+// out(m, n) = x(m, k) * dequantize(w)(n, k)^T + b
+//
+// Every task dequantizes kFusedLinearBlockSize rows of w into a transposed tile, so that the
+// inner loop runs over output features with independent accumulators and vectorizes without
+// reassociating float additions.
+template<typename T, typename U, int num_bits>
+void FusedLinear(ep::CpuStream* stream, const QuantizedWeight& weight, int64_t m, int64_t n,
+                 const T* x, const U* w, const T* scale, const T* zero, const T* b, T* out) {
+  const int64_t k = weight.k;
+  const int64_t num_blocks = (n + kFusedLinearBlockSize - 1) / kFusedLinearBlockSize;
+  stream->ParallelFor(
+      0, num_blocks,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> tile(k * kFusedLinearBlockSize);
+        for (int64_t block = begin; block < end; ++block) {
+          const int64_t j_begin = block * kFusedLinearBlockSize;
+          const int64_t j_end = std::min(j_begin + kFusedLinearBlockSize, n);
+          DequantizeWeightRows<T, U, num_bits>(weight, w, scale, zero, j_begin, j_end, 1,
+                                               kFusedLinearBlockSize, tile.data());
+          for (int64_t i = 0; i < m; ++i) {
+            T acc[kFusedLinearBlockSize] = {0};
+            const T* x_row = x + i * k;
+            for (int64_t p = 0; p < k; ++p) {
+              const T* tile_row = tile.data() + p * kFusedLinearBlockSize;
+              for (int64_t j = 0; j < kFusedLinearBlockSize; ++j) {
+                acc[j] += x_row[p] * tile_row[j];
+              }
+            }
+            for (int64_t j = j_begin; j < j_end; ++j) {
+              out[i * n + j] = acc[j - j_begin] + (b == nullptr ? 0 : b[j]);
+            }
+          }
+        }
+      },
+      1);
+}
+
+template<typename T, typename U>
+void DispatchFusedLinear(ep::CpuStream* stream, int32_t num_bits, const QuantizedWeight& weight,
+                         int64_t m, int64_t n, const T* x, const U* w, const T* scale,
+                         const T* zero, const T* b, T* out) {
+  if (num_bits == 4) {
+    FusedLinear<T, U, 4>(stream, weight, m, n, x, w, scale, zero, b, out);
+  } else if (num_bits == 8) {
+    FusedLinear<T, U, 8>(stream, weight, m, n, x, w, scale, zero, b, out);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T>
+class FusedLinearWithGroupwiseQuantizedWeightCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedLinearWithGroupwiseQuantizedWeightCpuKernel() = default;
+  ~FusedLinearWithGroupwiseQuantizedWeightCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* w = ctx->Tensor4ArgNameAndIndex("w", 0);
+    const user_op::Tensor* w_scale = ctx->Tensor4ArgNameAndIndex("w_scale", 0);
+    const user_op::Tensor* w_zero = nullptr;
+    if (ctx->has_input("w_zero", 0)) { w_zero = ctx->Tensor4ArgNameAndIndex("w_zero", 0); }
+    const user_op::Tensor* b = nullptr;
+    if (ctx->has_input("b", 0)) { b = ctx->Tensor4ArgNameAndIndex("b", 0); }
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    QuantizedWeight weight{};
+    weight.k = x->shape_view().At(x->shape_view().NumAxes() - 1);
+    weight.group_dim = ctx->Attr<int64_t>("group_dim");
+    weight.group_size = ctx->Attr<int64_t>("group_size");
+    weight.symmetric = ctx->Attr<bool>("symmetric");
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const int64_t n = w->shape_view().At(0);
+    const int64_t m = x->shape_view().elem_cnt() / weight.k;
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    const T* zero_ptr = w_zero == nullptr ? nullptr : w_zero->dptr<T>();
+    const T* b_ptr = b == nullptr ? nullptr : b->dptr<T>();
+    if (w->data_type() == DataType::kUInt8) {
+      DispatchFusedLinear<T, uint8_t>(stream, num_bits, weight, m, n, x->dptr<T>(),
+                                      w->dptr<uint8_t>(), w_scale->dptr<T>(), zero_ptr, b_ptr,
+                                      out->mut_dptr<T>());
+    } else if (w->data_type() == DataType::kInt8) {
+      DispatchFusedLinear<T, int8_t>(stream, num_bits, weight, m, n, x->dptr<T>(),
+                                     w->dptr<int8_t>(), w_scale->dptr<T>(), zero_ptr, b_ptr,
+                                     out->mut_dptr<T>());
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_LINEAR_WITH_GROUPWISE_QUANTIZED_WEIGHT_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_linear_with_groupwise_quantized_weight")          \
+      .SetCreateFn<FusedLinearWithGroupwiseQuantizedWeightCpuKernel<dtype>>()   \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)           \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_LINEAR_WITH_GROUPWISE_QUANTIZED_WEIGHT_CPU_KERNEL(float);
+
+}  // namespace
+
+}  // namespace oneflow
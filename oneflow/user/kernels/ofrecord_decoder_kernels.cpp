@@ -26,6 +26,7 @@ limitations under the License.
 #include "oneflow/user/kernels/op_kernel_wrapper.h"
 #include "oneflow/user/kernels/random_seed_util.h"
 #include "oneflow/user/image/jpeg_decoder.h"
+#include "oneflow/user/data/ofrecord_view.h"
 
 #include <opencv2/opencv.hpp>
 #include <jpeglib.h>
@@ -35,42 +36,29 @@ namespace oneflow {
 namespace {
 
 template<typename T>
-void DecodeOneRawOFRecord(const Feature& feature, T* dptr, int64_t sample_elem_cnt, bool truncate,
-                          bool dim1_varying_length) {
-  if (feature.has_bytes_list()) {
-    CHECK_EQ(feature.bytes_list().value_size(), 1);
-    const auto& value0 = feature.bytes_list().value(0);
-    auto in_dptr = reinterpret_cast<const int8_t*>(value0.c_str());
-    sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, value0.size());
-    std::transform(in_dptr, in_dptr + sample_elem_cnt, dptr,
-                   [](int8_t v) { return static_cast<T>(v); });
-  }
-#define DEFINE_ONE_ELIF(PbT, CppT)                                                       \
-  else if (feature.has_##PbT##_list()) {                                                 \
-    const auto& list = feature.PbT##_list();                                             \
-    const CppT* in_dptr = list.value().data();                                           \
-    const int64_t padding_elem_num = truncate ? sample_elem_cnt - list.value_size() : 0; \
-    if (truncate) {                                                                      \
-      sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, list.value_size());           \
-    } else {                                                                             \
-      if (dim1_varying_length) {                                                         \
-        sample_elem_cnt = list.value_size();                                             \
-      } else {                                                                           \
-        CHECK_EQ(sample_elem_cnt, list.value_size());                                    \
-      }                                                                                  \
-    }                                                                                    \
-    std::transform(in_dptr, in_dptr + sample_elem_cnt, dptr,                             \
-                   [](CppT v) { return static_cast<T>(v); });                            \
-    if (padding_elem_num > 0) {                                                          \
-      std::memset(dptr + sample_elem_cnt, 0, padding_elem_num * sizeof(T));              \
-    }                                                                                    \
-  }
-  DEFINE_ONE_ELIF(float, float)
-  DEFINE_ONE_ELIF(double, double)
-  DEFINE_ONE_ELIF(int32, int32_t)
-  DEFINE_ONE_ELIF(int64, int64_t)
-#undef DEFINE_ONE_ELIF
-  else {
+void DecodeOneRawOFRecord(const data::OFRecordFeatureView& feature, T* dptr,
+                          int64_t sample_elem_cnt, bool truncate, bool dim1_varying_length) {
+  if (feature.kind() == Feature::kBytesList) {
+    CHECK_EQ(feature.value_size(), 1);
+    sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, feature.bytes_size());
+    data::CastValues<int8_t>(feature.bytes_data(), sample_elem_cnt, dptr);
+  } else if (feature.kind() != Feature::KIND_NOT_SET) {
+    const int64_t value_size = feature.value_size();
+    const int64_t padding_elem_num = truncate ? sample_elem_cnt - value_size : 0;
+    if (truncate) {
+      sample_elem_cnt = std::min<int64_t>(sample_elem_cnt, value_size);
+    } else {
+      if (dim1_varying_length) {
+        sample_elem_cnt = value_size;
+      } else {
+        CHECK_EQ(sample_elem_cnt, value_size);
+      }
+    }
+    feature.CopyValuesTo(dptr, sample_elem_cnt);
+    if (padding_elem_num > 0) {
+      std::memset(dptr + sample_elem_cnt, 0, padding_elem_num * sizeof(T));
+    }
+  } else {
     UNIMPLEMENTED();
   }
 }
@@ -101,9 +89,8 @@ class OFRecordRawDecoderKernel final : public user_op::OpKernel {
     MultiThreadLoop(record_num, [&](size_t i) {
       const OFRecord& record = *(records + i);
       T* dptr = out_dptr + i * sample_elem_cnt;
-      CHECK(record.feature().find(name) != record.feature().end())
-          << "Field " << name << " not found";
-      const Feature& feature = record.feature().at(name);
+      data::OFRecordFeatureView feature;
+      CHECK(feature.Find(record, name)) << "Field " << name << " not found";
       DecodeOneRawOFRecord(feature, dptr, sample_elem_cnt, truncate, dim1_varying_length);
     });
   }
@@ -144,14 +131,13 @@ class OFRecordBytesDecoderKernel final : public user_op::OpKernel {
     MultiThreadLoop(num_instances, [&](size_t i) {
       const OFRecord& record = *(records + i);
       TensorBuffer* buffer = buffers + i;
-      auto it = record.feature().find(name);
-      CHECK(it != record.feature().end()) << "Field " << name << " not found";
-      const Feature& feature = it->second;
-      CHECK(feature.has_bytes_list());
-      CHECK_EQ(feature.bytes_list().value_size(), 1);
-      const int64_t size = feature.bytes_list().value(0).size();
+      data::OFRecordFeatureView feature;
+      CHECK(feature.Find(record, name)) << "Field " << name << " not found";
+      CHECK_EQ(feature.kind(), Feature::kBytesList);
+      CHECK_EQ(feature.value_size(), 1);
+      const int64_t size = feature.bytes_size();
       buffer->Resize(Shape({size}), DataType::kUInt8);
-      memcpy(buffer->mut_data(), feature.bytes_list().value(0).data(), size);
+      memcpy(buffer->mut_data(), feature.bytes_data(), size);
     });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -168,23 +154,22 @@ namespace {
 void DecodeRandomCropImageFromOneRecord(const OFRecord& record, TensorBuffer* buffer,
                                         const std::string& name, const std::string& color_space,
                                         RandomCropGenerator* random_crop_gen) {
-  CHECK(record.feature().find(name) != record.feature().end()) << "Field " << name << " not found";
-  const Feature& feature = record.feature().at(name);
-  CHECK(feature.has_bytes_list());
-  CHECK(feature.bytes_list().value_size() == 1);
-  const std::string& src_data = feature.bytes_list().value(0);
+  data::OFRecordFeatureView feature;
+  CHECK(feature.Find(record, name)) << "Field " << name << " not found";
+  CHECK_EQ(feature.kind(), Feature::kBytesList);
+  CHECK(feature.value_size() == 1);
+  const auto* src_data = reinterpret_cast<const unsigned char*>(feature.bytes_data());
+  const size_t src_size = feature.bytes_size();
   cv::Mat image;
 
-  if (JpegPartialDecodeRandomCropImage(reinterpret_cast<const unsigned char*>(src_data.data()),
-                                       src_data.size(), random_crop_gen, nullptr, 0, &image)) {
+  if (JpegPartialDecodeRandomCropImage(src_data, src_size, random_crop_gen, nullptr, 0, &image)) {
     // convert color space
     // jpeg decode output RGB
     if (ImageUtil::IsColor(color_space) && color_space != "RGB") {
       ImageUtil::ConvertColor("RGB", image, color_space, image);
     }
   } else {
-    OpenCvPartialDecodeRandomCropImage(reinterpret_cast<const unsigned char*>(src_data.data()),
-                                       src_data.size(), random_crop_gen, color_space, image);
+    OpenCvPartialDecodeRandomCropImage(src_data, src_size, random_crop_gen, color_space, image);
     // convert color space
     // opencv decode output BGR
     if (ImageUtil::IsColor(color_space) && color_space != "BGR") {
@@ -0,0 +1,78 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/include/primitive/quantized_matmul.h"
+
+namespace oneflow {
+
+namespace {
+
+ep::primitive::BlasTransposeType GetBlasTransposeType(bool transpose) {
+  return transpose ? ep::primitive::BlasTransposeType::T : ep::primitive::BlasTransposeType::N;
+}
+
+template<typename Context>
+std::unique_ptr<ep::primitive::QuantizedMatmul> NewQuantizedMatmulPrimitive(Context* ctx) {
+  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("out", 0)->data_type();
+  return ep::primitive::NewPrimitive<ep::primitive::QuantizedMatmulFactory>(
+      ctx->device_type(), data_type, GetBlasTransposeType(ctx->template Attr<bool>("transpose_a")),
+      GetBlasTransposeType(ctx->template Attr<bool>("transpose_b")),
+      ep::primitive::QuantizedMatmulChannelAxis::kN);
+}
+
+auto QuantizedMatmulPrimitiveExists() {
+  return hob::make_custom("QuantizedMatmulPrimitiveExists",
+                          [](const user_op::KernelRegContext& ctx) {
+                            return NewQuantizedMatmulPrimitive(&ctx).operator bool();
+                          });
+}
+
+class QuantizedMatmulKernel final : public user_op::OpKernel {
+ public:
+  QuantizedMatmulKernel() = default;
+  ~QuantizedMatmulKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* a = ctx->Tensor4ArgNameAndIndex("a", 0);
+    const user_op::Tensor* b = ctx->Tensor4ArgNameAndIndex("b", 0);
+    const user_op::Tensor* scale = nullptr;
+    if (ctx->has_input("scale", 0)) { scale = ctx->Tensor4ArgNameAndIndex("scale", 0); }
+    const user_op::Tensor* bias = nullptr;
+    if (ctx->has_input("bias", 0)) { bias = ctx->Tensor4ArgNameAndIndex("bias", 0); }
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const ShapeView& b_shape = b->shape_view();
+    const int64_t n = ctx->Attr<bool>("transpose_b") ? b_shape.At(0) : b_shape.At(1);
+    const int64_t k = ctx->Attr<bool>("transpose_b") ? b_shape.At(1) : b_shape.At(0);
+    const int64_t m = out->shape_view().elem_cnt() / n;
+    auto matmul = NewQuantizedMatmulPrimitive(ctx);
+    CHECK(matmul);
+    matmul->Launch(ctx->stream(), m, n, k, a->dptr(), b->dptr(),
+                   scale == nullptr ? nullptr : scale->dptr<float>(),
+                   bias == nullptr ? nullptr : bias->dptr<float>(), out->mut_dptr());
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("quantized_matmul")
+    .SetCreateFn<QuantizedMatmulKernel>()
+    .SetIsMatchedHob(QuantizedMatmulPrimitiveExists() == true);
+
+}  // namespace
+
+}  // namespace oneflow
@@ -18,106 +18,26 @@ limitations under the License.
 #include "oneflow/core/embedding/posix_file.h"
 #include "oneflow/core/common/nd_index_offset_helper.h"
 #include "oneflow/core/device/cuda_util.h"
-#include "oneflow/core/common/channel.h"
+#include "oneflow/user/data/raw_batch_reader.h"
 
 namespace oneflow {
 
 namespace {
 
-struct Block {
-  size_t file_index;
-  size_t offset_in_file;
-};
-
-struct BatchReaderRequest {
-  std::shared_ptr<std::vector<size_t>> blocks;
-  void* buffer{};
-};
-
-class BatchReader {
- public:
-  OF_DISALLOW_COPY_AND_MOVE(BatchReader);
-  BatchReader(std::vector<std::unique_ptr<embedding::PosixFile>>&& files,
-              std::vector<Block>&& blocks, size_t block_size_bytes, size_t num_workers)
-      : head_(0),
-        tail_(0),
-        files_(std::move(files)),
-        blocks_(blocks),
-        block_size_bytes_(block_size_bytes),
-        num_workers_(num_workers) {
-    for (size_t i = 0; i < num_workers_; ++i) {
-      Worker worker;
-      auto* sq = new Channel<BatchReaderRequest>();
-      auto* cq = new Channel<BatchReaderRequest>();
-      worker.sq.reset(sq);
-      worker.cq.reset(cq);
-      worker.thread = std::thread([sq, cq, this]() {
-        while (true) {
-          BatchReaderRequest request;
-          auto status = sq->Receive(&request);
-          if (status == kChannelStatusErrorClosed) { break; }
-          CHECK_EQ(status, kChannelStatusSuccess) << "channel error";
-          size_t buffer_offset = 0;
-          for (size_t i = 0; i < request.blocks->size(); ++i) {
-            size_t block_index = request.blocks->at(i);
-            const Block& block = blocks_[block_index];
-            size_t remaining = block_size_bytes_;
-            size_t file_index = block.file_index;
-            size_t file_offset = block.offset_in_file;
-            while (remaining != 0) {
-              const size_t bytes_to_read =
-                  std::min(remaining, files_.at(file_index)->Size() - file_offset);
-              PCHECK(pread(files_[file_index]->fd(),
-                           reinterpret_cast<unsigned char*>(request.buffer) + buffer_offset,
-                           bytes_to_read, file_offset)
-                     == bytes_to_read)
-                  << "file read error";
-              remaining -= bytes_to_read;
-              buffer_offset += bytes_to_read;
-              if (remaining != 0) {
-                file_index = (file_index + 1) % files_.size();
-                file_offset = 0;
-              }
-            }
-          }
-          CHECK(cq->Send(std::move(request)) == kChannelStatusSuccess) << "channel error";
-        }
-      });
-      workers_.emplace_back(std::move(worker));
-    }
-  }
-  ~BatchReader() {
-    for (auto& work : workers_) { work.Close(); }
-  }
-
-  void SubmitRequest(BatchReaderRequest&& request) {
-    size_t worker_id = head_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
-    workers_.at(worker_id).sq->Send(std::move(request));
+// Returns nullptr for the blocking pread engine.
+std::unique_ptr<embedding::AsyncReadEngine> NewAsyncReadEngine(const std::string& io_engine,
+                                                               size_t queue_depth) {
+  if (io_engine == "aio") {
+    return embedding::NewAioReadEngine(queue_depth);
+  } else if (io_engine == "uring") {
+    auto engine = embedding::NewRingReadEngine(queue_depth);
+    if (!engine) { LOG(WARNING) << "io_uring is unavailable, fall back to the pread engine"; }
+    return engine;
+  } else {
+    CHECK_EQ(io_engine, "pread") << "Unsupported raw reader io engine " << io_engine;
+    return nullptr;
   }
-  void WaitCompleted(BatchReaderRequest* request) {
-    size_t worker_id = tail_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
-    workers_.at(worker_id).cq->Receive(request);
-  }
-
- private:
-  struct Worker {
-    std::thread thread;
-    std::unique_ptr<Channel<BatchReaderRequest>> sq;
-    std::unique_ptr<Channel<BatchReaderRequest>> cq;
-    void Close() {
-      sq->Close();
-      cq->Close();
-      thread.join();
-    }
-  };
-  std::atomic<size_t> head_;
-  std::atomic<size_t> tail_;
-  std::vector<Worker> workers_;
-  std::vector<std::unique_ptr<embedding::PosixFile>> files_;
-  std::vector<Block> blocks_;
-  size_t block_size_bytes_;
-  size_t num_workers_;
-};
+}
 
 size_t GetNumShards(const Shape& hierarchy, const NdSbp& nd_sbp) {
   size_t num_shards = 1;
@@ -284,9 +204,9 @@ class RawReaderKernelState final : public user_op::OpKernelState {
     const size_t num_blocks = num_batches_ * (batch_size_ / block_size_);
     size_t file_index = 0;
     size_t offset_in_file = 0;
-    std::vector<Block> blocks;
+    std::vector<data::RawBlock> blocks;
     for (size_t i = 0; i < num_blocks; ++i) {
-      blocks.emplace_back(Block{file_index, offset_in_file});
+      blocks.emplace_back(data::RawBlock{file_index, offset_in_file});
       size_t remaining = block_size_bytes_;
       while (remaining != 0) {
         if (files[file_index]->Size() - offset_in_file >= remaining) {
@@ -311,11 +231,16 @@ class RawReaderKernelState final : public user_op::OpKernelState {
                                                           batch_size_ / block_size_));
     }
     const size_t num_workers = ParseIntegerFromEnv("ONEFLOW_RAW_READER_NUM_WORKERS", 1);
-    batch_reader_.reset(
-        new BatchReader(std::move(files), std::move(blocks), block_size_bytes_, num_workers));
     prefetching_qd_ = ParseIntegerFromEnv("ONEFLOW_RAW_READER_PREFETCHING_QUEUE_DEPTH", 256);
+    // pread, aio or uring
+    const std::string io_engine = GetStringFromEnv("ONEFLOW_RAW_READER_IO_ENGINE", "pread");
+    const size_t io_qd = ParseIntegerFromEnv("ONEFLOW_RAW_READER_IO_QUEUE_DEPTH", 64);
+    batch_reader_.reset(new data::BatchReader(
+        std::move(files), std::move(blocks), block_size_bytes_, num_workers, prefetching_qd_,
+        [io_engine, io_qd]() { return NewAsyncReadEngine(io_engine, io_qd); },
+        (flags & O_DIRECT) != 0));
     for (size_t i = 0; i < prefetching_qd_; ++i) {
-      BatchReaderRequest request;
+      data::BatchReaderRequest request;
       request.blocks = std::make_shared<std::vector<size_t>>();
       if (ctx->device_type() == DeviceType::kCPU) {
         request.buffer = aligned_alloc(4096, RoundUp(local_batch_size_bytes_, 4096));  // NOLINT
@@ -338,8 +263,9 @@ class RawReaderKernelState final : public user_op::OpKernelState {
   }
 
   ~RawReaderKernelState() {
+    VLOG(1) << "raw_reader " << batch_reader_->StatsString();
     for (size_t i = 0; i < prefetching_qd_; ++i) {
-      BatchReaderRequest request;
+      data::BatchReaderRequest request;
       batch_reader_->WaitCompleted(&request);
       if (device_type_ == DeviceType::kCPU) {
         free(request.buffer);  // NOLINT
@@ -359,7 +285,7 @@ class RawReaderKernelState final : public user_op::OpKernelState {
     auto* tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
     CHECK_EQ(tensor->data_type(), data_type_) << "data type mismatch";
     CHECK(tensor->shape_view() == ShapeView(out_shape_)) << "shape mismatch";
-    BatchReaderRequest request;
+    data::BatchReaderRequest request;
     batch_reader_->WaitCompleted(&request);
     if (ctx->stream()->device_type() == DeviceType::kCPU) {
       std::memcpy(tensor->mut_dptr<char>(), request.buffer, local_batch_size_bytes_);
@@ -379,9 +305,15 @@ class RawReaderKernelState final : public user_op::OpKernelState {
     CHECK_EQ(request.blocks->size(), num_blocks_per_local_batch_) << "blocks size mismatch";
     batch_generator_->Next(request.blocks->data());
     batch_reader_->SubmitRequest(std::move(request));
+    num_batches_read_ += 1;
+    if (num_batches_read_ % kStatsIntervalBatches == 0) {
+      VLOG(1) << "raw_reader " << batch_reader_->StatsString();
+    }
   }
 
  private:
+  static constexpr size_t kStatsIntervalBatches = 1000;
+
   size_t instance_size_;
   size_t batch_size_;
   size_t local_batch_size_;
@@ -396,9 +328,10 @@ class RawReaderKernelState final : public user_op::OpKernelState {
   Shape out_shape_;
   DataType data_type_;
   std::unique_ptr<BatchGenerator> batch_generator_;
-  std::unique_ptr<BatchReader> batch_reader_;
+  std::unique_ptr<data::BatchReader> batch_reader_;
   DeviceType device_type_;
   size_t prefetching_qd_;
+  size_t num_batches_read_ = 0;
 };
 
 }  // namespace
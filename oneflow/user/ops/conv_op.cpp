@@ -277,6 +277,62 @@ Maybe<void> CheckAttr_(const user_op::UserOpDefWrapper& def,
   return Maybe<void>::Ok();
 }
 
+/* static */ Maybe<void> QuantizedConv2DOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  JUST(InferTensorDesc4Conv<2>(ctx));
+  if (ctx->has_input("scale", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputShape("scale", 0), Shape({ctx->Attr<int32_t>("filters")}));
+  }
+  return Maybe<void>::Ok();
+}
+
+/*static*/ Maybe<void> QuantizedConv2DOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::GetSbp(user_op::SbpContext* ctx) {
+  std::vector<user_op::OpArg> channel_args;
+  if (ctx->user_op_conf().has_input("scale", 0)) { channel_args.emplace_back("scale", 0); }
+  if (ctx->user_op_conf().has_input("bias", 0)) { channel_args.emplace_back("bias", 0); }
+  ctx->NewBuilder()
+      .Split(user_op::OpArg("in", 0), 0)
+      .Broadcast(user_op::OpArg("weight", 0))
+      .Broadcast(channel_args)
+      .Split(user_op::OpArg("out", 0), 0)
+      .Build();
+  if (ctx->Attr<int32_t>("groups") == 1) {
+    const int64_t c_dim = ctx->Attr<std::string>("data_format") == "channels_first" ? 1 : 3;
+    ctx->NewBuilder()
+        .Broadcast(user_op::OpArg("in", 0))
+        .Split(user_op::OpArg("weight", 0), 0)
+        .Split(channel_args, 0)
+        .Split(user_op::OpArg("out", 0), c_dim)
+        .Build();
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::CheckAttr(const user_op::UserOpDefWrapper& def,
+                                                      const user_op::UserOpConfWrapper& conf) {
+  return CheckAttr_<2>(def, conf);
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::InferDataType(user_op::InferContext* ctx) {
+  CHECK_EQ_OR_RETURN(ctx->InputDType("in", 0), DataType::kInt8)
+      << "in should be int8, but got " << DataType_Name(ctx->InputDType("in", 0));
+  CHECK_EQ_OR_RETURN(ctx->InputDType("weight", 0), DataType::kInt8)
+      << "weight should be int8, but got " << DataType_Name(ctx->InputDType("weight", 0));
+  const DataType out_dtype = ctx->Attr<DataType>("out_dtype");
+  if (out_dtype == DataType::kInt32) {
+    CHECK_OR_RETURN(!ctx->has_input("scale", 0) && !ctx->has_input("bias", 0))
+        << "int32 output takes neither scale nor bias";
+  }
+  for (const std::string& name : {"scale", "bias"}) {
+    if (ctx->has_input(name, 0)) { CHECK_EQ_OR_RETURN(ctx->InputDType(name, 0), DataType::kFloat); }
+  }
+  ctx->SetOutputDType("out", 0, out_dtype);
+  return Maybe<void>::Ok();
+}
+
 /* static */ Maybe<void> ConvDataGradOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
   const user_op::TensorDesc& dy = ctx->InputTensorDesc("dy", 0);
   const user_op::TensorDesc& x_like = ctx->InputTensorDesc("x_like", 0);
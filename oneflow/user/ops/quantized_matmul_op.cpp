@@ -0,0 +1,127 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+namespace {
+
+// a is (..., k) or, when transposed, (k, m); b is (k, n) or, when transposed, (n, k).
+Maybe<void> InferMNK(const Shape& a_shape, const Shape& b_shape, bool transpose_a,
+                     bool transpose_b, int64_t* m, int64_t* n, int64_t* k) {
+  CHECK_GE_OR_RETURN(a_shape.NumAxes(), 2) << "a should have at least 2 dimensions";
+  CHECK_EQ_OR_RETURN(b_shape.NumAxes(), 2) << "b should have 2 dimensions";
+  if (transpose_a) {
+    CHECK_EQ_OR_RETURN(a_shape.NumAxes(), 2) << "a should have 2 dimensions when transposed";
+    *m = a_shape.At(1);
+    *k = a_shape.At(0);
+  } else {
+    *m = a_shape.Count(0, a_shape.NumAxes() - 1);
+    *k = a_shape.At(a_shape.NumAxes() - 1);
+  }
+  const int64_t b_k = transpose_b ? b_shape.At(1) : b_shape.At(0);
+  CHECK_EQ_OR_RETURN(b_k, *k) << "the reduced dimensions of a and b differ";
+  *n = transpose_b ? b_shape.At(0) : b_shape.At(1);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+/* static */ Maybe<void> QuantizedMatmulOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const Shape& a_shape = ctx->InputShape("a", 0);
+  const Shape& b_shape = ctx->InputShape("b", 0);
+  const bool transpose_a = ctx->Attr<bool>("transpose_a");
+  int64_t m = 0;
+  int64_t n = 0;
+  int64_t k = 0;
+  JUST(InferMNK(a_shape, b_shape, transpose_a, ctx->Attr<bool>("transpose_b"), &m, &n, &k));
+  for (const std::string& name : {"scale", "bias"}) {
+    if (ctx->has_input(name, 0)) { CHECK_EQ_OR_RETURN(ctx->InputShape(name, 0), Shape({n})); }
+  }
+  Shape out_shape = a_shape;
+  if (transpose_a) { out_shape.Set(0, m); }
+  out_shape.Set(out_shape.NumAxes() - 1, n);
+  ctx->SetOutputShape("out", 0, out_shape);
+  return Maybe<void>::Ok();
+}
+
+/*static*/ Maybe<void> QuantizedMatmulOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> QuantizedMatmulOp::GetSbp(user_op::SbpContext* ctx) {
+  const int64_t a_num_axes = ctx->LogicalTensorDesc4InputArgNameAndIndex("a", 0).shape().NumAxes();
+  const bool transpose_a = ctx->Attr<bool>("transpose_a");
+  const bool transpose_b = ctx->Attr<bool>("transpose_b");
+  std::vector<user_op::OpArg> channel_args;
+  if (ctx->user_op_conf().has_input("scale", 0)) { channel_args.emplace_back("scale", 0); }
+  if (ctx->user_op_conf().has_input("bias", 0)) { channel_args.emplace_back("bias", 0); }
+
+  // S(m) x B -> S(m)
+  if (transpose_a) {
+    ctx->NewBuilder()
+        .Split(user_op::OpArg("a", 0), 1)
+        .Broadcast(user_op::OpArg("b", 0))
+        .Broadcast(channel_args)
+        .Split(user_op::OpArg("out", 0), 0)
+        .Build();
+  } else {
+    for (int64_t i = 0; i < a_num_axes - 1; ++i) {
+      ctx->NewBuilder()
+          .Split(user_op::OpArg("a", 0), i)
+          .Broadcast(user_op::OpArg("b", 0))
+          .Broadcast(channel_args)
+          .Split(user_op::OpArg("out", 0), i)
+          .Build();
+    }
+  }
+  // B x S(n) -> S(n)
+  ctx->NewBuilder()
+      .Broadcast(user_op::OpArg("a", 0))
+      .Split(user_op::OpArg("b", 0), transpose_b ? 0 : 1)
+      .Split(channel_args, 0)
+      .Split(user_op::OpArg("out", 0), a_num_axes - 1)
+      .Build();
+  // S(k) x S(k) -> P, only without an epilogue since the epilogue is not linear
+  if (ctx->Attr<DataType>("out_dtype") == DataType::kInt32) {
+    ctx->NewBuilder()
+        .Split(user_op::OpArg("a", 0), transpose_a ? 0 : a_num_axes - 1)
+        .Split(user_op::OpArg("b", 0), transpose_b ? 1 : 0)
+        .PartialSum(user_op::OpArg("out", 0))
+        .Build();
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedMatmulOp::InferDataType(user_op::InferContext* ctx) {
+  CHECK_EQ_OR_RETURN(ctx->InputDType("a", 0), DataType::kInt8)
+      << "a should be int8, but got " << DataType_Name(ctx->InputDType("a", 0));
+  CHECK_EQ_OR_RETURN(ctx->InputDType("b", 0), DataType::kInt8)
+      << "b should be int8, but got " << DataType_Name(ctx->InputDType("b", 0));
+  const DataType out_dtype = ctx->Attr<DataType>("out_dtype");
+  if (out_dtype == DataType::kInt32) {
+    CHECK_OR_RETURN(!ctx->has_input("scale", 0) && !ctx->has_input("bias", 0))
+        << "int32 output takes neither scale nor bias";
+  }
+  for (const std::string& name : {"scale", "bias"}) {
+    if (ctx->has_input(name, 0)) { CHECK_EQ_OR_RETURN(ctx->InputDType(name, 0), DataType::kFloat); }
+  }
+  ctx->SetOutputDType("out", 0, out_dtype);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
@@ -138,6 +138,8 @@ def _init(
         persistent_table["capacity_hint"] = (
             persistent_table["capacity_hint"] // parallel_num
         )
+    if persistent_table.__contains__("io_engine"):
+        assert persistent_table["io_engine"] in ["aio", "uring"]
     key_value_store_options["kv_store"] = kv_store
     # initializer
     if tables is not None:
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import json
 import oneflow._oneflow_internal
 from oneflow.profiler.profiler import (
     profile,
@@ -34,6 +35,7 @@ __all__ = [
     "kineto_available",
     "tensorboard_trace_handler",
     "ProfilerAction",
+    "counters",
 ]
 
 
@@ -53,5 +55,12 @@ def profiler_stop():
     oneflow._oneflow_internal.profiler.ProfilerStop()
 
 
+def counters():
+    """Returns the runtime counters of this process (bytes, messages, queue depths and
+    blocked time of the communication stack) as {name: {"value": v, "peak": p}}.
+    """
+    return json.loads(oneflow._oneflow_internal.profiler.DumpCounters())
+
+
 def kineto_available():
     return True
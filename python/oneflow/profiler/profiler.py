@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 """
+import json
 import oneflow._oneflow_internal
 from enum import Enum
 from typing import Optional, Iterable, Set
@@ -70,8 +71,13 @@ class profile:
             ), "record_bandwidth_for_cuda = True can only work with cuda."
         self.record_bandwidth_for_cuda = record_bandwidth_for_cuda
         self.profile_events: Optional[Events] = None
+        self.counters_at_enter: Optional[dict] = None
+        self.counters_at_exit: Optional[dict] = None
 
     def __enter__(self):
+        self.counters_at_enter = json.loads(
+            oneflow._oneflow_internal.profiler.DumpCounters()
+        )
         oneflow._oneflow_internal.profiler.EnableProfiler(
             ProfilerActivity.CPU in self.activities,
             ProfilerActivity.CUDA in self.activities,
@@ -85,6 +91,9 @@ class profile:
         self.profile_events = Events(
             oneflow._oneflow_internal.profiler.DisableProfilerAndReturnResult()
         )
+        self.counters_at_exit = json.loads(
+            oneflow._oneflow_internal.profiler.DumpCounters()
+        )
 
     def __check_finish(self):
         if self.profile_events is None:
@@ -101,6 +110,17 @@ class profile:
         self.__check_finish()
         return self.profile_events
 
+    def counters(self):
+        """Returns how much each runtime counter changed while profiling, as
+        {name: {"value": delta, "peak": peak}}. Peaks are process-wide highs.
+        """
+        self.__check_finish()
+        result = {}
+        for name, counter in self.counters_at_exit.items():
+            base = self.counters_at_enter.get(name, {}).get("value", 0)
+            result[name] = {"value": counter["value"] - base, "peak": counter["peak"]}
+        return result
+
 
 class record_function:
     def __init__(self, name: str) -> None:
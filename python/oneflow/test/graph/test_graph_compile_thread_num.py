@@ -0,0 +1,80 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _dump_plan(plan_path):
+    class TrainGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = flow.nn.Sequential(
+                flow.nn.Linear(16, 32),
+                flow.nn.ReLU(),
+                flow.nn.Linear(32, 32),
+                flow.nn.Tanh(),
+                flow.nn.Linear(32, 4),
+            )
+            self.add_optimizer(flow.optim.SGD(self.model.parameters(), lr=0.1))
+
+        def build(self, x):
+            loss = self.model(x).sum()
+            loss.backward()
+            return loss
+
+    graph = TrainGraph()
+    graph(flow.ones(8, 16))
+    with open(plan_path, "wb") as f:
+        f.write(graph._c_nn_graph.plan)
+
+
+def _compile_plan(test_case, thread_num, plan_path):
+    env = os.environ.copy()
+    env["ONEFLOW_GRAPH_COMPILE_THREAD_NUM"] = str(thread_num)
+    env.pop("ONEFLOW_PLAN_CACHE_DIR", None)
+    p = subprocess.run(
+        [sys.executable, os.path.realpath(__file__), "--dump-plan", plan_path], env=env
+    )
+    test_case.assertEqual(p.returncode, 0)
+    with open(plan_path, "rb") as f:
+        return f.read()
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphCompileThreadNum(flow.unittest.TestCase):
+    def test_plan_independent_of_thread_num(test_case):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            serial_plan = _compile_plan(
+                test_case, 1, os.path.join(tmp_dir, "serial.plan")
+            )
+            parallel_plan = _compile_plan(
+                test_case, 4, os.path.join(tmp_dir, "parallel.plan")
+            )
+        test_case.assertGreater(len(serial_plan), 0)
+        test_case.assertEqual(serial_plan, parallel_plan)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "--dump-plan":
+        _dump_plan(sys.argv[2])
+    else:
+        unittest.main()
@@ -1928,6 +1928,51 @@ class TestConv2d(flow.unittest.TestCase):
         y = m(x)
         return y
 
+    @autotest(n=3, rtol=1e-3, atol=1e-4)
+    def test_conv2d_cpu_intra_sample_parallel(test_case):
+        # a batch smaller than the number of cpu threads is split within each sample
+        m = torch.nn.Conv2d(
+            in_channels=32,
+            out_channels=64,
+            kernel_size=oneof(1, 3),
+            padding=oneof(0, 1),
+            bias=random_bool(),
+        )
+        m.train(random())
+        m.to("cpu")
+        x = random_tensor(ndim=4, dim0=1, dim1=32, dim2=24, dim3=24).to("cpu")
+        y = m(x)
+        return y
+
+    @autotest(n=3, rtol=1e-3, atol=1e-4)
+    def test_conv2d_cpu_pointwise(test_case):
+        # 1x1 convolutions with unit stride and no padding skip im2col
+        m = torch.nn.Conv2d(
+            in_channels=16, out_channels=24, kernel_size=1, bias=random_bool()
+        )
+        m.train(random())
+        m.to("cpu")
+        x = random_tensor(ndim=4, dim0=oneof(1, 2, 16), dim1=16, dim2=12, dim3=12)
+        x = x.to("cpu")
+        y = m(x)
+        return y
+
+    @autotest(n=2, rtol=1e-3, atol=1e-3)
+    def test_conv2d_cpu_large_gemm(test_case):
+        # gemms too large for the stream threads are issued from the calling thread
+        m = torch.nn.Conv2d(
+            in_channels=64,
+            out_channels=64,
+            kernel_size=oneof(1, 3),
+            padding=oneof(0, 1),
+            bias=random_bool(),
+        )
+        m.train(random())
+        m.to("cpu")
+        x = random_tensor(ndim=4, dim0=16, dim1=64, dim2=32, dim3=32).to("cpu")
+        y = m(x)
+        return y
+
     @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
     @autotest(n=5, check_allclose=False)
     def test_conv2d_group_with_random_data(test_case):
@@ -0,0 +1,198 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+import unittest
+from contextlib import contextmanager
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+# The ccl kernels read these on every launch, so the tensors have to be synced
+# before leaving the context.
+@contextmanager
+def _env(**kwargs):
+    old = {key: os.environ.get(key) for key in kwargs}
+    os.environ.update({key: str(value) for key, value in kwargs.items()})
+    try:
+        yield
+    finally:
+        for key, value in old.items():
+            if value is None:
+                del os.environ[key]
+            else:
+                os.environ[key] = value
+
+
+def _local_input(rank, elem_cnt):
+    return (np.arange(elem_cnt, dtype=np.int64) * (rank + 3) + rank * 7) % 1009 - 500
+
+
+# All-reduces the inputs of ranks through a partial sum to broadcast boxing and
+# compares the result on the ranks taking part.
+def _test_all_reduce(test_case, ranks, elem_cnt):
+    rank = flow.env.get_rank()
+    x = flow.tensor(_local_input(rank, elem_cnt), device="cpu")
+    placement = flow.placement("cpu", ranks=ranks)
+    y = x.to_global(placement=placement, sbp=flow.sbp.partial_sum)
+    y = y.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+    if rank in ranks:
+        expected = sum(_local_input(r, elem_cnt) for r in ranks)
+        test_case.assertTrue(np.array_equal(y, expected))
+
+
+def _test_all_gather(test_case, ranks, elem_cnt):
+    rank = flow.env.get_rank()
+    x = flow.tensor(_local_input(rank, elem_cnt), device="cpu")
+    placement = flow.placement("cpu", ranks=ranks)
+    y = x.to_global(placement=placement, sbp=flow.sbp.split(0))
+    y = y.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+    if rank in ranks:
+        expected = np.concatenate([_local_input(r, elem_cnt) for r in ranks])
+        test_case.assertTrue(np.array_equal(y, expected))
+
+
+def _test_reduce_scatter(test_case, ranks, elem_cnt):
+    rank = flow.env.get_rank()
+    x = flow.tensor(_local_input(rank, elem_cnt * len(ranks)), device="cpu")
+    placement = flow.placement("cpu", ranks=ranks)
+    y = x.to_global(placement=placement, sbp=flow.sbp.partial_sum)
+    y = y.to_global(sbp=flow.sbp.split(0)).to_local().numpy()
+    if rank in ranks:
+        index = ranks.index(rank)
+        expected = sum(_local_input(r, elem_cnt * len(ranks)) for r in ranks)
+        expected = expected[index * elem_cnt : (index + 1) * elem_cnt]
+        test_case.assertTrue(np.array_equal(y, expected))
+
+
+def _test_reduce(test_case, root, elem_cnt):
+    rank = flow.env.get_rank()
+    x = flow.tensor(_local_input(rank, elem_cnt), device="cpu")
+    flow._C.local_reduce(x, dst=root)
+    if rank == root:
+        world_size = flow.env.get_world_size()
+        expected = sum(_local_input(r, elem_cnt) for r in range(world_size))
+        test_case.assertTrue(np.array_equal(x.numpy(), expected))
+
+
+class TestCpuRingAllReduce(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_1n4d()
+    def test_chunked_ring_all_reduce(test_case):
+        # 8 int64 per chunk, so that every part spans many chunks, and element
+        # counts that do not split evenly among the ranks.
+        for ranks in [[0, 1], [0, 1, 2], [0, 1, 2, 3]]:
+            for in_flight in [1, 2, 4]:
+                with _env(
+                    ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK=0,
+                    ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES=0,
+                    ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES=64,
+                    ONEFLOW_CCL_CPU_ALL_REDUCE_MAX_CHUNKS_IN_FLIGHT=in_flight,
+                ):
+                    for elem_cnt in [1, 2, 7, 25, 100, 1001]:
+                        _test_all_reduce(test_case, ranks, elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_unchunked_ring_all_reduce(test_case):
+        for ranks in [[0, 1, 2], [0, 1, 2, 3]]:
+            with _env(
+                ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK=0,
+                ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES=0,
+                ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES=0,
+            ):
+                for elem_cnt in [1, 7, 1001]:
+                    _test_all_reduce(test_case, ranks, elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_ring_all_reduce_default_chunks(test_case):
+        # 3 parts of 2MiB + 8 bytes, each 3 chunks with the default 1MiB chunks.
+        elem_cnt = 3 * 256 * 1024 + 3
+        _test_all_reduce(test_case, [0, 1, 2], elem_cnt)
+
+
+# With 64 bytes per rank, 8 int64 per rank are latency bound, and with 1KiB
+# Rabenseifner takes up to 128 int64. Every size is tested on both sides of the
+# thresholds.
+_SMALL_THRESHOLDS = dict(
+    ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK=64,
+    ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES=1024,
+)
+
+
+class TestCpuLatencyOptimizedCollectives(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_1n4d()
+    def test_all_reduce(test_case):
+        # Recursive doubling up to 8 * len(ranks) elements, then Rabenseifner
+        # up to 128 and the ring above.
+        for ranks in [[0, 1], [0, 1, 2], [0, 1, 2, 3]]:
+            with _env(**_SMALL_THRESHOLDS):
+                for elem_cnt in [1, 2, 7, 8 * len(ranks), 8 * len(ranks) + 1]:
+                    _test_all_reduce(test_case, ranks, elem_cnt)
+                for elem_cnt in [100, 128, 129, 1001]:
+                    _test_all_reduce(test_case, ranks, elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_all_reduce_default_thresholds(test_case):
+        # 3 ranks: recursive doubling up to 12KiB, Rabenseifner up to 4MiB.
+        for elem_cnt in [1536, 1537, 512 * 1024, 512 * 1024 + 1]:
+            _test_all_reduce(test_case, [0, 1, 2], elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_all_gather(test_case):
+        # Bruck up to 8 elements per rank, the ring above.
+        for ranks in [[0, 1], [0, 1, 2], [0, 1, 2, 3]]:
+            with _env(**_SMALL_THRESHOLDS):
+                for elem_cnt in [1, 3, 8, 9, 100]:
+                    _test_all_gather(test_case, ranks, elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_reduce_scatter(test_case):
+        # Recursive doubling up to 8 elements per rank, the ring above.
+        for ranks in [[0, 1], [0, 1, 2], [0, 1, 2, 3]]:
+            with _env(**_SMALL_THRESHOLDS):
+                for elem_cnt in [1, 3, 8, 9, 100]:
+                    _test_reduce_scatter(test_case, ranks, elem_cnt)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_reduce(test_case):
+        # local_reduce spans all 4 ranks. The binomial tree takes up to 32
+        # elements, the ring above.
+        with _env(**_SMALL_THRESHOLDS):
+            for root in range(4):
+                for elem_cnt in [1, 5, 32, 33, 1000]:
+                    _test_reduce(test_case, root, elem_cnt)
+
+
+class TestCpuHierarchicalAllReduce(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_2n2d()
+    def test_hierarchical_all_reduce(test_case):
+        # Both thresholds at 0, so every size goes through the node groups.
+        # [0, 2] has one rank per node and [0, 1] one node, both fall back to the
+        # ring.
+        with _env(
+            ONEFLOW_CCL_CPU_HIERARCHICAL_ALL_REDUCE=1,
+            ONEFLOW_CCL_CPU_LATENCY_OPTIMIZED_BYTES_PER_RANK=0,
+            ONEFLOW_CCL_CPU_ALL_REDUCE_RABENSEIFNER_MAX_BYTES=0,
+        ):
+            for ranks in [[0, 1, 2, 3], [0, 2], [0, 1]]:
+                for elem_cnt in [1, 3, 4, 5, 1001, 300 * 1024 + 1]:
+                    _test_all_reduce(test_case, ranks, elem_cnt)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,129 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _randint8(shape):
+    return np.random.randint(-128, 128, size=shape).astype(np.int8)
+
+
+def _test_quantized_matmul(test_case, m, k, n, transpose_a, transpose_b):
+    a = _randint8((k, m) if transpose_a else (m, k))
+    b = _randint8((n, k) if transpose_b else (k, n))
+    scale = np.random.uniform(1e-4, 1e-3, size=(n,)).astype(np.float32)
+    bias = np.random.uniform(-1, 1, size=(n,)).astype(np.float32)
+    acc = np.matmul(
+        (a.T if transpose_a else a).astype(np.int64),
+        (b.T if transpose_b else b).astype(np.int64),
+    )
+    a_tensor = flow.tensor(a, device="cpu")
+    b_tensor = flow.tensor(b, device="cpu")
+
+    out = flow._C.quantized_matmul(
+        a_tensor, b_tensor, transpose_a=transpose_a, transpose_b=transpose_b
+    )
+    test_case.assertEqual(out.dtype, flow.int32)
+    test_case.assertTrue(np.array_equal(out.numpy(), acc))
+
+    out = flow._C.quantized_matmul(
+        a_tensor,
+        b_tensor,
+        scale=flow.tensor(scale),
+        bias=flow.tensor(bias),
+        transpose_a=transpose_a,
+        transpose_b=transpose_b,
+    )
+    test_case.assertEqual(out.dtype, flow.float32)
+    ref = acc * scale + bias
+    test_case.assertTrue(np.allclose(out.numpy(), ref, atol=1e-4, rtol=1e-4))
+
+    out = flow._C.quantized_matmul(
+        a_tensor,
+        b_tensor,
+        scale=flow.tensor(scale),
+        bias=flow.tensor(bias),
+        transpose_a=transpose_a,
+        transpose_b=transpose_b,
+        out_dtype=flow.int8,
+    )
+    test_case.assertEqual(out.dtype, flow.int8)
+    ref = np.clip(np.rint(ref), -128, 127)
+    test_case.assertTrue(np.abs(out.numpy().astype(np.float32) - ref).max() <= 1)
+
+
+def _test_quantized_conv2d(test_case, shape, filters, kernel_size, stride, padding):
+    x = _randint8(shape)
+    weight = _randint8((filters, shape[1], kernel_size, kernel_size))
+    scale = np.random.uniform(1e-4, 1e-3, size=(filters,)).astype(np.float32)
+    bias = np.random.uniform(-1, 1, size=(filters,)).astype(np.float32)
+    acc = flow._C.conv2d(
+        flow.tensor(x.astype(np.float64)),
+        flow.tensor(weight.astype(np.float64)),
+        stride=stride,
+        padding=padding,
+    ).numpy()
+
+    out = flow._C.quantized_conv2d(
+        flow.tensor(x), flow.tensor(weight), stride=stride, padding=padding
+    )
+    test_case.assertEqual(out.dtype, flow.int32)
+    test_case.assertTrue(np.array_equal(out.numpy(), acc))
+
+    out = flow._C.quantized_conv2d(
+        flow.tensor(x),
+        flow.tensor(weight),
+        scale=flow.tensor(scale),
+        bias=flow.tensor(bias),
+        stride=stride,
+        padding=padding,
+    )
+    ref = acc * scale.reshape(1, -1, 1, 1) + bias.reshape(1, -1, 1, 1)
+    test_case.assertTrue(np.allclose(out.numpy(), ref, atol=1e-4, rtol=1e-4))
+
+    out = flow._C.quantized_conv2d(
+        flow.tensor(x.transpose(0, 2, 3, 1)),
+        flow.tensor(weight.transpose(0, 2, 3, 1)),
+        scale=flow.tensor(scale),
+        bias=flow.tensor(bias),
+        stride=stride,
+        padding=padding,
+        channel_pos="channels_last",
+    )
+    test_case.assertTrue(
+        np.allclose(out.numpy(), ref.transpose(0, 2, 3, 1), atol=1e-4, rtol=1e-4)
+    )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestQuantizedMatmul(flow.unittest.TestCase):
+    def test_quantized_matmul(test_case):
+        for transpose_a in [False, True]:
+            for transpose_b in [False, True]:
+                _test_quantized_matmul(test_case, 1, 64, 32, transpose_a, transpose_b)
+                _test_quantized_matmul(test_case, 67, 300, 129, transpose_a, transpose_b)
+
+    def test_quantized_conv2d(test_case):
+        _test_quantized_conv2d(test_case, (2, 16, 14, 14), 32, 3, 1, 1)
+        _test_quantized_conv2d(test_case, (1, 3, 15, 17), 8, 3, 2, 0)
+        _test_quantized_conv2d(test_case, (2, 32, 7, 7), 16, 1, 1, 0)
+
+
+if __name__ == "__main__":
+    unittest.main()